@@ -0,0 +1,77 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+/// <param name="type">Call, one of <see cref="TYPE"/>.</param>
+CApiCmd::CApiCmd(int type) :
+  m_pNext(NULL),
+  m_nType(type),
+  m_bClearNVM(false),
+  m_dwSeed(0),
+  m_dwJobID(0)
+{
+}
+
+/// <summary>Makes the call.</summary>
+/// <param name="pTarget">Pointer to object to be called, i.e. current state.
+/// </param>
+void CApiCmd::Execute(CState* pTarget)
+{
+  switch(m_nType)
+  {
+  case TYPE_SUSPEND         : pTarget->Suspend(); break;
+  case TYPE_RESUME          : pTarget->Resume(); break;
+  case TYPE_SELF_TEST       : pTarget->SelfTest(m_bClearNVM); break;
+  case TYPE_GAT_REPORT      : pTarget->RqGATReport(); break;
+  case TYPE_CRC             : pTarget->CalculateCRC(m_dwSeed); break;
+  case TYPE_DEFINE_GRAPHIC  : pTarget->DefineGraphic(m_Graphic); break;
+  case TYPE_DEFINE_REGION   : pTarget->DefineRegion(m_Region); break;
+  case TYPE_DEFINE_TEMPL    : pTarget->DefineTemplate(m_Templ); break;
+  case TYPE_PRINT           : pTarget->PrintJob(m_Job, m_dwJobID); break;
+  case TYPE_FORM_FEED       : pTarget->FormFeed(); break;
+  case TYPE_DEFINE_BATCH    :
+    // not taken, every definition is reported not attempted.
+    if(!pTarget->DefineBatch(m_Batch)) { m_Batch.Complete(); }
+    break;
+  } // switch...
+}
+
+/// <summary>Reports the call failed through the observer, after it threw or
+/// when it is dropped without being made.</summary>
+/// <param name="pContext">Pointer to context holding the observer.</param>
+/// <remarks>Definitions are reported with an identifier error, as arguments
+/// are checked when posted and only their content could be rejected. Print
+/// jobs are reported discarded, batches with every definition not attempted.
+/// Calls without failure event are not reported.</remarks>
+void CApiCmd::Fail(CPrinterContext* pContext)
+{
+  switch(m_nType)
+  {
+  case TYPE_DEFINE_GRAPHIC:
+    if(pContext->m_pEvtObserver != NULL)
+    {
+      pContext->m_Events.Post(EVT_DEFINE_GRAPHIC_FAILED, print::IObserver::GRAPH_ERR_ID);
+    }
+    break;
+  case TYPE_DEFINE_REGION:
+    if(pContext->m_pEvtObserver != NULL)
+    {
+      pContext->m_Events.Post(EVT_DEFINE_REGION_FAILED, print::IObserver::REGION_ERR_ID);
+    }
+    break;
+  case TYPE_DEFINE_TEMPL:
+    if(pContext->m_pEvtObserver != NULL)
+    {
+      pContext->m_Events.Post(EVT_DEFINE_TEMPL_FAILED, print::IObserver::TEMPL_ERR_ID);
+    }
+    break;
+  case TYPE_PRINT:
+    pContext->FailPrintJob(m_dwJobID);
+    break;
+  case TYPE_DEFINE_BATCH:
+    m_Batch.Complete();
+    break;
+  default:
+    break;
+  } // switch...
+}
@@ -0,0 +1,70 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+CCmdMailbox::CCmdMailbox() :
+  m_pHead(NULL)
+{
+}
+
+/// <summary>Destructor.</summary>
+CCmdMailbox::~CCmdMailbox()
+{
+  Clear();
+}
+
+/// <summary>Posts a call, may be called by any thread.</summary>
+/// <param name="pCmd">Call allocated with new, owned by this object from now
+/// on.</param>
+/// <remarks>Nodes are only ever pushed here, so the compare and swap is not
+/// exposed to ABA.</remarks>
+void CCmdMailbox::Post(CApiCmd* pCmd)
+{
+  CApiCmd *pOld;
+
+  if(pCmd == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"pCmd"); }
+
+  do
+  {
+    pOld = m_pHead;
+    pCmd->m_pNext = pOld;
+  }
+  while(::InterlockedCompareExchangePointer((PVOID volatile*)&m_pHead, pCmd,
+    pOld) != pOld);
+}
+
+/// <summary>Takes every posted call, called by consumer only.</summary>
+/// <returns>Calls linked through <see cref="CApiCmd::m_pNext"/>, oldest first,
+/// NULL if none. Caller deletes each of them.</returns>
+CApiCmd* CCmdMailbox::TakeAll()
+{
+  CApiCmd *pCmd, *pNext, *pFirst = NULL;
+
+  if(m_pHead == NULL) { return NULL; }
+
+  pCmd = (CApiCmd*)::InterlockedExchangePointer((PVOID volatile*)&m_pHead, NULL);
+
+  // newest first to oldest first.
+  while(pCmd != NULL)
+  {
+    pNext = pCmd->m_pNext;
+    pCmd->m_pNext = pFirst;
+    pFirst = pCmd;
+    pCmd = pNext;
+  } // while...
+
+  return pFirst;
+}
+
+/// <summary>Discards every posted call, called by consumer only.</summary>
+void CCmdMailbox::Clear()
+{
+  CApiCmd *pCmd = TakeAll(), *pNext;
+
+  while(pCmd != NULL)
+  {
+    pNext = pCmd->m_pNext;
+    delete pCmd;
+    pCmd = pNext;
+  } // while...
+}
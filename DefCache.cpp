@@ -0,0 +1,325 @@
+#include "stdafx.h"
+#include "printer.h"
+
+#define FNV_OFFSET_BASIS  0xCBF29CE484222325ULL
+#define FNV_PRIME         0x00000100000001B3ULL
+
+#define DEF_CACHE_KEY(kind, id) ( ((DWORD)(kind) << 16) | ((DWORD)(id) & 0xFFFF) )
+
+/// <summary>Constructor.</summary>
+CDefCache::CDefCache() :
+  m_nCount(0),
+  m_bVerified(false),
+  m_bDirty(false)
+{
+}
+
+/// <summary>Loads entries saved by previous session.</summary>
+/// <param name="file">Path of file to persist entries, NULL or empty to disable
+/// the cache.</param>
+/// <remarks>Loaded entries are not used until printer reports the firmware
+/// version they were saved with, see <see cref="SetVersion"/>. A missing or
+/// malformed file leaves the cache empty.</remarks>
+void CDefCache::Load(const wchar_t* file)
+{
+  FILE *pFile;
+  wchar_t ver[64];
+  unsigned int key;
+  ULONGLONG hash;
+
+  m_nCount = 0;
+  m_strVersion = CWkString();
+  m_bVerified = false;
+  m_bDirty = false;
+  m_strFile = (file != NULL) ? file : L"";
+  if(m_strFile.GetLength() <= 0) { return; }
+
+  pFile = _wfopen(m_strFile, L"r");
+  if(pFile == NULL) { return; }
+
+  if(fwscanf(pFile, L"%63s", ver) == 1)
+  {
+    m_strVersion = ver;
+    while( (m_nCount < DEF_CACHE_SIZE) &&
+      (fwscanf(pFile, L"%x %I64x", &key, &hash) == 2) )
+    {
+      m_aEntry[m_nCount].m_dwKey = key;
+      m_aEntry[m_nCount].m_ullHash = hash;
+      m_nCount++;
+    } // while...
+  } // if...
+  fclose(pFile);
+}
+
+/// <summary>Binds entries to firmware version reported by printer.</summary>
+/// <param name="ver">Printer software version.</param>
+/// <remarks>Entries of a different firmware version are discarded.</remarks>
+void CDefCache::SetVersion(const wchar_t* ver)
+{
+  if(m_bVerified && (m_strVersion == ver)) { return; }
+
+  if(m_strVersion != ver)
+  {
+    m_nCount = 0;
+    m_strVersion = ver;
+    Save();
+  }
+  m_bVerified = true;
+}
+
+/// <summary>Discards all entries, e.g. printer lost its definitions.</summary>
+void CDefCache::Invalidate()
+{
+  if(m_nCount == 0) { return; }
+
+  m_nCount = 0;
+  Save();
+}
+
+/// <summary>Checks if printer already holds identical graphic.</summary>
+/// <param name="graphic">Graphic.</param>
+/// <returns>True if identical graphic was defined, false otherwise.</returns>
+/// <exception cref="wcl::CArgumentException">If <paramref name="graphic"/> is
+/// invalid.</exception>
+bool CDefCache::IsDefined(const print::CGraphic& graphic)
+{
+  CMsgLibManage msg;
+
+  if(!m_bVerified || (m_nCount == 0)) { return false; }
+
+  msg.m_pGraphic = &graphic;
+  return IsDefined(DEF_CACHE_KEY(KIND_GRAPHIC, graphic.m_byID), Hash(msg));
+}
+
+/// <summary>Checks if printer already holds identical region.</summary>
+/// <param name="region">Region.</param>
+/// <returns>True if identical region was defined, false otherwise.</returns>
+/// <exception cref="wcl::CArgumentException">If <paramref name="region"/> is
+/// invalid.</exception>
+bool CDefCache::IsDefined(const print::CRegion& region)
+{
+  CMsgDefineRegion msg;
+
+  if(!m_bVerified || (m_nCount == 0)) { return false; }
+
+  msg.m_pRegion = &region;
+  return IsDefined(DEF_CACHE_KEY(KIND_REGION, region.m_nsID), Hash(msg));
+}
+
+/// <summary>Checks if printer already holds identical template.</summary>
+/// <param name="templ">Template.</param>
+/// <returns>True if identical template was defined, false otherwise.</returns>
+/// <exception cref="wcl::CArgumentException">If <paramref name="templ"/> is
+/// invalid.</exception>
+bool CDefCache::IsDefined(const print::CTemplate& templ)
+{
+  CMsgDefineTempl msg;
+
+  if(!m_bVerified || (m_nCount == 0)) { return false; }
+
+  msg.m_pTemplate = &templ;
+  return IsDefined(DEF_CACHE_KEY(KIND_TEMPL, templ.m_nsID), Hash(msg));
+}
+
+/// <summary>Records graphic accepted by printer.</summary>
+/// <param name="graphic">Graphic.</param>
+void CDefCache::Add(const print::CGraphic& graphic)
+{
+  CMsgLibManage msg;
+
+  if(!m_bVerified || (m_strFile.GetLength() <= 0)) { return; }
+
+  msg.m_pGraphic = &graphic;
+  try { Add(DEF_CACHE_KEY(KIND_GRAPHIC, graphic.m_byID), Hash(msg)); }
+  catch(...) {}
+}
+
+/// <summary>Records region accepted by printer.</summary>
+/// <param name="region">Region.</param>
+void CDefCache::Add(const print::CRegion& region)
+{
+  CMsgDefineRegion msg;
+
+  if(!m_bVerified || (m_strFile.GetLength() <= 0)) { return; }
+
+  msg.m_pRegion = &region;
+  try { Add(DEF_CACHE_KEY(KIND_REGION, region.m_nsID), Hash(msg)); }
+  catch(...) {}
+}
+
+/// <summary>Records template accepted by printer.</summary>
+/// <param name="templ">Template.</param>
+void CDefCache::Add(const print::CTemplate& templ)
+{
+  CMsgDefineTempl msg;
+
+  if(!m_bVerified || (m_strFile.GetLength() <= 0)) { return; }
+
+  msg.m_pTemplate = &templ;
+  try { Add(DEF_CACHE_KEY(KIND_TEMPL, templ.m_nsID), Hash(msg)); }
+  catch(...) {}
+}
+
+/// <summary>Forgets a definition, e.g. it is being replaced.</summary>
+/// <param name="kind">Kind of definition, one of <see cref="KIND"/>.</param>
+/// <param name="id">Identifier of definition.</param>
+void CDefCache::Remove(int kind, int id)
+{
+  int i = Find(DEF_CACHE_KEY(kind, id));
+
+  if(i < 0) { return; }
+
+  m_aEntry[i] = m_aEntry[--m_nCount];
+  SetDirty();
+}
+
+/// <summary>Writes entries to file if they changed since last written.
+/// </summary>
+/// <remarks>Called once a batch of changes is done, e.g. when the printer goes
+/// idle, instead of writing the file for every definition.</remarks>
+void CDefCache::Flush()
+{
+  if(m_bDirty) { Save(); }
+}
+
+/// <summary>Computes hash of define command bytes.</summary>
+/// <param name="msg">Define command.</param>
+/// <returns>64-bit FNV-1a hash.</returns>
+/// <exception cref="wcl::CArgumentException">If definition is invalid.</exception>
+ULONGLONG CDefCache::Hash(CMsg& msg)
+{
+  DWORD i, size;
+  BYTE *pData;
+  ULONGLONG hash = FNV_OFFSET_BASIS;
+
+  m_Sink.Clear();
+  msg.Encode(m_Sink);
+
+  pData = m_Sink.GetData();
+  size = m_Sink.GetSize();
+  for(i = 0;i < size;i++)
+  {
+    hash ^= pData[i];
+    hash *= FNV_PRIME;
+  } // for...
+
+  return hash;
+}
+
+/// <summary>Finds entry of a key.</summary>
+/// <param name="key">Kind and identifier.</param>
+/// <returns>Index into <see cref="m_aEntry"/>, -1 if not found.</returns>
+int CDefCache::Find(DWORD key)
+{
+  int i;
+
+  for(i = 0;i < m_nCount;i++)
+  {
+    if(m_aEntry[i].m_dwKey == key) { return i; }
+  } // for...
+
+  return -1;
+}
+
+/// <summary>Checks if entry of a key holds a hash.</summary>
+/// <param name="key">Kind and identifier.</param>
+/// <param name="hash">Hash of define command bytes.</param>
+/// <returns>True if matched, false otherwise.</returns>
+bool CDefCache::IsDefined(DWORD key, ULONGLONG hash)
+{
+  int i = Find(key);
+
+  return (i >= 0) && (m_aEntry[i].m_ullHash == hash);
+}
+
+/// <summary>Adds or replaces entry of a key.</summary>
+/// <param name="key">Kind and identifier.</param>
+/// <param name="hash">Hash of define command bytes.</param>
+/// <remarks>If the cache is full the definition is not recorded, it will
+/// simply be sent again next time.</remarks>
+void CDefCache::Add(DWORD key, ULONGLONG hash)
+{
+  int i = Find(key);
+
+  if((i >= 0) && (m_aEntry[i].m_ullHash == hash)) { return; }
+  if(i < 0)
+  {
+    if(m_nCount >= DEF_CACHE_SIZE) { return; }
+    i = m_nCount++;
+  }
+  m_aEntry[i].m_dwKey = key;
+  m_aEntry[i].m_ullHash = hash;
+  SetDirty();
+}
+
+/// <summary>Marks entries changed, to be written by <see cref="Flush"/>.
+/// </summary>
+/// <remarks>File is deleted on first change, so if the driver stops before
+/// <see cref="Flush"/> no stale entry is loaded next session, definitions are
+/// simply sent again.</remarks>
+void CDefCache::SetDirty()
+{
+  if(m_bDirty) { return; }
+
+  m_bDirty = true;
+  if(m_strFile.GetLength() > 0) { ::DeleteFile(m_strFile); }
+}
+
+/// <summary>Writes entries to <see cref="m_strFile"/>.</summary>
+/// <remarks>Entries are written to a temporary file which then replaces the
+/// previous one, so an interrupted write never leaves a partial cache. If
+/// writing fails the file is deleted, so stale entries are never loaded.</remarks>
+void CDefCache::Save()
+{
+  FILE *pFile;
+  CWkString tmpFile;
+  int i;
+  bool ok;
+
+  m_bDirty = false;
+  if(m_strFile.GetLength() <= 0) { return; }
+
+  tmpFile = m_strFile;
+  tmpFile += L".tmp";
+
+  pFile = _wfopen(tmpFile, L"w");
+  ok = (pFile != NULL);
+  if(ok)
+  {
+    ok = (fwprintf(pFile, L"%s\n",
+      (m_strVersion.GetLength() > 0) ? (const wchar_t*)m_strVersion : L"-") > 0);
+    for(i = 0;ok && (i < m_nCount);i++)
+    {
+      ok = (fwprintf(pFile, L"%08X %016I64X\n", m_aEntry[i].m_dwKey,
+        m_aEntry[i].m_ullHash) > 0);
+    } // for...
+    ok = (fclose(pFile) == 0) && ok;
+  } // if...
+
+  if(!ok || !::MoveFileEx(tmpFile, m_strFile, MOVEFILE_REPLACE_EXISTING))
+  {
+    ::DeleteFile(tmpFile);
+    ::DeleteFile(m_strFile);
+  }
+}
+
+/// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
+/// <param name="pElem">Pointer to XML DOM element.</param>
+void CDefCache::Dump(MSXML2::IXMLDOMElement* pElem)
+{
+  try
+  {
+
+    if(pElem != NULL)
+    {
+      wcl::CDumpHelper::DumpAttr<const wchar_t*>(pElem, L"m_strFile", m_strFile);
+      wcl::CDumpHelper::DumpAttr<const wchar_t*>(pElem, L"m_strVersion",
+        m_strVersion);
+      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bVerified", m_bVerified);
+      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bDirty", m_bDirty);
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"m_nCount", m_nCount);
+    } // if...
+
+  }
+  catch(...) {}
+}
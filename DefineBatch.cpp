@@ -0,0 +1,174 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+CDefineBatch::CDefineBatch() :
+  m_aGraphic(NULL),
+  m_nGraphicCnt(0),
+  m_aRegion(NULL),
+  m_nRegionCnt(0),
+  m_aTemplate(NULL),
+  m_nTemplCnt(0),
+  m_aResult(NULL),
+  m_nIndex(0),
+  m_pObserver(NULL)
+{
+}
+
+/// <summary>Destructor.</summary>
+CDefineBatch::~CDefineBatch()
+{
+  Clear();
+}
+
+/// <summary>Copies definitions to be uploaded.</summary>
+/// <param name="batch">Definitions.</param>
+/// <exception cref="wcl::CArgumentException">If a count is negative, or an
+/// array is NULL while its count is not zero.</exception>
+void CDefineBatch::Assign(const SDefineBatch& batch)
+{
+  int i;
+
+  if( (batch.m_nGraphicCnt < 0) || (batch.m_nRegionCnt < 0) ||
+    (batch.m_nTemplCnt < 0) )
+  {
+    WCL_THROW_ARGUMENTEXCEPTION(L"batch", L"count cannot be negative");
+  }
+  if( ((batch.m_nGraphicCnt > 0) && (batch.m_pGraphics == NULL)) ||
+    ((batch.m_nRegionCnt > 0) && (batch.m_pRegions == NULL)) ||
+    ((batch.m_nTemplCnt > 0) && (batch.m_pTemplates == NULL)) )
+  {
+    WCL_THROW_ARGUMENTEXCEPTION(L"batch", L"missing definitions");
+  }
+
+  Clear();
+
+  try
+  {
+    m_nGraphicCnt = batch.m_nGraphicCnt;
+    m_nRegionCnt = batch.m_nRegionCnt;
+    m_nTemplCnt = batch.m_nTemplCnt;
+
+    if(m_nGraphicCnt > 0)
+    {
+      m_aGraphic = new print::CGraphic[m_nGraphicCnt];
+      if(m_aGraphic == NULL) { throw wcl::COutOfMemoryException(); }
+      for(i = 0;i < m_nGraphicCnt;i++) { m_aGraphic[i] = batch.m_pGraphics[i]; }
+    }
+    if(m_nRegionCnt > 0)
+    {
+      m_aRegion = new print::CRegion[m_nRegionCnt];
+      if(m_aRegion == NULL) { throw wcl::COutOfMemoryException(); }
+      for(i = 0;i < m_nRegionCnt;i++) { m_aRegion[i] = batch.m_pRegions[i]; }
+    }
+    if(m_nTemplCnt > 0)
+    {
+      m_aTemplate = new print::CTemplate[m_nTemplCnt];
+      if(m_aTemplate == NULL) { throw wcl::COutOfMemoryException(); }
+      for(i = 0;i < m_nTemplCnt;i++) { m_aTemplate[i] = batch.m_pTemplates[i]; }
+    }
+
+    m_aResult = new SDefineResult[__max(1, GetCount())];
+    if(m_aResult == NULL) { throw wcl::COutOfMemoryException(); }
+    for(i = 0;i < GetCount();i++)
+    {
+      m_aResult[i].m_bSuccess = false;
+      m_aResult[i].m_nErr = -1;
+    }
+  }
+  catch(...)
+  {
+    Clear();
+    throw;
+  }
+
+  m_nIndex = 0;
+  m_pObserver = batch.m_pObserver;
+}
+
+/// <summary>Takes over definitions of another batch.</summary>
+/// <param name="src">Batch whose definitions are taken, left empty.</param>
+void CDefineBatch::Take(CDefineBatch& src)
+{
+  if(&src == this) { return; }
+
+  Clear();
+
+  m_aGraphic = src.m_aGraphic;
+  m_nGraphicCnt = src.m_nGraphicCnt;
+  m_aRegion = src.m_aRegion;
+  m_nRegionCnt = src.m_nRegionCnt;
+  m_aTemplate = src.m_aTemplate;
+  m_nTemplCnt = src.m_nTemplCnt;
+  m_aResult = src.m_aResult;
+  m_nIndex = src.m_nIndex;
+  m_pObserver = src.m_pObserver;
+
+  src.m_aGraphic = NULL;
+  src.m_aRegion = NULL;
+  src.m_aTemplate = NULL;
+  src.m_aResult = NULL;
+  src.Clear();
+}
+
+/// <summary>Releases definitions.</summary>
+void CDefineBatch::Clear()
+{
+  delete[] m_aGraphic;
+  delete[] m_aRegion;
+  delete[] m_aTemplate;
+  delete[] m_aResult;
+
+  m_aGraphic = NULL;
+  m_aRegion = NULL;
+  m_aTemplate = NULL;
+  m_aResult = NULL;
+  m_nGraphicCnt = 0;
+  m_nRegionCnt = 0;
+  m_nTemplCnt = 0;
+  m_nIndex = 0;
+  m_pObserver = NULL;
+}
+
+/// <summary>Records result of definition in progress.</summary>
+/// <param name="success">True if defined successfully, false otherwise.</param>
+/// <param name="err">Error code if failed.</param>
+void CDefineBatch::SetResult(bool success, int err)
+{
+  if((m_nIndex < 0) || (m_nIndex >= GetCount())) { return; }
+
+  m_aResult[m_nIndex].m_bSuccess = success;
+  m_aResult[m_nIndex].m_nErr = success ? 0 : err;
+}
+
+/// <summary>Notifies observer of results and releases definitions.</summary>
+/// <remarks>Definitions not yet processed are reported as not attempted.</remarks>
+void CDefineBatch::Complete()
+{
+  IDefineBatchObserver *pObserver = m_pObserver;
+
+  if(m_aResult == NULL) { return; }
+
+  if(pObserver != NULL) { pObserver->OnDefineBatchCompleted(m_aResult, GetCount()); }
+  Clear();
+}
+
+/// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
+/// <param name="pElem">Pointer to XML DOM element.</param>
+void CDefineBatch::Dump(MSXML2::IXMLDOMElement* pElem)
+{
+  try
+  {
+
+    if(pElem != NULL)
+    {
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"m_nGraphicCnt", m_nGraphicCnt);
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"m_nRegionCnt", m_nRegionCnt);
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"m_nTemplCnt", m_nTemplCnt);
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"m_nIndex", m_nIndex);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_pObserver", (DWORD)m_pObserver);
+    } // if...
+
+  }
+  catch(...) {}
+}
@@ -0,0 +1,282 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+CDrvStats::CDrvStats()
+{
+  Reset();
+}
+
+/// <summary>Clears all statistics.</summary>
+void CDrvStats::Reset()
+{
+  int i;
+
+  m_cs.Enter();
+  memset(&m_Stats, 0, sizeof(m_Stats));
+  for(i = 0;i < LATENCY_CMD_CNT;i++) { m_Stats.m_aLatency[i].m_dwMin = 0xFFFFFFFF; }
+  m_Stats.m_EvtLatency.m_dwMin = 0xFFFFFFFF;
+  m_ullCmdTime = 0;
+  m_ullPrevCmdTime = 0;
+  m_cs.Leave();
+}
+
+/// <summary>Retrieves snapshot of statistics.</summary>
+/// <param name="stats">Receives statistics.</param>
+void CDrvStats::Get(SDriverStats& stats)
+{
+  int i;
+
+  m_cs.Enter();
+  stats = m_Stats;
+  m_cs.Leave();
+
+  for(i = 0;i < LATENCY_CMD_CNT;i++)
+  {
+    if(stats.m_aLatency[i].m_dwCount == 0) { stats.m_aLatency[i].m_dwMin = 0; }
+  } // for...
+  if(stats.m_EvtLatency.m_dwCount == 0) { stats.m_EvtLatency.m_dwMin = 0; }
+}
+
+/// <summary>Records a command written to printer, starting its round trip.
+/// </summary>
+/// <param name="time">Time command was written, in microseconds of
+/// <see cref="CPrinterPort::GetTime"/>.</param>
+void CDrvStats::AddCmd(ULONGLONG time)
+{
+  m_cs.Enter();
+  m_ullPrevCmdTime = m_ullCmdTime;
+  m_ullCmdTime = time;
+  m_cs.Leave();
+}
+
+/// <summary>Records round trip of a command completed by a printer response.
+/// </summary>
+/// <param name="cmd">Command, one of <see cref="LATENCY_CMD"/>.</param>
+/// <param name="rxTime">Receive time of completing response, in microseconds
+/// of <see cref="CPrinterPort::GetTime"/>.</param>
+/// <remarks>If the next command was already written before the completing
+/// response was handled, e.g. next queued print job, round trip is measured
+/// from the command before. Called only when the command succeeded, so failed,
+/// interrupted and timed out commands do not skew the histograms.</remarks>
+void CDrvStats::AddLatency(int cmd, ULONGLONG rxTime)
+{
+  ULONGLONG start;
+
+  if((cmd < 0) || (cmd >= LATENCY_CMD_CNT)) { return; }
+
+  m_cs.Enter();
+  start = (m_ullCmdTime <= rxTime) ? m_ullCmdTime : m_ullPrevCmdTime;
+  if((start > 0) && (start <= rxTime))
+  {
+    AddValue(m_Stats.m_aLatency[cmd], rxTime - start);
+  } // if...
+  m_cs.Leave();
+}
+
+/// <summary>Records a command re-sent.</summary>
+void CDrvStats::AddResend()
+{
+  m_cs.Enter();
+  m_Stats.m_dwResendCnt++;
+  m_cs.Leave();
+}
+
+/// <summary>Records a command error reported by printer.</summary>
+void CDrvStats::AddCmdErr()
+{
+  m_cs.Enter();
+  m_Stats.m_dwCmdErrCnt++;
+  m_cs.Leave();
+}
+
+/// <summary>Records a disconnection.</summary>
+void CDrvStats::AddDisconnect()
+{
+  m_cs.Enter();
+  m_Stats.m_dwDisconnectCnt++;
+  m_cs.Leave();
+}
+
+/// <summary>Records received bytes discarded.</summary>
+/// <param name="cnt">Number of bytes.</param>
+void CDrvStats::AddDiscarded(DWORD cnt)
+{
+  m_cs.Enter();
+  m_Stats.m_dwDiscardedBytes += cnt;
+  m_cs.Leave();
+}
+
+/// <summary>Records bytes written to port.</summary>
+/// <param name="cnt">Number of bytes.</param>
+void CDrvStats::AddWritten(DWORD cnt)
+{
+  m_cs.Enter();
+  m_Stats.m_ullBytesWritten += cnt;
+  m_cs.Leave();
+}
+
+/// <summary>Records bytes read from port.</summary>
+/// <param name="cnt">Number of bytes.</param>
+void CDrvStats::AddRead(DWORD cnt)
+{
+  m_cs.Enter();
+  m_Stats.m_ullBytesRead += cnt;
+  m_cs.Leave();
+}
+
+/// <summary>Records delivery of an observer event.</summary>
+/// <param name="value">Time from event posted to observer returning, in
+/// microseconds.</param>
+void CDrvStats::AddEvtLatency(ULONGLONG value)
+{
+  m_cs.Enter();
+  AddValue(m_Stats.m_EvtLatency, value);
+  m_cs.Leave();
+}
+
+/// <summary>Records observer events coalesced away.</summary>
+/// <param name="cnt">Number of events.</param>
+void CDrvStats::AddEvtCoalesced(DWORD cnt)
+{
+  m_cs.Enter();
+  m_Stats.m_dwEvtCoalesced += cnt;
+  m_cs.Leave();
+}
+
+/// <summary>Records an observer event dropped on full queue that could not
+/// grow.</summary>
+void CDrvStats::AddEvtDropped()
+{
+  m_cs.Enter();
+  m_Stats.m_dwEvtDropped++;
+  m_cs.Leave();
+}
+
+/// <summary>Records a state machine run longer than
+/// <see cref="REACTOR_STALL_MAX"/>.</summary>
+void CDrvStats::AddStall()
+{
+  m_cs.Enter();
+  m_Stats.m_dwStallCnt++;
+  m_cs.Leave();
+}
+
+/// <summary>Records a state machine run delayed by more than
+/// <see cref="REACTOR_STALL_MAX"/> past its due time.</summary>
+/// <param name="time">Delay beyond the bound, not charged to the state
+/// machine's timers, in milliseconds.</param>
+void CDrvStats::AddLate(DWORD time)
+{
+  m_cs.Enter();
+  m_Stats.m_dwLateCnt++;
+  m_Stats.m_ullLateTime += time;
+  m_cs.Leave();
+}
+
+/// <summary>Counts a value in a histogram, called with
+/// <see cref="m_cs"/> held.</summary>
+/// <param name="hist">Histogram.</param>
+/// <param name="value">Value, in microseconds.</param>
+void CDrvStats::AddValue(SLatencyHist& hist, ULONGLONG value)
+{
+  value = __min(value, 0xFFFFFFFF);
+  hist.m_dwCount++;
+  hist.m_dwMin = __min(hist.m_dwMin, (DWORD)value);
+  hist.m_dwMax = __max(hist.m_dwMax, (DWORD)value);
+  hist.m_ullSum += value;
+  hist.m_adwBucket[GetBucket(value)]++;
+}
+
+/// <summary>Retrieves bucket of <see cref="SLatencyHist"/> counting a value.
+/// </summary>
+/// <param name="value">Value, in microseconds.</param>
+/// <returns>Bucket index, values beyond range count in last bucket.</returns>
+int CDrvStats::GetBucket(ULONGLONG value)
+{
+  int msb = 0;
+  DWORD dwValue = (DWORD)__min(value, 0xFFFFFFFF);
+
+  if(dwValue < LATENCY_SUB_BUCKETS) { return (int)dwValue; }
+
+  while((dwValue >> msb) > 1) { msb++; }
+
+  // msb is at least 3, as value is at least 8.
+  return (msb - 2) * LATENCY_SUB_BUCKETS +
+    (int)((dwValue >> (msb - 3)) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+/// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
+/// <param name="pElem">Pointer to XML DOM element.</param>
+void CDrvStats::Dump(MSXML2::IXMLDOMElement* pElem)
+{
+  int i;
+  CWkString strTmp;
+  SDriverStats stats;
+  MSXML2::IXMLDOMElement *pChild = NULL;
+
+  try
+  {
+
+    if(pElem != NULL)
+    {
+      Get(stats);
+
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwResendCnt",
+        stats.m_dwResendCnt);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwCmdErrCnt",
+        stats.m_dwCmdErrCnt);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwDisconnectCnt",
+        stats.m_dwDisconnectCnt);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwDiscardedBytes",
+        stats.m_dwDiscardedBytes);
+      strTmp.Format(L"%I64u", stats.m_ullBytesWritten);
+      wcl::CDumpHelper::DumpAttr<const wchar_t*>(pElem, L"m_ullBytesWritten",
+        strTmp);
+      strTmp.Format(L"%I64u", stats.m_ullBytesRead);
+      wcl::CDumpHelper::DumpAttr<const wchar_t*>(pElem, L"m_ullBytesRead",
+        strTmp);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwEvtCoalesced",
+        stats.m_dwEvtCoalesced);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwEvtDropped",
+        stats.m_dwEvtDropped);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwStallCnt",
+        stats.m_dwStallCnt);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwLateCnt",
+        stats.m_dwLateCnt);
+      strTmp.Format(L"%I64u", stats.m_ullLateTime);
+      wcl::CDumpHelper::DumpAttr<const wchar_t*>(pElem, L"m_ullLateTime",
+        strTmp);
+
+      for(i = 0;i < LATENCY_CMD_CNT;i++)
+      {
+        if(!CXmlUtil::AppendChild(pElem, L"m_aLatency", &pChild)) { throw false; }
+
+        wcl::CDumpHelper::DumpAttr<int>(pChild, L"cmd", i);
+        DumpHist(pChild, stats.m_aLatency[i]);
+        SAFE_RELEASE(pChild);
+      } // for...
+
+      if(!CXmlUtil::AppendChild(pElem, L"m_EvtLatency", &pChild)) { throw false; }
+      DumpHist(pChild, stats.m_EvtLatency);
+      SAFE_RELEASE(pChild);
+    } // if...
+
+  }
+  catch(...) {}
+  SAFE_RELEASE(pChild);
+}
+
+/// <summary>Dumps a histogram summary into XML DOM element.</summary>
+/// <param name="pElem">Pointer to XML DOM element.</param>
+/// <param name="hist">Histogram.</param>
+void CDrvStats::DumpHist(MSXML2::IXMLDOMElement* pElem, const SLatencyHist& hist)
+{
+  CWkString strTmp;
+
+  wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwCount", hist.m_dwCount);
+  wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwMin", hist.m_dwMin);
+  wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwMax", hist.m_dwMax);
+  strTmp.Format(L"%I64u", hist.m_dwCount ? hist.m_ullSum / hist.m_dwCount : 0);
+  wcl::CDumpHelper::DumpAttr<const wchar_t*>(pElem, L"mean", strTmp);
+}
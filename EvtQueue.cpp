@@ -0,0 +1,477 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Notifies observer of external power condition.</summary>
+/// <param name="pObserver">Observer.</param>
+/// <param name="set">True if condition is present, false otherwise.</param>
+static void NotifyExtPower(print::IEvtObserver* pObserver, bool set)
+{
+  if(set) { pObserver->OnExtPowerLost(); }
+  else { pObserver->OnExtPowerResumed(); }
+}
+
+#define NOTIFY_EVT(evtFunc) static void Notify##evtFunc(print::IEvtObserver* pObserver,\
+                              bool set)\
+                            {\
+                              pObserver->evtFunc(set);\
+                            }
+
+NOTIFY_EVT(OnFirmwareErr)
+NOTIFY_EVT(OnNVMErr)
+NOTIFY_EVT(OnPrintHeadErr)
+NOTIFY_EVT(OnTemperatureErr)
+NOTIFY_EVT(OnGeneralErr)
+NOTIFY_EVT(OnPrintHead)
+NOTIFY_EVT(OnPaperJam)
+NOTIFY_EVT(OnPaperEmpty)
+NOTIFY_EVT(OnTopOfForm)
+NOTIFY_EVT(OnChassis)
+NOTIFY_EVT(OnPaperLow)
+
+/// <summary>Observer notification of each condition event, indexed by
+/// <see cref="OBS_EVT"/>.</summary>
+static void (* const s_apfnNotify[EVT_COND_CNT])(print::IEvtObserver*, bool) =
+{
+  NotifyExtPower,         // EVT_EXT_POWER
+  NotifyOnFirmwareErr,    // EVT_FIRMWARE_ERR
+  NotifyOnNVMErr,         // EVT_NVM_ERR
+  NotifyOnPrintHeadErr,   // EVT_PRINT_HEAD_ERR
+  NotifyOnTemperatureErr, // EVT_TEMPERATURE_ERR
+  NotifyOnGeneralErr,     // EVT_GENERAL_ERR
+  NotifyOnPrintHead,      // EVT_PRINT_HEAD
+  NotifyOnPaperJam,       // EVT_PAPER_JAM
+  NotifyOnPaperEmpty,     // EVT_PAPER_EMPTY
+  NotifyOnTopOfForm,      // EVT_TOP_OF_FORM
+  NotifyOnChassis,        // EVT_CHASSIS
+  NotifyOnPaperLow        // EVT_PAPER_LOW
+};
+
+/// <summary>Retrieves index in <see cref="CEvtQueue::m_anPending"/> of an
+/// event.</summary>
+/// <param name="type">Event, one of <see cref="OBS_EVT"/>.</param>
+/// <returns>Index, -1 if event is never coalesced.</returns>
+static int GetPendingIndex(int type)
+{
+  if((type >= 0) && (type < EVT_COND_CNT)) { return type; }
+  if(type == EVT_STATUS_CHANGED) { return EVT_COND_CNT; }
+  if(type == EVT_UPLOAD_PROGRESS) { return EVT_COND_CNT + 1; }
+
+  return -1;
+}
+
+/// <summary>Constructor.</summary>
+/// <exception cref="wcl::COutOfMemoryException">If out of memory.</exception>
+CEvtQueue::CEvtQueue() :
+  m_pEvt(NULL),
+  m_nSize(EVT_QUEUE_SIZE),
+  m_nHead(0),
+  m_nCount(0),
+  m_hThread(NULL),
+  m_dwThreadID(0),
+  m_bStop(false),
+  m_pContext(NULL)
+{
+  memset(m_anPending, -1, sizeof(m_anPending));
+  ResetDelivered();
+
+  m_pEvt = new SObsEvt[m_nSize];
+  if(m_pEvt == NULL) { throw wcl::COutOfMemoryException(); }
+  m_hEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+/// <summary>Destructor.</summary>
+CEvtQueue::~CEvtQueue()
+{
+  Stop();
+  if(m_hEvent != NULL) { ::CloseHandle(m_hEvent); }
+  delete[] m_pEvt;
+}
+
+/// <summary>Starts dispatcher thread, if not running yet.</summary>
+/// <param name="pContext">Context holding observers and statistics, must stay
+/// valid until <see cref="Stop"/>.</param>
+/// <returns>True if dispatcher thread is running, false otherwise.</returns>
+/// <remarks>Events posted while stopped are delivered once started. Conditions
+/// are taken as last delivered in the state observers assume after
+/// initialization.</remarks>
+bool CEvtQueue::Start(CPrinterContext* pContext)
+{
+  if(pContext == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"pContext"); }
+
+  if(m_hThread != NULL)
+  {
+    if(!m_bStop) { return true; }
+
+    if(::GetCurrentThreadId() == m_dwThreadID)
+    {
+      // restarted from the observer call that stopped it, keep running.
+      m_pContext = pContext;
+      ResetDelivered();
+      m_bStop = false;
+      return true;
+    }
+
+    // thread asked to stop from its own observer call, wait for it to end.
+    ::WaitForSingleObject(m_hThread, INFINITE);
+    ::CloseHandle(m_hThread);
+    m_hThread = NULL;
+  } // if...
+  if(m_hEvent == NULL) { return false; }
+
+  m_pContext = pContext;
+  ResetDelivered();
+  m_bStop = false;
+  m_hThread = ::CreateThread(NULL, 0, CEvtQueue::_Run, this, 0, &m_dwThreadID);
+  if(m_hThread == NULL)
+  {
+    CLog::Log(L"[printdrv_fl_psa66st2r][CEvtQueue::Start] failed to CreateThread:%u\n",
+      GetLastError());
+    return false;
+  }
+
+  // deliver events posted before start.
+  ::SetEvent(m_hEvent);
+
+  return true;
+}
+
+/// <summary>Delivers every waiting event, then stops dispatcher thread.
+/// </summary>
+/// <remarks>If called from an observer call, the dispatcher thread is only
+/// asked to stop, as it cannot wait for itself.</remarks>
+void CEvtQueue::Stop()
+{
+  if(m_hThread == NULL) { return; }
+
+  m_bStop = true;
+  ::SetEvent(m_hEvent);
+
+  if(::GetCurrentThreadId() == m_dwThreadID) { return; }
+
+  ::WaitForSingleObject(m_hThread, INFINITE);
+  ::CloseHandle(m_hThread);
+  m_hThread = NULL;
+}
+
+/// <summary>Posts an event, may be called by any thread.</summary>
+/// <param name="type">Event, one of <see cref="OBS_EVT"/>.</param>
+/// <param name="arg0">First event argument.</param>
+/// <param name="arg1">Second event argument.</param>
+void CEvtQueue::Post(int type, DWORD arg0, DWORD arg1)
+{
+  SObsEvt evt;
+
+  evt.m_nType = type;
+  evt.m_adwArg[0] = arg0;
+  evt.m_adwArg[1] = arg1;
+  evt.m_ullTime = CPrinterPort::GetTime();
+  evt.m_szText[0] = L'\0';
+  Add(evt);
+}
+
+/// <summary>Posts an event with text argument, may be called by any thread.
+/// </summary>
+/// <param name="type">Event, one of <see cref="OBS_EVT"/>.</param>
+/// <param name="text">Text argument, truncated to
+/// <see cref="CMsgRespStatus::SOFTWARE_VER_SIZE"/> - 1 characters.</param>
+void CEvtQueue::PostText(int type, const wchar_t* text)
+{
+  SObsEvt evt;
+
+  if(text == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"text"); }
+
+  evt.m_nType = type;
+  evt.m_adwArg[0] = 0;
+  evt.m_adwArg[1] = 0;
+  evt.m_ullTime = CPrinterPort::GetTime();
+  wcsncpy_s(evt.m_szText, CMsgRespStatus::SOFTWARE_VER_SIZE, text, _TRUNCATE);
+  Add(evt);
+}
+
+/// <summary>Queues an event, coalescing it with a waiting one of the same
+/// condition.</summary>
+/// <param name="evt">Event.</param>
+/// <remarks>Queue grows when full, an event is only dropped if out of memory.
+/// </remarks>
+void CEvtQueue::Add(const SObsEvt& evt)
+{
+  int slot, index = GetPendingIndex(evt.m_nType);
+  DWORD coalesced = 0;
+  bool added = false, undone;
+
+  m_cs.Enter();
+  slot = (index >= 0) ? m_anPending[index] : -1;
+  if(slot >= 0)
+  {
+    SObsEvt& pending = m_pEvt[slot];
+
+    coalesced = 1;
+    if(index == EVT_COND_CNT)
+    {
+      // conditions changed again before host saw the first change.
+      pending.m_adwArg[1] = evt.m_adwArg[1];
+      undone = (pending.m_adwArg[0] == pending.m_adwArg[1]);
+    }
+    else if(index == EVT_COND_CNT + 1)
+    {
+      // only latest progress matters.
+      pending.m_adwArg[0] = evt.m_adwArg[0];
+      pending.m_adwArg[1] = evt.m_adwArg[1];
+      undone = false;
+    }
+    else
+    {
+      // host is to end up with the value posted last.
+      pending.m_adwArg[0] = evt.m_adwArg[0];
+      undone = (evt.m_adwArg[0] == m_adwDelivered[index]);
+    } // if...else...
+
+    // changed back to what host last saw, neither is delivered.
+    if(undone)
+    {
+      pending.m_nType = EVT_NONE;
+      m_anPending[index] = -1;
+      coalesced = 2;
+    }
+  }
+  else if((m_nCount < m_nSize) || Grow())
+  {
+    slot = (m_nHead + m_nCount) % m_nSize;
+    m_pEvt[slot] = evt;
+    m_nCount++;
+    if(index >= 0) { m_anPending[index] = slot; }
+    added = true;
+  } // if...
+  m_cs.Leave();
+
+  if(added)
+  {
+    ::SetEvent(m_hEvent);
+    return;
+  }
+  if(m_pContext == NULL) { return; }
+
+  if(coalesced > 0) { m_pContext->m_Port.m_Stats.AddEvtCoalesced(coalesced); }
+  else
+  {
+    TRACE(L"[printdrv_fl_psa66st2r][CEvtQueue::Add] event dropped, type:%d.\n",
+      evt.m_nType);
+    m_pContext->m_Port.m_Stats.AddEvtDropped();
+  }
+}
+
+/// <summary>Sets every condition last delivered to the value observers assume
+/// after initialization, see <see cref="CPrinterContext::ResetEvtMask"/>.
+/// </summary>
+void CEvtQueue::ResetDelivered()
+{
+  int i;
+
+  m_cs.Enter();
+  for(i = 0;i < EVT_COND_CNT;i++)
+  {
+    m_adwDelivered[i] = (STATUS_TOP_OF_FORM >> i) & 1;
+  }
+  m_cs.Leave();
+}
+
+/// <summary>Doubles number of slots, called with <see cref="m_cs"/> held.
+/// </summary>
+/// <returns>True if grown, false if out of memory.</returns>
+/// <remarks>Waiting events are moved to the start of the new slots, in
+/// posting order.</remarks>
+bool CEvtQueue::Grow()
+{
+  int i;
+  SObsEvt *pEvt;
+
+  try
+  {
+    pEvt = new SObsEvt[m_nSize * 2];
+  }
+  catch(...)
+  {
+    pEvt = NULL;
+  } // try...catch...
+  if(pEvt == NULL) { return false; }
+
+  for(i = 0;i < m_nCount;i++) { pEvt[i] = m_pEvt[(m_nHead + i) % m_nSize]; }
+  for(i = 0;i < EVT_COND_CNT + 2;i++)
+  {
+    if(m_anPending[i] >= 0)
+    {
+      m_anPending[i] = (m_anPending[i] - m_nHead + m_nSize) % m_nSize;
+    }
+  } // for...
+
+  delete[] m_pEvt;
+  m_pEvt = pEvt;
+  m_nHead = 0;
+  m_nSize *= 2;
+
+  return true;
+}
+
+/// <summary>Removes oldest event, called by dispatcher thread only.</summary>
+/// <param name="evt">Receives event.</param>
+/// <returns>True if an event was removed, false if queue is empty.</returns>
+bool CEvtQueue::Take(SObsEvt& evt)
+{
+  int index;
+  bool found = false;
+
+  m_cs.Enter();
+  while(!found && (m_nCount > 0))
+  {
+    SObsEvt& head = m_pEvt[m_nHead];
+
+    if(head.m_nType != EVT_NONE)
+    {
+      evt = head;
+      found = true;
+
+      index = GetPendingIndex(head.m_nType);
+      if((index >= 0) && (m_anPending[index] == m_nHead))
+      {
+        m_anPending[index] = -1;
+      }
+      if((index >= 0) && (index < EVT_COND_CNT))
+      {
+        m_adwDelivered[index] = head.m_adwArg[0];
+      }
+    } // if...
+
+    m_nHead = (m_nHead + 1) % m_nSize;
+    m_nCount--;
+  } // while...
+  m_cs.Leave();
+
+  return found;
+}
+
+/// <summary>Delivers an event to observer set in context.</summary>
+/// <param name="evt">Event.</param>
+void CEvtQueue::Dispatch(const SObsEvt& evt)
+{
+  CWkString strTmp;
+  print::IEvtObserver *pObserver = m_pContext->m_pEvtObserver;
+  IStatusObserver *pStatusObserver = m_pContext->m_pStatusObserver;
+
+  if(evt.m_nType == EVT_STATUS_CHANGED)
+  {
+    if(pStatusObserver != NULL)
+    {
+      pStatusObserver->OnStatusChanged(evt.m_adwArg[0], evt.m_adwArg[1]);
+    }
+    return;
+  }
+  if(evt.m_nType == EVT_UPLOAD_PROGRESS)
+  {
+    if(pStatusObserver != NULL)
+    {
+      pStatusObserver->OnUploadProgress(evt.m_adwArg[0], evt.m_adwArg[1]);
+    }
+    return;
+  }
+  if(pObserver == NULL) { return; }
+
+  if(evt.m_nType < EVT_COND_CNT)
+  {
+    s_apfnNotify[evt.m_nType](pObserver, evt.m_adwArg[0] != 0);
+    return;
+  }
+
+  switch(evt.m_nType)
+  {
+  case EVT_PRINT_FAILED:
+    pObserver->OnPrintFailed((int)evt.m_adwArg[0]);
+    break;
+  case EVT_DEFINE_GRAPHIC_FAILED:
+    pObserver->OnDefineGraphicFailed((int)evt.m_adwArg[0]);
+    break;
+  case EVT_DEFINE_REGION_FAILED:
+    pObserver->OnDefineRegionFailed((int)evt.m_adwArg[0]);
+    break;
+  case EVT_DEFINE_TEMPL_FAILED:
+    pObserver->OnDefineTemplateFailed((int)evt.m_adwArg[0]);
+    break;
+  case EVT_CRC_READY:
+    pObserver->OnCRCReady((WORD)evt.m_adwArg[0]);
+    break;
+  case EVT_GAT_REPORT_READY:
+    strTmp = evt.m_szText;
+    pObserver->OnGATReportReady(strTmp);
+    break;
+  case EVT_CONNECTED:
+    pObserver->OnConnected();
+    break;
+  case EVT_DISCONNECTED:
+    pObserver->OnDisconnected();
+    break;
+  case EVT_READY:
+    pObserver->OnReady();
+    break;
+  case EVT_SUSPENDED:
+    pObserver->OnSuspended();
+    break;
+  case EVT_RESUMED:
+    pObserver->OnResumed();
+    break;
+  case EVT_PRINTING:
+    pObserver->OnPrinting();
+    break;
+  case EVT_PRINT_COMPLETED:
+    pObserver->OnPrintCompleted();
+    break;
+  case EVT_DEFINE_GRAPHIC_SUCCESS:
+    pObserver->OnDefineGraphicSuccess();
+    break;
+  case EVT_DEFINE_REGION_SUCCESS:
+    pObserver->OnDefineRegionSuccess();
+    break;
+  case EVT_DEFINE_TEMPL_SUCCESS:
+    pObserver->OnDefineTemplateSuccess();
+    break;
+  default:
+    break;
+  } // switch...
+}
+
+/// <summary>Delivers events until stopped, called by dispatcher thread only.
+/// </summary>
+void CEvtQueue::Run()
+{
+  SObsEvt evt;
+
+  for(;;)
+  {
+    while(Take(evt))
+    {
+      try
+      {
+        Dispatch(evt);
+      }
+      catch(...)
+      {
+        CLog::Log(L"[printdrv_fl_psa66st2r][CEvtQueue::Run] observer failed on event %d.\n",
+          evt.m_nType);
+      } // try...catch...
+
+      m_pContext->m_Port.m_Stats.AddEvtLatency(CPrinterPort::GetTime() -
+        evt.m_ullTime);
+    } // while...
+
+    if(m_bStop) { break; }
+
+    ::WaitForSingleObject(m_hEvent, INFINITE);
+  } // for...
+}
+
+/// <summary>Dispatcher thread execution.</summary>
+/// <param name="lpParameter">Pointer to owner <see cref="CEvtQueue"/>.</param>
+DWORD WINAPI CEvtQueue::_Run(LPVOID lpParameter)
+{
+  ((CEvtQueue*)lpParameter)->Run();
+
+  return 0;
+}
@@ -0,0 +1,177 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Built-in firmware.</summary>
+static const struct
+{
+  const wchar_t* m_pszVersion;
+  const wchar_t* m_pszCurrency;
+  int m_nFilter;
+} s_aBuiltIn[] =
+{
+  { L"GUR109000", L"PHP", SFirmware::FILTER_GUR126003 },
+  { L"GUR126001", L"HKD", SFirmware::FILTER_GUR126003 },
+  { L"GUR126003", L"HKD", SFirmware::FILTER_GUR126003 },
+  { L"GUREUR100", L"EUR", SFirmware::FILTER_GUR126003 },
+  { L"GUREUR101", L"EUR", SFirmware::FILTER_GUR126003 },
+  { L"GUREUR102", L"EUR", SFirmware::FILTER_GUR126003 },
+  { L"GUREUR200", L"EUR", SFirmware::FILTER_GUR126003 },
+  { L"GUREURGE2", L"EUR", SFirmware::FILTER_GUR126003 },
+  { L"GURKORGE1", L"KRW", SFirmware::FILTER_GUR126003 },
+  { L"GURLKAGE1", L"LKR", SFirmware::FILTER_GUR126003 },
+  { L"GURLTG000", L"TWD", SFirmware::FILTER_GUR126003 },
+  { L"GURMAC105", L"HKD", SFirmware::FILTER_GUR126003 },
+  { L"GURMYSGE0", L"MYR", SFirmware::FILTER_GUR126003 },
+  { L"GURNSW200", L"AUD", SFirmware::FILTER_GURNSW200 },
+  { L"GURPHI101", L"PHP", SFirmware::FILTER_GUR126003 },
+  { L"GURSAFGE0", L"ZAR", SFirmware::FILTER_GUR126003 },
+  { L"GURSNG103", L"SGD", SFirmware::FILTER_GUR126003 },
+  { L"GURTHAGE0", L"THB", SFirmware::FILTER_GUR126003 },
+  { L"GURTHBGE0", L"THB", SFirmware::FILTER_GUR126003 },
+  { L"GURTOR100", L"HKD", SFirmware::FILTER_GUR126003 },
+  { L"GURTOR101", L"HKD", SFirmware::FILTER_GUR126003 },
+  { L"GURUSA001", L"USD", SFirmware::FILTER_GUR126003 },
+  { L"GURUSA003", L"USD", SFirmware::FILTER_GUR126003 },
+  { L"GURUSAG13", L"USD", SFirmware::FILTER_GUR126003 },
+  { L"GURUSDUS1", L"USD", SFirmware::FILTER_GUR126003 }
+};
+
+/// <summary>Constructor.</summary>
+CFirmwareRegistry::CFirmwareRegistry() :
+  m_nCount(0)
+{
+  Reset();
+}
+
+/// <summary>Restores built-in firmware only.</summary>
+void CFirmwareRegistry::Reset()
+{
+  int i;
+
+  m_nCount = 0;
+  for(i = 0;i < _countof(s_aBuiltIn);i++)
+  {
+    Set(s_aBuiltIn[i].m_pszVersion, s_aBuiltIn[i].m_pszCurrency,
+      s_aBuiltIn[i].m_nFilter);
+  } // for...
+}
+
+/// <summary>Restores built-in firmware, then adds or overrides firmware listed
+/// in configuration file.</summary>
+/// <param name="file">Path of configuration file, NULL or empty for built-in
+/// firmware only.</param>
+/// <remarks>Each line holds version, currency and job filter separated by
+/// spaces, e.g. "GURKORGE1 KRW GUR126003". Job filter is "GUR126003",
+/// "GURNSW200" or "none", and defaults to "GUR126003" if omitted. Currency "-"
+/// means unknown. Empty lines and lines starting with '#' are ignored.</remarks>
+void CFirmwareRegistry::Load(const wchar_t* file)
+{
+  FILE *pFile;
+  wchar_t line[256], version[64], currency[16], filter[32];
+  int cnt, nFilter;
+
+  Reset();
+  if((file == NULL) || (file[0] == L'\0')) { return; }
+
+  pFile = _wfopen(file, L"r");
+  if(pFile == NULL) { return; }
+
+  while(fgetws(line, _countof(line), pFile) != NULL)
+  {
+    cnt = swscanf(line, L"%63s %15s %31s", version, currency, filter);
+    if((cnt < 2) || (version[0] == L'#')) { continue; }
+
+    nFilter = SFirmware::FILTER_GUR126003;
+    if(cnt > 2)
+    {
+      if(!_wcsicmp(filter, L"none")) { nFilter = SFirmware::FILTER_NONE; }
+      else if(!_wcsicmp(filter, L"GURNSW200")) { nFilter = SFirmware::FILTER_GURNSW200; }
+    } // if...
+
+    Set(version, wcscmp(currency, L"-") ? currency : L"", nFilter);
+  } // while...
+  fclose(pFile);
+}
+
+/// <summary>Adds or overrides firmware.</summary>
+/// <param name="version">Printer software version.</param>
+/// <param name="currency">Currency, in ISO 4217.</param>
+/// <param name="filter">Job filter, one of <see cref="SFirmware::FILTER"/>.</param>
+/// <returns>True if set, false if registry is full.</returns>
+bool CFirmwareRegistry::Set(const wchar_t* version, const wchar_t* currency,
+                            int filter)
+{
+  int i, index;
+  bool found;
+
+  index = Search(version, found);
+  if(!found)
+  {
+    if(m_nCount >= FIRMWARE_REGISTRY_SIZE) { return false; }
+
+    for(i = m_nCount;i > index;i--) { m_aFirmware[i] = m_aFirmware[i - 1]; }
+    m_nCount++;
+    m_aFirmware[index].m_strVersion = version;
+  } // if...
+
+  m_aFirmware[index].m_strCurrency = currency;
+  m_aFirmware[index].m_nFilter = filter;
+
+  return true;
+}
+
+/// <summary>Finds firmware.</summary>
+/// <param name="version">Printer software version.</param>
+/// <returns>Pointer to firmware settings, NULL if unknown. Valid until registry
+/// is modified.</returns>
+const SFirmware* CFirmwareRegistry::Find(const wchar_t* version) const
+{
+  int index;
+  bool found;
+
+  index = Search(version, found);
+  return found ? &(m_aFirmware[index]) : NULL;
+}
+
+/// <summary>Binary searches firmware.</summary>
+/// <param name="version">Printer software version.</param>
+/// <param name="found">Receives true if found, false otherwise.</param>
+/// <returns>Index of firmware if found, otherwise index to insert it at.</returns>
+int CFirmwareRegistry::Search(const wchar_t* version, bool& found) const
+{
+  int low = 0, high = m_nCount - 1, mid, cmp;
+
+  found = false;
+  if(version == NULL) { return 0; }
+
+  while(low <= high)
+  {
+    mid = (low + high) / 2;
+    cmp = wcscmp(version, m_aFirmware[mid].m_strVersion);
+    if(cmp == 0)
+    {
+      found = true;
+      return mid;
+    }
+    if(cmp < 0) { high = mid - 1; }
+    else { low = mid + 1; }
+  } // while...
+
+  return low;
+}
+
+/// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
+/// <param name="pElem">Pointer to XML DOM element.</param>
+void CFirmwareRegistry::Dump(MSXML2::IXMLDOMElement* pElem)
+{
+  try
+  {
+
+    if(pElem != NULL)
+    {
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"m_nCount", m_nCount);
+    } // if...
+
+  }
+  catch(...) {}
+}
@@ -1,49 +1,21 @@
 #include "stdafx.h"
 #include "filter.h"
 
-
-/// <summary>Checks if transformation is needed for specified job.</summary>
-/// <param name="job">Job to be checked.</param>
-/// <returns>True if transformation is needed, false otherwise.</returns>
-bool CJobFilterGURNSW200::NeedTransform(const print::CJob& job)
+// template N: firmware version defaults to GURNSW200.
+static const SJobFieldEdit s_aEditTempl_N[] =
 {
-	switch(job.m_nsTemplateID)
-	{
-	case 0x4E	:
-		return true;
-	} // switch...
-
-	return CJobFilterGUR126003::NeedTransform(job);
-}
+  { 7, JF_DEFAULT, L"GURNSW200", NULL }
+};
 
-/// <summary>Performs necessary transformation on the job.</summary>
-/// <param name="job">Job to be transformed.</param>
-/// <returns>Transformed job.</returns>
-print::CJob CJobFilterGURNSW200::Transform(const print::CJob& job)
+/// <summary>Field mappings of firmware GURNSW200, in addition to those of
+/// GUR126003.</summary>
+static const SJobTemplMap s_aMapGURNSW200[] =
 {
-	switch(job.m_nsTemplateID)
-	{
-	case 0x4E	:
-		return TransformTempl_N(job);
-	} // switch...
-
-	return CJobFilterGUR126003::Transform(job);
-}
+  { 0x4E, 21, 21, NULL, s_aEditTempl_N, _countof(s_aEditTempl_N) }
+};
 
-/// <summary>Transforms job for template N.</summary>
-/// <param name="job">Job to be transformed.</param>
-/// <returns>Transformed job.</returns>
-print::CJob CJobFilterGURNSW200::TransformTempl_N(const print::CJob& job)
+/// <summary>Constructor.</summary>
+CJobFilterGURNSW200::CJobFilterGURNSW200()
 {
-	if(job.GetCount() != 21)	{ return job; }
-
-	print::CJob newJob(job);
-	POS pos(newJob.FindIndex(7));
-	// firmware version
-	if(!newJob.GetAt(pos).m_strData.GetLength())
-	{
-		newJob.GetAt(pos).m_strData = L"GURNSW200";
-	}
-
-	return newJob;
-}
\ No newline at end of file
+  m_Program.Compile(s_aMapGURNSW200, _countof(s_aMapGURNSW200));
+}
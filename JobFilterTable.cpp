@@ -0,0 +1,27 @@
+#include "stdafx.h"
+#include "filter.h"
+
+/// <summary>Checks if transformation is needed for specified job.</summary>
+/// <param name="job">Job to be checked.</param>
+/// <returns>True if transformation is needed, false otherwise.</returns>
+bool CJobFilterTable::NeedTransform(const print::CJob& job)
+{
+  return m_Program.IsMapped(job);
+}
+
+/// <summary>Performs necessary transformation on the job, in place.</summary>
+/// <param name="job">Job to be transformed.</param>
+void CJobFilterTable::Transform(print::CJob& job)
+{
+  m_Program.Apply(job);
+}
+
+/// <summary>Checks if transformation of specified job only appends blank
+/// fields.</summary>
+/// <param name="job">Job to be checked.</param>
+/// <returns>Number of blank fields appended, 0 if no transformation is needed,
+/// -1 if transformation does more than appending.</returns>
+int CJobFilterTable::GetBlankCnt(const print::CJob& job)
+{
+  return m_Program.GetBlankCnt(job);
+}
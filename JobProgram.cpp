@@ -0,0 +1,231 @@
+#include "stdafx.h"
+#include "filter.h"
+
+/// <summary>Constructor.</summary>
+CJobProgram::CJobProgram() :
+  m_nCount(0)
+{
+  int i;
+
+  for(i = 0;i < JOB_FILTER_MAX_TEMPL;i++) { m_anIndex[i] = -1; }
+}
+
+/// <summary>Compiles field mappings, replacing those of same template.</summary>
+/// <param name="pMap">Field mappings.</param>
+/// <param name="count">Number of elements in <paramref name="pMap"/>.</param>
+/// <exception cref="wcl::CArgumentException">If a mapping is invalid.</exception>
+void CJobProgram::Compile(const SJobTemplMap* pMap, int count)
+{
+  int i, j, src, last, index;
+  const SJobFieldEdit *pEdit;
+
+  if((pMap == NULL) && (count > 0)) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"pMap"); }
+
+  for(i = 0;i < count;i++)
+  {
+    if( (pMap[i].m_nsTemplID < 0) || (pMap[i].m_nsTemplID >= JOB_FILTER_MAX_TEMPL) ||
+      (pMap[i].m_nInCnt < 0) || (pMap[i].m_nOutCnt < pMap[i].m_nInCnt) ||
+      (pMap[i].m_nOutCnt > JOB_FILTER_MAX_FIELDS) )
+    {
+      WCL_THROW_ARGUMENTEXCEPTION(L"pMap", L"invalid template or field count");
+    }
+
+    index = m_anIndex[pMap[i].m_nsTemplID];
+    if(index < 0)
+    {
+      if(m_nCount >= JOB_FILTER_MAX_PROGRAM)
+      {
+        WCL_THROW_ARGUMENTEXCEPTION(L"count", L"too many templates");
+      }
+      index = m_nCount;
+    }
+
+    SProgram& prog = m_aProgram[index];
+
+    prog.m_nInCnt = pMap[i].m_nInCnt;
+    prog.m_nOutCnt = pMap[i].m_nOutCnt;
+    prog.m_bInPlace = true;
+
+    last = -1;
+    for(j = 0;j < prog.m_nOutCnt;j++)
+    {
+      if(pMap[i].m_pLayout != NULL) { src = pMap[i].m_pLayout[j]; }
+      else { src = (j < prog.m_nInCnt) ? j : JF_BLANK; }
+
+      if((src < JF_BLANK) || (src >= prog.m_nInCnt))
+      {
+        WCL_THROW_ARGUMENTEXCEPTION(L"pMap", L"invalid source field");
+      }
+      if(src != JF_BLANK)
+      {
+        // moving backwards in place needs source fields kept in order.
+        if((src > j) || (src <= last)) { prog.m_bInPlace = false; }
+        last = src;
+      }
+
+      prog.m_acSrc[j] = (signed char)src;
+      prog.m_abyOps[j] = 0;
+      prog.m_apszDefault[j] = NULL;
+      prog.m_apszPrefix[j] = NULL;
+    } // for...
+
+    for(j = 0;j < pMap[i].m_nEditCnt;j++)
+    {
+      pEdit = &(pMap[i].m_pEdit[j]);
+      if( (pEdit->m_nField < 0) || (pEdit->m_nField >= prog.m_nOutCnt) ||
+        ((pEdit->m_dwOps & JF_DEFAULT) && (pEdit->m_pszDefault == NULL)) ||
+        ((pEdit->m_dwOps & JF_PREFIX) && (pEdit->m_pszPrefix == NULL)) )
+      {
+        WCL_THROW_ARGUMENTEXCEPTION(L"pMap", L"invalid field edit");
+      }
+
+      prog.m_abyOps[pEdit->m_nField] |= (BYTE)pEdit->m_dwOps;
+      if(pEdit->m_dwOps & JF_DEFAULT)
+      {
+        prog.m_apszDefault[pEdit->m_nField] = pEdit->m_pszDefault;
+      }
+      if(pEdit->m_dwOps & JF_PREFIX)
+      {
+        prog.m_apszPrefix[pEdit->m_nField] = pEdit->m_pszPrefix;
+      }
+    } // for...
+
+    // programs which only append blanks let the job be sent as is.
+    prog.m_nBlankCnt = prog.m_nOutCnt - prog.m_nInCnt;
+    for(j = 0;j < prog.m_nOutCnt;j++)
+    {
+      if( (prog.m_abyOps[j] != 0) ||
+        (prog.m_acSrc[j] != ((j < prog.m_nInCnt) ? j : JF_BLANK)) )
+      {
+        prog.m_nBlankCnt = -1;
+        break;
+      }
+    } // for...
+
+    if(index == m_nCount) { m_nCount++; }
+    m_anIndex[pMap[i].m_nsTemplID] = (short)index;
+  } // for...
+}
+
+/// <summary>Checks if a job is mapped.</summary>
+/// <param name="job">Job to be checked.</param>
+/// <returns>True if its template is mapped and field count matches, false
+/// otherwise.</returns>
+bool CJobProgram::IsMapped(const print::CJob& job) const
+{
+  int index;
+
+  if((job.m_nsTemplateID < 0) || (job.m_nsTemplateID >= JOB_FILTER_MAX_TEMPL))
+  {
+    return false;
+  }
+
+  index = m_anIndex[job.m_nsTemplateID];
+  return (index >= 0) && (m_aProgram[index].m_nInCnt == job.GetCount());
+}
+
+/// <summary>Checks if program of a job only appends blank fields.</summary>
+/// <param name="job">Job to be checked.</param>
+/// <returns>Number of blank fields appended, 0 if job is not mapped, -1 if its
+/// program does more than appending.</returns>
+int CJobProgram::GetBlankCnt(const print::CJob& job) const
+{
+  if(!IsMapped(job)) { return 0; }
+
+  return m_aProgram[m_anIndex[job.m_nsTemplateID]].m_nBlankCnt;
+}
+
+/// <summary>Transforms job in place.</summary>
+/// <param name="job">Job to be transformed.</param>
+/// <returns>True if transformed, false if job is not mapped.</returns>
+bool CJobProgram::Apply(print::CJob& job) const
+{
+  int i, src;
+  POS pos, aPos[JOB_FILTER_MAX_FIELDS];
+  CWkString strTmp;
+
+  if(!IsMapped(job)) { return false; }
+
+  const SProgram& prog = m_aProgram[m_anIndex[job.m_nsTemplateID]];
+
+  for(i = prog.m_nInCnt;i < prog.m_nOutCnt;i++) { job.AddTail(print::CData()); }
+
+  // locate every field once.
+  pos = job.GetHeadPos();
+  for(i = 0;i < prog.m_nOutCnt;i++)
+  {
+    aPos[i] = pos;
+    job.GetNext(pos);
+  } // for...
+
+  if(prog.m_bInPlace)
+  {
+    for(i = prog.m_nOutCnt - 1;i >= 0;i--)
+    {
+      src = prog.m_acSrc[i];
+      if(src == i) { continue; }
+
+      if(src == JF_BLANK)
+      {
+        // appended fields are already blank.
+        if(i < prog.m_nInCnt) { job.GetAt(aPos[i]) = print::CData(); }
+      }
+      else { job.GetAt(aPos[i]) = job.GetAt(aPos[src]); }
+    } // for...
+  }
+  else { Reorder(job, prog, aPos); }
+
+  for(i = 0;i < prog.m_nOutCnt;i++)
+  {
+    if(prog.m_abyOps[i] == 0) { continue; }
+
+    print::CData& data = job.GetAt(aPos[i]);
+
+    if( (prog.m_abyOps[i] & JF_DEFAULT) && (data.m_strData.GetLength() <= 0) )
+    {
+      data.m_strData = prog.m_apszDefault[i];
+    }
+    if(prog.m_abyOps[i] & JF_EXPIRY) { TransformExpiry(data); }
+    if(prog.m_abyOps[i] & JF_PREFIX)
+    {
+      strTmp = data.m_strData;
+      data.m_strData = prog.m_apszPrefix[i];
+      data.m_strData += strTmp;
+    }
+  } // for...
+
+  return true;
+}
+
+/// <summary>Moves fields to their output index through a scratch copy, for
+/// layouts which cannot be moved in place.</summary>
+/// <param name="job">Job to be transformed, blank fields already appended.</param>
+/// <param name="prog">Compiled program.</param>
+/// <param name="aPos">Position of every field of <paramref name="job"/>.</param>
+void CJobProgram::Reorder(print::CJob& job, const SProgram& prog, POS* aPos) const
+{
+  int i, src;
+  print::CData aTmp[JOB_FILTER_MAX_FIELDS];
+
+  for(i = 0;i < prog.m_nInCnt;i++) { aTmp[i] = job.GetAt(aPos[i]); }
+
+  for(i = 0;i < prog.m_nOutCnt;i++)
+  {
+    src = prog.m_acSrc[i];
+    if(src == JF_BLANK) { job.GetAt(aPos[i]) = print::CData(); }
+    else { job.GetAt(aPos[i]) = aTmp[src]; }
+  } // for...
+}
+
+/// <summary>Rewrites never-expiring expiry to the text printed by firmware.</summary>
+/// <param name="data">Expiry field.</param>
+void CJobProgram::TransformExpiry(print::CData& data)
+{
+  if(!data.m_strData.CompareNoCase(L"9999 days") ||
+    !data.m_strData.CompareNoCase(L"9999days") ||
+    !data.m_strData.CompareNoCase(L"9999 day") ||
+    !data.m_strData.CompareNoCase(L"9999day"))
+  {
+    data.m_strData = L"Ticket Never expires";
+  }
+}
@@ -0,0 +1,235 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+CMemTransport::CMemTransport() :
+  m_RxBuffer(3000),
+  m_TxBuffer(3000),
+  m_bOpened(false)
+{
+  m_hRxEvent = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+  m_hTxEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+  m_hRoomEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+/// <summary>Destructor.</summary>
+CMemTransport::~CMemTransport()
+{
+  if(m_hRxEvent != NULL) { ::CloseHandle(m_hRxEvent); }
+  if(m_hTxEvent != NULL) { ::CloseHandle(m_hTxEvent); }
+  if(m_hRoomEvent != NULL) { ::CloseHandle(m_hRoomEvent); }
+}
+
+/// <summary>Extracts transport related parameters.</summary>
+/// <param name="parameters">Parameters string.</param>
+/// <remarks>No parameter is used.</remarks>
+void CMemTransport::Parse(const wchar_t* parameters)
+{
+}
+
+/// <summary>Opens transport, discarding bytes left from previous session.</summary>
+/// <returns>Always true.</returns>
+bool CMemTransport::Open()
+{
+  m_csThis.Enter();
+  while(!m_RxBuffer.IsEmpty()) { m_RxBuffer.Pop(); }
+  while(!m_TxBuffer.IsEmpty()) { m_TxBuffer.Pop(); }
+  if(m_hRxEvent != NULL) { ::ResetEvent(m_hRxEvent); }
+  m_bOpened = true;
+  m_csThis.Leave();
+
+  return true;
+}
+
+/// <summary>Closes transport.</summary>
+void CMemTransport::Close()
+{
+  m_csThis.Enter();
+  m_bOpened = false;
+  m_csThis.Leave();
+}
+
+/// <summary>Reads bytes delivered by peer.</summary>
+/// <param name="buffer">Buffer to receive bytes.</param>
+/// <param name="bufferSize">Size of <paramref name="buffer"/>, in number of
+/// bytes.</param>
+/// <returns>Number of bytes read.</returns>
+int CMemTransport::Read(BYTE* buffer, int bufferSize)
+{
+  int cnt = 0;
+
+  m_csThis.Enter();
+  if(!m_bOpened)
+  {
+    m_csThis.Leave();
+    WCL_THROW_INVALIDOPERATIONEXCEPTION(L"transport not opened");
+  }
+
+  while((cnt < bufferSize) && !m_RxBuffer.IsEmpty())
+  {
+    buffer[cnt++] = m_RxBuffer.Pop();
+  } // while...
+  if(m_RxBuffer.IsEmpty() && (m_hRxEvent != NULL)) { ::ResetEvent(m_hRxEvent); }
+  m_csThis.Leave();
+
+  return cnt;
+}
+
+/// <summary>Writes bytes for peer to drain.</summary>
+/// <param name="data">Data to be written.</param>
+/// <param name="dataSize">Size of <paramref name="data"/>, in number of bytes.</param>
+/// <returns>Number of bytes written.</returns>
+/// <exception cref="wcl::CInvalidOperationException">If transport is not
+/// opened.</exception>
+/// <exception cref="CCommException">If peer drained no room within
+/// <see cref="WRITE_TIMEOUT"/>.</exception>
+/// <remarks>Waits for peer to drain while the buffer is full, as a serial port
+/// waits for the line.</remarks>
+int CMemTransport::Write(BYTE* data, int dataSize)
+{
+  int i = 0;
+
+  for(;;)
+  {
+    m_csThis.Enter();
+    if(!m_bOpened)
+    {
+      m_csThis.Leave();
+      WCL_THROW_INVALIDOPERATIONEXCEPTION(L"transport not opened");
+    }
+
+    for(;(i < dataSize) && !m_TxBuffer.IsFull();i++)
+    {
+      m_TxBuffer.Push(data[i]);
+    } // for...
+    if((i > 0) && (m_hTxEvent != NULL)) { ::SetEvent(m_hTxEvent); }
+    m_csThis.Leave();
+
+    if(i == dataSize) { break; }
+
+    if((m_hRoomEvent == NULL) ||
+       (::WaitForSingleObject(m_hRoomEvent, WRITE_TIMEOUT) != WAIT_OBJECT_0))
+    {
+      throw CCommException(0, L"Write to transport timeout.");
+    }
+  } // for...
+
+  return i;
+}
+
+/// <summary>Waits until peer delivers bytes or timeout.</summary>
+/// <param name="timeout">Maximum time to wait, in milliseconds.</param>
+/// <param name="hWake">Event to abort the wait, NULL if none.</param>
+/// <returns>True if bytes are available for <see cref="Read"/>, false if
+/// timeout or woken by <paramref name="hWake"/>.</returns>
+bool CMemTransport::WaitRx(DWORD timeout, HANDLE hWake)
+{
+  DWORD cnt = 1;
+  HANDLE handles[2];
+
+  if(m_hRxEvent == NULL)
+  {
+    Sleep(__min(timeout, RUN_INTERVAL));
+    return false;
+  }
+
+  handles[0] = m_hRxEvent;
+  if(hWake != NULL) { handles[cnt++] = hWake; }
+
+  return ::WaitForMultipleObjects(cnt, handles, FALSE, timeout) == WAIT_OBJECT_0;
+}
+
+/// <summary>Checks if <see cref="WaitRx"/> blocks until bytes arrive.</summary>
+/// <returns>Always true.</returns>
+bool CMemTransport::CanWaitRx()
+{
+  return true;
+}
+
+/// <summary>Retrieves port number.</summary>
+/// <returns>Always zero.</returns>
+int CMemTransport::GetPort()
+{
+  return 0;
+}
+
+/// <summary>Delivers bytes from peer, to be read by driver.</summary>
+/// <param name="data">Bytes to be delivered.</param>
+/// <param name="dataSize">Size of <paramref name="data"/>, in number of bytes.</param>
+/// <returns>Number of bytes accepted.</returns>
+int CMemTransport::Inject(const BYTE* data, int dataSize)
+{
+  int i;
+
+  m_csThis.Enter();
+  for(i = 0;(i < dataSize) && !m_RxBuffer.IsFull();i++)
+  {
+    m_RxBuffer.Push(data[i]);
+  } // for...
+  if((i > 0) && (m_hRxEvent != NULL)) { ::SetEvent(m_hRxEvent); }
+  m_csThis.Leave();
+
+  return i;
+}
+
+/// <summary>Collects bytes written by driver.</summary>
+/// <param name="buffer">Buffer to receive bytes.</param>
+/// <param name="bufferSize">Size of <paramref name="buffer"/>, in number of
+/// bytes.</param>
+/// <returns>Number of bytes collected.</returns>
+int CMemTransport::Drain(BYTE* buffer, int bufferSize)
+{
+  int cnt = 0;
+
+  m_csThis.Enter();
+  while((cnt < bufferSize) && !m_TxBuffer.IsEmpty())
+  {
+    buffer[cnt++] = m_TxBuffer.Pop();
+  } // while...
+  if((cnt > 0) && (m_hRoomEvent != NULL)) { ::SetEvent(m_hRoomEvent); }
+  m_csThis.Leave();
+
+  return cnt;
+}
+
+/// <summary>Waits until driver writes bytes or timeout.</summary>
+/// <param name="timeout">Maximum time to wait, in milliseconds.</param>
+/// <param name="hWake">Event to abort the wait, NULL if none.</param>
+/// <returns>True if bytes may be available for <see cref="Drain"/>, false if
+/// timeout or woken by <paramref name="hWake"/>.</returns>
+bool CMemTransport::WaitTx(DWORD timeout, HANDLE hWake)
+{
+  DWORD cnt = 1;
+  HANDLE handles[2];
+
+  if(m_hTxEvent == NULL)
+  {
+    Sleep(__min(timeout, RUN_INTERVAL));
+    return true;
+  }
+
+  handles[0] = m_hTxEvent;
+  if(hWake != NULL) { handles[cnt++] = hWake; }
+
+  return ::WaitForMultipleObjects(cnt, handles, FALSE, timeout) == WAIT_OBJECT_0;
+}
+
+/// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
+/// <param name="pElem">Pointer to XML DOM element.</param>
+void CMemTransport::Dump(MSXML2::IXMLDOMElement* pElem)
+{
+  try
+  {
+
+    if(pElem != NULL)
+    {
+      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bOpened", m_bOpened);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_RxBuffer.GetCount",
+        m_RxBuffer.GetCount());
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_TxBuffer.GetCount",
+        m_TxBuffer.GetCount());
+    } // if...
+
+  }
+  catch(...) {}
+}
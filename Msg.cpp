@@ -0,0 +1,51 @@
+#include "stdafx.h"
+#include "message.h"
+
+/// <summary>Appends command bytes to sink in a single pass.</summary>
+/// <param name="sink">Sink to receive constructed bytes.</param>
+void CMsg::Encode(CMsgSink& sink)
+{
+  BYTE buffer[512]; // should be large enough for all fixed size commands.
+  DWORD len;
+
+  len = Build(NULL, 0);
+  if(len <= sizeof(buffer))
+  {
+    Build(buffer, len);
+    sink.Append(buffer, len);
+    return;
+  }
+
+  BYTE *pbyTmp = new BYTE[len];
+  if(pbyTmp == NULL) { throw wcl::COutOfMemoryException(); }
+  try
+  {
+    Build(pbyTmp, len);
+    sink.Append(pbyTmp, len);
+  }
+  catch(...)
+  {
+    delete[] pbyTmp;
+    throw;
+  }
+  delete[] pbyTmp;
+}
+
+/// <summary>Constructs command bytes through <see cref="Encode"/>.</summary>
+/// <param name="buffer">Buffer to receive constructed bytes, may be NULL.</param>
+/// <param name="bufferSize">Size of <paramref name="buffer"/> in number of bytes.</param>
+/// <returns>Length of constructed command bytes.</returns>
+/// <remarks>Keeps <see cref="CMsg::Build"/> contract for messages which
+/// implement <see cref="CMsg::Encode"/> natively.</remarks>
+DWORD CMsg::BuildByEncode(BYTE* buffer, DWORD bufferSize)
+{
+  CMsgSink sink(256);
+
+  Encode(sink);
+  if((buffer != NULL) && (bufferSize >= sink.GetSize()))
+  {
+    memcpy(buffer, sink.GetData(), sink.GetSize());
+  }
+
+  return sink.GetSize();
+}
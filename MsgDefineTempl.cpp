@@ -6,12 +6,6 @@ CMsgDefineTempl::CMsgDefineTempl() : m_bDefine(true), m_pTemplate(NULL)
 {
 }
 
-#define FILL_BUFFER(c)  len++;\
-                        if((buffer != NULL) && (bufferSize >= len))\
-                        {\
-                          buffer[len - 1] = c;\
-                        }
-
 /// <summary>Constructs command bytes.</summary>
 /// <param name="buffer">Buffer to receive constructed bytes. If NULL, function
 /// ignores all arguments and returns size of buffer required to contain the
@@ -26,8 +20,17 @@ CMsgDefineTempl::CMsgDefineTempl() : m_bDefine(true), m_pTemplate(NULL)
 /// is not assigned.</exception>
 DWORD CMsgDefineTempl::Build(BYTE* buffer, DWORD bufferSize)
 {
-  if(m_bDefine) { return BuildDefine(buffer, bufferSize); }
-  return BuildDelete(buffer, bufferSize);
+  return BuildByEncode(buffer, bufferSize);
+}
+
+/// <summary>Appends command bytes to sink in a single pass.</summary>
+/// <param name="sink">Sink to receive constructed bytes.</param>
+/// <exception cref="wcl::CInvalidOperationException">If <see cref="m_pTemplate"/>
+/// is not assigned.</exception>
+void CMsgDefineTempl::Encode(CMsgSink& sink)
+{
+  if(m_bDefine) { EncodeDefine(sink); }
+  else { EncodeDelete(sink); }
 }
 
 /// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
@@ -47,100 +50,78 @@ void CMsgDefineTempl::Dump(MSXML2::IXMLDOMElement* pElem)
   catch(...) {}
 }
 
-/// <summary>Constructs command bytes to define template.</summary>
-/// <param name="buffer">Buffer to receive constructed bytes. If NULL, function
-/// ignores all arguments and returns size of buffer required to contain the
-/// command bytes.</param>
-/// <param name="bufferSize">Size of <paramref name="buffer"/> in number of bytes.
-/// If zero, function ignores all arguments and returns size of buffer required to
-/// contain the command bytes.</param>
-/// <returns>Length of constructed command bytes, or size of buffer required to
-/// contain the command bytes if <paramref name="buffer"/> is NULL or
-/// <paramref name="bufferSize"/> is zero.</returns>
+/// <summary>Appends command bytes to sink to define template.</summary>
+/// <param name="sink">Sink to receive constructed bytes.</param>
 /// <exception cref="wcl::CInvalidOperationException">If <see cref="m_pTemplate"/>
 /// is not assigned.</exception>
-DWORD CMsgDefineTempl::BuildDefine(BYTE* buffer, DWORD bufferSize)
+void CMsgDefineTempl::EncodeDefine(CMsgSink& sink)
 {
   POS pos;
   short regionID;
   BYTE byTmp;
   CMsgMgr mgr;
-  DWORD len = 0;
 
   if(m_pTemplate == NULL)
   {
     WCL_THROW_INVALIDOPERATIONEXCEPTION(L"no template assigned.");
   }
 
-  FILL_BUFFER(CMsgMgr::CMD_START);
-  FILL_BUFFER(CMsgMgr::CMD_DEFINE_TEMPL);
-  FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
+  sink.Append(CMsgMgr::CMD_START);
+  sink.Append(CMsgMgr::CMD_DEFINE_TEMPL);
+  sink.Append(CMsgMgr::CMD_DELIMITER);
 
   byTmp = mgr.TemplID2Drv(m_pTemplate->m_nsID);
-  FILL_BUFFER(byTmp);
-  FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
-
-  FILL_BUFFER('R');
-  FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
-  FILL_BUFFER('5');
-  FILL_BUFFER('0');
-  FILL_BUFFER('0');
-  FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
-  FILL_BUFFER('1');
-  FILL_BUFFER('2');
-  FILL_BUFFER('4');
-  FILL_BUFFER('0');
-  FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
+  sink.Append(byTmp);
+  sink.Append(CMsgMgr::CMD_DELIMITER);
+
+  sink.Append('R');
+  sink.Append(CMsgMgr::CMD_DELIMITER);
+  sink.Append('5');
+  sink.Append('0');
+  sink.Append('0');
+  sink.Append(CMsgMgr::CMD_DELIMITER);
+  sink.Append('1');
+  sink.Append('2');
+  sink.Append('4');
+  sink.Append('0');
+  sink.Append(CMsgMgr::CMD_DELIMITER);
 
   pos = m_pTemplate->GetHeadPos();
   while(pos != NULL)
   {
     regionID = m_pTemplate->GetNext(pos);
     byTmp = mgr.RegionID2Drv(regionID);
-    FILL_BUFFER(byTmp);
-    FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
+    sink.Append(byTmp);
+    sink.Append(CMsgMgr::CMD_DELIMITER);
   } // while...
 
-  FILL_BUFFER(CMsgMgr::CMD_END);
-
-  return len;
+  sink.Append(CMsgMgr::CMD_END);
 }
 
-/// <summary>Constructs command bytes to delete template.</summary>
-/// <param name="buffer">Buffer to receive constructed bytes. If NULL, function
-/// ignores all arguments and returns size of buffer required to contain the
-/// command bytes.</param>
-/// <param name="bufferSize">Size of <paramref name="buffer"/> in number of bytes.
-/// If zero, function ignores all arguments and returns size of buffer required to
-/// contain the command bytes.</param>
-/// <returns>Length of constructed command bytes, or size of buffer required to
-/// contain the command bytes if <paramref name="buffer"/> is NULL or
-/// <paramref name="bufferSize"/> is zero.</returns>
+/// <summary>Appends command bytes to sink to delete template.</summary>
+/// <param name="sink">Sink to receive constructed bytes.</param>
 /// <exception cref="wcl::CInvalidOperationException">If <see cref="m_pTemplate"/>
 /// is not assigned.</exception>
-DWORD CMsgDefineTempl::BuildDelete(BYTE* buffer, DWORD bufferSize)
+void CMsgDefineTempl::EncodeDelete(CMsgSink& sink)
 {
   BYTE byTmp;
   CMsgMgr mgr;
-  DWORD len = 0;
 
   if(m_pTemplate == NULL)
   {
     WCL_THROW_INVALIDOPERATIONEXCEPTION(L"no template assigned.");
   }
 
-  FILL_BUFFER(CMsgMgr::CMD_START);
-  FILL_BUFFER(CMsgMgr::CMD_DEFINE_TEMPL);
-  FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
+  sink.Append(CMsgMgr::CMD_START);
+  sink.Append(CMsgMgr::CMD_DEFINE_TEMPL);
+  sink.Append(CMsgMgr::CMD_DELIMITER);
 
   byTmp = mgr.TemplID2Drv(m_pTemplate->m_nsID);
-  FILL_BUFFER(byTmp);
-  FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
-
-  FILL_BUFFER('D');
-  FILL_BUFFER('R');
-  FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
-  FILL_BUFFER(CMsgMgr::CMD_END);
+  sink.Append(byTmp);
+  sink.Append(CMsgMgr::CMD_DELIMITER);
 
-  return len;
+  sink.Append('D');
+  sink.Append('R');
+  sink.Append(CMsgMgr::CMD_DELIMITER);
+  sink.Append(CMsgMgr::CMD_END);
 }
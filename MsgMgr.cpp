@@ -25,26 +25,14 @@ char CMsgMgr::GetType(BYTE* msg, DWORD msgLen)
   return CMD_UNKNOWN;
 }
 
-/// <summary>Converts template ID to driver's range.</summary>
-/// <param name="id">Template ID.</param>
-/// <returns>Template ID mapped to driver's range.</returns>
-/// <exception cref="wcl::CArgumentException">If <paramref name="id"/> is out
-/// of range.</exception>
-/// <remarks>This printer use [0x30~0x39, 0x41, 0x42, 0x4E] as predefined template,
-/// use [0x3A~0x40, 0x43~0x5D, 0x5F~0x7B, 0x7D] as user-defined template. Thus
-/// this function map 0~99 to predefined range by truncating value > 11 to 11,
-// e.g. 0 will mapped to 0x30, and 11, 12, 13 all will be mapped to 0x42.
-/// And 100~999 is mapped to user-defined range in similar manner.</remarks>
-BYTE CMsgMgr::TemplID2Drv(short id)
+/// <summary>Maps template ID 0~999 to driver's range.</summary>
+/// <remarks>Rule behind <see cref="CMsgMgr::TemplID2Drv"/>, only used to build
+/// lookup tables.</remarks>
+static BYTE CalcTemplID2Drv(short id)
 {
   BYTE byTmp;
-  
-  if((id < 0) || (id > 999))
-  {
-    WCL_THROW_ARGUMENTEXCEPTION(L"id", L"must between 0 to 999");
-  }
 
-  if(!IsUserDefinedTempl(id))
+  if(id < 100)
   {
     byTmp = (BYTE)__min(id, 11);
     if((byTmp >= 0) && (byTmp <= 9)) { return byTmp + 0x30; }
@@ -61,25 +49,12 @@ BYTE CMsgMgr::TemplID2Drv(short id)
   return 0x7D;
 }
 
-/// <summary>Converts template ID to driver's range.</summary>
-/// <param name="id">Template ID.</param>
-/// <returns>Template ID mapped to driver's range.</returns>
-/// <exception cref="wcl::CArgumentException">If <paramref name="id"/> is out
-/// of range.</exception>
-/// <remarks>This printer use [0x31~0x39, 0x41~0x47, 0x49~0x4C, 0x4E~0x55, 0x58,
-/// 0x5A, 0x61~0x71] as predefined region, use [0x30, 0x3A~0x40, 0x48, 0x4D,
-/// 0x56~0x57, 0x59, 0x5B~0x5D, 0x5F~0x60, 0x72~0x7B, 0x7D] as user-defined template. Thus
-/// this function map 0~99 to the predefined range by truncating value > 46 to 46,
-/// e.g. 0 will be mapeed to 0x31, and 46, 47, 48 all will be mapped to 0x71.
-/// And 100~999 is mapped to user-defined range in similar manner.</remarks>
-BYTE CMsgMgr::RegionID2Drv(short id)
+/// <summary>Maps region ID 0~999 to driver's range.</summary>
+/// <remarks>Rule behind <see cref="CMsgMgr::RegionID2Drv"/>, only used to build
+/// lookup tables.</remarks>
+static BYTE CalcRegionID2Drv(short id)
 {
   BYTE byTmp;
-  
-  if((id < 0) || (id > 999))
-  {
-    WCL_THROW_ARGUMENTEXCEPTION(L"id", L"must between 0 to 999");
-  }
 
   if(id < 100)
   {
@@ -108,3 +83,83 @@ BYTE CMsgMgr::RegionID2Drv(short id)
   return 0x7D;
 }
 
+/// <summary>Maps graphic ID 0~999 to driver's range.</summary>
+/// <returns>Graphic ID mapped to driver's range, 0 if out of 1~255.</returns>
+/// <remarks>Rule behind <see cref="CMsgMgr::GraphicID2Drv"/>, only used to
+/// build lookup tables.</remarks>
+static BYTE CalcGraphicID2Drv(short id)
+{
+  if((id < 1) || (id > 255)) { return 0; }
+
+  if(id < 26) { return (BYTE)(id + 0x44); }
+
+  return (BYTE)(__min(id, 27) + 0x45);
+}
+
+/// <summary>Maps barcode ID 0~999 to driver's range.</summary>
+/// <remarks>Rule behind <see cref="CMsgMgr::BarcodeID2Drv"/>, only used to
+/// build lookup tables.</remarks>
+static BYTE CalcBarcodeID2Drv(short id)
+{
+  if(id < 27) { return (BYTE)(id + 'a'); }
+
+  return '}';
+}
+
+/// <summary>Maps template ID 0~999 to memory page ID.</summary>
+/// <remarks>Rule behind <see cref="CMsgMgr::TemplID2PageID"/>, only used to
+/// build lookup tables.</remarks>
+static BYTE CalcTemplID2PageID(short id)
+{
+  if(id < 100) { return 'A'; }
+
+  return (BYTE)__min('B' + id - 100, 'J');
+}
+
+/// <summary>Lookup tables shared by all message managers.</summary>
+const CMsgMgr::STables CMsgMgr::s_Tables;
+
+/// <summary>Builds lookup tables.</summary>
+CMsgMgr::STables::STables()
+{
+  short i;
+
+  for(i = 0;i < 256;i++)
+  {
+    m_ansTempl[i] = -1;
+    m_ansRegion[i] = -1;
+    m_ansGraphic[i] = -1;
+    m_ansBarcode[i] = -1;
+  } // for...
+
+  // walk downwards, so reverse tables end up with the lowest host ID.
+  for(i = ID_CNT - 1;i >= 0;i--)
+  {
+    BYTE *pbyHead = m_aabyPrintHead[i];
+
+
+    m_abyTempl[i] = CalcTemplID2Drv(i);
+    m_abyRegion[i] = CalcRegionID2Drv(i);
+    m_abyGraphic[i] = CalcGraphicID2Drv(i);
+    m_abyBarcode[i] = CalcBarcodeID2Drv(i);
+    m_abyPage[i] = CalcTemplID2PageID(i);
+
+    m_ansTempl[m_abyTempl[i]] = i;
+    m_ansRegion[m_abyRegion[i]] = i;
+    if(m_abyGraphic[i] != 0) { m_ansGraphic[m_abyGraphic[i]] = i; }
+    m_ansBarcode[m_abyBarcode[i]] = i;
+
+    m_abyPrintHeadLen[i] = 0;
+    pbyHead[m_abyPrintHeadLen[i]++] = CMD_START;
+    pbyHead[m_abyPrintHeadLen[i]++] = CMD_PRINT;
+    if(i >= 100)
+    {
+      pbyHead[m_abyPrintHeadLen[i]++] = (BYTE)__min('1' + i - 100, '9');
+    }
+    pbyHead[m_abyPrintHeadLen[i]++] = CMD_DELIMITER;
+    pbyHead[m_abyPrintHeadLen[i]++] = m_abyTempl[i];
+    pbyHead[m_abyPrintHeadLen[i]++] = CMD_DELIMITER;
+    pbyHead[m_abyPrintHeadLen[i]++] = '1';
+    pbyHead[m_abyPrintHeadLen[i]++] = CMD_DELIMITER;
+  } // for...
+}
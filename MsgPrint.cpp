@@ -2,16 +2,12 @@
 #include "message.h"
 
 /// <summary>Constructor.</summary>
-CMsgPrint::CMsgPrint() : m_pJob(NULL)
+CMsgPrint::CMsgPrint() :
+  m_pJob(NULL),
+  m_nBlankCnt(0)
 {
 }
 
-#define FILL_BUFFER(c)  len++;\
-                        if((buffer != NULL) && (bufferSize >= len))\
-                        {\
-                          buffer[len - 1] = c;\
-                        }
-
 /// <summary>Constructs command bytes.</summary>
 /// <param name="buffer">Buffer to receive constructed bytes. If NULL, function
 /// ignores all arguments and returns size of buffer required to contain the
@@ -26,50 +22,44 @@ CMsgPrint::CMsgPrint() : m_pJob(NULL)
 /// assigned.</exception>
 DWORD CMsgPrint::Build(BYTE* buffer, DWORD bufferSize)
 {
+  return BuildByEncode(buffer, bufferSize);
+}
+
+/// <summary>Appends command bytes to sink in a single pass.</summary>
+/// <param name="sink">Sink to receive constructed bytes.</param>
+/// <exception cref="wcl::CInvalidOperationException">If <see cref="m_pJob"/> not
+/// assigned.</exception>
+/// <exception cref="wcl::CArgumentException">If template ID of
+/// <see cref="m_pJob"/> is out of range.</exception>
+/// <remarks>Fixed head of the command is precompiled per template, see
+/// <see cref="CMsgMgr::TryGetPrintHead"/>, only field data is encoded.</remarks>
+void CMsgPrint::Encode(CMsgSink& sink)
+{
+  int i;
   POS pos;
-  BYTE byTmp;
   CMsgMgr mgr;
-  DWORD len = 0, asciiLen, i;
-  char *asciiBuffer;
-  print::CData data;
+  const BYTE *pbyHead;
+  DWORD len;
 
   if(m_pJob == NULL)
   {
     WCL_THROW_INVALIDOPERATIONEXCEPTION(L"no job assigned");
   }
-
-  FILL_BUFFER(CMsgMgr::CMD_START);
-  FILL_BUFFER('P');
-  if(mgr.IsUserDefinedTempl(m_pJob->m_nsTemplateID))
+  if(!mgr.TryGetPrintHead(m_pJob->m_nsTemplateID, pbyHead, len))
   {
-	  FILL_BUFFER(mgr.TemplID2PageIDPrint(m_pJob->m_nsTemplateID));
+    WCL_THROW_ARGUMENTEXCEPTION(L"id", L"must between 0 to 999");
   }
-  FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
-
-  byTmp = mgr.TemplID2Drv(m_pJob->m_nsTemplateID);
-  FILL_BUFFER(byTmp);
-  FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
 
-  FILL_BUFFER('1');
-  FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
+  sink.Append(pbyHead, len);
 
   pos = m_pJob->GetHeadPos();
   while(pos != NULL)
   {
-    data = m_pJob->GetNext(pos);
-    
-    asciiLen = data.m_strData.ToMultiByte(NULL, 0);
-    asciiBuffer = new char[asciiLen];
-    if(asciiBuffer == NULL) { throw wcl::COutOfMemoryException(); }
-    data.m_strData.ToMultiByte(asciiBuffer, asciiLen);
-
-    for(i = 0;i < (asciiLen - 1);i++) { FILL_BUFFER(asciiBuffer[i]); }
-    delete[] asciiBuffer;
-    FILL_BUFFER(CMsgMgr::CMD_DELIMITER);
+    sink.AppendStr(m_pJob->GetNext(pos).m_strData);
+    sink.Append(CMsgMgr::CMD_DELIMITER);
   } // while...
-  FILL_BUFFER(CMsgMgr::CMD_END);
-
-  return len;
+  for(i = 0;i < m_nBlankCnt;i++) { sink.Append(CMsgMgr::CMD_DELIMITER); }
+  sink.Append(CMsgMgr::CMD_END);
 }
 
 /// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
@@ -82,6 +72,7 @@ void CMsgPrint::Dump(MSXML2::IXMLDOMElement* pElem)
     if(pElem != NULL)
     {
       wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_pJob", (DWORD)m_pJob);
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"m_nBlankCnt", m_nBlankCnt);
     } // if...
 
   }
@@ -6,7 +6,7 @@ CMsgRespStatus::CMsgRespStatus() :
   m_dwUnitAddr(0),
   m_byTemplateID(' ')
 {
-
+  m_szSoftwareVer[0] = L'\0';
 }
 
 /// <summary>Parses printer response.</summary>
@@ -41,7 +41,7 @@ bool CMsgRespStatus::TryParse(BYTE* resp, DWORD size, CWkString* errMsg)
   bool end = false;
   BYTE lookUp[12] = {'*', 'S', '|', '|', '|', '|', '|', '|', '|', '|', '|', '*'};
   BYTE statusFlag[5] = {0};
-  std::stringstream ss;
+  int len;
   
   if(resp == NULL)
   {
@@ -82,14 +82,19 @@ bool CMsgRespStatus::TryParse(BYTE* resp, DWORD size, CWkString* errMsg)
         }
         break;
       case 3  : // unit address delimiter
-        ss.str("");
-        for(;start < i;start++) { ss << (char)resp[start]; }
-        m_dwUnitAddr = strtoul(ss.str().c_str(), NULL, 10);
+        // leading decimal digits, as strtoul used to.
+        m_dwUnitAddr = 0;
+        for(;(start < i) && (resp[start] >= '0') && (resp[start] <= '9');start++)
+        {
+          m_dwUnitAddr = (m_dwUnitAddr * 10) + (resp[start] - '0');
+        }
         break;
       case 4  : // software version delimiter
-        ss.str("");
-        for(;start < i;start++) { ss << (char)resp[start]; }
-        m_strSoftwareVer = ss.str().c_str();
+        for(len = 0;(start < i) && (len < (SOFTWARE_VER_SIZE - 1));start++)
+        {
+          m_szSoftwareVer[len++] = (wchar_t)resp[start];
+        }
+        m_szSoftwareVer[len] = L'\0';
         break;
       case 5  : // status flag 1 delimiter
         if((i - start) != 1)
@@ -158,70 +163,46 @@ bool CMsgRespStatus::TryParse(BYTE* resp, DWORD size, CWkString* errMsg)
     if(errMsg != NULL) { (*errMsg) = L"not a valid response"; }
     return false;
   }
-  ParseStatus(statusFlag[0], statusFlag[1], statusFlag[2], statusFlag[3],
+  m_Status.SetFlags(statusFlag[0], statusFlag[1], statusFlag[2], statusFlag[3],
     statusFlag[4]);
 
   return true;
 }
 
+/// <summary>Retrieves template ID of the last print job processed.</summary>
+/// <param name="id">Receives lowest template ID mapped to
+/// <see cref="m_byTemplateID"/>.</param>
+/// <returns>True if retrieved, false if <see cref="m_byTemplateID"/> is not a
+/// template ID, e.g. a system error was reported instead.</returns>
+bool CMsgRespStatus::GetTemplateID(short& id) const
+{
+  CMsgMgr mgr;
+
+  return mgr.TryDrv2TemplID(m_byTemplateID, id);
+}
+
 /// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
 /// <param name="pElem">Pointer to XML DOM element.</param>
 void CMsgRespStatus::Dump(MSXML2::IXMLDOMElement* pElem)
 {
+  short nsTmp;
+
   try
   {
 
     if(pElem != NULL)
     {
       wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwUnitAddr", m_dwUnitAddr);
-      wcl::CDumpHelper::DumpAttr<const wchar_t*>(pElem, L"m_strSoftwareVer",
-        m_strSoftwareVer);
+      wcl::CDumpHelper::DumpAttr<const wchar_t*>(pElem, L"m_szSoftwareVer",
+        m_szSoftwareVer);
       wcl::CDumpHelper::DumpChild<CStatus&>(pElem, L"m_Status", m_Status);
       wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_byTemplateID", m_byTemplateID);
+      if(GetTemplateID(nsTmp))
+      {
+        wcl::CDumpHelper::DumpAttr<int>(pElem, L"TemplateID", nsTmp);
+      }
     } // if...
 
   }
   catch(...) {}
 }
-
-/// <summary>Parses flags from response message into status.</summary>
-/// <param name="flag1">Flag 1.</param>
-/// <param name="flag2">Flag 2.</param>
-/// <param name="flag3">Flag 3.</param>
-/// <param name="flag4">Flag 4.</param>
-/// <param name="flag5">Flag 5.</param>
-void CMsgRespStatus::ParseStatus(BYTE flag1, BYTE flag2, BYTE flag3, BYTE flag4,
-                                 BYTE flag5)
-{
-  m_Status.m_bBusy = ((flag1 & 0x20) != 0);
-  m_Status.m_bError = ((flag1 & 0x10) != 0);
-  m_Status.m_bPrintHeadOpen = ((flag1 & 0x08) != 0);
-  m_Status.m_bPaperOut = ((flag1 & 0x04) != 0);
-  m_Status.m_bPrintHeadErr = ((flag1 & 0x02) != 0);
-  m_Status.m_bVoltageErr = ((flag1 & 0x01) != 0);
-
-  m_Status.m_bTemperatureErr = ((flag2 & 0x20) != 0);
-  m_Status.m_bLibRefErr = ((flag2 & 0x10) != 0);
-  m_Status.m_bRegionDataErr = ((flag2 & 0x08) != 0);
-  m_Status.m_bLoadLibErr = ((flag2 & 0x04) != 0);
-  m_Status.m_bBufferOverflow = ((flag2 & 0x02) != 0);
-  m_Status.m_bJobMemOverflow = ((flag2 & 0x01) != 0);
-
-  m_Status.m_bCmdErr = ((flag3 & 0x20) != 0);
-  m_Status.m_bNoFont = ((flag3 & 0x10) != 0);
-  m_Status.m_bPaperInChute = ((flag3 & 0x08) != 0);
-  m_Status.m_bFlashErr = ((flag3 & 0x04) != 0);
-  m_Status.m_bOffLine = ((flag3 & 0x02) != 0);
-  m_Status.m_bWrongPaper = ((flag3 & 0x01) != 0);
-
-  m_Status.m_bJournalMode = ((flag4 & 0x08) != 0);
-  m_Status.m_bCutterErr = ((flag4 & 0x04) != 0);
-  m_Status.m_bPaperJam = ((flag4 & 0x02) != 0);
-  m_Status.m_bPaperLow = ((flag4 & 0x01) != 0);
-
-  m_Status.m_bLastBarPrinted = ((flag5 & 0x20) != 0);
-  m_Status.m_bTopOfForm = ((flag5 & 0x10) != 0);
-  m_Status.m_bReadyToRx = ((flag5 & 0x08) == 0);
-  m_Status.m_bDoorOpened = ((flag5 & 0x04) != 0);
-  m_Status.m_bPowerUpReset = ((flag5 & 0x01) != 0);
-}
@@ -0,0 +1,125 @@
+#include "stdafx.h"
+#include "message.h"
+
+/// <summary>Constructor.</summary>
+/// <param name="memSize">Initial size of memory allocated, in number of bytes.</param>
+CMsgSink::CMsgSink(DWORD memSize) :
+  m_dwSize(0),
+  m_dwMemSize(__max(1, memSize)),
+  m_pszScratch(NULL),
+  m_dwScratchSize(0)
+{
+  m_pbyData = new BYTE[m_dwMemSize];
+  if(m_pbyData == NULL) { throw wcl::COutOfMemoryException(); }
+}
+
+/// <summary>Destructor.</summary>
+CMsgSink::~CMsgSink()
+{
+  delete[] m_pbyData;
+  delete[] m_pszScratch;
+}
+
+/// <summary>Appends bytes.</summary>
+/// <param name="data">Bytes to be appended.</param>
+/// <param name="size">Size of <paramref name="data"/>, in number of bytes.</param>
+void CMsgSink::Append(const BYTE* data, DWORD size)
+{
+  if(size == 0) { return; }
+  if((m_dwSize + size) > m_dwMemSize) { Reserve(m_dwSize + size); }
+
+  memcpy(m_pbyData + m_dwSize, data, size);
+  m_dwSize += size;
+}
+
+/// <summary>Appends unsigned number in decimal.</summary>
+/// <param name="value">Number to be appended.</param>
+void CMsgSink::AppendUInt(DWORD value)
+{
+  BYTE digits[10];
+  int i = sizeof(digits);
+
+  do
+  {
+    digits[--i] = (BYTE)('0' + (value % 10));
+    value /= 10;
+  }
+  while(value != 0);
+
+  Append(digits + i, sizeof(digits) - i);
+}
+
+/// <summary>Appends signed number in decimal.</summary>
+/// <param name="value">Number to be appended.</param>
+void CMsgSink::AppendInt(long value)
+{
+  if(value < 0)
+  {
+    Append('-');
+    AppendUInt((DWORD)(-(value + 1)) + 1);
+    return;
+  }
+
+  AppendUInt((DWORD)value);
+}
+
+/// <summary>Appends string converted to multi-byte, excluding terminator.</summary>
+/// <param name="str">String to be appended.</param>
+/// <remarks>ASCII strings, which ticket data mostly are, are copied without
+/// going through the code page conversion.</remarks>
+void CMsgSink::AppendStr(const CWkString& str)
+{
+  DWORD i, len;
+  const wchar_t *pszStr;
+
+  len = (DWORD)str.GetLength();
+  if(len <= 0) { return; }
+
+  Reserve(m_dwSize + len);
+  pszStr = (const wchar_t*)str;
+  for(i = 0;(i < len) && (pszStr[i] < 0x80);i++)
+  {
+    m_pbyData[m_dwSize + i] = (BYTE)pszStr[i];
+  } // for...
+  if(i == len)
+  {
+    m_dwSize += len;
+    return;
+  }
+
+  len = str.ToMultiByte(NULL, 0);
+  if(len > m_dwScratchSize)
+  {
+    delete[] m_pszScratch;
+    m_pszScratch = NULL;
+    m_dwScratchSize = 0;
+
+    m_pszScratch = new char[len];
+    if(m_pszScratch == NULL) { throw wcl::COutOfMemoryException(); }
+    m_dwScratchSize = len;
+  }
+
+  str.ToMultiByte(m_pszScratch, len);
+  Append((const BYTE*)m_pszScratch, len - 1);
+}
+
+/// <summary>Ensures memory allocated is large enough.</summary>
+/// <param name="size">Required size, in number of bytes.</param>
+/// <remarks>Memory grows at least twice its current size to amortize
+/// re-allocation.</remarks>
+void CMsgSink::Reserve(DWORD size)
+{
+  BYTE *pbyTmp;
+  DWORD memSize;
+
+  if(size <= m_dwMemSize) { return; }
+
+  memSize = __max(size, m_dwMemSize * 2);
+  pbyTmp = new BYTE[memSize];
+  if(pbyTmp == NULL) { throw wcl::COutOfMemoryException(); }
+
+  if(m_dwSize > 0) { memcpy(pbyTmp, m_pbyData, m_dwSize); }
+  delete[] m_pbyData;
+  m_pbyData = pbyTmp;
+  m_dwMemSize = memSize;
+}
@@ -0,0 +1,100 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+CPrintQueue::CPrintQueue() : m_nHead(0), m_nCount(0), m_dwNextID(1)
+{
+}
+
+/// <summary>Allocates identifier for a print job.</summary>
+/// <returns>New job identifier, never zero.</returns>
+DWORD CPrintQueue::NewID()
+{
+  DWORD dwTmp;
+
+  m_csThis.Enter();
+  dwTmp = m_dwNextID++;
+  if(m_dwNextID == 0) { m_dwNextID = 1; }
+  m_csThis.Leave();
+
+  return dwTmp;
+}
+
+/// <summary>Appends job to the end of queue.</summary>
+/// <param name="job">Print job.</param>
+/// <param name="id">Identifier of <paramref name="job"/>, from
+/// <see cref="NewID"/>.</param>
+/// <returns>True if job queued, false if queue is full.</returns>
+bool CPrintQueue::Push(const print::CJob& job, DWORD id)
+{
+  int nTail;
+
+  m_csThis.Enter();
+  if(m_nCount >= PRINT_QUEUE_SIZE)
+  {
+    m_csThis.Leave();
+    return false;
+  }
+
+  nTail = (m_nHead + m_nCount) % PRINT_QUEUE_SIZE;
+  m_aJob[nTail] = job;
+  m_adwID[nTail] = id;
+  m_nCount++;
+  m_csThis.Leave();
+
+  return true;
+}
+
+/// <summary>Removes oldest job from queue.</summary>
+/// <param name="job">Reference to object to receive the job.</param>
+/// <param name="id">Reference to variable to receive job identifier.</param>
+/// <returns>True if a job is removed, false if queue is empty.</returns>
+bool CPrintQueue::Pop(print::CJob& job, DWORD& id)
+{
+  m_csThis.Enter();
+  if(m_nCount <= 0)
+  {
+    m_csThis.Leave();
+    return false;
+  }
+
+  job = m_aJob[m_nHead];
+  id = m_adwID[m_nHead];
+  m_aJob[m_nHead] = print::CJob();
+  m_nHead = (m_nHead + 1) % PRINT_QUEUE_SIZE;
+  m_nCount--;
+  m_csThis.Leave();
+
+  return true;
+}
+
+/// <summary>Retrieves number of queued jobs.</summary>
+/// <returns>Number of queued jobs.</returns>
+int CPrintQueue::GetCount()
+{
+  int nTmp;
+
+  m_csThis.Enter();
+  nTmp = m_nCount;
+  m_csThis.Leave();
+
+  return nTmp;
+}
+
+/// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
+/// <param name="pElem">Pointer to XML DOM element.</param>
+void CPrintQueue::Dump(MSXML2::IXMLDOMElement* pElem)
+{
+  try
+  {
+
+    if(pElem != NULL)
+    {
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"m_nHead", m_nHead);
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"m_nCount", m_nCount);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwNextID", m_dwNextID);
+    } // if...
+
+  }
+  catch(...) {}
+}
@@ -4,10 +4,12 @@
 #include "state.h"
 
 /// <summary>Constructor.</summary>
-CPrinter::CPrinter()
+CPrinter::CPrinter() :
+  m_bInit(false)
 {
   m_pStateTop = new CStateTop(this, &m_Context, NULL);
   if(m_pStateTop == NULL) { throw wcl::COutOfMemoryException(); }
+  BuildTransitTable();
 
   m_pCurState = m_pStateTop;
   Transit(STATE_UNINIT);
@@ -20,22 +22,77 @@ CPrinter::~CPrinter()
   delete m_pStateTop;
 }
 
+/// <summary>Builds table of next state to go toward each target state.
+/// </summary>
+/// <remarks>Next state is the child leading to the target if target is a
+/// descendant, parent state otherwise, including when target is the state
+/// itself so that it is re-entered.</remarks>
+void CPrinter::BuildTransitTable()
+{
+  int from, to;
+  CState *pState, *pPrev;
+
+  memset(m_apState, 0, sizeof(m_apState));
+  memset(m_aanNext, -1, sizeof(m_aanNext));
+  m_pStateTop->Flatten(m_apState, STATE_CNT);
+
+  for(from = 0;from < STATE_CNT;from++)
+  {
+    if(m_apState[from] == NULL) { continue; }
+
+    for(to = 0;to < STATE_CNT;to++)
+    {
+      if(m_apState[to] == NULL) { continue; }
+
+      // climb from target until reaching this state or the top.
+      pPrev = NULL;
+      pState = m_apState[to];
+      while((pState != NULL) && (pState != m_apState[from]))
+      {
+        pPrev = pState;
+        pState = pState->GetParent();
+      } // while...
+
+      if((pState != NULL) && (pPrev != NULL))
+      {
+        m_aanNext[from][to] = (signed char)pPrev->GetID();
+      }
+      else if(m_apState[from]->GetParent() != NULL)
+      {
+        m_aanNext[from][to] = (signed char)m_apState[from]->GetParent()->GetID();
+      } // if...else...
+    } // for...
+  } // for...
+}
+
 /// <summary>Transits to target state.</summary>
 /// <param name="target">Target state ID.</param>
 /// <exception cref="wcl::CArgumentException">If state referred by
 /// <paramref name="target"/> does not exist.</exception>
+/// <remarks>Each step is looked up from table built by
+/// <see cref="BuildTransitTable"/>.</remarks>
 void CPrinter::Transit(int target)
 {
   bool reached = false;
+  int next;
   CState *pNext;
 
+  if((target < 0) || (target >= STATE_CNT) || (m_apState[target] == NULL))
+  {
+    WCL_THROW_ARGUMENTEXCEPTION(L"target", L"target not found");
+  }
+
   do
   {
-    pNext = m_pCurState->IsAncenstorOf(target);
-    if(pNext != NULL)
+    next = m_aanNext[m_pCurState->GetID()][target];
+    if(next < 0) { WCL_THROW_ARGUMENTEXCEPTION(L"target", L"target not found"); }
+
+    pNext = m_apState[next];
+    if(pNext->GetParent() == m_pCurState)
     {
       m_pCurState = pNext;
-      reached = (m_pCurState->GetID() == target);
+      m_Context.m_Trace.SetState(next);
+      reached = (next == target);
       m_pCurState->OnEnter(reached);
 
       // to ensure loop break even when OnEnter() recursively calls this function.
@@ -45,14 +102,14 @@ void CPrinter::Transit(int target)
     {
       // does not support OnLeave() recursively calls this function.
       m_pCurState->OnLeave();
-      m_pCurState = m_pCurState->GetParent();
-      if(m_pCurState == NULL)
-      {
-        WCL_THROW_ARGUMENTEXCEPTION(L"target", L"target not found");
-      }
+      m_pCurState = pNext;
+      m_Context.m_Trace.SetState(next);
     } // if...else...
   }
   while(m_pCurState->GetID() != target);
+
+  // new state may have a different deadline.
+  m_Context.Wake();
 }
 
 /// <summary>Initializes printer.</summary>
@@ -61,43 +118,53 @@ void CPrinter::Transit(int target)
 /// <exception cref="wcl::CArgumentException">If <paramref name="param"/> is
 /// invalid.</exception>
 /// <exception cref="CException">If initialization failed.</exception>
+/// <remarks>Observer is called from a dispatcher thread of this printer.
+/// </remarks>
 void CPrinter::Init(const wchar_t* param, print::IEvtObserver* evtObserver)
 {
   m_csThis.Enter();
+  m_Context.m_Events.Start(&m_Context);
   m_pCurState->Init(param, evtObserver);
+  m_bInit = true;
   m_csThis.Leave();
 }
 
 /// <summary>Un-initializes printer.</summary>
+/// <remarks>Calls still queued are not made but reported failed, then events
+/// still queued are delivered before returning.</remarks>
 void CPrinter::UnInit()
 {
   m_csThis.Enter();
+  m_bInit = false;
   m_pCurState->UnInit();
+  FailCmds(m_Mailbox.TakeAll());
   m_csThis.Leave();
+
+  m_Context.m_Events.Stop();
 }
 
 /// <summary>Suspends the printer.</summary>
-/// <remarks>If invoked before initialization, printer will enter suspend mode
+/// <remarks>Queued for the state machine thread, returns immediately. Outcome
+/// is reported through the observer.
+/// If invoked before initialization, printer will enter suspend mode
 /// immediately after initialization (which is also the default behaviour),
 /// but suspended event will not be issued as observer is not ready yet.
 /// If invoked in the middle of printing, printer will enter suspended mode but
 /// still continue to finish current print job.</remarks>
 void CPrinter::Suspend()
 {
-  m_csThis.Enter();
-  m_pCurState->Suspend();
-  m_csThis.Leave();
+  PostCmd(new CApiCmd(CApiCmd::TYPE_SUSPEND));
 }
 
 /// <summary>Resumes printer from suspend mode.</summary>
-/// <remarks>If invoked before initialization, printer will enter resumed mode
+/// <remarks>Queued for the state machine thread, returns immediately. Outcome
+/// is reported through the observer.
+/// If invoked before initialization, printer will enter resumed mode
 /// immediately after initialization, but resumed event will not be issued
 /// as observer is not ready yet.</remarks>
 void CPrinter::Resume()
 {
-  m_csThis.Enter();
-  m_pCurState->Resume();
-  m_csThis.Leave();
+  PostCmd(new CApiCmd(CApiCmd::TYPE_RESUME));
 }
 
 /// <summary>Retrieves printer metrics.</summary>
@@ -119,22 +186,29 @@ void CPrinter::GetMetrics(print::CMetrics& metrics)
 /// clearing the NVM.</param>
 /// <exception cref="wcl::CInvalidOperationException">If invoked before printer
 /// is initialized.</exception>
+/// <remarks>Queued for the state machine thread, returns immediately. Outcome
+/// is reported through the observer.</remarks>
 void CPrinter::SelfTest(bool clearNVM)
 {
-  m_csThis.Enter();
-  m_pCurState->SelfTest(clearNVM);
-  m_csThis.Leave();
+  CApiCmd *pCmd;
+
+  CheckInit();
+  pCmd = new CApiCmd(CApiCmd::TYPE_SELF_TEST);
+  if(pCmd == NULL) { throw wcl::COutOfMemoryException(); }
+  pCmd->m_bClearNVM = clearNVM;
+  PostCmd(pCmd);
 }
 
 /// <summary>Requests diagnostic information from the printer via a GAT Data
 /// event.</summary>
 /// <exception cref="wcl::CInvalidOperationException">If invoked before printer
 /// is initialized.</exception>
+/// <remarks>Queued for the state machine thread, returns immediately. Outcome
+/// is reported through the observer.</remarks>
 void CPrinter::RqGATReport()
 {
-  m_csThis.Enter();
-  m_pCurState->RqGATReport();
-  m_csThis.Leave();
+  CheckInit();
+  PostCmd(new CApiCmd(CApiCmd::TYPE_GAT_REPORT));
 }
 
 /// <summary>Requests a 32-bit checksum from the code space within the
@@ -142,81 +216,231 @@ void CPrinter::RqGATReport()
 /// <param name="seed">32-bit seed.</param>
 /// <exception cref="wcl::CInvalidOperationException">If invoked before printer
 /// is initialized.</exception>
-/// <remarks>Printer will not be functioning during the calculation.</remarks>
+/// <remarks>Queued for the state machine thread, returns immediately. Outcome
+/// is reported through the observer.
+/// Printer will not be functioning during the calculation.</remarks>
 void CPrinter::CalculateCRC(DWORD seed)
 {
-  m_csThis.Enter();
-  m_pCurState->CalculateCRC(seed);
-  m_csThis.Leave();
+  CApiCmd *pCmd;
+
+  CheckInit();
+  pCmd = new CApiCmd(CApiCmd::TYPE_CRC);
+  if(pCmd == NULL) { throw wcl::COutOfMemoryException(); }
+  pCmd->m_dwSeed = seed;
+  PostCmd(pCmd);
 }
 
 /// <summary>Defines graphic.</summary>
 /// <param name="graphic">Graphic.</param>
-/// <exception cref="wcl::CArgumentException">If <paramref name="graphic"/> is
-/// invalid.</exception>
+/// <exception cref="wcl::CArgumentException">If identifier of
+/// <paramref name="graphic"/> is invalid.</exception>
 /// <exception cref="wcl::CInvalidOperationException">If invoked before printer
 /// is initialized.</exception>
-/// <remarks>If graphic of same identifier already exists, new graphic will
+/// <remarks>Queued for the state machine thread, returns immediately. Outcome
+/// is reported through the observer.
+/// If graphic of same identifier already exists, new graphic will
 /// replace current one. If identifier being replaced is for a predefined
 /// graphic, the new graphic will still replace the predefined graphic, but the
 /// original predefined graphic will be restored after power cycle reset.</remarks>
 void CPrinter::DefineGraphic(const print::CGraphic& graphic)
+{
+  CApiCmd *pCmd;
+  CMsgMgr msgMgr;
+
+  CheckInit();
+  msgMgr.GraphicID2Drv(graphic.m_byID);
+  pCmd = new CApiCmd(CApiCmd::TYPE_DEFINE_GRAPHIC);
+  if(pCmd == NULL) { throw wcl::COutOfMemoryException(); }
+  pCmd->m_Graphic = graphic;
+  PostCmd(pCmd);
+}
+
+/// <summary>Uploads graphic, region and template definitions in one batch.</summary>
+/// <param name="batch">Definitions, processed graphics first, then regions,
+/// then templates.</param>
+/// <returns>True if batch is queued, in which case
+/// <see cref="IDefineBatchObserver::OnDefineBatchCompleted"/> is notified when
+/// done, false if printer is not initialized.</returns>
+/// <exception cref="wcl::CArgumentException">If <paramref name="batch"/> is
+/// invalid.</exception>
+/// <remarks>Definitions are copied and queued for the state machine thread,
+/// returns immediately. If printer is not idle when the batch is taken, every
+/// definition is reported not attempted.</remarks>
+bool CPrinter::DefineBatch(const SDefineBatch& batch)
+{
+  CApiCmd *pCmd;
+
+  if(!m_bInit) { return false; }
+
+  pCmd = new CApiCmd(CApiCmd::TYPE_DEFINE_BATCH);
+  if(pCmd == NULL) { throw wcl::COutOfMemoryException(); }
+  try
+  {
+    pCmd->m_Batch.Assign(batch);
+  }
+  catch(...)
+  {
+    delete pCmd;
+    throw;
+  }
+  PostCmd(pCmd);
+
+  return true;
+}
+
+/// <summary>Retrieves driver statistics.</summary>
+/// <param name="stats">Receives statistics since this instance was created.
+/// </param>
+/// <remarks>Does not wait for the state machine, statistics have their own
+/// lock.</remarks>
+void CPrinter::GetDriverStats(SDriverStats& stats)
+{
+  m_Context.m_Port.m_Stats.Get(stats);
+}
+
+/// <summary>Retrieves progress of last large command streamed to printer,
+/// e.g. a graphic definition.</summary>
+/// <param name="sent">Receives number of bytes sent.</param>
+/// <param name="total">Receives size of command, 0 if none was
+/// streamed.</param>
+/// <returns>True if command is still being streamed, false otherwise.
+/// </returns>
+/// <remarks>Does not wait for the state machine.</remarks>
+bool CPrinter::GetUploadProgress(DWORD& sent, DWORD& total)
+{
+  return m_Context.m_Port.GetTxProgress(sent, total);
+}
+
+/// <summary>Cancels large graphic definition being streamed to printer.
+/// </summary>
+/// <remarks>Does not wait for the state machine. Graphic is reported failed
+/// and printer is re-synchronized once streaming stops, nothing is done if
+/// streaming already completed or streamed command is not a graphic.</remarks>
+void CPrinter::CancelUpload()
+{
+  m_Context.m_Port.CancelTx();
+  m_Context.Wake();
+}
+
+/// <summary>Sets observer to receive printer condition changes in one call per
+/// status poll.</summary>
+/// <param name="pObserver">Observer, NULL to notify condition changes through
+/// <see cref="print::IEvtObserver"/> again.</param>
+void CPrinter::SetStatusObserver(IStatusObserver* pObserver)
 {
   m_csThis.Enter();
-  m_pCurState->DefineGraphic(graphic);
+  m_Context.m_pStatusObserver = pObserver;
   m_csThis.Leave();
 }
 
 /// <summary>Defines printable region.</summary>
 /// <param name="region">Printable region.</param>
-/// <exception cref="wcl::CArgumentException">If <paramref name="region"/> is
-/// invalid.</exception>
+/// <exception cref="wcl::CArgumentException">If identifier of
+/// <paramref name="region"/> is invalid.</exception>
 /// <exception cref="wcl::CInvalidOperationException">If invoked before printer
 /// is initialized.</exception>
-/// <remarks>Only region ID between 100 ~ 999 can be defined. If a region ID
+/// <remarks>Queued for the state machine thread, returns immediately. Outcome
+/// is reported through the observer.
+/// Only region ID between 100 ~ 999 can be defined. If a region ID
 /// already defined, new region will replace the current region definition.</remarks>
 void CPrinter::DefineRegion(const print::CRegion& region)
 {
-  m_csThis.Enter();
-  m_pCurState->DefineRegion(region);
-  m_csThis.Leave();
+  CApiCmd *pCmd;
+  CMsgMgr msgMgr;
+
+  CheckInit();
+  msgMgr.RegionID2Drv(region.m_nsID);
+  pCmd = new CApiCmd(CApiCmd::TYPE_DEFINE_REGION);
+  if(pCmd == NULL) { throw wcl::COutOfMemoryException(); }
+  pCmd->m_Region = region;
+  PostCmd(pCmd);
 }
 
 /// <summary>Defines printable template.</summary>
 /// <param name="templ">Printable template.</param>
-/// <exception cref="wcl::CArgumentException">If <paramref name="template"/>
-/// is invalid.</exception>
+/// <exception cref="wcl::CArgumentException">If identifier of
+/// <paramref name="templ"/> is invalid.</exception>
 /// <exception cref="wcl::CInvalidOperationException">If invoked before printer
 /// is initialized.</exception>
+/// <remarks>Queued for the state machine thread, returns immediately. Outcome
+/// is reported through the observer.</remarks>
 void CPrinter::DefineTemplate(const print::CTemplate& templ)
 {
-  m_csThis.Enter();
-  m_pCurState->DefineTemplate(templ);
-  m_csThis.Leave();
+  CApiCmd *pCmd;
+  CMsgMgr msgMgr;
+
+  CheckInit();
+  msgMgr.TemplID2Drv(templ.m_nsID);
+  pCmd = new CApiCmd(CApiCmd::TYPE_DEFINE_TEMPL);
+  if(pCmd == NULL) { throw wcl::COutOfMemoryException(); }
+  pCmd->m_Templ = templ;
+  PostCmd(pCmd);
 }
 
 /// <summary>Prints a job using specified template.</summary>
 /// <param name="job">Print job.</param>
+/// <exception cref="wcl::CArgumentException">If template ID of
+/// <paramref name="job"/> is out of range.</exception>
 /// <exception cref="wcl::CInvalidOperationException">If invoked before printer
 /// is initialized.</exception>
-/// <remarks>Printer will ignore this call when it is in suspend mode, or when
+/// <remarks>Queued for the state machine thread, returns immediately. Outcome
+/// is reported through the observer.
+/// Printer will discard the job when it is in suspend mode, or when
 /// following conditions are present: print head open, paper jam, paper empty,
-/// top of form.</remarks>
+/// top of form. If invoked while printing, job is queued and printed as soon as
+/// current job completes, queued jobs are discarded on suspend or error.
+/// Every job is reported once, discarded ones by OnPrintFailed with
+/// <see cref="PRINT_ERR_DISCARDED"/>.</remarks>
 void CPrinter::Print(const print::CJob& job)
 {
-  m_csThis.Enter();
-  m_pCurState->Print(job);
-  m_csThis.Leave();
+  SubmitJob(job);
+}
+
+/// <summary>Prints a job using specified template.</summary>
+/// <param name="job">Print job.</param>
+/// <returns>Identifier given to <paramref name="job"/>, never zero.</returns>
+/// <exception cref="wcl::CArgumentException">If template ID of
+/// <paramref name="job"/> is out of range.</exception>
+/// <exception cref="wcl::CInvalidOperationException">If invoked before printer
+/// is initialized.</exception>
+/// <remarks>As <see cref="Print"/>. A job that is not printed is reported by
+/// OnPrintFailed, with <see cref="PRINT_ERR_DISCARDED"/> if it was dropped.
+/// </remarks>
+DWORD CPrinter::SubmitJob(const print::CJob& job)
+{
+  DWORD id, len;
+  const BYTE *pbyHead;
+  CApiCmd *pCmd;
+  CMsgMgr msgMgr;
+
+  CheckInit();
+  if(!msgMgr.TryGetPrintHead(job.m_nsTemplateID, pbyHead, len))
+  {
+    WCL_THROW_ARGUMENTEXCEPTION(L"job", L"template ID must between 0 to 999");
+  }
+  pCmd = new CApiCmd(CApiCmd::TYPE_PRINT);
+  if(pCmd == NULL) { throw wcl::COutOfMemoryException(); }
+  pCmd->m_Job = job;
+
+  // call may be made and deleted as soon as it is posted.
+  m_csSubmit.Enter();
+  pCmd->m_dwJobID = id = m_Context.m_PrintQueue.NewID();
+  m_Mailbox.Post(pCmd);
+  m_csSubmit.Leave();
+  m_Context.Wake();
+
+  return id;
 }
 
 /// <summary>Feeds a blank ticket.</summary>
 /// <exception cref="wcl::CInvalidOperationException">If invoked before printer
 /// is initialized.</exception>
+/// <remarks>Queued for the state machine thread, returns immediately. Outcome
+/// is reported through the observer.</remarks>
 void CPrinter::FormFeed()
 {
-  m_csThis.Enter();
-  m_pCurState->FormFeed();
-  m_csThis.Leave();
+  CheckInit();
+  PostCmd(new CApiCmd(CApiCmd::TYPE_FORM_FEED));
 }
 
 /// <summary>Retrieves firmware currency.</summary>
@@ -231,17 +455,141 @@ void CPrinter::GetFirmwareCurrency(CWkString& currency)
   m_csThis.Leave();
 }
 
+/// <summary>Sets status flags reported by printer simulator.</summary>
+/// <param name="flags">Combination of <see cref="CStatus::FLAG"/>.</param>
+/// <returns>True if printer is simulated, false otherwise.</returns>
+/// <remarks>Does not wait for the state machine, flags are seen from the next
+/// status poll on.</remarks>
+bool CPrinter::SetSimStatus(DWORD flags)
+{
+  return m_Context.m_Port.SetSimStatus(flags);
+}
+
 /// <summary>Executes state.</summary>
 /// <param name="elapsed">Time elapsed since last run, in milliseconds.</param>
+/// <remarks>Queued API calls are made first. Then every frame already
+/// received is handled in this run, each by the state current by then, for as
+/// long as the state keeps consuming them.</remarks>
 void CPrinter::Run(DWORD elapsed)
 {
+  DWORD cnt, left;
+
   if( m_csThis.TryEnter() )
   {
+    RunCmds();
+
+    cnt = m_Context.m_Port.m_Frames.GetCount();
     m_pCurState->Run(elapsed);
+    while(((left = m_Context.m_Port.m_Frames.GetCount()) > 0) && (left < cnt))
+    {
+      cnt = left;
+      m_pCurState->Run(0);
+    } // while...
+
     m_csThis.Leave();
   } // if...
 }
 
+/// <summary>Checks printer is initialized, before queuing a call.</summary>
+/// <exception cref="wcl::CInvalidOperationException">If invoked before printer
+/// is initialized.</exception>
+void CPrinter::CheckInit()
+{
+  if(!m_bInit) { WCL_THROW_INVALIDOPERATIONEXCEPTION(L"printer not initialized"); }
+}
+
+/// <summary>Queues an API call for the state machine thread.</summary>
+/// <param name="pCmd">Call allocated with new, owned by mailbox from now on.
+/// </param>
+/// <exception cref="wcl::COutOfMemoryException">If <paramref name="pCmd"/> is
+/// NULL.</exception>
+void CPrinter::PostCmd(CApiCmd* pCmd)
+{
+  if(pCmd == NULL) { throw wcl::COutOfMemoryException(); }
+
+  m_Mailbox.Post(pCmd);
+  m_Context.Wake();
+}
+
+/// <summary>Makes queued API calls on current state, in the order posted.
+/// </summary>
+/// <remarks>A call failed by exception is traced and reported failed through
+/// the observer, as the host is no longer waiting for it.</remarks>
+void CPrinter::RunCmds()
+{
+  CWkString strTmp;
+  CApiCmd *pCmd = m_Mailbox.TakeAll(), *pNext;
+
+  while(pCmd != NULL)
+  {
+    pNext = pCmd->m_pNext;
+
+    try
+    {
+      pCmd->Execute(m_pCurState);
+    }
+    catch(wcl::CSelfDocException& e)
+    {
+      e.ToString(strTmp);
+      m_Context.Trace(TRACE_CMD_EXCEPTION, pCmd->m_nType);
+      CLog::Log(L"[printdrv_fl_psa66st2r][CPrinter::RunCmds] %s\n",
+        (const wchar_t*)strTmp);
+      pCmd->Fail(&m_Context);
+    }
+    catch(...)
+    {
+      // caller stops this instance, remaining calls are not made.
+      FailCmds(pCmd);
+      throw;
+    } // try...catch...
+
+    delete pCmd;
+    pCmd = pNext;
+  } // while...
+}
+
+/// <summary>Reports API calls failed through the observer without making
+/// them.</summary>
+/// <param name="pCmd">Calls linked through <see cref="CApiCmd::m_pNext"/>,
+/// oldest first, each deleted once reported. May be NULL.</param>
+void CPrinter::FailCmds(CApiCmd* pCmd)
+{
+  CApiCmd *pNext;
+
+  while(pCmd != NULL)
+  {
+    pNext = pCmd->m_pNext;
+
+    try
+    {
+      pCmd->Fail(&m_Context);
+    }
+    catch(...)
+    {
+      CLog::Log(L"[printdrv_fl_psa66st2r][CPrinter::FailCmds] failed to report call %d\n",
+        pCmd->m_nType);
+    }
+
+    delete pCmd;
+    pCmd = pNext;
+  } // while...
+}
+
+/// <summary>Retrieves time until state needs to run again.</summary>
+/// <returns>Time until next timer is due, in milliseconds.</returns>
+DWORD CPrinter::GetIdleTime()
+{
+  DWORD dwTmp = RUN_INTERVAL;
+
+  if( m_csThis.TryEnter() )
+  {
+    dwTmp = m_pCurState->GetIdleTime();
+    m_csThis.Leave();
+  } // if...
+
+  return dwTmp;
+}
+
 /// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
 /// <param name="pElem">Pointer to XML DOM element.</param>
 void CPrinter::Dump(MSXML2::IXMLDOMElement* pElem)
@@ -255,6 +603,10 @@ void CPrinter::Dump(MSXML2::IXMLDOMElement* pElem)
     {
       wcl::CDumpHelper::DumpChild<CPrinterContext&>(pElem, L"m_Context",
         m_Context);
+      wcl::CDumpHelper::DumpChild<CDrvStats&>(pElem, L"m_Stats",
+        m_Context.m_Port.m_Stats);
+      wcl::CDumpHelper::DumpChild<CTraceRing&>(pElem, L"m_Trace",
+        m_Context.m_Trace);
 
       if(!CXmlUtil::AppendChild(pElem, L"m_pStateTop", &pChild)) { throw false; }
       m_pStateTop->Dump(pChild);
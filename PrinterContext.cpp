@@ -6,20 +6,23 @@ CPrinterContext::CPrinterContext() :
   m_bDebug(false),
   m_bErrDump(true),
   m_pEvtObserver(NULL),
-  m_dwLastCmdSize(0),
-  m_dwLastCmdMemSize(1024),
-  m_hThread(NULL),
+  m_pStatusObserver(NULL),
+  m_dwEvtMask(STATUS_TOP_OF_FORM),
+  m_dwPrintJobID(0),
   m_bInitSuspend(true),
-  m_bStopThread(true),
+  m_dwPollBusy(POLL_BUSY_INTERVAL),
+  m_dwPollIdle(POLL_INTERVAL),
+  m_dwAliveTimeout(ALIVE_TIMEOUT),
+  m_dwFlashTime(FLASH_TRANSFER_TIME),
   m_pJobFilter(NULL)
 {
-  m_pbyLastCmd = new BYTE[m_dwLastCmdMemSize];
+  m_hWakeEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
 }
 
 /// <summary>Destructor.</summary>
 CPrinterContext::~CPrinterContext()
 {
-  delete[] m_pbyLastCmd;
+  if(m_hWakeEvent != NULL) { ::CloseHandle(m_hWakeEvent); }
 }
 
 /// <summary>Extracts context related parameters.</summary>
@@ -53,82 +56,271 @@ void CPrinterContext::Parse(const wchar_t* parameters)
 	{
 		m_strCfgCurrency = value;
 	}
-}
 
-/// <summary>Thread-safe function to check if <see cref="m_bStopThread"/> is set.
-/// </summary>
-/// <returns>Value of <see cref="m_bStopThread"/>.</returns>
-bool CPrinterContext::StopThread()
-{
-  bool bTmp;
+  value = CWkString();
+  pair.Get(L"firmware", value);
+  m_Firmware.Load(value);
+  // re-select settings of current firmware on next status.
+  m_strSoftwareVer = CWkString();
 
-  m_csStopThread.Enter();
-  bTmp = m_bStopThread;
-  m_csStopThread.Leave();
+  m_dwPollBusy = POLL_BUSY_INTERVAL;
+  if(pair.Get(L"poll_busy", value))
+  {
+    m_dwPollBusy = __max(RUN_INTERVAL, wcstoul((const wchar_t*)value, NULL, 10));
+  } // if...
+
+  m_dwPollIdle = POLL_INTERVAL;
+  if(pair.Get(L"poll_idle", value))
+  {
+    m_dwPollIdle = __max(RUN_INTERVAL, wcstoul((const wchar_t*)value, NULL, 10));
+  } // if...
+
+  m_dwAliveTimeout = ALIVE_TIMEOUT;
+  if(pair.Get(L"alive_timeout", value))
+  {
+    m_dwAliveTimeout = wcstoul((const wchar_t*)value, NULL, 10);
+  } // if...
+  // printer must be given at least two polls to answer.
+  m_dwAliveTimeout = __max(m_dwAliveTimeout, 2 * __max(m_dwPollBusy, m_dwPollIdle));
+
+  m_dwFlashTime = FLASH_TRANSFER_TIME;
+  if(pair.Get(L"flash_time", value))
+  {
+    m_dwFlashTime = wcstoul((const wchar_t*)value, NULL, 10);
+  } // if...
 
-  return bTmp;
+  value = CWkString();
+  pair.Get(L"def_cache", value);
+  m_DefCache.Load(value);
 }
 
-/// <summary>Thread-safe function to set <see cref="m_bStopThread"/>.</summary>
-/// <param name="stop">New value of <see cref="m_bStopThread"/>.</param>
-void CPrinterContext::SetStopThread(bool stop)
+/// <summary>Wakes reactor worker if it is waiting on the port, so that it
+/// re-evaluates its next deadline.</summary>
+void CPrinterContext::Wake()
 {
-  m_csStopThread.Enter();
-  m_bStopThread = stop;
-  m_csStopThread.Leave();
+  if(m_hWakeEvent != NULL) { ::SetEvent(m_hWakeEvent); }
 }
 
 /// <summary>Sends message and remembers the message as last sent command.</summary>
 /// <param name="msg">Message to be sent.</param>
-void CPrinterContext::SendNUpdateLastCmd(CMsg& msg)
+/// <param name="cancellable">True if message is a graphic upload, which may be
+/// cancelled while it is streamed, false otherwise.</param>
+void CPrinterContext::SendNUpdateLastCmd(CMsg& msg, bool cancellable)
+{
+  m_LastCmd.Clear();
+  try
+  {
+    msg.Encode(m_LastCmd);
+  }
+  catch(...)
+  {
+    m_LastCmd.Clear();
+    throw;
+  }
+
+  m_Port.Send(m_LastCmd.GetData(), m_LastCmd.GetSize(), cancellable);
+  m_Port.m_Stats.AddCmd(m_Port.GetTxTime());
+}
+
+/// <summary>Updates software version, and selects firmware settings if it
+/// changed.</summary>
+/// <param name="ver">Software version.</param>
+/// <remarks>Unknown firmware uses job filter of GUR126003, and configured
+/// currency if it is the configured version.</remarks>
+void CPrinterContext::UpdateSoftwareVer(const wchar_t* ver)
+{
+  const SFirmware *pFirmware;
+  IJobFilter *pJobFilter = &m_JFGUR126003;
+
+  m_DefCache.SetVersion(ver);
+  if(m_strSoftwareVer == ver) { return; }
+
+  m_strSoftwareVer = ver;
+  m_strCurrency = CWkString();
+
+  pFirmware = m_Firmware.Find(ver);
+  if(pFirmware != NULL)
+  {
+    m_strCurrency = pFirmware->m_strCurrency;
+    switch(pFirmware->m_nFilter)
+    {
+    case SFirmware::FILTER_NONE       : pJobFilter = NULL; break;
+    case SFirmware::FILTER_GURNSW200  : pJobFilter = &m_JFGURNSW200; break;
+    } // switch...
+  }
+  else if(m_strSoftwareVer == m_strCfgSoftwareVer)
+  {
+    m_strCurrency = m_strCfgCurrency;
+  } // if...else...
+
+  Trace(TRACE_SOFTWARE_VER, CTraceRing::Pack(m_strSoftwareVer, 0),
+    CTraceRing::Pack(m_strSoftwareVer, 4), CTraceRing::Pack(m_strSoftwareVer, 8),
+    CTraceRing::Pack(m_strCurrency, 0));
+
+  // select job filter.
+  m_csJobFilter.Enter();
+  m_pJobFilter = pJobFilter;
+  m_csJobFilter.Leave();
+}
+
+/// <summary>Fills in default data, applies job filter and sends print job.</summary>
+/// <param name="job">Print job.</param>
+/// <param name="id">Identifier of <paramref name="job"/>.</param>
+/// <exception cref="CCommException">If failed to send.</exception>
+void CPrinterContext::SendPrintJob(const print::CJob& job, DWORD id)
+{
+  CMsgMgr msgMgr;
+  BYTE templateID;
+  bool bDefData;
+  int blankCnt = 0;
+  CMsgPrint msg;
+  print::CJob ppJob;
+  IJobFilter *pJobFilter = GetJobFilter();
+
+  bDefData = msgMgr.TryTemplID2Drv(job.m_nsTemplateID, templateID) &&
+    m_TemplDefData.NeedApply(templateID, job);
+  if(pJobFilter != NULL) { blankCnt = pJobFilter->GetBlankCnt(job); }
+
+  if(!bDefData && (blankCnt >= 0))
+  {
+    // nothing to edit, job fields are spliced into the command as they are.
+    msg.m_pJob = &job;
+    msg.m_nBlankCnt = blankCnt;
+  }
+  else
+  {
+    ppJob = job;
+
+    // pre-process job to fill in default data.
+    if(bDefData) { m_TemplDefData.Apply(templateID, ppJob); }
+
+    // apply job filter.
+    if(pJobFilter && pJobFilter->NeedTransform(ppJob))
+    {
+	    pJobFilter->Transform(ppJob);
+    }
+    msg.m_pJob = &ppJob;
+  } // if...else...
+
+  m_dwPrintJobID = id;
+  Trace(TRACE_JOB_SENT, id);
+  SendNUpdateLastCmd(msg);
+}
+
+/// <summary>Reports a print job discarded without being printed.</summary>
+/// <param name="id">Identifier of job.</param>
+void CPrinterContext::FailPrintJob(DWORD id)
 {
-  m_dwLastCmdSize = msg.Build(NULL, 0);
-  if(m_dwLastCmdSize > m_dwLastCmdMemSize)
+  Trace(TRACE_JOB_FAILED, id);
+  if(m_pEvtObserver != NULL)
   {
-    delete[] m_pbyLastCmd;
-    m_pbyLastCmd = new BYTE[m_dwLastCmdSize];
-    if(m_pbyLastCmd == NULL) { throw wcl::COutOfMemoryException(); }
-    m_dwLastCmdMemSize = m_dwLastCmdSize;
+    m_Events.Post(EVT_PRINT_FAILED, PRINT_ERR_DISCARDED);
   }
+}
+
+/// <summary>Discards queued print jobs, reporting each of them failed.
+/// </summary>
+void CPrinterContext::DiscardPrintJobs()
+{
+  DWORD id;
+  print::CJob job;
+  int cnt = 0;
+
+  while(m_PrintQueue.Pop(job, id))
+  {
+    FailPrintJob(id);
+    cnt++;
+  } // while...
 
-  msg.Build(m_pbyLastCmd, m_dwLastCmdSize);
-  m_Port.Write(m_pbyLastCmd, m_dwLastCmdSize);
+  if(cnt > 0) { Trace(TRACE_JOBS_DISCARDED, cnt); }
 }
 
-#define CHECK_EVT(errFunc, evtFunc) if(status.errFunc() != m_Status.errFunc())\
-                                    {\
-                                      if(m_pEvtObserver != NULL)\
-                                      {\
-                                        m_pEvtObserver->evtFunc(status.errFunc());\
-                                      }\
-                                    }
+/// <summary>Stores a defined template.</summary>
+/// <param name="templateID">Driver template ID.</param>
+/// <param name="templ">Template.</param>
+void CPrinterContext::SetTemplate(BYTE templateID, const print::CTemplate& templ)
+{
+  m_Template.Set(templateID, templ);
+  m_TemplDefData.Set(templateID, templ, m_RegionDefData);
+}
+
+/// <summary>Removes a stored template.</summary>
+/// <param name="templateID">Driver template ID.</param>
+void CPrinterContext::RemoveTemplate(BYTE templateID)
+{
+  m_Template.Remove(templateID);
+  m_TemplDefData.Remove(templateID);
+}
+
+/// <summary>Replaces default data of a region.</summary>
+/// <param name="regionID">Driver region ID.</param>
+/// <param name="defData">Default data, NULL or empty to remove.</param>
+void CPrinterContext::SetRegionDefData(BYTE regionID, const wchar_t* defData)
+{
+  m_RegionDefData.Remove(regionID);
+  if((defData != NULL) && (defData[0] != L'\0'))
+  {
+    m_RegionDefData.Set(regionID, defData);
+  }
+  m_TemplDefData.SetRegion(regionID, defData);
+}
 
 /// <summary>Updates status and Notifies observer if errors detected.</summary>
 /// <param name="status">Latest printer status.</param>
 void CPrinterContext::UpdateStatusNNotifyObserver(const CStatus& status)
 {
-  if(status.ExtPowerLost() && !m_Status.ExtPowerLost())
+  if((status.m_dwFlags ^ m_Status.m_dwFlags) == 0) { return; }
+
+  NotifyStatus(status.GetEvtMask());
+
+  // printer restored its predefined definitions.
+  if(status.Test(CStatus::FLAG_POWER_UP_RESET) &&
+    !m_Status.Test(CStatus::FLAG_POWER_UP_RESET))
   {
-    if(m_pEvtObserver != NULL) { m_pEvtObserver->OnExtPowerLost(); }
+    m_DefCache.Invalidate();
   }
-  else if(!status.ExtPowerLost() && m_Status.ExtPowerLost())
+
+  m_Status = status;
+}
+
+/// <summary>Posts changed printer conditions to observer.</summary>
+/// <param name="newMask">Conditions now, combination of
+/// <see cref="STATUS_EVT"/>.</param>
+/// <remarks>Only conditions that differ from <see cref="m_dwEvtMask"/> are
+/// notified, in a single event if <see cref="m_pStatusObserver"/> is set, or
+/// one event each for <see cref="m_pEvtObserver"/> otherwise. Called once per
+/// status poll at most.</remarks>
+void CPrinterContext::NotifyStatus(DWORD newMask)
+{
+  int i;
+  DWORD oldMask = m_dwEvtMask, changed = oldMask ^ newMask;
+
+  if(changed == 0) { return; }
+  m_dwEvtMask = newMask;
+
+  if(m_pStatusObserver != NULL)
   {
-    if(m_pEvtObserver != NULL) { m_pEvtObserver->OnExtPowerResumed(); }
-  } // if...else...
+    m_Events.Post(EVT_STATUS_CHANGED, oldMask, newMask);
+    return;
+  }
+  if(m_pEvtObserver == NULL) { return; }
 
-  CHECK_EVT(FirmwareErr, OnFirmwareErr);
-  CHECK_EVT(NVMErr, OnNVMErr);
-  CHECK_EVT(PrintHeadErr, OnPrintHeadErr);
-  CHECK_EVT(TemperatureErr, OnTemperatureErr);
-  CHECK_EVT(GeneralErr, OnGeneralErr);
-  CHECK_EVT(PrintHeadOpened, OnPrintHead);
-  CHECK_EVT(PaperJam, OnPaperJam);
-  CHECK_EVT(PaperEmpty, OnPaperEmpty);
-  CHECK_EVT(TopOfForm, OnTopOfForm);
-  CHECK_EVT(ChassisOpened, OnChassis);
-  CHECK_EVT(PaperLow, OnPaperLow);
+  for(i = 0;changed != 0;i++, changed >>= 1)
+  {
+    if((changed & 1) != 0)
+    {
+      m_Events.Post(EVT_EXT_POWER + i, (newMask >> i) & 1);
+    }
+  } // for...
+}
 
-  m_Status = status;
+/// <summary>Resets conditions last notified to those observers assume after
+/// initialization, i.e. none present and paper at top of form.</summary>
+/// <remarks>Next <see cref="NotifyStatus"/> then announces every condition
+/// present.</remarks>
+void CPrinterContext::ResetEvtMask()
+{
+  m_dwEvtMask = STATUS_TOP_OF_FORM;
 }
 
 /// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
@@ -149,22 +341,23 @@ void CPrinterContext::Dump(MSXML2::IXMLDOMElement* pElem)
       wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bErrDump", m_bErrDump);
       wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_pEvtObserver",
         (DWORD)m_pEvtObserver);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_pStatusObserver",
+        (DWORD)m_pStatusObserver);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwEvtMask", m_dwEvtMask);
 
-      if(!CXmlUtil::AppendChild(pElem, L"m_pbyLastCmd", &pChild)) { throw false; }
-      if(m_pbyLastCmd != NULL)
+      if(!CXmlUtil::AppendChild(pElem, L"m_LastCmd", &pChild)) { throw false; }
+      for(i = 0;i < m_LastCmd.GetSize();i++)
       {
-        for(i = 0;i < m_dwLastCmdSize;i++)
-        {
-          str2.Format(L"0x%X", m_pbyLastCmd[i]);
-          str1 += str2;
-          if(i != (m_dwLastCmdSize - 1)) { str1 += L" "; }
-        } // for...
-        if(!CXmlUtil::SetValue(pChild, (const wchar_t*)str1)) { throw false; }
-      }
+        str2.Format(L"0x%X", m_LastCmd.GetData()[i]);
+        str1 += str2;
+        if(i != (m_LastCmd.GetSize() - 1)) { str1 += L" "; }
+      } // for...
+      if(!CXmlUtil::SetValue(pChild, (const wchar_t*)str1)) { throw false; }
       SAFE_RELEASE(pChild);
-
-      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwLastCmdSize", m_dwLastCmdSize);
-      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwLastCmdMemSize", m_dwLastCmdMemSize);
+      wcl::CDumpHelper::DumpChild<CPrintQueue&>(pElem, L"m_PrintQueue",
+        m_PrintQueue);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwPrintJobID", m_dwPrintJobID);
+      wcl::CDumpHelper::DumpChild<CDefCache&>(pElem, L"m_DefCache", m_DefCache);
       wcl::CDumpHelper::DumpChild<print::CGraphic&>(pElem, L"m_LastGraphic",
         m_LastGraphic);
       wcl::CDumpHelper::DumpChild<print::CRegion&>(pElem, L"m_LastRegion",
@@ -173,6 +366,10 @@ void CPrinterContext::Dump(MSXML2::IXMLDOMElement* pElem)
         m_LastTemplate);
       wcl::CDumpHelper::DumpAttr<const wchar_t*>(pElem, L"m_strSoftwareVer",
         m_strSoftwareVer);
+      wcl::CDumpHelper::DumpAttr<const wchar_t*>(pElem, L"m_strCurrency",
+        m_strCurrency);
+      wcl::CDumpHelper::DumpChild<CFirmwareRegistry&>(pElem, L"m_Firmware",
+        m_Firmware);
       wcl::CDumpHelper::DumpChild<CStatus&>(pElem, L"m_Status", m_Status);
 
       if(!CXmlUtil::AppendChild(pElem, L"m_RegionDefData", &pChild))
@@ -189,53 +386,17 @@ void CPrinterContext::Dump(MSXML2::IXMLDOMElement* pElem)
       wcl::CDumpHelper::DumpComplexMap<int, print::CTemplate>(m_Template, pChild);
       SAFE_RELEASE(pChild);
 
-      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_hThread", (DWORD)m_hThread);
+      wcl::CDumpHelper::DumpChild<CTemplDefData&>(pElem, L"m_TemplDefData",
+        m_TemplDefData);
+
       wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bInitSuspend", m_bInitSuspend);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bStopThread", m_bStopThread);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwPollBusy", m_dwPollBusy);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwPollIdle", m_dwPollIdle);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwAliveTimeout", m_dwAliveTimeout);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwFlashTime", m_dwFlashTime);
     } // if...
 
   }
   catch(...) {}
   SAFE_RELEASE(pChild);
 }
-
-/// <summary>Run thread execution.</summary>
-DWORD WINAPI CPrinterContext::_Run(LPVOID lpParameter)
-{
-  CWkString strTmp;
-  SRunThreadParam *pParam = (SRunThreadParam*)lpParameter;
-  CPrinterContext *pContext = pParam->m_pContext;
-  IStateMach *pStateMach = pParam->m_pStateMach;
-
-  DWORD dwNow, dwLastTime = CWkTime::GetTime();
-
-  try
-  {
-
-    while(!pContext->StopThread())
-    {
-      dwNow = CWkTime::GetTime();
-      pStateMach->Run(dwNow - dwLastTime);
-      dwLastTime = dwNow;
-      Sleep(RUN_INTERVAL);
-    } // while...
-
-  }
-  catch(wcl::CSelfDocException& e)
-  {
-    e.ToString(strTmp);
-    pContext->Trace(L"%s\n", (const wchar_t*)strTmp);
-  }
-  catch(...)
-  {
-    try
-    {
-      pContext->m_pEvtObserver->OnGeneralErr(true);
-    }
-    catch(...){}
-
-    if(pContext->m_bErrDump) { pStateMach->Dump(L"CPrinterContext::_Run"); }
-  } // try...catch...
-
-  return 0;
-}
@@ -3,28 +3,45 @@
 
 /// <summary>Constructor.</summary>
 CPrinterPort::CPrinterPort() :
-  m_Buffer(3000),
-  m_strHandshake(L"x")
+  m_pTransport(&m_Serial),
+  m_hReader(NULL),
+  m_bRxErr(false),
+  m_dwRxDropped(0),
+  m_ullRxTime(0),
+  m_ullTxTime(0),
+  m_pbyTx(NULL),
+  m_dwTxMemSize(0),
+  m_bTxPending(false),
+  m_dwTxSize(0),
+  m_dwTxCmdSize(0),
+  m_dwTxCmdEnd(0),
+  m_dwTxSent(0),
+  m_bTxCancellable(false),
+  m_lTxCancel(0),
+  m_dwTxChunk(TX_CHUNK_SIZE)
 {
-  m_nPort = 1;
-  m_nBaudRate = 38400;
-  m_nParity = CComPort::PNONE;
-  m_nDataBit = 8;
-  m_nStopBit = 1;
-  m_nTimeOut = 5;
-  m_nBufferSize = 2048;
+  m_hStopReader = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+  m_hRxEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
 }
 
 /// <summary>Destructor.</summary>
 CPrinterPort::~CPrinterPort()
 {
+  if(m_hReader != NULL) { Close(); }
 
+  if(m_hStopReader != NULL) { ::CloseHandle(m_hStopReader); }
+  if(m_hRxEvent != NULL) { ::CloseHandle(m_hRxEvent); }
+  delete[] m_pbyTx;
 }
 
 /// <summary>Extracts port related parameters.</summary>
 /// <param name="parameters">Parameters string.</param>
 /// <exception cref="wcl::CArgumentException">If <paramref name="parameters"/>
 /// is invalid.</exception>
+/// <remarks>"transport" selects "serial" (default) or "sim", the printer
+/// simulator of <see cref="CSimTransport"/>. "tx_chunk" sets the number of
+/// bytes written at a time when streaming large commands, see
+/// <see cref="Send"/>.</remarks>
 void CPrinterPort::Parse(const wchar_t* parameters)
 {
 	CWkString value;
@@ -33,120 +50,178 @@ void CPrinterPort::Parse(const wchar_t* parameters)
   if(parameters == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"parameters"); }
   ::Parse(parameters, pair);
 
-	if(pair.Get(L"port", value)) { m_nPort = wcstol(value, NULL, 10); }
-  else { WCL_THROW_ARGUMENTEXCEPTION(L"parameters", L"missing 'port' parameter"); }
-
-  if(pair.Get(L"baudrate", value)) { m_nBaudRate = wcstol(value, NULL, 10); }
+  m_pTransport = &m_Serial;
+  if(pair.Get(L"transport", value))
+  {
+    if(value == L"sim")           { m_pTransport = &m_Sim; }
+    else if(value != L"serial")
+    {
+      WCL_THROW_ARGUMENTEXCEPTION(L"parameters", L"unknown 'transport' parameter");
+    }
+  } // if...
 
-	if(pair.Get(L"parity", value))
-	{
-		if(value == L"none")			{ m_nParity = CComPort::PNONE; }
-		else if(value == L"even")	{ m_nParity = CComPort::PEVEN; }
-		else if(value == L"odd")	{ m_nParity = CComPort::PODD; }
-	}	// if...
+  m_dwTxChunk = TX_CHUNK_SIZE;
+  if(pair.Get(L"tx_chunk", value))
+  {
+    m_dwTxChunk = __max(1, wcstoul((const wchar_t*)value, NULL, 10));
+  }
 
-	if(pair.Get(L"databit", value)) { m_nDataBit = wcstol(value, NULL, 10); }
-	if(pair.Get(L"timeout", value)) { m_nTimeOut = wcstol(value, NULL, 10); }
-	if(pair.Get(L"buffer_size", value)) { m_nBufferSize = wcstol(value, NULL, 10); }
-  pair.Get(L"handshake", m_strHandshake);
+  m_pTransport->Parse(parameters);
 }
 
-/// <summary>Opens communication port.</summary>
+/// <summary>Opens communication port and starts reader thread.</summary>
 /// <returns>True if port opened successfully, false otherwise.</returns>
 bool CPrinterPort::Open()
 {
-  DCB dcb;
+  if(m_hReader != NULL) { return true; }
+  if(m_hStopReader == NULL) { return false; }
+
+  if(!m_pTransport->Open()) { return false; }
+
+  // nothing received before this open is delivered.
+  m_Buffer.Discard(m_Buffer.GetCount());
+  m_Decoder.Reset();
+  m_Frames.Clear();
+  m_csRxErr.Enter();
+  m_bRxErr = false;
+  m_csRxErr.Leave();
+
+  ::ResetEvent(m_hStopReader);
+  m_hReader = ::CreateThread(NULL, 0, CPrinterPort::_Read, this, 0, NULL);
+  if(m_hReader == NULL)
+  {
+    CLog::Log(L"[printdrv_fl_psa66st2r][CPrinterPort::Open] failed to CreateThread:%u\n",
+      GetLastError());
+    m_pTransport->Close();
+    return false;
+  }
 
-  try
+  return true;
+}
+
+/// <summary>Stops reader thread and closes communication port.</summary>
+void CPrinterPort::Close()
+{
+  if(m_hReader != NULL)
+  {
+    ::SetEvent(m_hStopReader);
+    ::WaitForSingleObject(m_hReader, INFINITE);
+    ::CloseHandle(m_hReader);
+    m_hReader = NULL;
+  } // if...
+
+  ClearTx();
+  m_pTransport->Close();
+}
+
+/// <summary>Reads bytes from transport and posts every completed frame, called
+/// by reader thread only.</summary>
+/// <param name="now">Time bytes were found available, in microseconds.</param>
+/// <exception cref="CCommException">If transport failed.</exception>
+void CPrinterPort::Poll(ULONGLONG now)
+{
+  int cnt;
+  DWORD len;
+  BYTE byIn[256];
+  SRxFrame *pFrame;
+
+  do
   {
+    // bytes not fitting in a full ring are dropped, as before.
+    cnt = m_pTransport->Read(byIn, 256);
+    if(cnt > 0) { m_Stats.AddRead(cnt); }
+    m_Buffer.Push(byIn, cnt);
+
+    while((len = Extract(NULL, 0)) > 0)
+    {
+      pFrame = m_Frames.GetFree();
+      if((len > RX_FRAME_SIZE) || (pFrame == NULL))
+      {
+        TRACE(L"[printdrv_fl_psa66st2r][CPrinterPort::Poll] frame dropped, len:%u.\n",
+          len);
+        m_Buffer.Discard(len);
+        m_Decoder.Reset();
+        m_dwRxDropped = m_dwRxDropped + 1;
+        m_Stats.AddDiscarded(len);
+        continue;
+      }
 
-    if(!CComPort::Open(true)) { return false; }
-    GetState(dcb);
+      pFrame->m_ullRxTime = now;
+      pFrame->m_dwLen = Extract(pFrame->m_abyData, RX_FRAME_SIZE);
+      m_Frames.Post();
+      ::SetEvent(m_hRxEvent);
+    } // while...
+  } while(cnt == 256);
+}
 
-    if(m_strHandshake == L"rtsx")
+/// <summary>Records reader thread failure, to be thrown by next
+/// <see cref="GetMsg"/>.</summary>
+/// <param name="message">Failure message.</param>
+void CPrinterPort::SetRxErr(const wchar_t* message)
+{
+  m_csRxErr.Enter();
+  m_bRxErr = true;
+  m_strRxErr = message;
+  m_csRxErr.Leave();
+
+  ::SetEvent(m_hRxEvent);
+}
+
+/// <summary>Reader thread execution.</summary>
+/// <param name="lpParameter">Pointer to owner <see cref="CPrinterPort"/>.</param>
+DWORD WINAPI CPrinterPort::_Read(LPVOID lpParameter)
+{
+  CPrinterPort *pPort = (CPrinterPort*)lpParameter;
+
+  while(::WaitForSingleObject(pPort->m_hStopReader, 0) != WAIT_OBJECT_0)
+  {
+    try
     {
-      dcb.fOutxCtsFlow = TRUE;
-      dcb.fOutxDsrFlow = TRUE;
-      dcb.fDtrControl = DTR_CONTROL_DISABLE;
-      dcb.fDsrSensitivity = TRUE;
-      dcb.fTXContinueOnXoff = TRUE;
-      dcb.fOutX = TRUE;
-      dcb.fInX = FALSE;
-      dcb.fErrorChar = FALSE;
-      dcb.fNull = FALSE;
-      dcb.fRtsControl = RTS_CONTROL_DISABLE;
+      // transports unable to wait sleep briefly instead, then poll anyway.
+      if(pPort->m_pTransport->WaitRx(INFINITE, pPort->m_hStopReader) ||
+        !pPort->m_pTransport->CanWaitRx())
+      {
+        pPort->Poll(GetTime());
+      }
     }
-    else if(m_strHandshake == L"rts")
+    catch(CCommException& e)
     {
-      dcb.fOutxCtsFlow = TRUE;
-      dcb.fOutxDsrFlow = TRUE;
-      dcb.fDtrControl = DTR_CONTROL_DISABLE;
-      dcb.fDsrSensitivity = TRUE;
-      dcb.fTXContinueOnXoff = TRUE;
-      dcb.fOutX = FALSE;
-      dcb.fInX = FALSE;
-      dcb.fErrorChar = FALSE;
-      dcb.fNull = FALSE;
-      dcb.fRtsControl = RTS_CONTROL_DISABLE;
+      pPort->SetRxErr(e.GetMsg());
+      Sleep(RUN_INTERVAL);
     }
-    else // "x"
+    catch(...)
     {
-      dcb.fOutxCtsFlow = FALSE;
-      dcb.fOutxDsrFlow = FALSE;
-      dcb.fDtrControl = DTR_CONTROL_DISABLE;
-      dcb.fDsrSensitivity = FALSE;
-      dcb.fTXContinueOnXoff = TRUE;
-      dcb.fOutX = TRUE;
-      dcb.fInX = FALSE;
-      dcb.fErrorChar = FALSE;
-      dcb.fNull = FALSE;
-      dcb.fRtsControl = RTS_CONTROL_DISABLE;
-    } // if...else...
-    SetState(dcb);
-
-    Break(100);
-    ClearError();
-    Purge();
-
-  }
-  catch(...)
-  {
-    Close();
-    return false;
-  }
+      pPort->SetRxErr(L"Read from comm. port failed.");
+      Sleep(RUN_INTERVAL);
+    } // try...catch...
+  } // while...
 
-  return true;
+  return 0;
 }
 
-/// <summary>Poll bytes from communication port buffer.</summary>
-void CPrinterPort::Poll()
+/// <summary>Retrieves monotonic time used to stamp frames and writes.</summary>
+/// <returns>Time since system start, in microseconds.</returns>
+ULONGLONG CPrinterPort::GetTime()
 {
-  int i, cnt = 1;
-  BYTE byIn[256];
-  COMSTAT stat;
+  LARGE_INTEGER count, freq;
 
-  if(m_hComm == INVALID_HANDLE_VALUE)
+  if(!::QueryPerformanceFrequency(&freq) || !::QueryPerformanceCounter(&count))
   {
-    WCL_THROW_INVALIDOPERATIONEXCEPTION(L"comm. port not opened");
+    return (ULONGLONG)::GetTickCount() * 1000;
   }
 
-  ClearError(&stat);
-  if(stat.cbInQue > 0) { cnt = __min(256, stat.cbInQue); }
-  cnt = Read(byIn, cnt);
+  return (ULONGLONG)(count.QuadPart / freq.QuadPart) * 1000000 +
+    (ULONGLONG)(count.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+}
 
-  m_csBuffer.Enter();
-  for(i = 0;i < cnt;i++)
-  {
-    if(m_Buffer.IsFull())
-    {
-      break;
-    }
-    m_Buffer.Push(byIn[i]);
-  } // for...
-  m_csBuffer.Leave();
+/// <summary>Retrieves port number.</summary>
+/// <returns>Port number of selected transport.</returns>
+int CPrinterPort::GetPort()
+{
+  return m_pTransport->GetPort();
 }
 
-/// <summary>Retrieves message from buffer.</summary>
+/// <summary>Retrieves message posted by reader thread.</summary>
 /// <param name="buffer">Buffer to contain retrieved message. If NULL, function
 /// ignores the arguments and returns size of buffer required to contain the
 /// message.</param>
@@ -155,84 +230,121 @@ void CPrinterPort::Poll()
 /// of buffer required to contain the message.</param>
 /// <returns>Size of buffer required to contain the message, in number of bytes.
 /// 0 if no message available.</returns>
+/// <exception cref="CCommException">If reader thread failed since last call.
+/// </exception>
+/// <remarks>Receive time of retrieved message is available from
+/// <see cref="GetRxTime"/>.</remarks>
 DWORD CPrinterPort::GetMsg(BYTE* buffer, DWORD bufferSize)
 {
-  DWORD i, len = 0;
-  CMsgRespCRC respCRC;
-  CMsgRespStatus respStatus;
-  CWkString strTmp;
-  BYTE tmpBuffer[3000];
-
-  m_csBuffer.Enter();
-  while(!m_Buffer.IsEmpty())
+  CWkString strErr;
+  const SRxFrame *pFrame;
+
+  if(m_bRxErr)
   {
-    // discard non-header start bytes.
-    if(m_Buffer.GetHead() != CMsgMgr::RESP_START)
-    {
-      TRACE(L"[printdrv_fl_psa66st2r][CPrinterPort::GetMsg] discard non-header.\n");
-      m_Buffer.Pop();
-    }
-    else
-    {
-      break;
-    }
-  } // while...
+    m_csRxErr.Enter();
+    strErr = m_strRxErr;
+    m_bRxErr = false;
+    m_csRxErr.Leave();
+
+    throw CCommException(GetPort(), strErr);
+  } // if...
+
+  pFrame = m_Frames.GetHead();
+  if(pFrame == NULL) { return 0; }
+
+  if((buffer != NULL) && (bufferSize >= pFrame->m_dwLen))
+  {
+    memcpy(buffer, pFrame->m_abyData, pFrame->m_dwLen);
+    m_ullRxTime = pFrame->m_ullRxTime;
+    bufferSize = pFrame->m_dwLen;
+    m_Frames.Pop();
+    return bufferSize;
+  }
 
-  if(!m_Buffer.IsEmpty())
+  return pFrame->m_dwLen;
+}
+
+/// <summary>Extracts frame at head of <see cref="m_Buffer"/>, called by reader
+/// thread only.</summary>
+/// <param name="buffer">Buffer to contain extracted frame. If NULL, function
+/// ignores the arguments and returns size of buffer required to contain the
+/// frame.</param>
+/// <param name="bufferSize">Size of <paramref name="buffer"/>, in number of bytes.
+/// If less than required size, function ignores the arguments and returns size
+/// of buffer required to contain the frame.</param>
+/// <returns>Size of buffer required to contain the frame, in number of bytes.
+/// 0 if no complete frame available.</returns>
+/// <remarks>A header that cannot start a frame is dropped and the buffer is
+/// scanned again from the next header, until a frame is found or the bytes
+/// left may still be the start of one.</remarks>
+DWORD CPrinterPort::Extract(BYTE* buffer, DWORD bufferSize)
+{
+  DWORD i, cnt, len = 0;
+
+  cnt = m_Buffer.GetCount();
+  while(cnt > 0)
   {
-    // copy circular buffer into temporary continuous buffer
-    for(i = 0;i < m_Buffer.GetCount();i++)
+    // discard non-header start bytes.
+    for(i = 0;(i < cnt) && (m_Buffer.GetAt(i) != CMsgMgr::RESP_START);i++) {}
+    if(i > 0)
     {
-      tmpBuffer[i] = m_Buffer.GetAt(i);
-    }
+      TRACE(L"[printdrv_fl_psa66st2r][CPrinterPort::Extract] discard non-header.\n");
+      m_Buffer.Discard(i);
+      m_Decoder.Reset();
+      m_Stats.AddDiscarded(i);
+      cnt -= i;
+      if(cnt == 0) { break; }
+    } // if...
 
-    // first bytes in buffer must be header.
-    for(i = 1;i < m_Buffer.GetCount();i++)
+    // first bytes in buffer must be header, feed only bytes not yet decoded.
+    len = m_Decoder.GetFrameLength();
+    while((len == 0) && (m_Decoder.GetLength() < cnt))
     {
-      if(tmpBuffer[i] == CMsgMgr::RESP_END)
-      {
-        if(respCRC.TryParse(tmpBuffer, i + 1, NULL)) { break; }
-        if(respStatus.TryParse(tmpBuffer, i + 1, NULL)) { break; }
-      }
-    } // for...
+      len = m_Decoder.Feed(m_Buffer.GetAt(m_Decoder.GetLength()));
+    } // while...
 
-    if(i < m_Buffer.GetCount())
+    if(len > 0)
     {
       // match found.
-      len = i + 1;
       if((buffer != NULL) && (bufferSize >= len))
       {
-        for(i = 0;i < len;i++) { buffer[i] = m_Buffer.Pop(); }
+        m_Buffer.Pop(buffer, len);
+        m_Decoder.Reset();
       }
-    }
-    else if(m_Buffer.IsFull() || (m_Buffer.GetCount() > 44))
-    {
-      TRACE(L"[printdrv_fl_psa66st2r][CPrinterPort::GetMsg] discard full.\n");
+      break;
+    } // if...
 
-      // pop only when full to prevent popping of unfinished received message,
-      // or when buffer too long for a messsage to prevent parsing always start
-      // at corrupted bytes, assuming longest possible message is 44.
-      m_Buffer.Pop();
-    } // if...else...
-  } // if...
-  m_csBuffer.Leave();
+    // wait for more bytes unless full, so that an unfinished message is not
+    // dropped, or longer than the longest possible message, 44 bytes, so that
+    // parsing does not always start at a corrupted header.
+    if((cnt < m_Buffer.GetCapacity()) && (cnt <= 44)) { break; }
+
+    TRACE(L"[printdrv_fl_psa66st2r][CPrinterPort::Extract] discard full.\n");
+    m_Buffer.Discard(1);
+    m_Decoder.Reset();
+    m_Stats.AddDiscarded(1);
+    cnt--;
+  } // while...
 
   return len;
 }
 
 /// <summary>Writes data to communication port.</summary>
-/// <param name="buffer">Data to be written.</param>
-/// <param name="dataSize">Size of <paramref name="buffer"/>, in number of bytes.</param>
-/// <returns>Number of bytes written.</returns>
+/// <param name="data">Data to be written.</param>
+/// <param name="dataSize">Size of <paramref name="data"/>, in number of bytes.</param>
+/// <returns>Number of bytes written or queued.</returns>
+/// <exception cref="CCommException">If not all bytes are written.</exception>
+/// <remarks>While a command is being streamed, data is queued behind it and
+/// sent by <see cref="PumpTx"/>, so commands never interleave and the state
+/// thread never waits for the stream.</remarks>
 int CPrinterPort::Write(BYTE* data, int dataSize)
 {
-  int written, timeOut = __max(1, m_nTimeOut) * dataSize * 3;
-  timeOut = __max(1000, timeOut);
+  int written;
 
-  written = CComPort::Write(data, dataSize, timeOut);
-  if(written != dataSize)
+  if(m_bTxPending)
   {
-    throw CCommException(m_nPort, L"Write to comm. port timeout.");
+    QueueTx(data, dataSize);
+    return dataSize;
   }
 
   /*TRACE(L"[printdrv_fl_psa66st2r] SEND ");
@@ -242,28 +354,223 @@ int CPrinterPort::Write(BYTE* data, int dataSize)
   }
   TRACE(L"\n");*/
 
+  m_ullTxTime = GetTime();
+  written = m_pTransport->Write(data, dataSize);
+  m_Stats.AddWritten(written);
+
   return written;
 }
 
+/// <summary>Writes a command, streaming it in chunks if it is large.</summary>
+/// <param name="data">Command to be written.</param>
+/// <param name="dataSize">Size of <paramref name="data"/>, in number of bytes.</param>
+/// <param name="cancellable">True if command is a graphic upload, which
+/// <see cref="CancelTx"/> may cancel, false otherwise.</param>
+/// <returns>Number of bytes written or queued for streaming.</returns>
+/// <exception cref="CCommException">If not all bytes of first chunk are
+/// written.</exception>
+/// <remarks>Commands larger than <see cref="m_dwTxChunk"/> are copied, their
+/// first chunk is written, and the rest is left for <see cref="PumpTx"/>, so
+/// that the state thread is not blocked for the whole transfer. While a command
+/// is being streamed, the command is queued behind it.</remarks>
+int CPrinterPort::Send(BYTE* data, int dataSize, bool cancellable)
+{
+  if(m_bTxPending)
+  {
+    QueueTx(data, dataSize);
+    return dataSize;
+  }
+  if((dataSize <= 0) || ((DWORD)dataSize <= m_dwTxChunk))
+  {
+    return Write(data, dataSize);
+  }
+
+  m_dwTxSize = 0;
+  m_dwTxSent = 0;
+  QueueTx(data, dataSize);
+
+  ::InterlockedExchange(&m_lTxCancel, 0);
+  m_dwTxCmdSize = dataSize;
+  m_dwTxCmdEnd = dataSize;
+  m_bTxCancellable = cancellable;
+  m_bTxPending = true;
+  m_ullTxTime = GetTime();
+
+  PumpTx();
+
+  return dataSize;
+}
+
+/// <summary>Appends bytes to <see cref="m_pbyTx"/>.</summary>
+/// <param name="data">Bytes to be appended.</param>
+/// <param name="dataSize">Size of <paramref name="data"/>, in number of bytes.</param>
+/// <exception cref="wcl::COutOfMemoryException">If out of memory.</exception>
+void CPrinterPort::QueueTx(BYTE* data, int dataSize)
+{
+  BYTE *pbyTmp;
+  DWORD size;
+
+  if(dataSize <= 0) { return; }
+
+  size = m_dwTxSize + dataSize;
+  if(size > m_dwTxMemSize)
+  {
+    pbyTmp = new BYTE[size];
+    if(pbyTmp == NULL) { throw wcl::COutOfMemoryException(); }
+    if(m_dwTxSize > 0) { memcpy(pbyTmp, m_pbyTx, m_dwTxSize); }
+    delete[] m_pbyTx;
+    m_pbyTx = pbyTmp;
+    m_dwTxMemSize = size;
+  } // if...
+
+  memcpy(m_pbyTx + m_dwTxSize, data, dataSize);
+  m_dwTxSize = size;
+}
+
+/// <summary>Writes next chunk of command being streamed, or of commands
+/// queued behind it.</summary>
+/// <returns>True if a chunk was written or nothing is pending, false if
+/// streaming was cancelled by <see cref="CancelTx"/>, in which case the rest of
+/// the command is dropped, see <see cref="DiscardTx"/>.</returns>
+/// <exception cref="CCommException">If not all bytes are written, everything
+/// pending is then dropped.</exception>
+bool CPrinterPort::PumpTx()
+{
+  DWORD len;
+
+  if(!m_bTxPending) { return true; }
+
+  if(m_lTxCancel != 0)
+  {
+    if(m_dwTxSent < m_dwTxCmdEnd)
+    {
+      DiscardTx();
+      return false;
+    }
+    // stream ended before cancel took effect, only queued commands are left.
+    ::InterlockedExchange(&m_lTxCancel, 0);
+  } // if...
+
+  len = __min(m_dwTxChunk, m_dwTxSize - m_dwTxSent);
+
+  // a command queued behind the stream goes out now.
+  if(m_dwTxSent + len > m_dwTxCmdEnd) { m_ullTxTime = GetTime(); }
+
+  try
+  {
+    m_pTransport->Write(m_pbyTx + m_dwTxSent, len);
+  }
+  catch(...)
+  {
+    ClearTx();
+    throw;
+  }
+  m_Stats.AddWritten(len);
+
+  m_dwTxSent += len;
+  if(m_dwTxSent >= m_dwTxCmdEnd) { m_bTxCancellable = false; }
+  if(m_dwTxSent >= m_dwTxSize) { m_bTxPending = false; }
+
+  return true;
+}
+
+/// <summary>Requests cancellation of command being streamed, can be called
+/// from any thread.</summary>
+/// <remarks>Takes effect at the next <see cref="PumpTx"/>, the printer is
+/// left with a truncated command.</remarks>
+void CPrinterPort::CancelTx()
+{
+  if(m_bTxPending && m_bTxCancellable) { ::InterlockedExchange(&m_lTxCancel, 1); }
+}
+
+/// <summary>Drops rest of command being streamed.</summary>
+/// <remarks>Commands queued behind it, e.g. status polls or clear error, are
+/// kept and sent by <see cref="PumpTx"/>.</remarks>
+void CPrinterPort::DiscardTx()
+{
+  DWORD left;
+
+  if(m_bTxPending && (m_dwTxSent < m_dwTxCmdEnd))
+  {
+    left = m_dwTxSize - m_dwTxCmdEnd;
+    if(left > 0) { memmove(m_pbyTx + m_dwTxSent, m_pbyTx + m_dwTxCmdEnd, left); }
+    m_dwTxCmdEnd = m_dwTxSent;
+    m_dwTxSize = m_dwTxSent + left;
+  } // if...
+
+  m_bTxCancellable = false;
+  m_bTxPending = (m_dwTxSent < m_dwTxSize);
+  ::InterlockedExchange(&m_lTxCancel, 0);
+}
+
+/// <summary>Drops everything pending: rest of command being streamed and
+/// commands queued behind it.</summary>
+void CPrinterPort::ClearTx()
+{
+  m_bTxPending = false;
+  m_bTxCancellable = false;
+  m_dwTxSize = 0;
+  m_dwTxSent = 0;
+  m_dwTxCmdEnd = 0;
+  ::InterlockedExchange(&m_lTxCancel, 0);
+}
+
+/// <summary>Retrieves progress of last streamed command, can be called from
+/// any thread.</summary>
+/// <param name="sent">Receives number of bytes sent.</param>
+/// <param name="total">Receives size of command, 0 if no command was
+/// streamed.</param>
+/// <returns>True if command is still being streamed, false otherwise, e.g.
+/// while only commands queued behind it are left.</returns>
+bool CPrinterPort::GetTxProgress(DWORD& sent, DWORD& total) const
+{
+  DWORD end = m_dwTxCmdEnd;
+  bool bTmp = m_bTxPending && (m_dwTxSent < end);
+
+  total = m_dwTxCmdSize;
+  sent = __min(__min(m_dwTxSent, end), total);
+
+  return bTmp;
+}
+
+/// <summary>Sets status flags reported by printer simulator.</summary>
+/// <param name="flags">Combination of <see cref="CStatus::FLAG"/>, see
+/// <see cref="CSimTransport::SetStatus"/>.</param>
+/// <returns>True if simulator is the selected transport, false otherwise.
+/// </returns>
+bool CPrinterPort::SetSimStatus(DWORD flags)
+{
+  if(m_pTransport != &m_Sim) { return false; }
+
+  m_Sim.SetStatus(flags);
+  return true;
+}
+
 /// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
 /// <param name="pElem">Pointer to XML DOM element.</param>
 void CPrinterPort::Dump(MSXML2::IXMLDOMElement* pElem)
 {
-  MSXML2::IXMLDOMElement *pChild = NULL;
   try
   {
 
     if(pElem != NULL)
     {
-      if(!CXmlUtil::AppendChild(pElem, L"m_Buffer", &pChild)) { throw false; }
-      wcl::CDumpHelper::DumpWkCirBuffer<BYTE>(m_Buffer, pChild);
-      SAFE_RELEASE(pChild);
-
-      wcl::CDumpHelper::DumpAttr<const wchar_t*>(pElem, L"m_strHandshake",
-        m_strHandshake);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_Buffer.GetCount",
+        m_Buffer.GetCount());
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_Frames.GetCount",
+        m_Frames.GetCount());
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_hReader", (DWORD)m_hReader);
+      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bRxErr", m_bRxErr);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwRxDropped", m_dwRxDropped);
+      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bTxPending", m_bTxPending);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwTxSize", m_dwTxSize);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwTxSent", m_dwTxSent);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwTxCmdEnd", m_dwTxCmdEnd);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwTxChunk", m_dwTxChunk);
+      wcl::CDumpHelper::DumpChild<ITransport&>(pElem, L"m_pTransport",
+        *m_pTransport);
     } // if...
 
   }
   catch(...) {}
-  SAFE_RELEASE(pChild);
 }
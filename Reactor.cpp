@@ -0,0 +1,284 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Reactor shared by every printer instance of the process.</summary>
+static CReactor s_Reactor;
+
+/// <summary>Constructor.</summary>
+CReactor::CReactor()
+{
+  int i;
+  SYSTEM_INFO info;
+
+  ::GetSystemInfo(&info);
+  m_nWorkerCnt = __max(1, __min(REACTOR_MAX_WORKERS, (int)info.dwNumberOfProcessors));
+
+  for(i = 0;i < REACTOR_MAX_WORKERS;i++)
+  {
+    m_aWorker[i].m_hThread = NULL;
+    m_aWorker[i].m_dwThreadID = 0;
+    m_aWorker[i].m_hCtrl = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+    m_aWorker[i].m_nCount = 0;
+    m_aWorker[i].m_pOwner = this;
+  } // for...
+}
+
+/// <summary>Destructor.</summary>
+/// <remarks>Every instance is expected to be unregistered already, so no worker
+/// is running.</remarks>
+CReactor::~CReactor()
+{
+  int i;
+
+  for(i = 0;i < REACTOR_MAX_WORKERS;i++)
+  {
+    if(m_aWorker[i].m_hThread != NULL) { ::CloseHandle(m_aWorker[i].m_hThread); }
+    if(m_aWorker[i].m_hCtrl != NULL) { ::CloseHandle(m_aWorker[i].m_hCtrl); }
+  } // for...
+}
+
+/// <summary>Retrieves reactor shared by every printer instance.</summary>
+/// <returns>Reference to reactor.</returns>
+CReactor& CReactor::GetInstance()
+{
+  return s_Reactor;
+}
+
+/// <summary>Starts running a printer instance on the least loaded worker.
+/// </summary>
+/// <param name="pInst">Instance, must stay valid until
+/// <see cref="Unregister"/>.</param>
+/// <returns>True if registered, false if every worker is full or worker thread
+/// could not be started.</returns>
+bool CReactor::Register(SRunThreadParam* pInst)
+{
+  int i, index = -1;
+  HANDLE hOld = NULL;
+
+  if(pInst == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"pInst"); }
+
+  pInst->m_dwLastTime = CWkTime::GetTime();
+  pInst->m_dwIdleTime = 0;
+
+  m_cs.Enter();
+  for(i = 0;i < m_nWorkerCnt;i++)
+  {
+    if( (m_aWorker[i].m_nCount < REACTOR_WORKER_SIZE) && (m_aWorker[i].m_hCtrl != NULL) &&
+      ((index < 0) || (m_aWorker[i].m_nCount < m_aWorker[index].m_nCount)) )
+    {
+      index = i;
+    }
+  } // for...
+
+  if(index < 0)
+  {
+    m_cs.Leave();
+    return false;
+  }
+
+  SWorker& worker = m_aWorker[index];
+
+  if(worker.m_dwThreadID == 0)
+  {
+    // previous thread of this worker, if any, exits by itself.
+    hOld = worker.m_hThread;
+    worker.m_hThread = ::CreateThread(NULL, 0, CReactor::_Run, &worker, 0,
+      &(worker.m_dwThreadID));
+    if(worker.m_hThread == NULL)
+    {
+      worker.m_dwThreadID = 0;
+      m_cs.Leave();
+      if(hOld != NULL) { ::CloseHandle(hOld); }
+      return false;
+    }
+  } // if...
+
+  worker.m_apInst[worker.m_nCount++] = pInst;
+  ::SetEvent(worker.m_hCtrl);
+  m_cs.Leave();
+
+  if(hOld != NULL) { ::CloseHandle(hOld); }
+
+  return true;
+}
+
+/// <summary>Stops running a printer instance.</summary>
+/// <param name="pInst">Instance registered by <see cref="Register"/>, ignored
+/// if not registered.</param>
+/// <remarks>Instance is not run anymore once this function returns. Worker
+/// thread is stopped with its last instance, unless called from that thread.
+/// </remarks>
+void CReactor::Unregister(SRunThreadParam* pInst)
+{
+  int i, j, index = -1;
+  HANDLE hStop = NULL;
+
+  m_cs.Enter();
+  for(i = 0;(i < m_nWorkerCnt) && (index < 0);i++)
+  {
+    for(j = 0;j < m_aWorker[i].m_nCount;j++)
+    {
+      if(m_aWorker[i].m_apInst[j] == pInst)
+      {
+        index = i;
+        m_aWorker[i].m_apInst[j] = m_aWorker[i].m_apInst[--m_aWorker[i].m_nCount];
+        break;
+      }
+    } // for...
+  } // for...
+
+  if(index >= 0)
+  {
+    if((m_aWorker[index].m_nCount == 0) && (m_aWorker[index].m_dwThreadID != 0))
+    {
+      // waiting on itself would dead lock, let next start close it.
+      if(m_aWorker[index].m_dwThreadID != ::GetCurrentThreadId())
+      {
+        hStop = m_aWorker[index].m_hThread;
+        m_aWorker[index].m_hThread = NULL;
+      }
+      m_aWorker[index].m_dwThreadID = 0;
+    } // if...
+    ::SetEvent(m_aWorker[index].m_hCtrl);
+  } // if...
+  m_cs.Leave();
+
+  if(index < 0) { return; }
+
+  // wait for a run started before removal to complete.
+  m_aWorker[index].m_csRun.Enter();
+  m_aWorker[index].m_csRun.Leave();
+
+  if(hStop != NULL)
+  {
+    ::WaitForSingleObject(hStop, INFINITE);
+    ::CloseHandle(hStop);
+  } // if...
+}
+
+/// <summary>Worker thread execution.</summary>
+/// <param name="lpParameter">Pointer to <see cref="SWorker"/>.</param>
+DWORD WINAPI CReactor::_Run(LPVOID lpParameter)
+{
+  SWorker *pWorker = (SWorker*)lpParameter;
+
+  pWorker->m_pOwner->Run(*pWorker);
+
+  return 0;
+}
+
+/// <summary>Runs worker's instances until worker is stopped.</summary>
+/// <param name="worker">Worker of calling thread.</param>
+void CReactor::Run(SWorker& worker)
+{
+  int i, cnt, hCnt;
+  DWORD now, timeout;
+  SRunThreadParam *apInst[REACTOR_WORKER_SIZE];
+  HANDLE handles[1 + REACTOR_WORKER_SIZE * 2];
+
+  for(;;)
+  {
+    worker.m_csRun.Enter();
+
+    m_cs.Enter();
+    if(worker.m_dwThreadID != ::GetCurrentThreadId())
+    {
+      m_cs.Leave();
+      worker.m_csRun.Leave();
+      break;
+    }
+    cnt = worker.m_nCount;
+    memcpy(apInst, worker.m_apInst, cnt * sizeof(SRunThreadParam*));
+    m_cs.Leave();
+
+    timeout = INFINITE;
+    hCnt = 0;
+    handles[hCnt++] = worker.m_hCtrl;
+    for(i = 0;i < cnt;i++)
+    {
+      now = CWkTime::GetTime();
+      if(!RunInst(apInst[i], now))
+      {
+        // instance stopped by unexpected error, as its own thread used to.
+        Unregister(apInst[i]);
+        continue;
+      }
+      if(CWkTime::GetTime() - now > REACTOR_STALL_MAX)
+      {
+        apInst[i]->m_pContext->m_Port.m_Stats.AddStall();
+      }
+
+      apInst[i]->m_dwIdleTime = apInst[i]->m_pStateMach->GetIdleTime();
+      timeout = __min(timeout, apInst[i]->m_dwIdleTime);
+      if(apInst[i]->m_pContext->GetWakeEvent() != NULL)
+      {
+        handles[hCnt++] = apInst[i]->m_pContext->GetWakeEvent();
+      }
+      else { timeout = __min(timeout, RUN_INTERVAL); }
+      if(apInst[i]->m_pContext->m_Port.GetRxEvent() != NULL)
+      {
+        handles[hCnt++] = apInst[i]->m_pContext->m_Port.GetRxEvent();
+      }
+      else { timeout = __min(timeout, RUN_INTERVAL); }
+    } // for...
+
+    worker.m_csRun.Leave();
+
+    // frames and port errors are posted by each port's reader thread.
+    ::WaitForMultipleObjects(hCnt, handles, FALSE, timeout);
+  } // for...
+}
+
+/// <summary>Runs state machine of an instance once.</summary>
+/// <param name="pInst">Instance.</param>
+/// <param name="now">Current time, in milliseconds of CWkTime::GetTime.</param>
+/// <returns>True if instance should keep running, false if it failed.</returns>
+/// <remarks>Time the instance is run late by more than
+/// <see cref="REACTOR_STALL_MAX"/>, as other instances of the worker stalled
+/// it, is not charged to its timers, so the stall never expires its alive
+/// timeout. Such runs, and the time not charged, are counted in
+/// <see cref="SDriverStats::m_dwLateCnt"/>.</remarks>
+bool CReactor::RunInst(SRunThreadParam* pInst, DWORD now)
+{
+  CWkString strTmp;
+  CPrinterContext *pContext = pInst->m_pContext;
+  IStateMach *pStateMach = pInst->m_pStateMach;
+  DWORD elapsed = now - pInst->m_dwLastTime;
+
+  if((pInst->m_dwIdleTime < INFINITE - REACTOR_STALL_MAX) &&
+     (elapsed > pInst->m_dwIdleTime + REACTOR_STALL_MAX))
+  {
+    pContext->m_Port.m_Stats.AddLate(
+      elapsed - pInst->m_dwIdleTime - REACTOR_STALL_MAX);
+    elapsed = pInst->m_dwIdleTime + REACTOR_STALL_MAX;
+  } // if...
+
+  try
+  {
+
+    pStateMach->Run(elapsed);
+    pInst->m_dwLastTime = now;
+
+  }
+  catch(wcl::CSelfDocException& e)
+  {
+    e.ToString(strTmp);
+    pContext->Trace(TRACE_RUN_EXCEPTION);
+    CLog::Log(L"[printdrv_fl_psa66st2r][CReactor::RunInst] %s\n",
+      (const wchar_t*)strTmp);
+    return false;
+  }
+  catch(...)
+  {
+    try
+    {
+      pContext->m_Events.Post(EVT_GENERAL_ERR, true);
+    }
+    catch(...){}
+
+    if(pContext->m_bErrDump) { pStateMach->Dump(L"CReactor::RunInst"); }
+    return false;
+  } // try...catch...
+
+  return true;
+}
@@ -0,0 +1,93 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+CRespDecoder::CRespDecoder()
+{
+  Reset();
+}
+
+/// <summary>Discards parse state, next byte fed is treated as frame header.</summary>
+void CRespDecoder::Reset()
+{
+  m_dwLen = 0;
+  m_dwFrameLen = 0;
+  m_nState = 0;
+  m_dwStart = 0;
+  m_byFieldHead = 0;
+  m_bStatusDead = false;
+}
+
+/// <summary>Feeds next received byte.</summary>
+/// <param name="by">Received byte.</param>
+/// <returns>Length of completed frame, in number of bytes, 0 if no frame
+/// completed yet.</returns>
+/// <remarks>Accepts exactly the frames accepted by
+/// <see cref="CMsgRespCRC::TryParse"/> and <see cref="CMsgRespStatus::TryParse"/>,
+/// the shortest one wins. Once a frame completes, further bytes are ignored
+/// until <see cref="Reset"/>.</remarks>
+DWORD CRespDecoder::Feed(BYTE by)
+{
+  static const BYTE lookUp[12] = {'*', 'S', '|', '|', '|', '|', '|', '|', '|',
+    '|', '|', '*'};
+  CMsgRespCRC respCRC;
+  DWORD i = m_dwLen;
+
+  if(m_dwFrameLen > 0) { return m_dwFrameLen; }
+  m_dwLen++;
+
+  //*********************
+  // CRC RESPONSE.
+  if(i < sizeof(m_abyHead)) { m_abyHead[i] = by; }
+  if((i == (sizeof(m_abyHead) - 1)) && (by == CMsgMgr::RESP_END) &&
+    (m_abyHead[1] == CMsgMgr::CMD_CRC))
+  {
+    if(respCRC.TryParse(m_abyHead, sizeof(m_abyHead), NULL))
+    {
+      m_dwFrameLen = m_dwLen;
+      return m_dwFrameLen;
+    }
+  } // if...
+  // END OF CRC RESPONSE.
+  //************************
+
+  //***********************
+  // STATUS RESPONSE.
+  if(m_bStatusDead) { return 0; }
+
+  if(i == m_dwStart) { m_byFieldHead = by; }
+  if(by == lookUp[m_nState])
+  {
+    switch(m_nState)
+    {
+    case 0  : // command header
+    case 1  : // command
+    case 2  : // command delimiter
+      if(i != (DWORD)m_nState) { m_bStatusDead = true; }
+      break;
+    case 5  : // status flag 1 delimiter
+    case 6  : // status flag 2 delimiter
+    case 7  : // status flag 3 delimiter
+    case 8  : // status flag 4 delimiter
+    case 9  : // status flag 5 delimiter
+      if((i - m_dwStart) != 1) { m_bStatusDead = true; }
+      break;
+    case 10 : // template number delimiter
+      if(m_byFieldHead != 'P') { m_bStatusDead = true; }
+      break;
+    case 11 : // command terminator
+      if(i != m_dwStart) { m_bStatusDead = true; }
+      else { m_dwFrameLen = m_dwLen; }
+      break;
+    } // switch...
+    m_dwStart = i + 1;
+    m_nState++;
+  } // if...
+
+  // header, command and delimiter must be the first 3 bytes.
+  if((i < 3) && (m_nState != (int)(i + 1))) { m_bStatusDead = true; }
+  // END OF STATUS RESPONSE.
+  //**************************
+
+  return m_dwFrameLen;
+}
@@ -0,0 +1,77 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+CRxFrameQueue::CRxFrameQueue() :
+  m_dwWrite(0),
+  m_dwRead(0)
+{
+}
+
+/// <summary>Retrieves slot to fill with next frame, called by producer only.
+/// </summary>
+/// <returns>Pointer to free slot, NULL if queue is full. Frame is not visible
+/// to consumer until <see cref="Post"/>.</returns>
+SRxFrame* CRxFrameQueue::GetFree()
+{
+  DWORD write = m_dwWrite, read = m_dwRead;
+
+  // slot is reused only after consumer is done with it.
+  MemoryBarrier();
+
+  if((write - read) >= RX_FRAME_QUEUE_SIZE) { return NULL; }
+  return &(m_aFrame[write & (RX_FRAME_QUEUE_SIZE - 1)]);
+}
+
+/// <summary>Publishes slot retrieved by <see cref="GetFree"/>, called by
+/// producer only.</summary>
+void CRxFrameQueue::Post()
+{
+  // publish frame only after it is stored.
+  MemoryBarrier();
+  m_dwWrite = m_dwWrite + 1;
+}
+
+/// <summary>Retrieves oldest frame without removing it, called by consumer
+/// only.</summary>
+/// <returns>Pointer to oldest frame, NULL if queue is empty. Valid until
+/// <see cref="Pop"/>.</returns>
+const SRxFrame* CRxFrameQueue::GetHead()
+{
+  DWORD read = m_dwRead;
+
+  if(GetCount() == 0) { return NULL; }
+  return &(m_aFrame[read & (RX_FRAME_QUEUE_SIZE - 1)]);
+}
+
+/// <summary>Removes oldest frame, called by consumer only.</summary>
+void CRxFrameQueue::Pop()
+{
+  if(GetCount() == 0) { return; }
+
+  // hand slot back only after frame is copied out.
+  MemoryBarrier();
+  m_dwRead = m_dwRead + 1;
+}
+
+/// <summary>Removes all frames, called by consumer only.</summary>
+void CRxFrameQueue::Clear()
+{
+  DWORD write = m_dwWrite;
+
+  MemoryBarrier();
+  m_dwRead = write;
+}
+
+/// <summary>Retrieves number of frames not yet removed, called by consumer
+/// only.</summary>
+/// <returns>Number of frames.</returns>
+DWORD CRxFrameQueue::GetCount()
+{
+  DWORD write = m_dwWrite;
+
+  // frames are read only after the index publishing them.
+  MemoryBarrier();
+
+  return write - m_dwRead;
+}
@@ -0,0 +1,272 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+CSerialTransport::CSerialTransport() :
+  m_strHandshake(L"x"),
+  m_bRxWait(true),
+  m_dwTxTimeout(TX_TIMEOUT)
+{
+  m_nPort = 1;
+  m_nBaudRate = 38400;
+  m_nParity = CComPort::PNONE;
+  m_nDataBit = 8;
+  m_nStopBit = 1;
+  m_nTimeOut = 5;
+  m_nBufferSize = 2048;
+
+  m_hRxEvent = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+}
+
+/// <summary>Destructor.</summary>
+CSerialTransport::~CSerialTransport()
+{
+  if(m_hRxEvent != NULL) { ::CloseHandle(m_hRxEvent); }
+}
+
+/// <summary>Extracts port related parameters.</summary>
+/// <param name="parameters">Parameters string.</param>
+/// <exception cref="wcl::CArgumentException">If <paramref name="parameters"/>
+/// is invalid.</exception>
+void CSerialTransport::Parse(const wchar_t* parameters)
+{
+	CWkString value;
+	CWkMapStr<CWkString> pair;
+
+  if(parameters == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"parameters"); }
+  ::Parse(parameters, pair);
+
+	if(pair.Get(L"port", value)) { m_nPort = wcstol(value, NULL, 10); }
+  else { WCL_THROW_ARGUMENTEXCEPTION(L"parameters", L"missing 'port' parameter"); }
+
+  if(pair.Get(L"baudrate", value)) { m_nBaudRate = wcstol(value, NULL, 10); }
+
+	if(pair.Get(L"parity", value))
+	{
+		if(value == L"none")			{ m_nParity = CComPort::PNONE; }
+		else if(value == L"even")	{ m_nParity = CComPort::PEVEN; }
+		else if(value == L"odd")	{ m_nParity = CComPort::PODD; }
+	}	// if...
+
+	if(pair.Get(L"databit", value)) { m_nDataBit = wcstol(value, NULL, 10); }
+	if(pair.Get(L"timeout", value)) { m_nTimeOut = wcstol(value, NULL, 10); }
+	if(pair.Get(L"buffer_size", value)) { m_nBufferSize = wcstol(value, NULL, 10); }
+  pair.Get(L"handshake", m_strHandshake);
+
+  if(pair.Get(L"rx_wait", value)) { m_bRxWait = (wcstol(value, NULL, 10) == 1); }
+
+  m_dwTxTimeout = TX_TIMEOUT;
+  if(pair.Get(L"tx_timeout", value)) { m_dwTxTimeout = wcstoul(value, NULL, 10); }
+}
+
+/// <summary>Opens communication port.</summary>
+/// <returns>True if port opened successfully, false otherwise.</returns>
+bool CSerialTransport::Open()
+{
+  DCB dcb;
+
+  try
+  {
+
+    if(!CComPort::Open(true)) { return false; }
+    GetState(dcb);
+
+    if(m_strHandshake == L"rtsx")
+    {
+      dcb.fOutxCtsFlow = TRUE;
+      dcb.fOutxDsrFlow = TRUE;
+      dcb.fDtrControl = DTR_CONTROL_DISABLE;
+      dcb.fDsrSensitivity = TRUE;
+      dcb.fTXContinueOnXoff = TRUE;
+      dcb.fOutX = TRUE;
+      dcb.fInX = FALSE;
+      dcb.fErrorChar = FALSE;
+      dcb.fNull = FALSE;
+      dcb.fRtsControl = RTS_CONTROL_DISABLE;
+    }
+    else if(m_strHandshake == L"rts")
+    {
+      dcb.fOutxCtsFlow = TRUE;
+      dcb.fOutxDsrFlow = TRUE;
+      dcb.fDtrControl = DTR_CONTROL_DISABLE;
+      dcb.fDsrSensitivity = TRUE;
+      dcb.fTXContinueOnXoff = TRUE;
+      dcb.fOutX = FALSE;
+      dcb.fInX = FALSE;
+      dcb.fErrorChar = FALSE;
+      dcb.fNull = FALSE;
+      dcb.fRtsControl = RTS_CONTROL_DISABLE;
+    }
+    else // "x"
+    {
+      dcb.fOutxCtsFlow = FALSE;
+      dcb.fOutxDsrFlow = FALSE;
+      dcb.fDtrControl = DTR_CONTROL_DISABLE;
+      dcb.fDsrSensitivity = FALSE;
+      dcb.fTXContinueOnXoff = TRUE;
+      dcb.fOutX = TRUE;
+      dcb.fInX = FALSE;
+      dcb.fErrorChar = FALSE;
+      dcb.fNull = FALSE;
+      dcb.fRtsControl = RTS_CONTROL_DISABLE;
+    } // if...else...
+    SetState(dcb);
+
+    if(m_bRxWait && !::SetCommMask(m_hComm, EV_RXCHAR)) { m_bRxWait = false; }
+
+    Break(100);
+    ClearError();
+    Purge();
+
+  }
+  catch(...)
+  {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+/// <summary>Closes communication port.</summary>
+void CSerialTransport::Close()
+{
+  CComPort::Close();
+}
+
+/// <summary>Reads bytes from communication port buffer.</summary>
+/// <param name="buffer">Buffer to receive bytes.</param>
+/// <param name="bufferSize">Size of <paramref name="buffer"/>, in number of
+/// bytes.</param>
+/// <returns>Number of bytes read.</returns>
+/// <remarks>If nothing is queued, waits up to port timeout for one byte.</remarks>
+int CSerialTransport::Read(BYTE* buffer, int bufferSize)
+{
+  int cnt = 1;
+  COMSTAT stat;
+
+  if(m_hComm == INVALID_HANDLE_VALUE)
+  {
+    WCL_THROW_INVALIDOPERATIONEXCEPTION(L"comm. port not opened");
+  }
+
+  ClearError(&stat);
+  if(stat.cbInQue > 0) { cnt = __min((DWORD)bufferSize, stat.cbInQue); }
+  return CComPort::Read(buffer, cnt);
+}
+
+/// <summary>Writes data to communication port.</summary>
+/// <param name="data">Data to be written.</param>
+/// <param name="dataSize">Size of <paramref name="data"/>, in number of bytes.</param>
+/// <returns>Number of bytes written.</returns>
+/// <exception cref="CCommException">If write timeout.</exception>
+/// <remarks>Write is bounded by twice the line time of the bytes plus
+/// <see cref="m_dwTxTimeout"/>, as it blocks the reactor worker shared with
+/// other printers. Commands are written at most a chunk at a time, see
+/// <see cref="CPrinterPort::Send"/>.</remarks>
+int CSerialTransport::Write(BYTE* data, int dataSize)
+{
+  int written, timeOut;
+
+  // 10 bits per byte, start and stop bits included.
+  timeOut = (int)(((ULONGLONG)dataSize * 20000) / __max(1, m_nBaudRate)) +
+    (int)m_dwTxTimeout;
+
+  written = CComPort::Write(data, dataSize, timeOut);
+  if(written != dataSize)
+  {
+    throw CCommException(m_nPort, L"Write to comm. port timeout.");
+  }
+
+  return written;
+}
+
+/// <summary>Waits until bytes are received or timeout.</summary>
+/// <param name="timeout">Maximum time to wait, in milliseconds.</param>
+/// <param name="hWake">Event to abort the wait, NULL if none.</param>
+/// <returns>True if bytes are available for <see cref="Read"/>, false if
+/// timeout or woken by <paramref name="hWake"/>.</returns>
+/// <remarks>Falls back to sleeping <see cref="RUN_INTERVAL"/> if the port does
+/// not support overlapped receive event.</remarks>
+bool CSerialTransport::WaitRx(DWORD timeout, HANDLE hWake)
+{
+  DWORD mask = 0, transferred, cnt = 1;
+  COMSTAT stat;
+  OVERLAPPED ov;
+  HANDLE handles[2];
+
+  if(m_hComm == INVALID_HANDLE_VALUE)
+  {
+    WCL_THROW_INVALIDOPERATIONEXCEPTION(L"comm. port not opened");
+  }
+
+  ClearError(&stat);
+  if(stat.cbInQue > 0) { return true; }
+  if(timeout == 0) { return false; }
+
+  if(!m_bRxWait || (m_hRxEvent == NULL))
+  {
+    Sleep(__min(timeout, RUN_INTERVAL));
+    return false;
+  }
+
+  memset(&ov, 0, sizeof(ov));
+  ov.hEvent = m_hRxEvent;
+  ::ResetEvent(m_hRxEvent);
+
+  if(::WaitCommEvent(m_hComm, &mask, &ov)) { return (mask & EV_RXCHAR) != 0; }
+  if(GetLastError() != ERROR_IO_PENDING)
+  {
+    Sleep(__min(timeout, RUN_INTERVAL));
+    return false;
+  }
+
+  handles[0] = m_hRxEvent;
+  if(hWake != NULL) { handles[cnt++] = hWake; }
+
+  if(::WaitForMultipleObjects(cnt, handles, FALSE, timeout) == WAIT_OBJECT_0)
+  {
+    if(!::GetOverlappedResult(m_hComm, &ov, &transferred, FALSE)) { return false; }
+    return (mask & EV_RXCHAR) != 0;
+  }
+
+  // timeout or woken, re-setting the mask completes the pending wait.
+  ::SetCommMask(m_hComm, EV_RXCHAR);
+  ::GetOverlappedResult(m_hComm, &ov, &transferred, TRUE);
+
+  return false;
+}
+
+/// <summary>Checks if <see cref="WaitRx"/> blocks until bytes arrive.</summary>
+/// <returns>Value of <see cref="m_bRxWait"/>.</returns>
+bool CSerialTransport::CanWaitRx()
+{
+  return m_bRxWait;
+}
+
+/// <summary>Retrieves port number.</summary>
+/// <returns>Port number.</returns>
+int CSerialTransport::GetPort()
+{
+  return m_nPort;
+}
+
+/// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
+/// <param name="pElem">Pointer to XML DOM element.</param>
+void CSerialTransport::Dump(MSXML2::IXMLDOMElement* pElem)
+{
+  try
+  {
+
+    if(pElem != NULL)
+    {
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"m_nPort", m_nPort);
+      wcl::CDumpHelper::DumpAttr<const wchar_t*>(pElem, L"m_strHandshake",
+        m_strHandshake);
+      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bRxWait", m_bRxWait);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwTxTimeout", m_dwTxTimeout);
+    } // if...
+
+  }
+  catch(...) {}
+}
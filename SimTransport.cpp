@@ -0,0 +1,369 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+CSimTransport::CSimTransport() :
+  m_hSim(NULL),
+  m_dwFlags(CStatus::FLAG_TOP_OF_FORM | CStatus::FLAG_READY_TO_RX),
+  m_dwBusyTime(500),
+  m_dwBaud(0),
+  m_dwCorrupt(0),
+  m_nParse(PARSE_IDLE),
+  m_nHeadLen(0),
+  m_dwSkip(0),
+  m_dwBusyEnd(0),
+  m_bBusy(false),
+  m_byTemplate('0'),
+  m_dwRespCnt(0)
+{
+  m_hStopSim = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+  strcpy_s(m_szVer, sizeof(m_szVer), "GUR126003");
+}
+
+/// <summary>Destructor.</summary>
+CSimTransport::~CSimTransport()
+{
+  if(m_hSim != NULL) { Close(); }
+
+  if(m_hStopSim != NULL) { ::CloseHandle(m_hStopSim); }
+}
+
+/// <summary>Extracts simulator related parameters.</summary>
+/// <param name="parameters">Parameters string.</param>
+/// <remarks>"sim_busy" sets the time print, form feed and flash transfer keep
+/// the printer busy, in milliseconds. "sim_flags" sets the initial status
+/// flags, see <see cref="SetStatus"/>. "sim_baud" limits the line speed, in
+/// bits per second. "sim_corrupt" corrupts one of this many response bytes.
+/// "sim_ver" sets the reported software version.</remarks>
+void CSimTransport::Parse(const wchar_t* parameters)
+{
+  CWkString value;
+  CWkMapStr<CWkString> pair;
+  const wchar_t* psz;
+  int i;
+
+  CMemTransport::Parse(parameters);
+  ::Parse(parameters, pair);
+
+  m_dwBusyTime = 500;
+  if(pair.Get(L"sim_busy", value))
+  {
+    m_dwBusyTime = wcstoul((const wchar_t*)value, NULL, 10);
+  }
+
+  m_dwFlags = CStatus::FLAG_TOP_OF_FORM | CStatus::FLAG_READY_TO_RX;
+  if(pair.Get(L"sim_flags", value))
+  {
+    m_dwFlags = wcstoul((const wchar_t*)value, NULL, 0) & CStatus::FLAG_MASK;
+  }
+
+  m_dwBaud = 0;
+  if(pair.Get(L"sim_baud", value))
+  {
+    m_dwBaud = wcstoul((const wchar_t*)value, NULL, 10);
+  }
+
+  m_dwCorrupt = 0;
+  if(pair.Get(L"sim_corrupt", value))
+  {
+    m_dwCorrupt = wcstoul((const wchar_t*)value, NULL, 10);
+  }
+
+  strcpy_s(m_szVer, sizeof(m_szVer), "GUR126003");
+  if(pair.Get(L"sim_ver", value))
+  {
+    psz = (const wchar_t*)value;
+    for(i = 0;(psz[i] != L'\0') && (i < (int)sizeof(m_szVer) - 1);i++)
+    {
+      m_szVer[i] = (char)psz[i];
+    }
+    m_szVer[i] = '\0';
+  } // if...
+}
+
+/// <summary>Opens transport and starts simulator thread.</summary>
+/// <returns>True if opened successfully, false otherwise.</returns>
+bool CSimTransport::Open()
+{
+  if(m_hSim != NULL) { return true; }
+  if(m_hStopSim == NULL) { return false; }
+
+  if(!CMemTransport::Open()) { return false; }
+
+  m_nParse = PARSE_IDLE;
+  m_bBusy = false;
+  m_dwRespCnt = 0;
+
+  ::ResetEvent(m_hStopSim);
+  m_hSim = ::CreateThread(NULL, 0, CSimTransport::_Run, this, 0, NULL);
+  if(m_hSim == NULL)
+  {
+    CLog::Log(L"[printdrv_fl_psa66st2r][CSimTransport::Open] failed to CreateThread:%u\n",
+      GetLastError());
+    CMemTransport::Close();
+    return false;
+  }
+
+  return true;
+}
+
+/// <summary>Stops simulator thread and closes transport.</summary>
+void CSimTransport::Close()
+{
+  if(m_hSim != NULL)
+  {
+    ::SetEvent(m_hStopSim);
+    ::WaitForSingleObject(m_hSim, INFINITE);
+    ::CloseHandle(m_hSim);
+    m_hSim = NULL;
+  } // if...
+
+  CMemTransport::Close();
+}
+
+/// <summary>Sets status flags reported from next status poll on.</summary>
+/// <param name="flags">Combination of <see cref="CStatus::FLAG"/>, as the
+/// driver decodes them. Busy is added by the simulator while a command is being
+/// processed, <see cref="CStatus::FLAG_CLEAR_ERR"/> flags are cleared by a
+/// clear error command.</param>
+void CSimTransport::SetStatus(DWORD flags)
+{
+  m_csSim.Enter();
+  m_dwFlags = flags & CStatus::FLAG_MASK;
+  m_csSim.Leave();
+}
+
+/// <summary>Answers commands written by driver until stopped, called by
+/// simulator thread only.</summary>
+void CSimTransport::Run()
+{
+  BYTE buffer[256];
+  int cnt, i, max;
+
+  while(::WaitForSingleObject(m_hStopSim, 0) != WAIT_OBJECT_0)
+  {
+    WaitTx(RUN_INTERVAL, m_hStopSim);
+
+    // about a run interval of bytes at a time when line speed is limited.
+    max = sizeof(buffer);
+    if(m_dwBaud != 0) { max = __min(max, __max(1, (int)(m_dwBaud / 1000))); }
+
+    while((cnt = Drain(buffer, max)) > 0)
+    {
+      // 10 bits per byte, start and stop bits included.
+      if(m_dwBaud != 0) { Sleep((cnt * 10000) / m_dwBaud); }
+      for(i = 0;i < cnt;i++) { Feed(buffer[i]); }
+      if(::WaitForSingleObject(m_hStopSim, 0) == WAIT_OBJECT_0) { return; }
+    } // while...
+
+    if(m_bBusy && ((long)(CWkTime::GetTime() - m_dwBusyEnd) >= 0))
+    {
+      m_bBusy = false;
+    }
+  } // while...
+}
+
+/// <summary>Parses one byte written by driver, executing command once
+/// complete.</summary>
+/// <param name="by">Byte written.</param>
+/// <remarks>Commands are framed by '^'. CRC requests have a fixed size and
+/// graphic definitions a declared size of binary data, which may contain
+/// '^'.</remarks>
+void CSimTransport::Feed(BYTE by)
+{
+  int i, delim;
+
+  switch(m_nParse)
+  {
+  case PARSE_IDLE :
+    if(by == '^')
+    {
+      m_abyHead[0] = by;
+      m_nHeadLen = 1;
+      m_nParse = PARSE_HEAD;
+    } // if...
+    break;
+
+  case PARSE_HEAD :
+    if(m_nHeadLen < HEAD_SIZE) { m_abyHead[m_nHeadLen] = by; }
+    m_nHeadLen++;
+
+    if(m_abyHead[1] == 'G')
+    {
+      // ^G|addr(4)|seed(2)|^
+      if(m_nHeadLen == 11) { Execute(); }
+    }
+    else if((m_abyHead[1] == 'l') && (by == '|') && (m_nHeadLen < HEAD_SIZE) &&
+            (m_nHeadLen > 3) && (m_abyHead[3] == 'A'))
+    {
+      // ^l|A|F|id|size|data|^
+      for(i = 0, delim = 0;i < m_nHeadLen;i++)
+      {
+        if(m_abyHead[i] == '|') { delim++; }
+      }
+      if(delim == 5)
+      {
+        m_abyHead[m_nHeadLen - 1] = '\0';
+        for(i = m_nHeadLen - 2;(i > 0) && (m_abyHead[i - 1] != '|');i--);
+        m_dwSkip = strtoul((const char*)&m_abyHead[i], NULL, 10) + 2;
+        m_abyHead[m_nHeadLen - 1] = '|';
+        m_nParse = PARSE_DATA;
+      } // if...
+    }
+    else if((by == '^') && (m_nHeadLen > 2))
+    {
+      Execute();
+    }
+    break;
+
+  case PARSE_DATA :
+    if(--m_dwSkip == 0) { Execute(); }
+    break;
+  } // switch...
+}
+
+/// <summary>Executes command parsed by <see cref="Feed"/>.</summary>
+void CSimTransport::Execute()
+{
+  BYTE resp[7];
+  WORD crc;
+
+  m_nParse = PARSE_IDLE;
+
+  switch(m_abyHead[1])
+  {
+  case 'S' : // status
+    RespondStatus();
+    break;
+
+  case 'C' : // clear error
+    m_csSim.Enter();
+    m_dwFlags &= ~CStatus::FLAG_CLEAR_ERR;
+    m_csSim.Leave();
+    break;
+
+  case 'P' : // print
+    if(m_nHeadLen > 3) { m_byTemplate = m_abyHead[3]; }
+    // fall through
+
+  case 'f' : // form feed
+  case 'z' : // flash transfer
+    m_bBusy = true;
+    m_dwBusyEnd = CWkTime::GetTime() + m_dwBusyTime;
+    break;
+
+  case 'G' : // CRC, derived from seed only
+    crc = (WORD)((m_abyHead[7] | (m_abyHead[8] << 8)) ^ 0xA5A5);
+    resp[0] = '*';
+    resp[1] = 'G';
+    resp[2] = '|';
+    resp[3] = (BYTE)(crc & 0xFF);
+    resp[4] = (BYTE)(crc >> 8);
+    resp[5] = '|';
+    resp[6] = '*';
+    Respond(resp, sizeof(resp));
+    break;
+  } // switch...
+}
+
+/// <summary>Answers status poll.</summary>
+void CSimTransport::RespondStatus()
+{
+  BYTE resp[64];
+  DWORD flags;
+  int len;
+
+  m_csSim.Enter();
+  flags = m_dwFlags;
+  m_csSim.Leave();
+
+  if(m_bBusy && ((long)(CWkTime::GetTime() - m_dwBusyEnd) >= 0)) { m_bBusy = false; }
+  if(m_bBusy)
+  {
+    flags |= CStatus::FLAG_BUSY;
+    flags &= ~CStatus::FLAG_READY_TO_RX;
+  } // if...
+
+  // printer sets the bit when it is NOT ready.
+  flags ^= CStatus::FLAG_READY_TO_RX;
+
+  len = sprintf_s((char*)resp, sizeof(resp), "*S|0|%s|", m_szVer);
+  resp[len++] = (BYTE)(0x40 | (flags & 0x3F));
+  resp[len++] = '|';
+  resp[len++] = (BYTE)(0x40 | ((flags >> 6) & 0x3F));
+  resp[len++] = '|';
+  resp[len++] = (BYTE)(0x40 | ((flags >> 12) & 0x3F));
+  resp[len++] = '|';
+  resp[len++] = (BYTE)(0x40 | ((flags >> 18) & 0x0F));
+  resp[len++] = '|';
+  resp[len++] = (BYTE)(0x40 | ((flags >> 22) & 0x3F));
+  resp[len++] = '|';
+  resp[len++] = 'P';
+  resp[len++] = m_byTemplate;
+  resp[len++] = '|';
+  resp[len++] = '*';
+
+  Respond(resp, len);
+}
+
+/// <summary>Delivers response to driver, corrupting bytes if configured.
+/// </summary>
+/// <param name="data">Response.</param>
+/// <param name="dataSize">Size of <paramref name="data"/>, in number of bytes.
+/// </param>
+void CSimTransport::Respond(const BYTE* data, int dataSize)
+{
+  BYTE buffer[64];
+  int i;
+
+  for(i = 0;(i < dataSize) && (i < (int)sizeof(buffer));i++)
+  {
+    buffer[i] = data[i];
+    if((m_dwCorrupt != 0) && ((++m_dwRespCnt % m_dwCorrupt) == 0))
+    {
+      buffer[i] ^= 0xFF;
+    }
+  } // for...
+
+  if(m_dwBaud != 0) { Sleep((i * 10000) / m_dwBaud); }
+  Inject(buffer, i);
+}
+
+/// <summary>Simulator thread.</summary>
+/// <param name="lpParameter">Pointer to <see cref="CSimTransport"/>.</param>
+/// <returns>Always zero.</returns>
+DWORD WINAPI CSimTransport::_Run(LPVOID lpParameter)
+{
+  try
+  {
+    ((CSimTransport*)lpParameter)->Run();
+  }
+  catch(...)
+  {
+    CLog::Log(L"[printdrv_fl_psa66st2r][CSimTransport::_Run] unexpected exception\n");
+  }
+
+  return 0;
+}
+
+/// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
+/// <param name="pElem">Pointer to XML DOM element.</param>
+void CSimTransport::Dump(MSXML2::IXMLDOMElement* pElem)
+{
+  try
+  {
+
+    if(pElem != NULL)
+    {
+      CMemTransport::Dump(pElem);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwFlags", m_dwFlags);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwBusyTime", m_dwBusyTime);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwBaud", m_dwBaud);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwCorrupt", m_dwCorrupt);
+      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bBusy", m_bBusy);
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"m_nParse", m_nParse);
+    } // if...
+
+  }
+  catch(...) {}
+}
@@ -0,0 +1,86 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+CSpscRing::CSpscRing() :
+  m_dwWrite(0),
+  m_dwRead(0)
+{
+}
+
+/// <summary>Appends bytes, called by producer only.</summary>
+/// <param name="data">Bytes to be appended.</param>
+/// <param name="size">Size of <paramref name="data"/>, in number of bytes.</param>
+/// <returns>Number of bytes appended, less than <paramref name="size"/> if ring
+/// is full.</returns>
+int CSpscRing::Push(const BYTE* data, int size)
+{
+  DWORD write = m_dwWrite, read, cnt, offset, first;
+
+  if((data == NULL) || (size <= 0)) { return 0; }
+
+  // consumer's index, bytes before it are free.
+  read = m_dwRead;
+  MemoryBarrier();
+
+  cnt = __min((DWORD)size, RX_RING_SIZE - (write - read));
+  if(cnt == 0) { return 0; }
+
+  offset = write & (RX_RING_SIZE - 1);
+  first = __min(cnt, RX_RING_SIZE - offset);
+  memcpy(m_abyData + offset, data, first);
+  memcpy(m_abyData, data + first, cnt - first);
+
+  // publish bytes only after they are stored.
+  MemoryBarrier();
+  m_dwWrite = write + cnt;
+
+  return (int)cnt;
+}
+
+/// <summary>Retrieves number of bytes not yet popped, called by consumer only.
+/// </summary>
+/// <returns>Number of bytes available to <see cref="GetAt"/>.</returns>
+DWORD CSpscRing::GetCount()
+{
+  DWORD write = m_dwWrite;
+
+  // bytes are read only after the index publishing them.
+  MemoryBarrier();
+
+  return write - m_dwRead;
+}
+
+/// <summary>Removes oldest bytes, called by consumer only.</summary>
+/// <param name="buffer">Buffer to receive bytes.</param>
+/// <param name="size">Size of <paramref name="buffer"/>, in number of bytes.</param>
+/// <returns>Number of bytes popped.</returns>
+DWORD CSpscRing::Pop(BYTE* buffer, DWORD size)
+{
+  DWORD read = m_dwRead, cnt, offset, first;
+
+  if(buffer == NULL) { return 0; }
+
+  cnt = __min(size, GetCount());
+  offset = read & (RX_RING_SIZE - 1);
+  first = __min(cnt, RX_RING_SIZE - offset);
+  memcpy(buffer, m_abyData + offset, first);
+  memcpy(buffer + first, m_abyData, cnt - first);
+
+  // hand space back only after bytes are copied out.
+  MemoryBarrier();
+  m_dwRead = read + cnt;
+
+  return cnt;
+}
+
+/// <summary>Removes oldest bytes without copying them, called by consumer only.
+/// </summary>
+/// <param name="size">Number of bytes to be removed.</param>
+void CSpscRing::Discard(DWORD size)
+{
+  DWORD cnt = __min(size, GetCount());
+
+  MemoryBarrier();
+  m_dwRead = m_dwRead + cnt;
+}
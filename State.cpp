@@ -31,23 +31,24 @@ CState* CState::GetParent()
   return m_pParent;
 }
 
-/// <summary>Checks if this state is ancestor of specified state.</summary>
-/// <param name="id">ID of descendant state to be checked.</param>
-/// <returns>Pointer to the child state which is the specified state, or is
-/// the ancenstor of specified state. NULL if this state is NOT the ancenstor
-/// of specified state.</returns>
-CState* CState::IsAncenstorOf(int id)
+/// <summary>Stores this state and all its descendants by ID.</summary>
+/// <param name="apState">Array to receive pointer to each state at index of
+/// its ID.</param>
+/// <param name="size">Number of elements in <paramref name="apState"/>.</param>
+/// <exception cref="wcl::CArgumentException">If a state ID is out of
+/// <paramref name="apState"/> or used by more than one state.</exception>
+void CState::Flatten(CState** apState, int size)
 {
-  CState *pChild;
+  int id = GetID();
   POS pos = m_Children.GetHeadPos();
 
-  while(pos != NULL)
+  if((id < 0) || (id >= size) || (apState[id] != NULL))
   {
-    pChild = m_Children.GetNext(pos);
-    if((pChild->GetID() == id) || pChild->IsAncenstorOf(id)) { return pChild; }
-  } // while...
+    WCL_THROW_ARGUMENTEXCEPTION(L"size", L"invalid or duplicate state ID");
+  }
+  apState[id] = this;
 
-  return NULL;
+  while(pos != NULL) { m_Children.GetNext(pos)->Flatten(apState, size); }
 }
 
 /// <summary>Handles state entered event.</summary>
@@ -71,24 +72,36 @@ void CState::Run(DWORD elapsed)
 
 }
 
+/// <summary>Retrieves time until state needs to run again.</summary>
+/// <returns>Time until next timer is due, in milliseconds.</returns>
+DWORD CState::GetIdleTime()
+{
+  return RUN_INTERVAL;
+}
+
 /// <summary>Handles printer response.</summary>
 /// <param name="resp">Printer response.</param>
 /// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
+/// <remarks>Status response is decoded once here, every
+/// <see cref="HandleRespStatus"/> override along the chain shares the result.
+/// </remarks>
 bool CState::HandleResp(BYTE* resp, DWORD size)
 {
   CMsgMgr mgr;
-  DWORD i;
+  CMsgRespStatus msgStatus;
 
   switch( mgr.GetType(resp, size) )
   {
   case CMsgMgr::CMD_CRC : return HandleRespCRC(resp, size);
-  case CMsgMgr::CMD_STATUS  : return HandleRespStatus(resp, size);
+  case CMsgMgr::CMD_STATUS  :
+    msgStatus.Parse(resp, size);
+    return HandleRespStatus(msgStatus);
   default :
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CState::HandleResp] unknown response:");
-    for(i = 0;i < size;i++) { m_pContext->Trace(L" 0x%X", resp[i]); }
-    m_pContext->Trace(L"\n");
+    m_pContext->Trace(TRACE_RESP_UNKNOWN, size, CTraceRing::Pack(resp, size),
+      CTraceRing::Pack(resp + 4, (int)size - 4),
+      CTraceRing::Pack(resp + 8, (int)size - 8));
     break;
   } // switch...
 
@@ -215,6 +228,17 @@ void CState::DefineGraphic(const print::CGraphic& graphic)
 {
 }
 
+/// <summary>Uploads graphic, region and template definitions in one batch.</summary>
+/// <param name="batch">Definitions, processed graphics first, then regions,
+/// then templates. Taken over if accepted.</param>
+/// <returns>True if batch is accepted, in which case
+/// <see cref="IDefineBatchObserver::OnDefineBatchCompleted"/> is notified when
+/// done, false if printer is not ready to accept it.</returns>
+bool CState::DefineBatch(CDefineBatch& batch)
+{
+  return false;
+}
+
 /// <summary>Defines printable region.</summary>
 /// <param name="region">Printable region.</param>
 /// <exception cref="wcl::CArgumentException">If <paramref name="region"/> is
@@ -246,6 +270,16 @@ void CState::DefineTemplate(const print::CTemplate& templ)
 /// top of form.</remarks>
 void CState::Print(const print::CJob& job)
 {
+  PrintJob(job, m_pContext->m_PrintQueue.NewID());
+}
+
+/// <summary>Prints a job with an identifier already given.</summary>
+/// <param name="job">Print job.</param>
+/// <param name="id">Identifier of <paramref name="job"/>.</param>
+/// <remarks>Job is reported discarded in states unable to print.</remarks>
+void CState::PrintJob(const print::CJob& job, DWORD id)
+{
+  m_pContext->FailPrintJob(id);
 }
 
 /// <summary>Feeds a blank ticket.</summary>
@@ -262,59 +296,7 @@ void CState::FormFeed()
 /// is initialized.</exception>
 void CState::GetFirmwareCurrency(CWkString& currency)
 {
-    /*
-    char* software = new char[m_pContext->m_strSoftwareVer.GetLength()];
-    if (strstr(software, "HKD") != NULL) { currency = L"HKD";  }
-    if (strstr(software, "PHP") != NULL) { currency = L"PHP"; }
-    if (strstr(software, "EUR") != NULL) { currency = L"EUR"; }
-    if (strstr(software, "KRW") != NULL) { currency = L"KRW"; }
-    if (strstr(software, "LKR") != NULL) { currency = L"LKR"; }
-    if (strstr(software, "MYR") != NULL) { currency = L"MYR"; }
-    if (strstr(software, "SGD") != NULL) { currency = L"SGD"; }
-    if (strstr(software, "THB") != NULL) { currency = L"THB"; }
-    if (strstr(software, "TWD") != NULL) { currency = L"TWD"; }
-    if (strstr(software, "USD") != NULL) { currency = L"USD"; }
-    if (strstr(software, "ZAR") != NULL) { currency = L"ZAR"; }
-    if (strstr(software, "ZAR") != NULL) { currency = L"AUD"; }
-    */    
-  if(m_pContext->m_strSoftwareVer == L"GUR126001") { currency = L"HKD"; }
-  else if(m_pContext->m_strSoftwareVer == L"GUR126003") { currency = L"HKD"; }
-  else if (m_pContext->m_strSoftwareVer == L"GURMAC105") { currency = L"HKD"; }
-  else if(m_pContext->m_strSoftwareVer == L"GUR109000") { currency = L"PHP"; }
-  else if(m_pContext->m_strSoftwareVer == L"GUREUR100") { currency = L"EUR"; }
-  else if(m_pContext->m_strSoftwareVer == L"GUREUR101") { currency = L"EUR"; }
-  else if(m_pContext->m_strSoftwareVer == L"GUREUR102") { currency = L"EUR"; }
-  else if(m_pContext->m_strSoftwareVer == L"GUREUR200") { currency = L"EUR"; }
-  else if (m_pContext->m_strSoftwareVer == L"GUREURGE2") { currency = L"EUR"; }
-  else if (m_pContext->m_strSoftwareVer == L"GURKORGE1") { currency = L"KRW"; }
-  else if (m_pContext->m_strSoftwareVer == L"GURLKAGE1") { currency = L"LKR"; }
-  else if (m_pContext->m_strSoftwareVer == L"GURMYSGE0") { currency = L"MYR"; }
-  else if (m_pContext->m_strSoftwareVer == L"GURPHI101") { currency = L"PHP"; }
-  else if (m_pContext->m_strSoftwareVer == L"GURSNG103") { currency = L"SGD"; }
-  else if (m_pContext->m_strSoftwareVer == L"GURTHAGE0") { currency = L"THB"; }
-  else if (m_pContext->m_strSoftwareVer == L"GURTHBGE0") { currency = L"THB"; }
-  else if (m_pContext->m_strSoftwareVer == L"GURLTG000") { currency = L"TWD"; }
-  else if (m_pContext->m_strSoftwareVer == L"GURUSAG13") { currency = L"USD"; }
-  else if (m_pContext->m_strSoftwareVer == L"GURUSDUS1") { currency = L"USD"; }
-  else if (m_pContext->m_strSoftwareVer == L"GURSAFGE0") { currency = L"ZAR"; }
-  else if((m_pContext->m_strSoftwareVer == L"GURTOR100")||(m_pContext->m_strSoftwareVer == L"GURTOR101")) 
-  {
-    currency = L"HKD";
-  }
-  else if((m_pContext->m_strSoftwareVer == L"GURUSA001")||(m_pContext->m_strSoftwareVer == L"GURUSA003"))
-  {
-	  currency = L"USD";
-  }
-  else if(m_pContext->m_strSoftwareVer == L"GURNSW200")	{ currency = L"AUD"; }
-  else if(m_pContext->m_strSoftwareVer == L"GURSNG103")	{ currency = L"SGD"; }
-  else
-  {
-	  if(m_pContext->m_strSoftwareVer == m_pContext->m_strCfgSoftwareVer)
-	  {
-		  currency = m_pContext->m_strCfgCurrency;
-	  }
-	  else { currency = L""; }
-  }
+  currency = m_pContext->m_strCurrency;
 }
 
 /// <summary>Handles printer's response to obtain program CRC command.</summary>
@@ -328,11 +310,10 @@ bool CState::HandleRespCRC(BYTE* resp, DWORD size)
 }
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CState::HandleRespStatus(BYTE* resp, DWORD size)
+bool CState::HandleRespStatus(const CMsgRespStatus& msg)
 {
   return false;
 }
@@ -26,39 +26,37 @@ void CStateAddGraphic::OnEnter(bool isTarget)
 {
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateAddGraphic::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
   CStatePollStatus::OnEnter(isTarget);
 }
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStateAddGraphic::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStateAddGraphic::HandleRespStatus(const CMsgRespStatus& msg)
 {
   int target = STATE_ADD_GRAPHIC;
-  CMsgRespStatus msg;
-
-  msg.Parse(resp, size);
 
   try
   {
 
-    if(CStatePollStatus::HandleRespStatus(resp, size)) { return true; }
+    if(CStatePollStatus::HandleRespStatus(msg)) { return true; }
     m_pContext->UpdateStatusNNotifyObserver(msg.m_Status);
 
     //************************************************
     // RETRY IF PRINTER COMPLAIN ABOUT COMMAND SYNTAX
-    if(m_bPolled && msg.m_Status.m_bCmdErr)
+    if(m_bPolled && msg.m_Status.Test(CStatus::FLAG_CMD_ERR))
     {
+      m_pContext->m_Port.m_Stats.AddCmdErr();
       if(m_nResendCnt < MAX_RESEND_CNT)
       {
         m_nResendCnt++;
+        m_pContext->m_Port.m_Stats.AddResend();
 
-        m_pContext->m_Port.Write(m_pContext->m_pbyLastCmd,
-          m_pContext->m_dwLastCmdSize);
+        m_pContext->m_Port.Send(m_pContext->m_LastCmd.GetData(),
+          m_pContext->m_LastCmd.GetSize(), true);
         m_bPolled = false;
       }
       else
@@ -75,29 +73,29 @@ bool CStateAddGraphic::HandleRespStatus(BYTE* resp, DWORD size)
     // THESE ERRORS INDICATE FAILURE OF DEFINITION.
     if(m_bPolled)
     {
-      if(msg.m_Status.m_bLibRefErr)
+      if(msg.m_Status.Test(CStatus::FLAG_LIB_REF_ERR))
       {
         if(m_pContext->m_pEvtObserver != NULL)
         {
-          m_pContext->m_pEvtObserver->OnDefineGraphicFailed(
+          m_pContext->m_Events.Post(EVT_DEFINE_GRAPHIC_FAILED,
             print::IObserver::GRAPH_ERR_ID);
         }
         target = STATE_IDLE;
       }
-      else if(msg.m_Status.m_bLoadLibErr)
+      else if(msg.m_Status.Test(CStatus::FLAG_LOAD_LIB_ERR))
       {
         if(m_pContext->m_pEvtObserver != NULL)
         {
-          m_pContext->m_pEvtObserver->OnDefineGraphicFailed(
+          m_pContext->m_Events.Post(EVT_DEFINE_GRAPHIC_FAILED,
             print::IObserver::GRAPH_ERR_CORRUPT);
         }
         target = STATE_IDLE;
       }
-      else if(msg.m_Status.m_bBufferOverflow)
+      else if(msg.m_Status.Test(CStatus::FLAG_BUFFER_OVERFLOW))
       {
         if(m_pContext->m_pEvtObserver != NULL)
         {
-          m_pContext->m_pEvtObserver->OnDefineGraphicFailed(
+          m_pContext->m_Events.Post(EVT_DEFINE_GRAPHIC_FAILED,
             print::IObserver::GRAPH_ERR_MEMORY);
         }
         target = STATE_IDLE;
@@ -108,11 +106,13 @@ bool CStateAddGraphic::HandleRespStatus(BYTE* resp, DWORD size)
 
     //**********************
     // DEFINITION SUCCESS.
-    if((target == STATE_DEFINE_GRAPHIC) && m_bPolled && !msg.m_Status.m_bBusy)
+    if((target == STATE_DEFINE_GRAPHIC) && m_bPolled &&
+      !msg.m_Status.Test(CStatus::FLAG_BUSY))
     {
+      m_pContext->m_DefCache.Add(m_pContext->m_LastGraphic);
       if(m_pContext->m_pEvtObserver != NULL)
       {
-        m_pContext->m_pEvtObserver->OnDefineGraphicSuccess();
+        m_pContext->m_Events.Post(EVT_DEFINE_GRAPHIC_SUCCESS);
       }
 
       if(msg.m_Status.ShouldSuspend()) { target = STATE_SUSPENDED; }
@@ -126,10 +126,21 @@ bool CStateAddGraphic::HandleRespStatus(BYTE* resp, DWORD size)
   }
   catch(CCommException& e)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateAddGraphic::HandleRespStatus] CCommException caught, Port:%i, message:%s, error code:%u.\n",
-      e.GetPort(), e.GetMsg(), e.GetSysErrCode());
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
     m_pStateMach->Transit(STATE_DISCONNECTED);
   } // try...catch...
 
   return true;
 }
+
+/// <summary>Handles cancellation of graphic being streamed.</summary>
+void CStateAddGraphic::OnTxCancelled()
+{
+  if(m_pContext->m_pEvtObserver != NULL)
+  {
+    m_pContext->m_Events.Post(EVT_DEFINE_GRAPHIC_FAILED,
+      print::IObserver::GRAPH_ERR_CORRUPT);
+  }
+
+  CStatePollStatus::OnTxCancelled();
+}
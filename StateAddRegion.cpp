@@ -26,41 +26,39 @@ void CStateAddRegion::OnEnter(bool isTarget)
 {
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateAddRegion::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
   CStatePollStatus::OnEnter(isTarget);
 }
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStateAddRegion::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStateAddRegion::HandleRespStatus(const CMsgRespStatus& msg)
 {
   int target = STATE_ADD_REGION;
-  CMsgRespStatus msg;
   BYTE regionID;
   CMsgMgr msgMgr;
 
-  msg.Parse(resp, size);
-
   try
   {
 
-    if(CStatePollStatus::HandleRespStatus(resp, size)) { return true; }
+    if(CStatePollStatus::HandleRespStatus(msg)) { return true; }
     m_pContext->UpdateStatusNNotifyObserver(msg.m_Status);
 
     //************************************************
     // RETRY IF PRINTER COMPLAIN ABOUT COMMAND SYNTAX
-    if(m_bPolled && msg.m_Status.m_bCmdErr)
+    if(m_bPolled && msg.m_Status.Test(CStatus::FLAG_CMD_ERR))
     {
+      m_pContext->m_Port.m_Stats.AddCmdErr();
       if(m_nResendCnt < MAX_RESEND_CNT)
       {
         m_nResendCnt++;
+        m_pContext->m_Port.m_Stats.AddResend();
    
-        m_pContext->m_Port.Write(m_pContext->m_pbyLastCmd,
-          m_pContext->m_dwLastCmdSize);
+        m_pContext->m_Port.Send(m_pContext->m_LastCmd.GetData(),
+          m_pContext->m_LastCmd.GetSize());
         m_bPolled = false;
       }
       else
@@ -77,29 +75,29 @@ bool CStateAddRegion::HandleRespStatus(BYTE* resp, DWORD size)
     // THESE ERRORS INDICATE FAILURE OF DEFINITION.
     if(m_bPolled)
     {
-      if(msg.m_Status.m_bLibRefErr)
+      if(msg.m_Status.Test(CStatus::FLAG_LIB_REF_ERR))
       {
         if(m_pContext->m_pEvtObserver != NULL)
         {
-          m_pContext->m_pEvtObserver->OnDefineRegionFailed(
+          m_pContext->m_Events.Post(EVT_DEFINE_REGION_FAILED,
             print::IObserver::REGION_ERR_UNDEFINED_GRAPHIC);
         }
         target = STATE_IDLE;
       }
-      else if(msg.m_Status.m_bRegionDataErr)
+      else if(msg.m_Status.Test(CStatus::FLAG_REGION_DATA_ERR))
       {
         if(m_pContext->m_pEvtObserver != NULL)
         {
-          m_pContext->m_pEvtObserver->OnDefineRegionFailed(
+          m_pContext->m_Events.Post(EVT_DEFINE_REGION_FAILED,
             print::IObserver::REGION_ERR_DATATYPE_MISMATCH);
         }
         target = STATE_IDLE;
       }
-      else if(msg.m_Status.m_bBufferOverflow)
+      else if(msg.m_Status.Test(CStatus::FLAG_BUFFER_OVERFLOW))
       {
         if(m_pContext->m_pEvtObserver != NULL)
         {
-          m_pContext->m_pEvtObserver->OnDefineRegionFailed(
+          m_pContext->m_Events.Post(EVT_DEFINE_REGION_FAILED,
             print::IObserver::REGION_ERR_OVERFLOW);
         }
         target = STATE_IDLE;
@@ -116,19 +114,22 @@ bool CStateAddRegion::HandleRespStatus(BYTE* resp, DWORD size)
 
     //**********************
     // DEFINITION SUCCESS.
-    if(m_bPolled && !msg.m_Status.m_bBusy)
+    if(m_bPolled && !msg.m_Status.Test(CStatus::FLAG_BUSY))
     {
       // store default data if neccessary.
       if(m_pContext->m_LastRegion.m_strDefData.GetLength() > 0)
       {
         regionID = msgMgr.RegionID2Drv(m_pContext->m_LastRegion.m_nsID);
-        m_pContext->m_RegionDefData.Set(regionID,
+        m_pContext->SetRegionDefData(regionID,
           m_pContext->m_LastRegion.m_strDefData);
       }
 
+      m_pContext->m_DefCache.Add(m_pContext->m_LastRegion);
+      m_pContext->m_Port.m_Stats.AddLatency(LATENCY_DEFINE_REGION,
+        m_pContext->m_Port.GetRxTime());
       if(m_pContext->m_pEvtObserver != NULL)
       {
-        m_pContext->m_pEvtObserver->OnDefineRegionSuccess();
+        m_pContext->m_Events.Post(EVT_DEFINE_REGION_SUCCESS);
       }
 
       if(msg.m_Status.ShouldSuspend()) { m_pStateMach->Transit(STATE_SUSPENDED); }
@@ -140,8 +141,7 @@ bool CStateAddRegion::HandleRespStatus(BYTE* resp, DWORD size)
   }
   catch(CCommException& e)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateAddRegion::HandleRespStatus] CCommException caught, Port:%i, message:%s, error code:%u.\n",
-      e.GetPort(), e.GetMsg(), e.GetSysErrCode());
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
     m_pStateMach->Transit(STATE_DISCONNECTED);
   } // try...catch...
 
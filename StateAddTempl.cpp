@@ -26,41 +26,39 @@ void CStateAddTempl::OnEnter(bool isTarget)
 {
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateAddTempl::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
   CStatePollStatus::OnEnter(isTarget);
 }
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStateAddTempl::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStateAddTempl::HandleRespStatus(const CMsgRespStatus& msg)
 {
   int target = STATE_ADD_TEMPL;
-  CMsgRespStatus msg;
   BYTE templateID;
   CMsgMgr msgMgr;
 
-  msg.Parse(resp, size);
-
   try
   {
 
-    if(CStatePollStatus::HandleRespStatus(resp, size)) { return true; }
+    if(CStatePollStatus::HandleRespStatus(msg)) { return true; }
     m_pContext->UpdateStatusNNotifyObserver(msg.m_Status);
 
     //************************************************
     // RETRY IF PRINTER COMPLAIN ABOUT COMMAND SYNTAX
-    if(m_bPolled && msg.m_Status.m_bCmdErr)
+    if(m_bPolled && msg.m_Status.Test(CStatus::FLAG_CMD_ERR))
     {
+      m_pContext->m_Port.m_Stats.AddCmdErr();
       if(m_nResendCnt < MAX_RESEND_CNT)
       {
         m_nResendCnt++;
+        m_pContext->m_Port.m_Stats.AddResend();
 
-        m_pContext->m_Port.Write(m_pContext->m_pbyLastCmd,
-          m_pContext->m_dwLastCmdSize);
+        m_pContext->m_Port.Send(m_pContext->m_LastCmd.GetData(),
+          m_pContext->m_LastCmd.GetSize());
         m_bPolled = false;
       }
       else
@@ -77,20 +75,20 @@ bool CStateAddTempl::HandleRespStatus(BYTE* resp, DWORD size)
     // THESE ERRORS INDICATE FAILURE OF DEFINITION.
     if(m_bPolled)
     {
-      if(msg.m_Status.m_bLibRefErr || msg.m_Status.m_bRegionDataErr)
+      if(msg.m_Status.Test(CStatus::FLAG_LIB_REF_ERR | CStatus::FLAG_REGION_DATA_ERR))
       {
         if(m_pContext->m_pEvtObserver != NULL)
         {
-          m_pContext->m_pEvtObserver->OnDefineTemplateFailed(
+          m_pContext->m_Events.Post(EVT_DEFINE_TEMPL_FAILED,
             print::IObserver::TEMPL_ERR_UNDEFINED_REGION);
         }
         target = STATE_IDLE;
       }
-      else if(msg.m_Status.m_bBufferOverflow)
+      else if(msg.m_Status.Test(CStatus::FLAG_BUFFER_OVERFLOW))
       {
         if(m_pContext->m_pEvtObserver != NULL)
         {
-          m_pContext->m_pEvtObserver->OnDefineTemplateFailed(
+          m_pContext->m_Events.Post(EVT_DEFINE_TEMPL_FAILED,
             print::IObserver::TEMPL_ERR_MEMORY);
         }
         target = STATE_IDLE;
@@ -107,17 +105,20 @@ bool CStateAddTempl::HandleRespStatus(BYTE* resp, DWORD size)
 
     //**********************
     // DEFINITION SUCCESS.
-    if(m_bPolled && !msg.m_Status.m_bBusy)
+    if(m_bPolled && !msg.m_Status.Test(CStatus::FLAG_BUSY))
     {
 		  if(!msgMgr.IsUserDefinedTempl(m_pContext->m_LastTemplate.m_nsID))
 		  {
 			  // no need to perform flash transfer when overwriting pre-defined template.
 			  // store template.
 			  templateID = msgMgr.TemplID2Drv(m_pContext->m_LastTemplate.m_nsID);
-			  m_pContext->m_Template.Set(templateID, m_pContext->m_LastTemplate);
+			  m_pContext->SetTemplate(templateID, m_pContext->m_LastTemplate);
+			  m_pContext->m_DefCache.Add(m_pContext->m_LastTemplate);
+			  m_pContext->m_Port.m_Stats.AddLatency(LATENCY_DEFINE_TEMPL,
+				  m_pContext->m_Port.GetRxTime());
 			  if(m_pContext->m_pEvtObserver != NULL)
 			  {
-				  m_pContext->m_pEvtObserver->OnDefineTemplateSuccess();
+				  m_pContext->m_Events.Post(EVT_DEFINE_TEMPL_SUCCESS);
 			  }
 			  if(msg.m_Status.ShouldSuspend()) { m_pStateMach->Transit(STATE_SUSPENDED); }
 			  else { m_pStateMach->Transit(STATE_IDLE); }
@@ -134,8 +135,7 @@ bool CStateAddTempl::HandleRespStatus(BYTE* resp, DWORD size)
   }
   catch(CCommException& e)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateAddTempl::HandleRespStatus] CCommException caught, Port:%i, message:%s, error code:%u.\n",
-      e.GetPort(), e.GetMsg(), e.GetSysErrCode());
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
     m_pStateMach->Transit(STATE_DISCONNECTED);
   } // try...catch...
 
@@ -26,7 +26,7 @@ void CStateCRC::OnEnter(bool isTarget)
 {
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateCRC::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
   CStatePollStatus::OnEnter(isTarget);
 }
@@ -41,9 +41,10 @@ bool CStateCRC::HandleRespCRC(BYTE* resp, DWORD size)
   CMsgRespCRC msg;
 
   msg.Parse(resp, size);
+  m_pContext->m_Port.m_Stats.AddLatency(LATENCY_CRC, m_pContext->m_Port.GetRxTime());
   if(m_pContext->m_pEvtObserver != NULL)
   {
-    m_pContext->m_pEvtObserver->OnCRCReady(msg.m_wCRC);
+    m_pContext->m_Events.Post(EVT_CRC_READY, msg.m_wCRC);
   }
   m_pStateMach->Transit(STATE_SUSPENDED);
 
@@ -51,27 +52,21 @@ bool CStateCRC::HandleRespCRC(BYTE* resp, DWORD size)
 }
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStateCRC::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStateCRC::HandleRespStatus(const CMsgRespStatus& msg)
 {
-  CMsgRespStatus msg;
-
-  msg.Parse(resp, size);
-
   try
   {
 
-    if(CStatePollStatus::HandleRespStatus(resp, size)) { return true; }
+    if(CStatePollStatus::HandleRespStatus(msg)) { return true; }
     m_pContext->UpdateStatusNNotifyObserver(msg.m_Status);
 
   }
   catch(CCommException& e)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateCRC::HandleRespStatus] CCommException caught, Port:%i, message:%s, error code:%u.\n",
-      e.GetPort(), e.GetMsg(), e.GetSysErrCode());
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
     m_pStateMach->Transit(STATE_DISCONNECTED);
   } // if...
 
@@ -29,7 +29,7 @@ void CStateCompleteFlashTransfer::OnEnter(bool isTarget)
 {
 	if(isTarget)
 	{
-		m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateCompleteFlashTransfer::OnEnter]\n");
+		m_pContext->Trace(TRACE_STATE_ENTER, GetID());
 
 		m_PollStatusTimer.Reset();
 		m_DisconnectTimer.Reset();
@@ -49,7 +49,6 @@ void CStateCompleteFlashTransfer::Run(DWORD elapsed)
 
 	try
 	{
-		m_pContext->m_Port.Poll();
 		len = m_pContext->m_Port.GetMsg(buffer, 512);
 
 		if((len <= 0) || (len > 512) || !HandleResp(buffer, len))
@@ -73,30 +72,30 @@ void CStateCompleteFlashTransfer::Run(DWORD elapsed)
 }
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStateCompleteFlashTransfer::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStateCompleteFlashTransfer::HandleRespStatus(const CMsgRespStatus& msg)
 {
-	CMsgRespStatus msg;
 	BYTE templateID;
 	CMsgMgr msgMgr;
 
-	msg.Parse(resp, size);
 	m_pContext->m_Status = msg.m_Status;
 
 	templateID = msgMgr.TemplID2Drv(m_pContext->m_LastTemplate.m_nsID);
-	m_pContext->m_Template.Set(templateID, m_pContext->m_LastTemplate);
+	m_pContext->SetTemplate(templateID, m_pContext->m_LastTemplate);
+	m_pContext->m_DefCache.Add(m_pContext->m_LastTemplate);
+	m_pContext->m_Port.m_Stats.AddLatency(LATENCY_FLASH_TRANSFER,
+		m_pContext->m_Port.GetRxTime());
 	if(m_pContext->m_pEvtObserver != NULL)
 	{
-		m_pContext->m_pEvtObserver->OnDefineTemplateSuccess();
+		m_pContext->m_Events.Post(EVT_DEFINE_TEMPL_SUCCESS);
 	}
 
 	if(msg.m_Status.ShouldSuspend()) { m_pStateMach->Transit(STATE_SUSPENDED); }
 	else { m_pStateMach->Transit(STATE_IDLE); }
 
-	CStateInitialized::HandleRespStatus(resp, size);
+	CStateInitialized::HandleRespStatus(msg);
 
 	return true;
 }
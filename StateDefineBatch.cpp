@@ -0,0 +1,417 @@
+#include "stdafx.h"
+#include "state.h"
+
+/// <summary>Constructor.</summary>
+/// <param name="pStateMach">Pointer to owner state machine.</param>
+/// <param name="pContext">Pointer to printer context.</param>
+/// <param name="pParent">Pointer to parent state, NULL for no parent state.</param>
+/// <exception cref="wcl::CArgumentNullException">If <paramref name="pStateMach"/>
+/// or <paramref name="pContext"/> is NULL.</exception>
+CStateDefineBatch::CStateDefineBatch(IStateMach* pStateMach,
+                                     CPrinterContext* pContext, CState* pParent) :
+  CStatePollStatus(pStateMach, pContext, pParent),
+  m_nPhase(PHASE_ADD),
+  m_dwSinceFlash(0),
+  m_nSkip(0)
+{
+}
+
+/// <summary>Rerieves ID of this state.</summary>
+int CStateDefineBatch::GetID()
+{
+  return STATE_DEFINE_BATCH;
+}
+
+/// <summary>Handles state entered event.</summary>
+/// <param name="isTarget">True if this state is the final target of transition,
+/// false otherwise.</param>
+/// <exception cref="CCommException">If failed to send first definition.</exception>
+void CStateDefineBatch::OnEnter(bool isTarget)
+{
+  if(isTarget)
+  {
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
+  }
+  CStatePollStatus::OnEnter(isTarget);
+
+  m_nPhase = PHASE_ADD;
+  m_dwSinceFlash = 0;
+  m_nSkip = 0;
+  if(isTarget) { NextItem(); }
+}
+
+/// <summary>Handles state exited event.</summary>
+/// <remarks>If left before all definitions are processed, e.g. due to
+/// disconnection, remaining definitions are reported as not attempted.</remarks>
+void CStateDefineBatch::OnLeave()
+{
+  CStatePollStatus::OnLeave();
+  m_pContext->m_Batch.Complete();
+}
+
+/// <summary>State execution.<summary>
+/// <param name="elapsed">Time elapsed since last run, in milliseconds.</param>
+/// <remarks>Printer does not respond during flash transfer, status is not
+/// polled until it is expected to be done.</remarks>
+void CStateDefineBatch::Run(DWORD elapsed)
+{
+  if(m_nPhase != PHASE_FLASH)
+  {
+    CStatePollStatus::Run(elapsed);
+    return;
+  }
+
+  m_dwSinceFlash += elapsed;
+  if(m_dwSinceFlash < m_pContext->m_dwFlashTime) { return; }
+
+  try
+  {
+    m_nPhase = PHASE_FLASH_DONE;
+    m_AliveTimer.Reset();
+    m_dwSinceAlive = 0;
+    m_nSkip = m_nPollPending;
+    PollNow();
+  }
+  catch(CCommException& e)
+  {
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
+    m_pStateMach->Transit(STATE_DISCONNECTED);
+  }
+}
+
+/// <summary>Retrieves time until state needs to run again.</summary>
+/// <returns>Time until next timer is due, in milliseconds.</returns>
+DWORD CStateDefineBatch::GetIdleTime()
+{
+  if(m_nPhase != PHASE_FLASH) { return CStatePollStatus::GetIdleTime(); }
+
+  return (m_dwSinceFlash < m_pContext->m_dwFlashTime) ?
+    (m_pContext->m_dwFlashTime - m_dwSinceFlash) : 0;
+}
+
+/// <summary>Handles printer status response.</summary>
+/// <param name="msg">Decoded printer status response.</param>
+/// <returns>True if the response was consumed (thus should not be used for
+/// further process anymore), false otherwise.</returns>
+bool CStateDefineBatch::HandleRespStatus(const CMsgRespStatus& msg)
+{
+  CMsgMgr msgMgr;
+
+  try
+  {
+
+    if(CStatePollStatus::HandleRespStatus(msg)) { return true; }
+    m_pContext->UpdateStatusNNotifyObserver(msg.m_Status);
+
+    if(m_nSkip > 0)
+    {
+      // answers a poll sent before the command in progress.
+      m_nSkip--;
+      return true;
+    }
+    if(!m_bPolled || (m_nPhase == PHASE_FLASH)) { return true; }
+
+    if(m_nPhase == PHASE_FLASH_DONE)
+    {
+      // printer responding again, flash transfer completed.
+      CommitItem();
+      m_pContext->m_Batch.m_nIndex++;
+      NextItem();
+      return true;
+    }
+
+    //************************************************
+    // RETRY IF PRINTER COMPLAIN ABOUT COMMAND SYNTAX
+    if(msg.m_Status.Test(CStatus::FLAG_CMD_ERR))
+    {
+      m_pContext->m_Port.m_Stats.AddCmdErr();
+      if(m_nResendCnt < MAX_RESEND_CNT)
+      {
+        m_nResendCnt++;
+        m_pContext->m_Port.m_Stats.AddResend();
+
+        m_nSkip = m_nPollPending;
+        m_pContext->m_Port.Send(m_pContext->m_LastCmd.GetData(),
+          m_pContext->m_LastCmd.GetSize(), m_pContext->m_Batch.IsGraphic());
+        PollNow();
+      }
+      else
+      {
+        m_pStateMach->Transit(STATE_DISCONNECTED);
+      } // if...else...
+      return true;
+    }
+    else { m_nResendCnt = 0; }
+    // END OF RETRY.
+    //********************
+
+    // PHASE_ADD
+    if(CheckAddErr(msg.m_Status))
+    {
+      m_pContext->m_Batch.m_nIndex++;
+      NextItem();
+      return true;
+    }
+    if(msg.m_Status.Test(CStatus::FLAG_BUSY)) { return true; }
+
+    if( !m_pContext->m_Batch.IsGraphic() && !m_pContext->m_Batch.IsRegion() &&
+      msgMgr.IsUserDefinedTempl(m_pContext->m_Batch.GetTemplate().m_nsID) )
+    {
+      // perform flash transfer for user-defined template.
+      CMsgFlashTransfer msgFlash(msgMgr.TemplID2PageID(
+        m_pContext->m_Batch.GetTemplate().m_nsID));
+      m_pContext->SendNUpdateLastCmd(msgFlash);
+      m_nPhase = PHASE_FLASH;
+      m_dwSinceFlash = 0;
+      return true;
+    }
+
+    CommitItem();
+    m_pContext->m_Batch.m_nIndex++;
+    NextItem();
+
+  }
+  catch(CCommException& e)
+  {
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
+    m_pStateMach->Transit(STATE_DISCONNECTED);
+  } // try...catch...
+
+  return true;
+}
+
+/// <summary>Handles status polls left unanswered for a whole polling interval.
+/// </summary>
+/// <remarks>Responses still to be skipped were for those polls, so the next
+/// response answers a poll sent after the command in progress.</remarks>
+void CStateDefineBatch::OnPollsLost()
+{
+  m_nSkip = 0;
+  CStatePollStatus::OnPollsLost();
+}
+
+/// <summary>Sends delete and define commands of definition in progress back to
+/// back, followed by a single status poll.</summary>
+/// <returns>True if sent, false if definition is invalid, in which case its
+/// failure is recorded.</returns>
+/// <exception cref="CCommException">If failed to send.</exception>
+/// <remarks>Printer processes commands in order, so the define does not wait
+/// for the delete to be answered, saving a round trip per definition.</remarks>
+bool CStateDefineBatch::SendItem()
+{
+  m_nPhase = PHASE_ADD;
+  m_nSkip = m_nPollPending;
+  m_nResendCnt = 0;
+
+  if(!SendCmd(false)) { return false; }
+  if(!SendCmd(true)) { return false; }
+
+  PollNow();
+  return true;
+}
+
+/// <summary>Sends delete or define command of definition in progress.</summary>
+/// <param name="define">True to send define command, false to send delete
+/// command.</param>
+/// <returns>True if sent, false if definition is invalid, in which case its
+/// failure is recorded.</returns>
+/// <exception cref="CCommException">If failed to send.</exception>
+bool CStateDefineBatch::SendCmd(bool define)
+{
+  CDefineBatch& batch = m_pContext->m_Batch;
+  CMsgMgr msgMgr;
+
+  if(!define)
+  {
+    // definition on printer is about to be replaced.
+    if(batch.IsGraphic())
+    {
+      m_pContext->m_DefCache.Remove(CDefCache::KIND_GRAPHIC, batch.GetGraphic().m_byID);
+    }
+    else if(batch.IsRegion())
+    {
+      m_pContext->m_DefCache.Remove(CDefCache::KIND_REGION, batch.GetRegion().m_nsID);
+    }
+    else
+    {
+      m_pContext->m_DefCache.Remove(CDefCache::KIND_TEMPL, batch.GetTemplate().m_nsID);
+    } // if...else...
+  } // if...
+
+  if(batch.IsGraphic())
+  {
+    CMsgLibManage msg;
+
+    msg.m_bDefine = define;
+    msg.m_pGraphic = &(batch.GetGraphic());
+    try
+    {
+      m_pContext->SendNUpdateLastCmd(msg, true);
+    }
+    catch(wcl::CArgumentException&)
+    {
+      batch.SetResult(false, print::IObserver::GRAPH_ERR_ID);
+      return false;
+    }
+  }
+  else if(batch.IsRegion())
+  {
+    CMsgDefineRegion msg;
+
+    msg.m_bDefine = define;
+    msg.m_pRegion = &(batch.GetRegion());
+    try
+    {
+      m_pContext->SendNUpdateLastCmd(msg);
+    }
+    catch(CInvalidRegionException&)
+    {
+      batch.SetResult(false, print::IObserver::REGION_ERR_DATATYPE_MISMATCH);
+      return false;
+    }
+    catch(wcl::CArgumentException&)
+    {
+      batch.SetResult(false, print::IObserver::REGION_ERR_ID);
+      return false;
+    }
+  }
+  else
+  {
+    CMsgDefineTempl msg;
+
+    msg.m_bDefine = define;
+    msg.m_pTemplate = &(batch.GetTemplate());
+    try
+    {
+      m_pContext->SendNUpdateLastCmd(msg);
+    }
+    catch(wcl::CArgumentException&)
+    {
+      batch.SetResult(false, print::IObserver::TEMPL_ERR_ID);
+      return false;
+    }
+  } // if...else...
+
+  if(!define && batch.IsRegion())
+  {
+    // remove associated default data.
+    m_pContext->SetRegionDefData(msgMgr.RegionID2Drv(batch.GetRegion().m_nsID), NULL);
+  }
+
+  return true;
+}
+
+/// <summary>Handles cancellation of definition being streamed.</summary>
+/// <remarks>Definitions not yet processed are reported as not attempted when
+/// the state is left.</remarks>
+void CStateDefineBatch::OnTxCancelled()
+{
+  if(m_pContext->m_Batch.IsGraphic())
+  {
+    m_pContext->m_Batch.SetResult(false, print::IObserver::GRAPH_ERR_CORRUPT);
+  }
+
+  CStatePollStatus::OnTxCancelled();
+}
+
+/// <summary>Checks status for failure of define command in progress.</summary>
+/// <param name="status">Printer status.</param>
+/// <returns>True if definition failed, in which case its failure is recorded,
+/// false otherwise.</returns>
+bool CStateDefineBatch::CheckAddErr(const CStatus& status)
+{
+  CDefineBatch& batch = m_pContext->m_Batch;
+
+  if(batch.IsGraphic())
+  {
+    if(status.Test(CStatus::FLAG_LIB_REF_ERR)) { batch.SetResult(false, print::IObserver::GRAPH_ERR_ID); }
+    else if(status.Test(CStatus::FLAG_LOAD_LIB_ERR)) { batch.SetResult(false, print::IObserver::GRAPH_ERR_CORRUPT); }
+    else if(status.Test(CStatus::FLAG_BUFFER_OVERFLOW)) { batch.SetResult(false, print::IObserver::GRAPH_ERR_MEMORY); }
+    else { return false; }
+  }
+  else if(batch.IsRegion())
+  {
+    if(status.Test(CStatus::FLAG_LIB_REF_ERR)) { batch.SetResult(false, print::IObserver::REGION_ERR_UNDEFINED_GRAPHIC); }
+    else if(status.Test(CStatus::FLAG_REGION_DATA_ERR)) { batch.SetResult(false, print::IObserver::REGION_ERR_DATATYPE_MISMATCH); }
+    else if(status.Test(CStatus::FLAG_BUFFER_OVERFLOW)) { batch.SetResult(false, print::IObserver::REGION_ERR_OVERFLOW); }
+    else { return false; }
+  }
+  else
+  {
+    if(status.Test(CStatus::FLAG_LIB_REF_ERR | CStatus::FLAG_REGION_DATA_ERR)) { batch.SetResult(false, print::IObserver::TEMPL_ERR_UNDEFINED_REGION); }
+    else if(status.Test(CStatus::FLAG_BUFFER_OVERFLOW)) { batch.SetResult(false, print::IObserver::TEMPL_ERR_MEMORY); }
+    else { return false; }
+  } // if...else...
+
+  return true;
+}
+
+/// <summary>Checks if printer already holds definition in progress.</summary>
+/// <returns>True if identical definition was accepted before, false otherwise
+/// or if definition is invalid.</returns>
+bool CStateDefineBatch::IsCached()
+{
+  CDefineBatch& batch = m_pContext->m_Batch;
+
+  try
+  {
+    if(batch.IsGraphic()) { return m_pContext->m_DefCache.IsDefined(batch.GetGraphic()); }
+    if(batch.IsRegion()) { return m_pContext->m_DefCache.IsDefined(batch.GetRegion()); }
+    return m_pContext->m_DefCache.IsDefined(batch.GetTemplate());
+  }
+  catch(...) {}
+
+  return false;
+}
+
+/// <summary>Records success of definition in progress and keeps what the
+/// driver needs to remember about it.</summary>
+void CStateDefineBatch::CommitItem()
+{
+  CDefineBatch& batch = m_pContext->m_Batch;
+  CMsgMgr msgMgr;
+  BYTE regionID;
+
+  if(batch.IsGraphic())
+  {
+    m_pContext->m_DefCache.Add(batch.GetGraphic());
+  }
+  else if(batch.IsRegion())
+  {
+    // replace default data.
+    regionID = msgMgr.RegionID2Drv(batch.GetRegion().m_nsID);
+    m_pContext->SetRegionDefData(regionID, batch.GetRegion().m_strDefData);
+    m_pContext->m_DefCache.Add(batch.GetRegion());
+  }
+  else
+  {
+    m_pContext->SetTemplate(msgMgr.TemplID2Drv(batch.GetTemplate().m_nsID),
+      batch.GetTemplate());
+    m_pContext->m_DefCache.Add(batch.GetTemplate());
+  } // if...else...
+
+  batch.SetResult(true, 0);
+}
+
+/// <summary>Starts definition at <see cref="CDefineBatch::m_nIndex"/>, skipping
+/// invalid ones, or completes the batch if none left.</summary>
+/// <exception cref="CCommException">If failed to send.</exception>
+void CStateDefineBatch::NextItem()
+{
+  CDefineBatch& batch = m_pContext->m_Batch;
+
+  for(;batch.m_nIndex < batch.GetCount();batch.m_nIndex++)
+  {
+    if(IsCached())
+    {
+      // printer already holds identical definition.
+      CommitItem();
+      continue;
+    }
+    if(SendItem()) { return; }
+  } // for...
+
+  batch.Complete();
+  if(m_pContext->m_Status.ShouldSuspend()) { m_pStateMach->Transit(STATE_SUSPENDED); }
+  else { m_pStateMach->Transit(STATE_IDLE); }
+}
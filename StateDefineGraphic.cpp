@@ -35,6 +35,6 @@ void CStateDefineGraphic::OnEnter(bool isTarget)
 {
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateDefineGraphic::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
 }
@@ -26,40 +26,38 @@ void CStateDeleteGraphic::OnEnter(bool isTarget)
 {
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateDeleteGraphic::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
   CStatePollStatus::OnEnter(isTarget);
 }
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStateDeleteGraphic::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStateDeleteGraphic::HandleRespStatus(const CMsgRespStatus& msg)
 {
   int target = STATE_DELETE_GRAPHIC;
-  CMsgRespStatus msg;
   CMsgLibManage msgLibManage;
 
-  msg.Parse(resp, size);
-
   try
   {
 
-    if(CStatePollStatus::HandleRespStatus(resp, size)) { return true; }
+    if(CStatePollStatus::HandleRespStatus(msg)) { return true; }
     m_pContext->UpdateStatusNNotifyObserver(msg.m_Status);
 
     //************************************************
     // RETRY IF PRINTER COMPLAIN ABOUT COMMAND SYNTAX
-    if(m_bPolled && msg.m_Status.m_bCmdErr)
+    if(m_bPolled && msg.m_Status.Test(CStatus::FLAG_CMD_ERR))
     {
+      m_pContext->m_Port.m_Stats.AddCmdErr();
       if(m_nResendCnt < MAX_RESEND_CNT)
       {
         m_nResendCnt++;
+        m_pContext->m_Port.m_Stats.AddResend();
 
-        m_pContext->m_Port.Write(m_pContext->m_pbyLastCmd,
-          m_pContext->m_dwLastCmdSize);
+        m_pContext->m_Port.Send(m_pContext->m_LastCmd.GetData(),
+          m_pContext->m_LastCmd.GetSize());
         m_bPolled = false;
       }
       else
@@ -74,12 +72,12 @@ bool CStateDeleteGraphic::HandleRespStatus(BYTE* resp, DWORD size)
 
     //**********************
     // DEFINITION SUCCESS.
-    if(m_bPolled && !msg.m_Status.m_bBusy)
+    if(m_bPolled && !msg.m_Status.Test(CStatus::FLAG_BUSY))
     { 
       msgLibManage.m_bDefine = true;
       msgLibManage.m_pGraphic = &(m_pContext->m_LastGraphic);
 
-      m_pContext->SendNUpdateLastCmd(msgLibManage);
+      m_pContext->SendNUpdateLastCmd(msgLibManage, true);
 
       m_pStateMach->Transit(STATE_ADD_GRAPHIC);
     } // if...
@@ -89,15 +87,14 @@ bool CStateDeleteGraphic::HandleRespStatus(BYTE* resp, DWORD size)
   }
   catch(wcl::CArgumentException& e)
   {
-    m_pContext->m_pEvtObserver->OnDefineGraphicFailed(print::IObserver::REGION_ERR_ID);
+    m_pContext->m_Events.Post(EVT_DEFINE_GRAPHIC_FAILED, print::IObserver::REGION_ERR_ID);
     
     if(msg.m_Status.ShouldSuspend()) { m_pStateMach->Transit(STATE_SUSPENDED); }
     else { m_pStateMach->Transit(STATE_IDLE); }
   }
   catch(CCommException& e)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateDeleteGraphic::HandleRespStatus] CCommException caught, Port:%i, message:%s, error code:%u.\n",
-      e.GetPort(), e.GetMsg(), e.GetSysErrCode());
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
     m_pStateMach->Transit(STATE_DISCONNECTED);
   } // try...catch...
 
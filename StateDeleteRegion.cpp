@@ -26,41 +26,39 @@ void CStateDeleteRegion::OnEnter(bool isTarget)
 {
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateDeleteRegion::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
   CStatePollStatus::OnEnter(isTarget);
 }
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStateDeleteRegion::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStateDeleteRegion::HandleRespStatus(const CMsgRespStatus& msg)
 {
-  CMsgRespStatus msg;
   CMsgDefineRegion msgDefineRegion;
   BYTE regionID;
   CMsgMgr msgMgr;
 
-  msg.Parse(resp, size);
-
   try
   {
 
-    if(CStatePollStatus::HandleRespStatus(resp, size)) { return true; }
+    if(CStatePollStatus::HandleRespStatus(msg)) { return true; }
     m_pContext->UpdateStatusNNotifyObserver(msg.m_Status);
 
     //************************************************
     // RETRY IF PRINTER COMPLAIN ABOUT COMMAND SYNTAX
-    if(m_bPolled && msg.m_Status.m_bCmdErr)
+    if(m_bPolled && msg.m_Status.Test(CStatus::FLAG_CMD_ERR))
     {
+      m_pContext->m_Port.m_Stats.AddCmdErr();
       if(m_nResendCnt < MAX_RESEND_CNT)
       {
         m_nResendCnt++;
+        m_pContext->m_Port.m_Stats.AddResend();
   
-        m_pContext->m_Port.Write(m_pContext->m_pbyLastCmd,
-          m_pContext->m_dwLastCmdSize);
+        m_pContext->m_Port.Send(m_pContext->m_LastCmd.GetData(),
+          m_pContext->m_LastCmd.GetSize());
         m_bPolled = false;
       }
       else
@@ -75,11 +73,11 @@ bool CStateDeleteRegion::HandleRespStatus(BYTE* resp, DWORD size)
 
     //**********************
     // DEFINITION SUCCESS.
-    if(m_bPolled && !msg.m_Status.m_bBusy)
+    if(m_bPolled && !msg.m_Status.Test(CStatus::FLAG_BUSY))
     {
       // remove associated default data.
       regionID = msgMgr.RegionID2Drv(m_pContext->m_LastRegion.m_nsID);
-      m_pContext->m_RegionDefData.Remove(regionID);
+      m_pContext->SetRegionDefData(regionID, NULL);
 
       msgDefineRegion.m_bDefine = true;
       msgDefineRegion.m_pRegion = &(m_pContext->m_LastRegion);
@@ -94,22 +92,21 @@ bool CStateDeleteRegion::HandleRespStatus(BYTE* resp, DWORD size)
   }
   catch(CInvalidRegionException& e)
   {
-    m_pContext->m_pEvtObserver->OnDefineRegionFailed(print::IObserver::REGION_ERR_DATATYPE_MISMATCH);
+    m_pContext->m_Events.Post(EVT_DEFINE_REGION_FAILED, print::IObserver::REGION_ERR_DATATYPE_MISMATCH);
 
     if(msg.m_Status.ShouldSuspend()) { m_pStateMach->Transit(STATE_SUSPENDED); }
     else { m_pStateMach->Transit(STATE_IDLE); }
   }
   catch(wcl::CArgumentException& e)
   {
-    m_pContext->m_pEvtObserver->OnDefineRegionFailed(print::IObserver::REGION_ERR_ID);
+    m_pContext->m_Events.Post(EVT_DEFINE_REGION_FAILED, print::IObserver::REGION_ERR_ID);
 
     if(msg.m_Status.ShouldSuspend()) { m_pStateMach->Transit(STATE_SUSPENDED); }
     else { m_pStateMach->Transit(STATE_IDLE); }
   }
   catch(CCommException& e)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateDeleteRegion::HandleRespStatus] CCommException caught, Port:%i, message:%s, error code:%u.\n",
-      e.GetPort(), e.GetMsg(), e.GetSysErrCode());
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
     m_pStateMach->Transit(STATE_DISCONNECTED);
   } // try...catch...
 
@@ -28,15 +28,24 @@ void CStateDisconnected::OnEnter(bool isTarget)
 {
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateDisconnected::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
 
+  // queued jobs are not carried over an error or a suspend.
+  m_pContext->DiscardPrintJobs();
+  m_pContext->m_DefCache.Flush();
+
+  // rest of a command being streamed is of no use anymore, commands queued
+  // behind it are still sent by Run.
+  m_pContext->m_Port.DiscardTx();
+
   m_nResendCnt = 0;
   m_PollStatusTimer.Reset();
+  m_pContext->m_Port.m_Stats.AddDisconnect();
 
   if(m_pContext->m_pEvtObserver != NULL)
   {
-    m_pContext->m_pEvtObserver->OnDisconnected();
+    m_pContext->m_Events.Post(EVT_DISCONNECTED);
   }
 }
 
@@ -52,17 +61,18 @@ void CStateDisconnected::Run(DWORD elapsed)
 
   try
   {
-    m_pContext->m_Port.Poll();
+    m_pContext->m_Port.PumpTx();
+
     len = m_pContext->m_Port.GetMsg(buffer, 512);
 
     if((len > 0) && (len < 512))
     {
       HandleResp(buffer, len);
-      if(!m_pContext->m_Status.m_bCmdErr)
+      if(!m_pContext->m_Status.Test(CStatus::FLAG_CMD_ERR))
       {
         if(m_pContext->m_pEvtObserver != NULL)
         {
-          m_pContext->m_pEvtObserver->OnConnected();
+          m_pContext->m_Events.Post(EVT_CONNECTED);
         }
         m_pStateMach->Transit(STATE_INIT);
       }
@@ -78,16 +88,12 @@ void CStateDisconnected::Run(DWORD elapsed)
 }
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStateDisconnected::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStateDisconnected::HandleRespStatus(const CMsgRespStatus& msg)
 {
-  CMsgRespStatus msg;
-
-  msg.Parse(resp, size);
   m_pContext->m_Status = msg.m_Status;
 
-  return CStateInitialized::HandleRespStatus(resp, size);
+  return CStateInitialized::HandleRespStatus(msg);
 }
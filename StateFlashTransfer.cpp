@@ -11,7 +11,7 @@ CStateFlashTransfer::CStateFlashTransfer(IStateMach* pStateMach,
 										 CPrinterContext* pContext, CState* pParent) :
 	CStateInitialized(pStateMach, pContext, pParent)
 {
-	m_Timer.SetExpiry(2000);
+	m_Timer.SetExpiry(FLASH_TRANSFER_TIME);
 }
 
 /// <summary>Rerieves ID of this state.</summary>
@@ -27,13 +27,14 @@ void CStateFlashTransfer::OnEnter(bool isTarget)
 {
 	if(isTarget)
 	{
-		m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateFlashTransfer::OnEnter]\n");
+		m_pContext->Trace(TRACE_STATE_ENTER, GetID());
 
 		CMsgMgr msgMgr;
 		CMsgFlashTransfer msg(msgMgr.TemplID2PageID(
 			m_pContext->m_LastTemplate.m_nsID));
 		m_pContext->SendNUpdateLastCmd(msg);
 
+		m_Timer.SetExpiry(m_pContext->m_dwFlashTime);
 		m_Timer.Reset();
 	}
 }
@@ -26,9 +26,12 @@ void CStateIdle::OnEnter(bool isTarget)
 {
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateIdle::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
   CStatePollStatus::OnEnter(isTarget);
+
+  // definitions made since last idle are persisted at once.
+  m_pContext->m_DefCache.Flush();
 }
 
 /// <summary>Suspends the printer.</summary>
@@ -42,7 +45,7 @@ void CStateIdle::Suspend()
   m_pStateMach->Transit(STATE_SUSPENDED);
   if(m_pContext->m_pEvtObserver != NULL)
   {
-    m_pContext->m_pEvtObserver->OnSuspended();
+    m_pContext->m_Events.Post(EVT_SUSPENDED);
   } // if...
 }
 
@@ -67,12 +70,23 @@ void CStateIdle::DefineGraphic(const print::CGraphic& graphic)
 
   try
   {
+    if(m_pContext->m_DefCache.IsDefined(graphic))
+    {
+      // printer already holds identical graphic.
+      if(m_pContext->m_pEvtObserver != NULL)
+      {
+        m_pContext->m_Events.Post(EVT_DEFINE_GRAPHIC_SUCCESS);
+      }
+      return;
+    }
+
+    m_pContext->m_DefCache.Remove(CDefCache::KIND_GRAPHIC, graphic.m_byID);
     m_pContext->SendNUpdateLastCmd(msg);
     m_pStateMach->Transit(STATE_DELETE_GRAPHIC);
   }
   catch(wcl::CArgumentException& e)
   {
-    m_pContext->m_pEvtObserver->OnDefineGraphicFailed(print::IObserver::GRAPH_ERR_ID);
+    m_pContext->m_Events.Post(EVT_DEFINE_GRAPHIC_FAILED, print::IObserver::GRAPH_ERR_ID);
   }
   catch(CCommException& e)
   {
@@ -82,6 +96,30 @@ void CStateIdle::DefineGraphic(const print::CGraphic& graphic)
   } // try...catch...
 }
 
+/// <summary>Uploads graphic, region and template definitions in one batch.</summary>
+/// <param name="batch">Definitions, processed graphics first, then regions,
+/// then templates. Taken over.</param>
+/// <returns>True, as batch is always accepted.</returns>
+/// <remarks>Each definition replaces the one of same identifier, as
+/// <see cref="DefineGraphic"/>, <see cref="DefineRegion"/> and
+/// <see cref="DefineTempl"/> do.</remarks>
+bool CStateIdle::DefineBatch(CDefineBatch& batch)
+{
+  m_pContext->m_Batch.Take(batch);
+
+  try
+  {
+    m_pStateMach->Transit(STATE_DEFINE_BATCH);
+  }
+  catch(CCommException& e)
+  {
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
+    m_pStateMach->Transit(STATE_DISCONNECTED);
+  } // try...catch...
+
+  return true;
+}
+
 /// <summary>Defines printable region.</summary>
 /// <param name="region">Printable region.</param>
 /// <exception cref="wcl::CArgumentException">If <paramref name="region"/> is
@@ -93,6 +131,8 @@ void CStateIdle::DefineGraphic(const print::CGraphic& graphic)
 void CStateIdle::DefineRegion(const print::CRegion& region)
 {
   CMsgDefineRegion msg;
+  CMsgMgr msgMgr;
+  BYTE regionID;
 
   msg.m_bDefine = false;
   msg.m_pRegion = &region;
@@ -101,12 +141,25 @@ void CStateIdle::DefineRegion(const print::CRegion& region)
 
   try
   {
+    if(m_pContext->m_DefCache.IsDefined(region))
+    {
+      // printer already holds identical region, only default data to update.
+      regionID = msgMgr.RegionID2Drv(region.m_nsID);
+      m_pContext->SetRegionDefData(regionID, region.m_strDefData);
+      if(m_pContext->m_pEvtObserver != NULL)
+      {
+        m_pContext->m_Events.Post(EVT_DEFINE_REGION_SUCCESS);
+      }
+      return;
+    }
+
+    m_pContext->m_DefCache.Remove(CDefCache::KIND_REGION, region.m_nsID);
     m_pContext->SendNUpdateLastCmd(msg);
     m_pStateMach->Transit(STATE_DELETE_REGION);
   }
   catch(wcl::CArgumentException& e)
   {
-    m_pContext->m_pEvtObserver->OnDefineRegionFailed(print::IObserver::REGION_ERR_ID);
+    m_pContext->m_Events.Post(EVT_DEFINE_REGION_FAILED, print::IObserver::REGION_ERR_ID);
   }
   catch(CCommException& e)
   {
@@ -125,6 +178,7 @@ void CStateIdle::DefineRegion(const print::CRegion& region)
 void CStateIdle::DefineTemplate(const print::CTemplate& templ)
 {
   CMsgDefineTempl msg;
+  CMsgMgr msgMgr;
 
   msg.m_bDefine = false;
   msg.m_pTemplate = &templ;
@@ -133,12 +187,24 @@ void CStateIdle::DefineTemplate(const print::CTemplate& templ)
 
   try
   {
+    if(m_pContext->m_DefCache.IsDefined(templ))
+    {
+      // printer already holds identical template.
+      m_pContext->SetTemplate(msgMgr.TemplID2Drv(templ.m_nsID), templ);
+      if(m_pContext->m_pEvtObserver != NULL)
+      {
+        m_pContext->m_Events.Post(EVT_DEFINE_TEMPL_SUCCESS);
+      }
+      return;
+    }
+
+    m_pContext->m_DefCache.Remove(CDefCache::KIND_TEMPL, templ.m_nsID);
     m_pContext->SendNUpdateLastCmd(msg);
     m_pStateMach->Transit(STATE_DELETE_TEMPL);
   }
   catch(wcl::CArgumentException& e)
   {
-    m_pContext->m_pEvtObserver->OnDefineTemplateFailed(print::IObserver::TEMPL_ERR_ID);
+    m_pContext->m_Events.Post(EVT_DEFINE_TEMPL_FAILED, print::IObserver::TEMPL_ERR_ID);
   }
   catch(CCommException& e)
   {
@@ -148,61 +214,21 @@ void CStateIdle::DefineTemplate(const print::CTemplate& templ)
   }
 }
 
-/// <summary>Prints a job using specified template.</summary>
+/// <summary>Prints a job with an identifier already given.</summary>
 /// <param name="job">Print job.</param>
-/// <exception cref="wcl::CInvalidOperationException">If invoked before printer
-/// is initialized.</exception>
-/// <remarks>Printer will ignore this call when it is in suspend mode, or when
-/// following conditions are present: print head open, paper jam, paper empty,
-/// top of form.</remarks>
-void CStateIdle::Print(const print::CJob& job)
+/// <param name="id">Identifier of <paramref name="job"/>.</param>
+void CStateIdle::PrintJob(const print::CJob& job, DWORD id)
 {
-  CMsgMgr msgMgr;
-  BYTE templateID, regionID;
-  print::CTemplate templ;
-  int i, cnt;
-  POS posJob, posTempl;
-  CWkString defData;
-  CMsgPrint msg;
-  print::CJob ppJob = job;
-  IJobFilter *pJobFilter;
-
-  // pre-process job to fill in default data.
-  templateID = msgMgr.TemplID2Drv(job.m_nsTemplateID);
-  if(m_pContext->m_Template.Get(templateID, templ))
-  {
-    cnt = __min(job.GetCount(), templ.GetCount());
-    for(i = 0;i < cnt;i++)
-    {
-      posJob = ppJob.FindIndex(i);
-      posTempl = templ.FindIndex(i);
-      regionID = msgMgr.RegionID2Drv( templ.GetAt(posTempl) );
-
-      if( (job.GetAt(posJob).m_strData.GetLength() <= 0) &&
-        m_pContext->m_RegionDefData.Get(regionID, defData) )
-      {
-        ppJob.GetAt(posJob).m_strData = defData;
-      }
-    } // for...
-  } // if...
-
-  // apply job filter.
-  pJobFilter = m_pContext->GetJobFilter();
-  if(pJobFilter && pJobFilter->NeedTransform(ppJob))
-  {
-	  ppJob = pJobFilter->Transform(ppJob);
-  }
-  msg.m_pJob = &ppJob;
-
   try
   {
-    m_pContext->SendNUpdateLastCmd(msg);
+    m_pContext->SendPrintJob(job, id);
     m_pStateMach->Transit(STATE_PRINTING);
   }
   catch(CCommException& e)
   {
    // m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateIdle::Print] disconnected due to CCommException, port:%i, msg:%s, err:%u.\n",
    //   e.GetPort(), e.GetMsg(), e.GetSysErrCode);
+    m_pContext->FailPrintJob(id);
     m_pStateMach->Transit(STATE_DISCONNECTED);
   }
 }
@@ -227,20 +253,15 @@ void CStateIdle::FormFeed()
 }
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStateIdle::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStateIdle::HandleRespStatus(const CMsgRespStatus& msg)
 {
-  CMsgRespStatus msg;
-
-  msg.Parse(resp, size);
-
   try
   {
 
-    if(CStatePollStatus::HandleRespStatus(resp, size)) { return true; }
+    if(CStatePollStatus::HandleRespStatus(msg)) { return true; }
     m_pContext->UpdateStatusNNotifyObserver(msg.m_Status);
 
     if(msg.m_Status.ShouldSuspend()) { m_pStateMach->Transit(STATE_SUSPENDED); }
@@ -248,10 +269,16 @@ bool CStateIdle::HandleRespStatus(BYTE* resp, DWORD size)
   }
   catch(CCommException& e)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateIdle::Run] CCommException caught, Port:%i, message:%s, error code:%u.\n",
-      e.GetPort(), e.GetMsg(), e.GetSysErrCode());
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
     m_pStateMach->Transit(STATE_DISCONNECTED);
   } // try...catch...
 
   return true;
 }
+
+/// <summary>Retrieves status polling interval to be used in this state.</summary>
+/// <returns>Idle polling interval, in milliseconds.</returns>
+DWORD CStateIdle::GetPollInterval()
+{
+  return m_pContext->m_dwPollIdle;
+}
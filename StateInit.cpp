@@ -30,7 +30,7 @@ void CStateInit::OnEnter(bool isTarget)
 
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateInit::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
   CStatePollStatus::OnEnter(isTarget);
 
@@ -67,72 +67,42 @@ void CStateInit::Resume()
   m_pContext->m_bInitSuspend = false;
 }
 
-#define CHECK_EVT(errFunc, evtFunc) if(msg.m_Status.errFunc())\
-                                    {\
-                                      if(m_pContext->m_pEvtObserver != NULL)\
-                                      {\
-                                        m_pContext->m_pEvtObserver->evtFunc(true);\
-                                      }\
-                                    }\
-
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStateInit::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStateInit::HandleRespStatus(const CMsgRespStatus& msg)
 {
-  CMsgRespStatus msg;
-
-  msg.Parse(resp, size);
-
   try
   {
 
     m_pContext->m_Status = msg.m_Status;
-    if(CStatePollStatus::HandleRespStatus(resp, size)) { return true; }
+    if(CStatePollStatus::HandleRespStatus(msg)) { return true; }
+
+    if(msg.m_Status.Test(CStatus::FLAG_POWER_UP_RESET))
+    {
+      m_pContext->m_DefCache.Invalidate();
+    }
+    m_pContext->m_DefCache.SetVersion(msg.m_szSoftwareVer);
 
-    if(msg.m_Status.m_bCmdErr)
+    if(msg.m_Status.Test(CStatus::FLAG_CMD_ERR))
     {
+      m_pContext->m_Port.m_Stats.AddCmdErr();
       m_pStateMach->Transit(STATE_DISCONNECTED);
     }
     else
     {
       //*********************************
       // ANNOUNCE ERRORS TO OBSERVER.
-      if(m_pContext->m_Status.ExtPowerLost())
-      {
-        if(m_pContext->m_pEvtObserver != NULL)
-        {
-          m_pContext->m_pEvtObserver->OnExtPowerLost();
-        }
-      }
-
-      CHECK_EVT(FirmwareErr, OnFirmwareErr);
-      CHECK_EVT(NVMErr, OnNVMErr);
-      CHECK_EVT(PrintHeadErr, OnPrintHeadErr);
-      CHECK_EVT(TemperatureErr, OnTemperatureErr);
-      CHECK_EVT(GeneralErr, OnGeneralErr);
-      CHECK_EVT(PrintHeadOpened, OnPrintHead);
-      CHECK_EVT(PaperJam, OnPaperJam);
-      CHECK_EVT(PaperEmpty, OnPaperEmpty);
-
-      if(!m_pContext->m_Status.TopOfForm())
-      {
-        if(m_pContext->m_pEvtObserver != NULL)
-        {
-          m_pContext->m_pEvtObserver->OnTopOfForm(true);
-        }
-      }
-
-      CHECK_EVT(ChassisOpened, OnChassis);
-      CHECK_EVT(PaperLow, OnPaperLow);
+      // every condition present is announced, as is paper not at top of form.
+      m_pContext->ResetEvtMask();
+      m_pContext->NotifyStatus(m_pContext->m_Status.GetEvtMask());
       // END OF ERROR ANNOUNCEMENTS.
       //********************************   
 
       if(m_pContext->m_pEvtObserver != NULL)
       {
-        m_pContext->m_pEvtObserver->OnReady();
+        m_pContext->m_Events.Post(EVT_READY);
       } // if...
       m_pStateMach->Transit(STATE_READY);
     } // if...else...
@@ -140,8 +110,7 @@ bool CStateInit::HandleRespStatus(BYTE* resp, DWORD size)
   }
   catch(CCommException& e)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateInit::HandleRespStatus] CCommException caught, Port:%i, message:%s, error code:%u.\n",
-      e.GetPort(), e.GetMsg(), e.GetSysErrCode());
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
     m_pStateMach->Transit(STATE_DISCONNECTED);
   } // try...catch...
 
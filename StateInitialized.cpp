@@ -20,22 +20,18 @@ void CStateInitialized::UnInit()
 }
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStateInitialized::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStateInitialized::HandleRespStatus(const CMsgRespStatus& msg)
 {
-  CMsgRespStatus msg;
   CMsgClearErr msgClearErr;
   BYTE buffer[512]; // should be large enough for clear error status command.
   DWORD len;
 
-  msg.Parse(resp, size);
-
   try
   {
-    m_pContext->UpdateSoftwareVer(msg.m_strSoftwareVer);
+    m_pContext->UpdateSoftwareVer(msg.m_szSoftwareVer);
 
     //********************************************************
     // RESET ERRORS TO INDICATE THAT THEY HAD BEEN PROCESSED.
@@ -50,8 +46,7 @@ bool CStateInitialized::HandleRespStatus(BYTE* resp, DWORD size)
   }
   catch(CCommException& e)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateInit::HandleRespStatus] CCommException caught, Port:%i, message:%s, error code:%u.\n",
-      e.GetPort(), e.GetMsg(), e.GetSysErrCode());
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
     m_pStateMach->Transit(STATE_DISCONNECTED);
 
     return true;
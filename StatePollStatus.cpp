@@ -9,10 +9,18 @@
 /// or <paramref name="pContext"/> is NULL.</exception>
 CStatePollStatus::CStatePollStatus(IStateMach* pStateMach,
                                    CPrinterContext* pContext, CState* pParent) :
-  CStateInitialized(pStateMach, pContext, pParent)
+  CStateInitialized(pStateMach, pContext, pParent),
+  m_bPolled(false),
+  m_dwSincePoll(0),
+  m_dwSinceAlive(0),
+  m_bRxHandled(false),
+  m_dwPollInterval(POLL_INTERVAL),
+  m_dwAliveTimeout(ALIVE_TIMEOUT),
+  m_nPollPending(0),
+  m_bPollAfterTx(false)
 {
-  m_AliveTimer.SetExpiry(2000);
-  m_PollStatusTimer.SetExpiry(300);
+  m_AliveTimer.SetExpiry(m_dwAliveTimeout);
+  m_PollStatusTimer.SetExpiry(m_dwPollInterval);
 }
 
 /// <summary>Handles state entered event.</summary>
@@ -22,9 +30,19 @@ void CStatePollStatus::OnEnter(bool isTarget)
 {
   CState::OnEnter(isTarget);
 
+  m_dwPollInterval = GetPollInterval();
+  m_dwAliveTimeout = m_pContext->m_dwAliveTimeout;
+  m_AliveTimer.SetExpiry(m_dwAliveTimeout);
+  m_PollStatusTimer.SetExpiry(m_dwPollInterval);
+
   m_AliveTimer.Reset();
   m_PollStatusTimer.Reset();
   m_bPolled = false;
+  m_dwSincePoll = 0;
+  m_dwSinceAlive = 0;
+  m_bRxHandled = false;
+  m_nPollPending = 0;
+  m_bPollAfterTx = false;
 }
 
 /// <summary>State execution.<summary>
@@ -33,20 +51,30 @@ void CStatePollStatus::Run(DWORD elapsed)
 {
   DWORD len;
   BYTE buffer[512]; // 512 bytes should be large enough for all printer response.
-  CMsgStatus msg;
 
   m_AliveTimer.Elapsed(elapsed);
   m_PollStatusTimer.Elapsed(elapsed);
+  m_dwSincePoll += elapsed;
+  m_dwSinceAlive += elapsed;
+  m_bRxHandled = false;
+
+  if(m_pContext->m_Port.IsTxPending() || m_bPollAfterTx)
+  {
+    RunTx();
+    return;
+  }
 
   try
   {
-    m_pContext->m_Port.Poll();
     len = m_pContext->m_Port.GetMsg(buffer, 512);
 
     if((len > 0) && (len < 512))
     {
       m_PollStatusTimer.Reset();
       m_AliveTimer.Reset();
+      m_dwSincePoll = 0;
+      m_dwSinceAlive = 0;
+      m_bRxHandled = true;
 
       /*{
           m_pContext->Trace(L"[printdrv_fl_psa66st2r] RECV ");
@@ -56,30 +84,154 @@ void CStatePollStatus::Run(DWORD elapsed)
           }
           m_pContext->Trace(L"\n");
       }*/
+      if((m_nPollPending > 0) && (buffer[1] == CMsgMgr::CMD_STATUS)) { m_nPollPending--; }
       HandleResp(buffer, len);
     }
     else if(m_AliveTimer.IsExpired())
     {
-      m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStatePollStatus::Run] disconnected due to alive timer expired.\n");
+      m_pContext->Trace(TRACE_ALIVE_EXPIRED);
       m_pStateMach->Transit(STATE_DISCONNECTED);
     }
     else if(m_PollStatusTimer.IsExpired())
     {
-      m_PollStatusTimer.Reset();
-      len = msg.Build(buffer, 512);
-      m_pContext->m_Port.Write(buffer, len);
-      m_bPolled = true;
+      // nothing received for a whole interval, polls not answered by now
+      // never will be.
+      if(m_nPollPending > 0) { OnPollsLost(); }
+      PollNow();
     } // if...else...
   }
   catch(CCommException& e)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStatePollStatus::Run] CCommException caught, Port:%i, message:%s, error code:%u.\n",
-        e.GetPort(), e.GetMsg(), e.GetSysErrCode());
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
     m_pStateMach->Transit(STATE_DISCONNECTED);
   }
   catch(...)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStatePollStatus::Run] unexpected exception caught.\n");
+    m_pContext->Trace(TRACE_UNEXPECTED);
     throw;
   } // try...catch...
 }
+
+/// <summary>Retrieves time until state needs to run again.</summary>
+/// <returns>Time until status poll or alive timer is due, in milliseconds.
+/// Zero if a response was just handled, as more may already be buffered, or
+/// if a command is being streamed.</returns>
+DWORD CStatePollStatus::GetIdleTime()
+{
+  DWORD dwPoll, dwAlive;
+
+  if(m_bRxHandled) { return 0; }
+  if(m_pContext->m_Port.IsTxPending() || m_bPollAfterTx) { return 0; }
+
+  dwPoll = (m_dwSincePoll < m_dwPollInterval) ? (m_dwPollInterval - m_dwSincePoll) : 0;
+  dwAlive = (m_dwSinceAlive < m_dwAliveTimeout) ? (m_dwAliveTimeout - m_dwSinceAlive) : 0;
+
+  return __min(dwPoll, dwAlive);
+}
+
+/// <summary>Sends status poll now, instead of waiting for poll timer.</summary>
+/// <exception cref="CCommException">If failed to send.</exception>
+/// <remarks>While a command is being streamed, poll is sent right after it
+/// instead.</remarks>
+void CStatePollStatus::PollNow()
+{
+  DWORD len;
+  BYTE buffer[16];
+  CMsgStatus msg;
+
+  m_PollStatusTimer.Reset();
+  m_dwSincePoll = 0;
+  if(m_pContext->m_Port.IsTxPending()) { m_bPollAfterTx = true; }
+  else
+  {
+    len = msg.Build(buffer, sizeof(buffer));
+    m_pContext->m_Port.Write(buffer, len);
+  }
+  m_bPolled = true;
+  m_nPollPending++;
+}
+
+/// <summary>Streams next chunk of command in progress, then sends held back
+/// status poll once it is complete.</summary>
+/// <remarks>Printer is busy receiving, so it is neither polled nor expected
+/// to answer meanwhile.</remarks>
+void CStatePollStatus::RunTx()
+{
+  DWORD len, sent, total;
+  BYTE buffer[16];
+  CMsgStatus msg;
+  bool upload;
+
+  m_AliveTimer.Reset();
+  m_PollStatusTimer.Reset();
+  m_dwSinceAlive = 0;
+  m_dwSincePoll = 0;
+
+  try
+  {
+    if(m_pContext->m_Port.IsTxPending())
+    {
+      upload = m_pContext->m_Port.IsTxCancellable();
+      if(!m_pContext->m_Port.PumpTx())
+      {
+        m_pContext->m_Port.GetTxProgress(sent, total);
+        m_pContext->Trace(TRACE_TX_CANCELLED, sent, total);
+        if(m_bPollAfterTx)
+        {
+          m_bPollAfterTx = false;
+          m_nPollPending--;
+        }
+        OnTxCancelled();
+        return;
+      }
+
+      m_pContext->m_Port.GetTxProgress(sent, total);
+      m_pContext->Trace(TRACE_TX_PROGRESS, sent, total);
+      if(upload && (m_pContext->m_pStatusObserver != NULL))
+      {
+        m_pContext->m_Events.Post(EVT_UPLOAD_PROGRESS, sent, total);
+      }
+    } // if...
+
+    if(!m_pContext->m_Port.IsTxPending() && m_bPollAfterTx)
+    {
+      m_bPollAfterTx = false;
+      len = msg.Build(buffer, sizeof(buffer));
+      m_pContext->m_Port.Write(buffer, len);
+    }
+  }
+  catch(CCommException& e)
+  {
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
+    m_pStateMach->Transit(STATE_DISCONNECTED);
+  } // try...catch...
+}
+
+/// <summary>Handles cancellation of command being streamed.</summary>
+/// <remarks>Printer is left with a truncated command, so by default it is
+/// re-synchronized through disconnected state. Only graphic uploads may be
+/// cancelled, states streaming one report its failure first.</remarks>
+void CStatePollStatus::OnTxCancelled()
+{
+  m_pStateMach->Transit(STATE_DISCONNECTED);
+}
+
+/// <summary>Handles status polls left unanswered for a whole polling interval.
+/// </summary>
+/// <remarks>Printer answers a poll well within the interval, so the polls are
+/// taken as lost, e.g. to a corrupted response, and no longer counted as
+/// pending.</remarks>
+void CStatePollStatus::OnPollsLost()
+{
+  m_nPollPending = 0;
+}
+
+/// <summary>Retrieves status polling interval to be used in this state.</summary>
+/// <returns>Polling interval, in milliseconds.</returns>
+/// <remarks>By default states poll at the busy interval, so completion of
+/// a command in progress is noticed early. States without a command in
+/// progress override this to back off.</remarks>
+DWORD CStatePollStatus::GetPollInterval()
+{
+  return m_pContext->m_dwPollBusy;
+}
@@ -10,7 +10,10 @@
 CStatePrinting::CStatePrinting(IStateMach* pStateMach, CPrinterContext* pContext,
                                CState* pParent) :
   CStatePollStatus(pStateMach, pContext, pParent),
-  m_bSuspendPending(false)
+  m_bSuspendPending(false),
+  m_bJobPending(false),
+  m_bBusySeen(false),
+  m_nNotBusyCnt(0)
 {
 }
 
@@ -27,20 +30,42 @@ void CStatePrinting::OnEnter(bool isTarget)
 {
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStatePrinting::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
   CStatePollStatus::OnEnter(isTarget);
 
   m_bSuspendPending = false;
+  m_bBusySeen = false;
+  m_nNotBusyCnt = 0;
   if(isTarget)
   {
+    // entered as target only once a job is sent.
+    m_bJobPending = true;
     if(m_pContext->m_pEvtObserver != NULL)
     {
-      m_pContext->m_pEvtObserver->OnPrinting();
+      m_pContext->m_Events.Post(EVT_PRINTING);
     }
   } // if...
 }
 
+/// <summary>Handles state exited event.</summary>
+/// <remarks>A job left without being reported is reported interrupted.
+/// </remarks>
+void CStatePrinting::OnLeave()
+{
+  if(m_bJobPending)
+  {
+    m_bJobPending = false;
+    m_pContext->Trace(TRACE_JOB_FAILED, m_pContext->m_dwPrintJobID);
+    if(m_pContext->m_pEvtObserver != NULL)
+    {
+      m_pContext->m_Events.Post(EVT_PRINT_FAILED, PRINT_ERR_INTERRUPTED);
+    }
+  } // if...
+
+  CStatePollStatus::OnLeave();
+}
+
 /// <summary>Suspends the printer.</summary>
 /// <remarks>If invoked before initialization, printer will enter suspend mode
 /// immediately after initialization (which is also the default behaviour),
@@ -52,7 +77,7 @@ void CStatePrinting::Suspend()
   m_bSuspendPending = true;
   if(m_pContext->m_pEvtObserver != NULL)
   {
-    m_pContext->m_pEvtObserver->OnSuspended();
+    m_pContext->m_Events.Post(EVT_SUSPENDED);
   }
 }
 
@@ -67,79 +92,89 @@ void CStatePrinting::Resume()
     m_bSuspendPending = false;
     if(m_pContext->m_pEvtObserver != NULL)
     {
-      m_pContext->m_pEvtObserver->OnResumed();
+      m_pContext->m_Events.Post(EVT_RESUMED);
     }
   } // if...
 }
 
-#define CHECK_ERR(errFunc, evtFunc) if(msg.m_Status.errFunc())\
-                                    {\
-                                      if(m_pContext->m_pEvtObserver != NULL)\
-                                      {\
-                                        m_pContext->m_pEvtObserver->evtFunc(true);\
-                                      }\
-                                      target = STATE_SUSPENDED;\
-                                    }
-
-#define CHECK_EVT(errFunc, evtFunc) if(msg.m_Status.errFunc() &&\
-                                      !m_pContext->m_Status.errFunc())\
-                                    {\
-                                      if(m_pContext->m_pEvtObserver != NULL)\
-                                      {\
-                                        m_pContext->m_pEvtObserver->evtFunc(true);\
-                                      }\
-                                    }\
-                                    else if(!msg.m_Status.errFunc() &&\
-                                      m_pContext->m_Status.errFunc())\
-                                    {\
-                                      if(m_pContext->m_pEvtObserver != NULL)\
-                                      {\
-                                        m_pContext->m_pEvtObserver->evtFunc(false);\
-                                      }\
-                                    }
+/// <summary>Queues a job to be printed after current print job.</summary>
+/// <param name="job">Print job.</param>
+/// <param name="id">Identifier of <paramref name="job"/>.</param>
+/// <remarks>Job is reported discarded if suspend is pending or the queue is
+/// full.</remarks>
+void CStatePrinting::PrintJob(const print::CJob& job, DWORD id)
+{
+  if(m_bSuspendPending)
+  {
+    m_pContext->Trace(TRACE_JOB_IGNORED, 1);
+    m_pContext->FailPrintJob(id);
+    return;
+  }
+
+  if(m_pContext->m_PrintQueue.Push(job, id))
+  {
+    m_pContext->Trace(TRACE_JOB_QUEUED, id);
+  }
+  else
+  {
+    m_pContext->Trace(TRACE_JOB_IGNORED, 0);
+    m_pContext->FailPrintJob(id);
+  }
+}
+
+/// <summary>Sends next queued job, if any.</summary>
+/// <returns>True if a job was sent and state re-entered, false if queue is
+/// empty.</returns>
+/// <exception cref="CCommException">If failed to send.</exception>
+bool CStatePrinting::PrintNext()
+{
+  print::CJob job;
+  DWORD id;
+
+  if(!m_pContext->m_PrintQueue.Pop(job, id)) { return false; }
+
+  try
+  {
+    m_pContext->SendPrintJob(job, id);
+  }
+  catch(CCommException&)
+  {
+    m_pContext->FailPrintJob(id);
+    throw;
+  } // try...catch...
+  // re-enter to restart polling for the new job.
+  m_pStateMach->Transit(STATE_PRINTING);
+  return true;
+}
+
+/// <summary>Conditions failing the printing, along with paper not at top of
+/// form.</summary>
+static const DWORD PRINT_FAIL_EVT = STATUS_EXT_POWER_LOST | STATUS_FIRMWARE_ERR |
+  STATUS_NVM_ERR | STATUS_PRINT_HEAD_ERR | STATUS_TEMPERATURE_ERR |
+  STATUS_GENERAL_ERR | STATUS_PRINT_HEAD_OPENED | STATUS_PAPER_JAM;
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStatePrinting::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStatePrinting::HandleRespStatus(const CMsgRespStatus& msg)
 {
   int target = STATE_PRINTING;
-  CMsgRespStatus msg;
-
-  msg.Parse(resp, size);
+  DWORD newMask;
 
   try
   {
 
-    if(CStatePollStatus::HandleRespStatus(resp, size)) { return true; }
+    if(CStatePollStatus::HandleRespStatus(msg)) { return true; }
+
+    // every changed condition is notified at once, failing or not.
+    newMask = msg.m_Status.GetEvtMask();
+    m_pContext->NotifyStatus(newMask);
 
     //**********************************************************
     // THESE ERRORS WILL FAILED THE PRINTING AND GO TO SUSPEND.
-    if(msg.m_Status.ExtPowerLost())
-    {
-      if(m_pContext->m_pEvtObserver != NULL)
-      {
-        m_pContext->m_pEvtObserver->OnExtPowerLost();
-      }
-      target = STATE_SUSPENDED;
-    } // if...
-
-    CHECK_ERR(FirmwareErr, OnFirmwareErr);
-    CHECK_ERR(NVMErr, OnNVMErr);
-    CHECK_ERR(PrintHeadErr, OnPrintHeadErr);
-    CHECK_ERR(TemperatureErr, OnTemperatureErr);
-    CHECK_ERR(GeneralErr, OnGeneralErr);
-    CHECK_ERR(PrintHeadOpened, OnPrintHead);
-    CHECK_ERR(PaperJam, OnPaperJam);
-
-    if(!msg.m_Status.TopOfForm())
+    if(((newMask & PRINT_FAIL_EVT) != 0) || !msg.m_Status.TopOfForm())
     {
-      if(m_pContext->m_pEvtObserver != NULL)
-      {
-        m_pContext->m_pEvtObserver->OnTopOfForm(true);
-      }
       target = STATE_SUSPENDED;
     } // if...
 
@@ -153,24 +188,18 @@ bool CStatePrinting::HandleRespStatus(BYTE* resp, DWORD size)
     // END OF PRINTING FAILING ERRORS
     //**********************************
 
-    //********************************************
-    // THESE ERRORS WILL NOT AFFECT PRINTING.
-    CHECK_EVT(ChassisOpened, OnChassis);
-    CHECK_EVT(PaperLow, OnPaperLow);
-    CHECK_EVT(PaperEmpty, OnPaperEmpty);
-    // END OF PRINTING SAFE ERRORS.
-    //*********************************
-
     //*****************************************************
     // RETRY IF PRINTER COMPLAIN ABOUT COMMAND SYNTAX.
-    if(m_bPolled && msg.m_Status.m_bCmdErr)
+    if(m_bPolled && msg.m_Status.Test(CStatus::FLAG_CMD_ERR))
     {
       m_pContext->m_Status = msg.m_Status;
+      m_pContext->m_Port.m_Stats.AddCmdErr();
       if(m_nResendCnt < MAX_RESEND_CNT)
       {
         m_nResendCnt++;
-        m_pContext->m_Port.Write(m_pContext->m_pbyLastCmd,
-          m_pContext->m_dwLastCmdSize);
+        m_pContext->m_Port.m_Stats.AddResend();
+        m_pContext->m_Port.Send(m_pContext->m_LastCmd.GetData(),
+          m_pContext->m_LastCmd.GetSize());
         m_bPolled = false;
       }
       else
@@ -185,21 +214,23 @@ bool CStatePrinting::HandleRespStatus(BYTE* resp, DWORD size)
 
     //**********************
     // PRINTING FAILED.
-    if(msg.m_Status.m_bRegionDataErr)
+    if(msg.m_Status.Test(CStatus::FLAG_REGION_DATA_ERR))
     {
+      m_bJobPending = false;
+      m_pContext->Trace(TRACE_JOB_FAILED, m_pContext->m_dwPrintJobID);
       if(m_pContext->m_pEvtObserver != NULL)
       {
-        m_pContext->m_pEvtObserver->OnPrintFailed(
+        m_pContext->m_Events.Post(EVT_PRINT_FAILED,
           print::IPrintObserver::PRINT_ERR_DATATYPE_MISMATCH);
       }
 
-      m_pContext->UpdateSoftwareVer(msg.m_strSoftwareVer);
+      m_pContext->UpdateSoftwareVer(msg.m_szSoftwareVer);
       m_pContext->m_Status = msg.m_Status;
       if(m_bSuspendPending || msg.m_Status.ShouldSuspend())
       {
         m_pStateMach->Transit(STATE_SUSPENDED);
       }
-      else
+      else if(!PrintNext())
       {
         m_pStateMach->Transit(STATE_IDLE);
       } // if...else...
@@ -211,13 +242,25 @@ bool CStatePrinting::HandleRespStatus(BYTE* resp, DWORD size)
     //*****************************
     // PRINTING COMPLETED.
     // busy flag must be set at least once to indicate that following responses
-    // came after printer received the printing command.
-    if(m_bPolled && !msg.m_Status.m_bBusy)
+    // came after printer received the printing command. A job printed before
+    // busy could be seen is taken as completed once not busy for as long as
+    // the idle poll interval, the time it was given before polling got faster.
+    if(m_bPolled)
+    {
+      if(msg.m_Status.Test(CStatus::FLAG_BUSY)) { m_bBusySeen = true; }
+      else if(!m_bBusySeen) { m_nNotBusyCnt++; }
+    } // if...
+    if(m_bPolled && !msg.m_Status.Test(CStatus::FLAG_BUSY) && (m_bBusySeen ||
+      ((DWORD)m_nNotBusyCnt * m_dwPollInterval >= m_pContext->m_dwPollIdle)))
     {
       // printing completed.
+      m_bJobPending = false;
+      m_pContext->Trace(TRACE_JOB_COMPLETED, m_pContext->m_dwPrintJobID);
+      m_pContext->m_Port.m_Stats.AddLatency(LATENCY_PRINT,
+        m_pContext->m_Port.GetRxTime());
       if(m_pContext->m_pEvtObserver != NULL)
       {
-        m_pContext->m_pEvtObserver->OnPrintCompleted();
+        m_pContext->m_Events.Post(EVT_PRINT_COMPLETED);
       }
 
       if(m_bSuspendPending || msg.m_Status.ShouldSuspend())
@@ -232,6 +275,8 @@ bool CStatePrinting::HandleRespStatus(BYTE* resp, DWORD size)
     } // if...
 
     m_pContext->m_Status = msg.m_Status;
+    // send next queued job straight away instead of going idle.
+    if((target == STATE_IDLE) && PrintNext()) { return true; }
     if(target != STATE_PRINTING) { m_pStateMach->Transit(target); }
     // END OF PRINTING COMPLETED.
     //*****************************
@@ -239,8 +284,7 @@ bool CStatePrinting::HandleRespStatus(BYTE* resp, DWORD size)
   }
   catch(CCommException& e)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStatePrinting::HandleRespStatus] CCommException caught, Port:%i, message:%s, error code:%u.\n",
-      e.GetPort(), e.GetMsg(), e.GetSysErrCode());
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
     m_pStateMach->Transit(STATE_DISCONNECTED);
   } // try...catch...
 
@@ -26,6 +26,7 @@ CStateReady::CStateReady(IStateMach* pStateMach, CPrinterContext* pContext,
   CREATE_CHILD_STATE(CStateDefineRegion);
   CREATE_CHILD_STATE(CStateDefineTempl);
   CREATE_CHILD_STATE(CStatePrinting);
+  CREATE_CHILD_STATE(CStateDefineBatch);
 }
 
 /// <summary>Rerieves ID of this state.</summary>
@@ -41,7 +42,7 @@ void CStateReady::OnEnter(bool isTarget)
 {
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateReady::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
 
   if(isTarget)
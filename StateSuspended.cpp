@@ -26,8 +26,12 @@ void CStateSuspended::OnEnter(bool isTarget)
 {
   if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateSuspended::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
+
+  // queued jobs are not carried over an error or a suspend.
+  m_pContext->DiscardPrintJobs();
+  m_pContext->m_DefCache.Flush();
   CStatePollStatus::OnEnter(isTarget);
 }
 
@@ -41,7 +45,7 @@ void CStateSuspended::Suspend()
 {
   if(m_pContext->m_pEvtObserver != NULL)
   {
-    m_pContext->m_pEvtObserver->OnSuspended();
+    m_pContext->m_Events.Post(EVT_SUSPENDED);
   } // if...
 }
 
@@ -55,14 +59,14 @@ void CStateSuspended::Resume()
   {
     if(m_pContext->m_pEvtObserver != NULL)
     {
-      m_pContext->m_pEvtObserver->OnSuspended();
+      m_pContext->m_Events.Post(EVT_SUSPENDED);
     }
   }
   else
   {
     if(m_pContext->m_pEvtObserver != NULL)
     {
-      m_pContext->m_pEvtObserver->OnResumed();
+      m_pContext->m_Events.Post(EVT_RESUMED);
     }
     m_pStateMach->Transit(STATE_IDLE);
   } // if...else...
@@ -87,6 +91,9 @@ void CStateSuspended::SelfTest(bool clearNVM)
 
   msg.m_pJob = &job;
 
+  // definitions cannot be assumed to survive an NVM clear.
+  if(clearNVM) { m_pContext->m_DefCache.Invalidate(); }
+
   try
   {
     m_pContext->SendNUpdateLastCmd(msg);
@@ -147,29 +154,30 @@ void CStateSuspended::CalculateCRC(DWORD seed)
 }
 
 /// <summary>Handles printer status response.</summary>
-/// <param name="resp">Printer status response.</param>
-/// <param name="size">Size of <paramref name="resp"/>, in number of bytes.</param>
+/// <param name="msg">Decoded printer status response.</param>
 /// <returns>True if the response was consumed (thus should not be used for
 /// further process anymore), false otherwise.</returns>
-bool CStateSuspended::HandleRespStatus(BYTE* resp, DWORD size)
+bool CStateSuspended::HandleRespStatus(const CMsgRespStatus& msg)
 {
-  CMsgRespStatus msg;
-
-  msg.Parse(resp, size);
-
   try
   {
 
-    if(CStatePollStatus::HandleRespStatus(resp, size)) { return true; }
+    if(CStatePollStatus::HandleRespStatus(msg)) { return true; }
     m_pContext->UpdateStatusNNotifyObserver(msg.m_Status);
 
   }
   catch(CCommException& e)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateSuspended::HandleRespStatus] CCommException caught, Port:%i, message:%s, error code:%u.\n",
-      e.GetPort(), e.GetMsg(), e.GetSysErrCode());
+    m_pContext->Trace(TRACE_COMM_ERR, e.GetPort(), e.GetSysErrCode());
     m_pStateMach->Transit(STATE_DISCONNECTED);
   } // try...catch...
 
   return true;
 }
+
+/// <summary>Retrieves status polling interval to be used in this state.</summary>
+/// <returns>Idle polling interval, in milliseconds.</returns>
+DWORD CStateSuspended::GetPollInterval()
+{
+  return m_pContext->m_dwPollIdle;
+}
@@ -35,9 +35,9 @@ int CStateTop::GetID()
 /// false otherwise.</param>
 void CStateTop::OnEnter(bool isTarget)
 {
-  if(isTarget && m_pContext->m_bDebug)
+  if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateTop::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
 
   m_nResendCnt = 0;
@@ -24,24 +24,16 @@ int CStateUnInit::GetID()
 /// false otherwise.</param>
 void CStateUnInit::OnEnter(bool isTarget)
 {
-  if(isTarget && m_pContext->m_bDebug)
+  if(isTarget)
   {
-    m_pContext->Trace(L"[printdrv_fl_psa66st2r][CStateUnInit::OnEnter]\n");
+    m_pContext->Trace(TRACE_STATE_ENTER, GetID());
   }
 
   m_nResendCnt = 0;
+  m_pContext->DiscardPrintJobs();
+  m_pContext->m_DefCache.Flush();
 
-  m_pContext->SetStopThread(true);
-  if(m_pContext->m_hThread != NULL)
-  {
-    ::WaitForSingleObject(m_pContext->m_hThread, INFINITE);
-    if(!::CloseHandle(m_pContext->m_hThread))
-    {
-      CLog::Log(L"[printdrv_fl_psa66st2r][CStateUnInit::OnEnter] failed to ::WaitForSingleObject():%u\n",
-        GetLastError());
-    }
-    m_pContext->m_hThread = NULL;
-  } // if...
+  CReactor::GetInstance().Unregister(&m_ThreadParam);
 
   m_pContext->m_Port.Close();
 }
@@ -65,18 +57,14 @@ void CStateUnInit::Init(const wchar_t* param, print::IEvtObserver* evtObserver)
     throw print::CException(strTmp, WCL_WFUNCSIG);
   }
 
-  m_pContext->SetStopThread(false);
-
   m_ThreadParam.m_pContext = m_pContext;
   m_ThreadParam.m_pStateMach = m_pStateMach;
 
-  m_pContext->m_hThread = ::CreateThread(NULL, 0, CPrinterContext::_Run,
-    &m_ThreadParam, 0, NULL);
-  if(m_pContext->m_hThread == NULL)
+  if(!CReactor::GetInstance().Register(&m_ThreadParam))
   {
     m_pContext->m_Port.Close();
 
-    WCL_THROW_SYSTEMEXCEPTION(GetLastError(), L"failed to CreateThread");
+    throw print::CException(L"failed to register on reactor", WCL_WFUNCSIG);
   } // if...
 
   m_pStateMach->Transit(STATE_INIT);
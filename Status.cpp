@@ -1,47 +1,28 @@
 #include "stdafx.h"
 #include "message.h"
+#include "printdrv_fl_psa66st2r.h"
 
 /// <summary>Constructor.</summary>
 CStatus::CStatus() :
-  m_bBusy(false),
-  m_bError(false),
-  m_bPrintHeadOpen(false),
-  m_bPaperOut(false),
-  m_bPrintHeadErr(false),
-  m_bVoltageErr(false),
-  m_bTemperatureErr(false),
-  m_bLibRefErr(false),
-  m_bRegionDataErr(false),
-  m_bLoadLibErr(false),
-  m_bBufferOverflow(false),
-  m_bJobMemOverflow(false),
-  m_bCmdErr(false),
-  m_bNoFont(false),
-  m_bPaperInChute(false),
-  m_bFlashErr(false),
-  m_bOffLine(false),
-  m_bWrongPaper(false),
-  m_bJournalMode(false),
-  m_bCutterErr(false),
-  m_bPaperJam(false),
-  m_bPaperLow(false),
-  m_bLastBarPrinted(false),
-  m_bTopOfForm(true),
-  m_bReadyToRx(false),
-  m_bDoorOpened(false),
-  m_bPowerUpReset(false)
+  m_dwFlags(FLAG_TOP_OF_FORM)
 {
 }
 
-/// <summary>Checks for general error.</summary>
-/// <returns>True if general error, false otherwise.</returns>
-bool CStatus::GeneralErr() const
+/// <summary>Sets flags from status flag bytes of response message.</summary>
+/// <param name="flag1">Flag 1.</param>
+/// <param name="flag2">Flag 2.</param>
+/// <param name="flag3">Flag 3.</param>
+/// <param name="flag4">Flag 4.</param>
+/// <param name="flag5">Flag 5.</param>
+void CStatus::SetFlags(BYTE flag1, BYTE flag2, BYTE flag3, BYTE flag4,
+                       BYTE flag5)
 {
-  if(m_bNoFont) { return true; }
-  if(m_bOffLine) { return true; }
-  if(m_bJournalMode) { return true; }
+  m_dwFlags = (((DWORD)flag1 & 0x3F) | (((DWORD)flag2 & 0x3F) << 6) |
+    (((DWORD)flag3 & 0x3F) << 12) | (((DWORD)flag4 & 0x0F) << 18) |
+    (((DWORD)flag5 & 0x3F) << 22)) & FLAG_MASK;
 
-  return false;
+  // printer sets the bit when it is NOT ready.
+  m_dwFlags ^= FLAG_READY_TO_RX;
 }
 
 /// <summary>Checks if should go suspend.</summary>
@@ -66,53 +47,79 @@ bool CStatus::ShouldSuspend() const
 /// <returns>True if need to send clear error command, false otherwise.</returns>
 bool CStatus::NeedClearErr() const
 {
-  return (m_bLibRefErr || m_bRegionDataErr || m_bLoadLibErr ||
-    m_bBufferOverflow || m_bJobMemOverflow || m_bCmdErr ||
-    m_bLastBarPrinted || !m_bTopOfForm);
+  return Test(FLAG_CLEAR_ERR) || !Test(FLAG_TOP_OF_FORM);
+}
+
+/// <summary>Retrieves conditions reported to observers.</summary>
+/// <returns>Combination of <see cref="STATUS_EVT"/>, one bit for each
+/// condition currently present.</returns>
+DWORD CStatus::GetEvtMask() const
+{
+  DWORD mask = 0;
+
+  if(ExtPowerLost()) { mask |= STATUS_EXT_POWER_LOST; }
+  if(FirmwareErr()) { mask |= STATUS_FIRMWARE_ERR; }
+  if(NVMErr()) { mask |= STATUS_NVM_ERR; }
+  if(PrintHeadErr()) { mask |= STATUS_PRINT_HEAD_ERR; }
+  if(TemperatureErr()) { mask |= STATUS_TEMPERATURE_ERR; }
+  if(GeneralErr()) { mask |= STATUS_GENERAL_ERR; }
+  if(PrintHeadOpened()) { mask |= STATUS_PRINT_HEAD_OPENED; }
+  if(PaperJam()) { mask |= STATUS_PAPER_JAM; }
+  if(PaperEmpty()) { mask |= STATUS_PAPER_EMPTY; }
+  if(TopOfForm()) { mask |= STATUS_TOP_OF_FORM; }
+  if(ChassisOpened()) { mask |= STATUS_CHASSIS_OPENED; }
+  if(PaperLow()) { mask |= STATUS_PAPER_LOW; }
+
+  return mask;
 }
 
 /// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
 /// <param name="pElem">Pointer to XML DOM element.</param>
 void CStatus::Dump(MSXML2::IXMLDOMElement* pElem)
 {
+  static const struct { DWORD m_dwFlag; const wchar_t* m_szName; } names[] =
+  {
+    { FLAG_BUSY, L"Busy" },
+    { FLAG_ERROR, L"Error" },
+    { FLAG_PRINT_HEAD_OPEN, L"PrintHeadOpen" },
+    { FLAG_PAPER_OUT, L"PaperOut" },
+    { FLAG_PRINT_HEAD_ERR, L"PrintHeadErr" },
+    { FLAG_VOLTAGE_ERR, L"VoltageErr" },
+    { FLAG_TEMPERATURE_ERR, L"TemperatureErr" },
+    { FLAG_LIB_REF_ERR, L"LibRefErr" },
+    { FLAG_REGION_DATA_ERR, L"RegionDataErr" },
+    { FLAG_LOAD_LIB_ERR, L"LoadLibErr" },
+    { FLAG_BUFFER_OVERFLOW, L"BufferOverflow" },
+    { FLAG_JOB_MEM_OVERFLOW, L"JobMemOverflow" },
+    { FLAG_CMD_ERR, L"CmdErr" },
+    { FLAG_NO_FONT, L"NoFont" },
+    { FLAG_PAPER_IN_CHUTE, L"PaperInChute" },
+    { FLAG_FLASH_ERR, L"FlashErr" },
+    { FLAG_OFF_LINE, L"OffLine" },
+    { FLAG_WRONG_PAPER, L"WrongPaper" },
+    { FLAG_JOURNAL_MODE, L"JournalMode" },
+    { FLAG_CUTTER_ERR, L"CutterErr" },
+    { FLAG_PAPER_JAM, L"PaperJam" },
+    { FLAG_PAPER_LOW, L"PaperLow" },
+    { FLAG_LAST_BAR_PRINTED, L"LastBarPrinted" },
+    { FLAG_TOP_OF_FORM, L"TopOfForm" },
+    { FLAG_READY_TO_RX, L"ReadyToRx" },
+    { FLAG_DOOR_OPENED, L"DoorOpened" },
+    { FLAG_POWER_UP_RESET, L"PowerUpReset" }
+  };
+  int i;
+
   try
   {
 
     if(pElem != NULL)
     {
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bBusy", m_bBusy);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bError", m_bError);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bPrintHeadOpen",
-        m_bPrintHeadOpen);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bPaperOut", m_bPaperOut);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bPrintHeadErr", m_bPrintHeadErr);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bVoltageErr", m_bVoltageErr);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bTemperatureErr",
-        m_bTemperatureErr);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bLibRefErr", m_bLibRefErr);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bRegionDataErr",
-        m_bRegionDataErr);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bLoadLibErr", m_bLoadLibErr);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bBufferOverflow",
-        m_bBufferOverflow);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bJobMemOverflow",
-        m_bJobMemOverflow);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bCmdErr", m_bCmdErr);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bNoFont", m_bNoFont);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bPaperInChute", m_bPaperInChute);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bFlashErr", m_bFlashErr);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bOffLine", m_bOffLine);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bWrongPaper", m_bWrongPaper);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bJournalMode", m_bJournalMode);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bCutterErr", m_bCutterErr);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bPaperJam", m_bPaperJam);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bPaperLow", m_bPaperLow);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bLastBarPrinted",
-        m_bLastBarPrinted);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bTopOfForm", m_bTopOfForm);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bReadyToRx", m_bReadyToRx);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bDoorOpened", m_bDoorOpened);
-      wcl::CDumpHelper::DumpAttr<bool>(pElem, L"m_bPowerUpReset", m_bPowerUpReset);
+      wcl::CDumpHelper::DumpAttr<DWORD>(pElem, L"m_dwFlags", m_dwFlags);
+      for(i = 0;i < (int)(sizeof(names) / sizeof(names[0]));i++)
+      {
+        wcl::CDumpHelper::DumpAttr<bool>(pElem, names[i].m_szName,
+          Test(names[i].m_dwFlag));
+      } // for...
     } // if...
 
   }
@@ -0,0 +1,171 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+CTemplDefData::CTemplDefData()
+{
+  memset(m_apEntry, 0, sizeof(m_apEntry));
+}
+
+/// <summary>Destructor.</summary>
+CTemplDefData::~CTemplDefData()
+{
+  int i;
+
+  for(i = 0;i < 256;i++) { Remove((BYTE)i); }
+}
+
+/// <summary>Stores a template, replacing one with same ID.</summary>
+/// <param name="templateID">Driver template ID.</param>
+/// <param name="templ">Template.</param>
+/// <param name="regionDefData">Default data by driver region ID.</param>
+void CTemplDefData::Set(BYTE templateID, const print::CTemplate& templ,
+                        CWkMapInt<CWkString>& regionDefData)
+{
+  int i;
+  POS pos;
+  CMsgMgr msgMgr;
+  SEntry *pEntry;
+
+  Remove(templateID);
+
+  pEntry = new SEntry;
+  pEntry->m_nCount = templ.GetCount();
+  pEntry->m_nDefCnt = 0;
+  pEntry->m_abyRegion = new BYTE[__max(1, pEntry->m_nCount)];
+  pEntry->m_astrDef = new CWkString[__max(1, pEntry->m_nCount)];
+
+  pos = templ.GetHeadPos();
+  for(i = 0;(pos != NULL) && (i < pEntry->m_nCount);i++)
+  {
+    if(!msgMgr.TryRegionID2Drv(templ.GetNext(pos), pEntry->m_abyRegion[i]))
+    {
+      pEntry->m_abyRegion[i] = 0;
+    }
+    else if(regionDefData.Get(pEntry->m_abyRegion[i], pEntry->m_astrDef[i]) &&
+      (pEntry->m_astrDef[i].GetLength() > 0))
+    {
+      pEntry->m_nDefCnt++;
+    }
+  } // for...
+
+  m_apEntry[templateID] = pEntry;
+}
+
+/// <summary>Removes a stored template.</summary>
+/// <param name="templateID">Driver template ID, ignored if not stored.</param>
+void CTemplDefData::Remove(BYTE templateID)
+{
+  SEntry *pEntry = m_apEntry[templateID];
+
+  if(pEntry == NULL) { return; }
+
+  m_apEntry[templateID] = NULL;
+  delete [] pEntry->m_abyRegion;
+  delete [] pEntry->m_astrDef;
+  delete pEntry;
+}
+
+/// <summary>Updates default data of a region in every stored template.</summary>
+/// <param name="regionID">Driver region ID.</param>
+/// <param name="defData">New default data, NULL or empty if none.</param>
+void CTemplDefData::SetRegion(BYTE regionID, const wchar_t* defData)
+{
+  int i, j;
+  SEntry *pEntry;
+
+  if(defData == NULL) { defData = L""; }
+
+  for(i = 0;i < 256;i++)
+  {
+    pEntry = m_apEntry[i];
+    if(pEntry == NULL) { continue; }
+
+    for(j = 0;j < pEntry->m_nCount;j++)
+    {
+      if((pEntry->m_abyRegion[j] != regionID) || (regionID == 0)) { continue; }
+
+      if(pEntry->m_astrDef[j].GetLength() > 0) { pEntry->m_nDefCnt--; }
+      pEntry->m_astrDef[j] = defData;
+      if(pEntry->m_astrDef[j].GetLength() > 0) { pEntry->m_nDefCnt++; }
+    } // for...
+  } // for...
+}
+
+/// <summary>Checks if a print job has blank fields with default data.</summary>
+/// <param name="templateID">Driver template ID of <paramref name="job"/>.
+/// </param>
+/// <param name="job">Print job.</param>
+/// <returns>True if <see cref="Apply"/> would change <paramref name="job"/>,
+/// false otherwise.</returns>
+bool CTemplDefData::NeedApply(BYTE templateID, const print::CJob& job)
+{
+  int i;
+  POS pos;
+  const SEntry *pEntry = m_apEntry[templateID];
+
+  if((pEntry == NULL) || (pEntry->m_nDefCnt <= 0)) { return false; }
+
+  pos = job.GetHeadPos();
+  for(i = 0;(pos != NULL) && (i < pEntry->m_nCount);i++)
+  {
+    if( (job.GetNext(pos).m_strData.GetLength() <= 0) &&
+      (pEntry->m_astrDef[i].GetLength() > 0) )
+    {
+      return true;
+    }
+  } // for...
+
+  return false;
+}
+
+/// <summary>Fills blank fields of a print job with default data.</summary>
+/// <param name="templateID">Driver template ID of <paramref name="job"/>.
+/// </param>
+/// <param name="job">Print job, filled in place.</param>
+/// <remarks>Job is left untouched if template is not stored.</remarks>
+void CTemplDefData::Apply(BYTE templateID, print::CJob& job)
+{
+  int i;
+  POS pos;
+  const SEntry *pEntry = m_apEntry[templateID];
+
+  if((pEntry == NULL) || (pEntry->m_nDefCnt <= 0)) { return; }
+
+  pos = job.GetHeadPos();
+  for(i = 0;(pos != NULL) && (i < pEntry->m_nCount);i++)
+  {
+    print::CData& data = job.GetNext(pos);
+
+    if((data.m_strData.GetLength() <= 0) && (pEntry->m_astrDef[i].GetLength() > 0))
+    {
+      data.m_strData = pEntry->m_astrDef[i];
+    }
+  } // for...
+}
+
+/// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
+/// <param name="pElem">Pointer to XML DOM element.</param>
+void CTemplDefData::Dump(MSXML2::IXMLDOMElement* pElem)
+{
+  int i, cnt = 0, defCnt = 0;
+
+  try
+  {
+
+    if(pElem != NULL)
+    {
+      for(i = 0;i < 256;i++)
+      {
+        if(m_apEntry[i] == NULL) { continue; }
+        cnt++;
+        defCnt += m_apEntry[i]->m_nDefCnt;
+      } // for...
+
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"Count", cnt);
+      wcl::CDumpHelper::DumpAttr<int>(pElem, L"DefCnt", defCnt);
+    } // if...
+
+  }
+  catch(...) {}
+}
@@ -0,0 +1,133 @@
+#include "stdafx.h"
+#include "printer.h"
+
+/// <summary>Constructor.</summary>
+CTraceRing::CTraceRing() :
+  m_lNext(0),
+  m_nsState(-1)
+{
+  memset(m_aRec, 0, sizeof(m_aRec));
+}
+
+/// <summary>Sets current state ID, stamped on records added afterwards.</summary>
+/// <param name="state">State ID.</param>
+void CTraceRing::SetState(int state)
+{
+  m_nsState = (short)state;
+}
+
+/// <summary>Adds a record, overwriting oldest one if ring is full.</summary>
+/// <param name="evt">Event, one of <see cref="TRACE_EVT"/>.</param>
+/// <param name="arg0">First event argument.</param>
+/// <param name="arg1">Second event argument.</param>
+/// <param name="arg2">Third event argument.</param>
+/// <param name="arg3">Fourth event argument.</param>
+void CTraceRing::Add(WORD evt, DWORD arg0, DWORD arg1, DWORD arg2, DWORD arg3)
+{
+  LONG seq = ::InterlockedIncrement(&m_lNext);
+  STraceRec& rec = m_aRec[(seq - 1) & (TRACE_RING_SIZE - 1)];
+
+  // mark record as being written, so a dump skips it.
+  rec.m_lSeq = 0;
+  MemoryBarrier();
+
+  rec.m_wEvt = evt;
+  rec.m_nsState = m_nsState;
+  rec.m_ullTime = CPrinterPort::GetTime();
+  rec.m_adwArg[0] = arg0;
+  rec.m_adwArg[1] = arg1;
+  rec.m_adwArg[2] = arg2;
+  rec.m_adwArg[3] = arg3;
+
+  MemoryBarrier();
+  rec.m_lSeq = seq;
+}
+
+/// <summary>Packs bytes into a trace argument.</summary>
+/// <param name="data">Bytes to be packed.</param>
+/// <param name="size">Number of bytes in <paramref name="data"/>, only first 4
+/// are packed.</param>
+/// <returns>Bytes packed little-endian, missing bytes are 0.</returns>
+DWORD CTraceRing::Pack(const BYTE* data, int size)
+{
+  int i;
+  DWORD dwTmp = 0;
+
+  for(i = 0;(data != NULL) && (i < size) && (i < 4);i++)
+  {
+    dwTmp |= (DWORD)data[i] << (i * 8);
+  } // for...
+
+  return dwTmp;
+}
+
+/// <summary>Packs characters into a trace argument.</summary>
+/// <param name="str">Null-terminated string.</param>
+/// <param name="offset">Number of characters to skip before packing.</param>
+/// <returns>Up to 4 characters after the skipped ones, each truncated to a
+/// byte and packed little-endian, missing characters are 0.</returns>
+DWORD CTraceRing::Pack(const wchar_t* str, int offset)
+{
+  int i;
+  DWORD dwTmp = 0;
+
+  if(str == NULL) { return 0; }
+
+  for(i = 0;(i < offset) && (str[i] != L'\0');i++) {}
+  if(i < offset) { return 0; }
+
+  for(i = 0;(i < 4) && (str[offset + i] != L'\0');i++)
+  {
+    dwTmp |= (DWORD)(BYTE)str[offset + i] << (i * 8);
+  } // for...
+
+  return dwTmp;
+}
+
+/// <summary>Dumps records into XML DOM element for offline decoding.</summary>
+/// <param name="pElem">Pointer to XML DOM element.</param>
+/// <remarks>Each line of the element's text is one record, oldest first:
+/// sequence, time, state, event and 4 arguments, all in hexadecimal. Records
+/// being written during the dump are skipped.</remarks>
+void CTraceRing::Dump(MSXML2::IXMLDOMElement* pElem)
+{
+  LONG i, next, seq;
+  STraceRec rec;
+  CWkString strTmp, strText;
+
+  try
+  {
+
+    if(pElem != NULL)
+    {
+      next = m_lNext;
+      wcl::CDumpHelper::DumpAttr<LONG>(pElem, L"m_lNext", next);
+
+      i = (next > TRACE_RING_SIZE) ? (next - TRACE_RING_SIZE) : 0;
+      for(;i < next;i++)
+      {
+        const STraceRec& src = m_aRec[i & (TRACE_RING_SIZE - 1)];
+
+        seq = src.m_lSeq;
+        MemoryBarrier();
+        rec.m_wEvt = src.m_wEvt;
+        rec.m_nsState = src.m_nsState;
+        rec.m_ullTime = src.m_ullTime;
+        memcpy(rec.m_adwArg, src.m_adwArg, sizeof(rec.m_adwArg));
+        MemoryBarrier();
+
+        // skip records being written or already overwritten.
+        if((seq != i + 1) || (src.m_lSeq != seq)) { continue; }
+
+        strTmp.Format(L"%X %I64X %X %X %X %X %X %X\n", seq, rec.m_ullTime,
+          (WORD)rec.m_nsState, rec.m_wEvt, rec.m_adwArg[0], rec.m_adwArg[1],
+          rec.m_adwArg[2], rec.m_adwArg[3]);
+        strText += strTmp;
+      } // for...
+
+      if(!CXmlUtil::SetValue(pElem, (const wchar_t*)strText)) { throw false; }
+    } // if...
+
+  }
+  catch(...) {}
+}
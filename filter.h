@@ -2,13 +2,116 @@
 
 #include "printPrinter.h"
 
+#define JOB_FILTER_MAX_FIELDS 32
+#define JOB_FILTER_MAX_TEMPL  256
+#define JOB_FILTER_MAX_PROGRAM 32
+
+/// <summary>Layout entry of an output field which is inserted blank.</summary>
+#define JF_BLANK  (-1)
+
+/// <summary>Edits applied to an output field, in order of declaration.</summary>
+enum JOB_FIELD_OP
+{
+  /// <summary>Replace empty data with <see cref="SJobFieldEdit::m_pszDefault"/>.</summary>
+  JF_DEFAULT  = 0x01,
+  /// <summary>Rewrite never-expiring expiry, e.g. "9999 days".</summary>
+  JF_EXPIRY   = 0x02,
+  /// <summary>Prepend <see cref="SJobFieldEdit::m_pszPrefix"/>.</summary>
+  JF_PREFIX   = 0x04
+};
+
+/// <summary>Edit of an output field.</summary>
+struct SJobFieldEdit
+{
+  /// <value>Index of output field.</value>
+  int m_nField;
+
+  /// <value>Combination of <see cref="JOB_FIELD_OP"/>.</value>
+  DWORD m_dwOps;
+
+  /// <value>Data for <see cref="JF_DEFAULT"/>, NULL if not used.</value>
+  const wchar_t* m_pszDefault;
+
+  /// <value>Prefix for <see cref="JF_PREFIX"/>, NULL if not used.</value>
+  const wchar_t* m_pszPrefix;
+};
+
+/// <summary>Field mapping of a template.</summary>
+/// <remarks>Jobs of other field counts than <see cref="m_nInCnt"/> are sent as
+/// is.</remarks>
+struct SJobTemplMap
+{
+  /// <value>Template identifier.</value>
+  short m_nsTemplID;
+
+  /// <value>Number of fields of job submitted.</value>
+  int m_nInCnt;
+
+  /// <value>Number of fields of job sent to printer, not less than
+  /// <see cref="m_nInCnt"/>.</value>
+  int m_nOutCnt;
+
+  /// <value>Source field of each output field, or <see cref="JF_BLANK"/>. NULL
+  /// if output fields are the source fields in order, followed by blanks.</value>
+  const int* m_pLayout;
+
+  /// <value>Edits of output fields, NULL if none.</value>
+  const SJobFieldEdit* m_pEdit;
+
+  /// <value>Number of elements in <see cref="m_pEdit"/>.</value>
+  int m_nEditCnt;
+};
+
+/// <summary>Field mappings compiled into flat per-template index programs.</summary>
+/// <remarks>A program is applied to the job in place: blank fields are appended,
+/// then fields are moved to their output index from the last one backwards,
+/// which is safe as long as source fields keep their order. Other layouts go
+/// through a scratch copy of the source fields.</remarks>
+class CJobProgram
+{
+protected:
+  /// <summary>Compiled field mapping of a template.</summary>
+  struct SProgram
+  {
+    int m_nInCnt;
+    int m_nOutCnt;
+    bool m_bInPlace;
+    int m_nBlankCnt;
+    signed char m_acSrc[JOB_FILTER_MAX_FIELDS];
+    BYTE m_abyOps[JOB_FILTER_MAX_FIELDS];
+    const wchar_t* m_apszDefault[JOB_FILTER_MAX_FIELDS];
+    const wchar_t* m_apszPrefix[JOB_FILTER_MAX_FIELDS];
+  };
+
+  /// <value>Compiled programs.</value>
+  SProgram m_aProgram[JOB_FILTER_MAX_PROGRAM];
+
+  /// <value>Index into <see cref="m_aProgram"/> by template identifier, -1 if
+  /// template is not mapped.</value>
+  short m_anIndex[JOB_FILTER_MAX_TEMPL];
+
+  /// <value>Number of elements used in <see cref="m_aProgram"/>.</value>
+  int m_nCount;
+
+public:
+  CJobProgram();
+
+public:
+  void Compile(const SJobTemplMap* pMap, int count);
+  bool IsMapped(const print::CJob& job) const;
+  int GetBlankCnt(const print::CJob& job) const;
+  bool Apply(print::CJob& job) const;
+
+protected:
+  void Reorder(print::CJob& job, const SProgram& prog, POS* aPos) const;
+  static void TransformExpiry(print::CData& data);
+};
+
 /// <summary>Performs necessary transformation on the job before sending
 /// them to printer.</summary>
 class IJobFilter
 {
 public:
-	//static const wchar_t* const s_strNeverExpires;
-
     /// <summary>Destructor.</summary>
 	virtual ~IJobFilter() {}
 
@@ -17,87 +120,45 @@ public:
     /// <returns>True if transformation is needed, false otherwise.</returns>
 	virtual bool NeedTransform(const print::CJob& job) = 0;
 
-    /// <summary>Performs necessary transformation on the job.</summary>
+    /// <summary>Performs necessary transformation on the job, in place.</summary>
     /// <param name="job">Job to be transformed.</param>
-    /// <returns>Transformed job.</returns>
-    virtual print::CJob Transform(const print::CJob& job) = 0;
-};
-
-/// <summary>Job filter for firmware GUR126003.</summary>
-class CJobFilterGUR126003 : public IJobFilter
-{
-public:
-    virtual bool NeedTransform(const print::CJob& job);
-    virtual print::CJob Transform(const print::CJob& job);
+    virtual void Transform(print::CJob& job) = 0;
 
-protected:
-	print::CJob TransformTempl_0(const print::CJob& job);
-	print::CJob TransformTempl_1(const print::CJob& job);
-	print::CJob TransformTempl_2(const print::CJob& job);
-	print::CJob TransformTempl_3(const print::CJob& job);
-	print::CJob TransformTempl_4(const print::CJob& job);
-	print::CJob TransformTempl_5(const print::CJob& job);
-	print::CJob TransformTempl_6(const print::CJob& job);
-	print::CJob TransformTempl_7(const print::CJob& job);
-	print::CJob TransformTempl_8(const print::CJob& job);
-	print::CJob TransformTempl_9(const print::CJob& job);
-	print::CJob TransformTempl_A(const print::CJob& job);
-	print::CJob TransformTempl_B(const print::CJob& job);
-
-  void TransformExpiry(print::CData& data)
-  {
-    if(!data.m_strData.CompareNoCase(L"9999 days") ||
-      !data.m_strData.CompareNoCase(L"9999days") ||
-      !data.m_strData.CompareNoCase(L"9999 day") ||
-      !data.m_strData.CompareNoCase(L"9999day"))
+    /// <summary>Checks if transformation of specified job only appends blank
+    /// fields, so job can be sent without being copied.</summary>
+    /// <param name="job">Job to be checked.</param>
+    /// <returns>Number of blank fields appended, 0 if no transformation is
+    /// needed, -1 if transformation does more than appending.</returns>
+    virtual int GetBlankCnt(const print::CJob& job)
     {
-		data.m_strData = _T("Ticket Never expires");
+      return NeedTransform(job) ? -1 : 0;
     }
-  }
 };
 
-/// <summary>Job filter for firmware GUR126001.</summary>
-class CJobFilterGUR126001 : public CJobFilterGUR126003 {};
-
-/// <summary>Job filter for firmware GUR109000.</summary>
-class CJobFilterGUR109000 : public CJobFilterGUR126003 {};
-
-/// <summary>Job filter for firmware GUREUR100.</summary>
-class CJobFilterGUREUR100 : public CJobFilterGUR126003 {};
-
-/// <summary>Job filter for firmware GUREUR101.</summary>
-class CJobFilterGUREUR101 : public CJobFilterGUR126003 {};
-
-/// <summary>Job filter for firmware GUREUR102.</summary>
-class CJobFilterGUREUR102 : public CJobFilterGUR126003 {};
-
-/// <summary>Job filter for firmware GUREUR200.</summary>
-class CJobFilterGUREUR200 : public CJobFilterGUR126003 {};
-
-/// <summary>Job filter for firmware GURTOR100.</summary>
-class CJobFilterGURTOR100 : public CJobFilterGUR126003 {};
-
-/// <summary>Job filter for firmware GURTOR101.</summary>
-class CJobFilterGURTOR101 : public CJobFilterGUR126003 {};
+/// <summary>Job filter driven by field mapping tables.</summary>
+class CJobFilterTable : public IJobFilter
+{
+protected:
+  /// <value>Compiled field mappings.</value>
+  CJobProgram m_Program;
 
-/// <summary>Job filter for firmware GURUSA001.</summary>
-class CJobFilterGURUSA001 : public CJobFilterGUR126003 {};
+public:
+    virtual bool NeedTransform(const print::CJob& job);
+    virtual void Transform(print::CJob& job);
+    virtual int GetBlankCnt(const print::CJob& job);
+};
 
-/// <summary>Job filter for firmware GURUSA003.</summary>
-class CJobFilterGURUSA003 : public CJobFilterGUR126003 {};
+/// <summary>Job filter for firmware GUR126003, also used by most other
+/// firmware, see <see cref="CFirmwareRegistry"/>.</summary>
+class CJobFilterGUR126003 : public CJobFilterTable
+{
+public:
+  CJobFilterGUR126003();
+};
 
 /// <summary>Job filter for firmware GURNSW200.</summary>
 class CJobFilterGURNSW200 : public CJobFilterGUR126003
 {
 public:
-    virtual bool NeedTransform(const print::CJob& job);
-    virtual print::CJob Transform(const print::CJob& job);
-
-protected:
-	print::CJob TransformTempl_N(const print::CJob& job);
+  CJobFilterGURNSW200();
 };
-
-
-/// <summary>Job filter for firmware GURSNG103.</summary>
-class CJobFilterGURSNG103 : public CJobFilterGUR126003 {};
-
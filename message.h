@@ -50,6 +50,41 @@ public:
   /// <value>Flash transfer.</value>
   static const char CMD_FLASH_TRANSFER = 'z';
 
+  /// <value>Number of host IDs covered by the lookup tables.</value>
+  static const int ID_CNT = 1000;
+
+  /// <value>Maximum size of print command head, see
+  /// <see cref="TryGetPrintHead"/>.</value>
+  static const int PRINT_HEAD_SIZE = 8;
+
+protected:
+  /// <summary>Lookup tables between host IDs and driver bytes.</summary>
+  /// <remarks>Built once at start-up from the mapping rules. A forward entry
+  /// of 0 marks an invalid host ID, as 0 is never a driver byte. A reverse
+  /// entry holds the lowest host ID mapped to the driver byte, -1 if
+  /// none.</remarks>
+  struct STables
+  {
+    BYTE m_abyTempl[ID_CNT];
+    BYTE m_abyRegion[ID_CNT];
+    BYTE m_abyGraphic[ID_CNT];
+    BYTE m_abyBarcode[ID_CNT];
+    BYTE m_abyPage[ID_CNT];
+
+    short m_ansTempl[256];
+    short m_ansRegion[256];
+    short m_ansGraphic[256];
+    short m_ansBarcode[256];
+
+    BYTE m_aabyPrintHead[ID_CNT][PRINT_HEAD_SIZE];
+    BYTE m_abyPrintHeadLen[ID_CNT];
+
+    STables();
+  };
+
+  /// <value>Lookup tables shared by all message managers.</value>
+  static const STables s_Tables;
+
 public:
   char GetType(BYTE* msg, DWORD msgLen);
   bool IsUserDefinedTempl(short id);
@@ -63,8 +98,212 @@ public:
 
   BYTE TemplID2PageID(short id);
   BYTE TemplID2PageIDPrint(short id);
+
+  bool TryTemplID2Drv(short id, BYTE& drv);
+  bool TryRegionID2Drv(short id, BYTE& drv);
+  bool TryGraphicID2Drv(short id, BYTE& drv);
+  bool TryBarcodeID2Drv(short id, BYTE& drv);
+  bool TryTemplID2PageID(short id, BYTE& page);
+
+  bool TryDrv2TemplID(BYTE drv, short& id);
+  bool TryDrv2RegionID(BYTE drv, short& id);
+  bool TryDrv2GraphicID(BYTE drv, short& id);
+  bool TryDrv2BarcodeID(BYTE drv, short& id);
+
+  bool TryGetPrintHead(short id, const BYTE*& head, DWORD& len);
+
+protected:
+  static bool Lookup(const BYTE* table, short id, BYTE& drv);
+  static bool Lookup(const short* table, BYTE drv, short& id);
 };
 
+/// <summary>Looks up a host ID in a forward table.</summary>
+/// <param name="table">Forward table of <see cref="ID_CNT"/> entries.</param>
+/// <param name="id">Host ID.</param>
+/// <param name="drv">Receives driver byte, if found.</param>
+/// <returns>True if found, false if <paramref name="id"/> is out of range.
+/// </returns>
+inline bool CMsgMgr::Lookup(const BYTE* table, short id, BYTE& drv)
+{
+  if((unsigned short)id >= ID_CNT) { return false; }
+
+  drv = table[id];
+  return drv != 0;
+}
+
+/// <summary>Looks up a driver byte in a reverse table.</summary>
+/// <param name="table">Reverse table of 256 entries.</param>
+/// <param name="drv">Driver byte.</param>
+/// <param name="id">Receives lowest host ID mapped to <paramref name="drv"/>,
+/// if found.</param>
+/// <returns>True if found, false if no host ID maps to <paramref name="drv"/>.
+/// </returns>
+inline bool CMsgMgr::Lookup(const short* table, BYTE drv, short& id)
+{
+  if(table[drv] < 0) { return false; }
+
+  id = table[drv];
+  return true;
+}
+
+/// <summary>Converts template ID to driver's range, without throwing.</summary>
+/// <param name="id">Template ID.</param>
+/// <param name="drv">Receives template ID mapped to driver's range.</param>
+/// <returns>True if converted, false if <paramref name="id"/> is out of range.
+/// </returns>
+inline bool CMsgMgr::TryTemplID2Drv(short id, BYTE& drv)
+{
+  return Lookup(s_Tables.m_abyTempl, id, drv);
+}
+
+/// <summary>Converts region ID to driver's range, without throwing.</summary>
+/// <param name="id">Region ID.</param>
+/// <param name="drv">Receives region ID mapped to driver's range.</param>
+/// <returns>True if converted, false if <paramref name="id"/> is out of range.
+/// </returns>
+inline bool CMsgMgr::TryRegionID2Drv(short id, BYTE& drv)
+{
+  return Lookup(s_Tables.m_abyRegion, id, drv);
+}
+
+/// <summary>Converts graphic ID to driver's range, without throwing.</summary>
+/// <param name="id">Graphic ID.</param>
+/// <param name="drv">Receives graphic ID mapped to driver's range.</param>
+/// <returns>True if converted, false if <paramref name="id"/> is out of range.
+/// </returns>
+inline bool CMsgMgr::TryGraphicID2Drv(short id, BYTE& drv)
+{
+  return Lookup(s_Tables.m_abyGraphic, id, drv);
+}
+
+/// <summary>Converts barcode ID to driver's range, without throwing.</summary>
+/// <param name="id">Barcode ID.</param>
+/// <param name="drv">Receives barcode ID mapped to driver's range.</param>
+/// <returns>True if converted, false if <paramref name="id"/> is out of range.
+/// </returns>
+inline bool CMsgMgr::TryBarcodeID2Drv(short id, BYTE& drv)
+{
+  return Lookup(s_Tables.m_abyBarcode, id, drv);
+}
+
+/// <summary>Determines memory page ID to store the defined template, without
+/// throwing.</summary>
+/// <param name="id">Template ID.</param>
+/// <param name="page">Receives memory page ID.</param>
+/// <returns>True if determined, false if <paramref name="id"/> is out of range.
+/// </returns>
+inline bool CMsgMgr::TryTemplID2PageID(short id, BYTE& page)
+{
+  return Lookup(s_Tables.m_abyPage, id, page);
+}
+
+/// <summary>Converts driver's template ID back to template ID.</summary>
+/// <param name="drv">Template ID in driver's range, e.g.
+/// <see cref="CMsgRespStatus::m_byTemplateID"/>.</param>
+/// <param name="id">Receives lowest template ID mapped to
+/// <paramref name="drv"/>.</param>
+/// <returns>True if converted, false if <paramref name="drv"/> is not a
+/// template ID.</returns>
+inline bool CMsgMgr::TryDrv2TemplID(BYTE drv, short& id)
+{
+  return Lookup(s_Tables.m_ansTempl, drv, id);
+}
+
+/// <summary>Converts driver's region ID back to region ID.</summary>
+/// <param name="drv">Region ID in driver's range.</param>
+/// <param name="id">Receives lowest region ID mapped to
+/// <paramref name="drv"/>.</param>
+/// <returns>True if converted, false if <paramref name="drv"/> is not a
+/// region ID.</returns>
+inline bool CMsgMgr::TryDrv2RegionID(BYTE drv, short& id)
+{
+  return Lookup(s_Tables.m_ansRegion, drv, id);
+}
+
+/// <summary>Converts driver's graphic ID back to graphic ID.</summary>
+/// <param name="drv">Graphic ID in driver's range.</param>
+/// <param name="id">Receives lowest graphic ID mapped to
+/// <paramref name="drv"/>.</param>
+/// <returns>True if converted, false if <paramref name="drv"/> is not a
+/// graphic ID.</returns>
+inline bool CMsgMgr::TryDrv2GraphicID(BYTE drv, short& id)
+{
+  return Lookup(s_Tables.m_ansGraphic, drv, id);
+}
+
+/// <summary>Converts driver's barcode ID back to barcode ID.</summary>
+/// <param name="drv">Barcode ID in driver's range.</param>
+/// <param name="id">Receives lowest barcode ID mapped to
+/// <paramref name="drv"/>.</param>
+/// <returns>True if converted, false if <paramref name="drv"/> is not a
+/// barcode ID.</returns>
+inline bool CMsgMgr::TryDrv2BarcodeID(BYTE drv, short& id)
+{
+  return Lookup(s_Tables.m_ansBarcode, drv, id);
+}
+
+/// <summary>Retrieves fixed head of print command for a template.</summary>
+/// <param name="id">Template ID.</param>
+/// <param name="head">Receives pointer to command bytes up to and including
+/// the delimiter before first field, i.e. "^P|&lt;tmpl&gt;|1|" with memory page
+/// ID after 'P' for user-defined template.</param>
+/// <param name="len">Receives size of <paramref name="head"/>, in number of
+/// bytes.</param>
+/// <returns>True if retrieved, false if <paramref name="id"/> is out of range.
+/// </returns>
+inline bool CMsgMgr::TryGetPrintHead(short id, const BYTE*& head, DWORD& len)
+{
+  if((unsigned short)id >= ID_CNT) { return false; }
+
+  head = s_Tables.m_aabyPrintHead[id];
+  len = s_Tables.m_abyPrintHeadLen[id];
+  return true;
+}
+
+/// <summary>Converts template ID to driver's range.</summary>
+/// <param name="id">Template ID.</param>
+/// <returns>Template ID mapped to driver's range.</returns>
+/// <exception cref="wcl::CArgumentException">If <paramref name="id"/> is out
+/// of range.</exception>
+/// <remarks>This printer use [0x30~0x39, 0x41, 0x42, 0x4E] as predefined template,
+/// use [0x3A~0x40, 0x43~0x5D, 0x5F~0x7B, 0x7D] as user-defined template. Thus
+/// 0~99 is mapped to predefined range by truncating value > 11 to 11,
+/// e.g. 0 will mapped to 0x30, and 11, 12, 13 all will be mapped to 0x42.
+/// And 100~999 is mapped to user-defined range in similar manner.</remarks>
+inline BYTE CMsgMgr::TemplID2Drv(short id)
+{
+  BYTE byTmp;
+
+  if(!TryTemplID2Drv(id, byTmp))
+  {
+    WCL_THROW_ARGUMENTEXCEPTION(L"id", L"must between 0 to 999");
+  }
+  return byTmp;
+}
+
+/// <summary>Converts region ID to driver's range.</summary>
+/// <param name="id">Region ID.</param>
+/// <returns>Region ID mapped to driver's range.</returns>
+/// <exception cref="wcl::CArgumentException">If <paramref name="id"/> is out
+/// of range.</exception>
+/// <remarks>This printer use [0x31~0x39, 0x41~0x47, 0x49~0x4C, 0x4E~0x55, 0x58,
+/// 0x5A, 0x61~0x71] as predefined region, use [0x30, 0x3A~0x40, 0x48, 0x4D,
+/// 0x56~0x57, 0x59, 0x5B~0x5D, 0x5F~0x60, 0x72~0x7B, 0x7D] as user-defined
+/// region. Thus 0~99 is mapped to the predefined range by truncating value
+/// > 46 to 46, e.g. 0 will be mapeed to 0x31, and 46, 47, 48 all will be
+/// mapped to 0x71. And 100~999 is mapped to user-defined range in similar
+/// manner.</remarks>
+inline BYTE CMsgMgr::RegionID2Drv(short id)
+{
+  BYTE byTmp;
+
+  if(!TryRegionID2Drv(id, byTmp))
+  {
+    WCL_THROW_ARGUMENTEXCEPTION(L"id", L"must between 0 to 999");
+  }
+  return byTmp;
+}
+
 /// <summary>Checks if specified ID refers to user-defined template.</summary>
 /// <param name="id">Template ID.</param>
 /// <exception cref="wcl::CArgumentException">If <paramref name="id"/> is out
@@ -108,14 +347,13 @@ inline BYTE CMsgMgr::FontID2Drv(short id)
 /// e.g. 1 will be mapeed to 0x45, and 27, 28, 29 all will be mapped to 0x60.</remarks>
 inline BYTE CMsgMgr::GraphicID2Drv(short id)
 {
-  if((id < 1) || (id > 255))
+  BYTE byTmp;
+
+  if(!TryGraphicID2Drv(id, byTmp))
   {
     WCL_THROW_ARGUMENTEXCEPTION(L"id", L"must between 0 to 999");
   }
-
-  if(id < 26) { return id + 0x44; }
-    
-  return __min(id, 27) + 0x45;
+  return byTmp;
 }
 
 /// <summary>Converts barcode ID to driver's range.</summary>
@@ -128,14 +366,13 @@ inline BYTE CMsgMgr::GraphicID2Drv(short id)
 /// e.g. 0 will be mapeed to 'a', and 27, 28, 29 all will be mapped to '}'.</remarks>
 inline BYTE CMsgMgr::BarcodeID2Drv(short id)
 {
-  if((id < 0) || (id > 999))
+  BYTE byTmp;
+
+  if(!TryBarcodeID2Drv(id, byTmp))
   {
     WCL_THROW_ARGUMENTEXCEPTION(L"id", L"must between 0 to 999");
   }
-
-  if(id < 27) { return id + 'a'; }
-
-  return '}';
+  return byTmp;
 }
 
 /// <summary>Determines memory page ID to store the defined template.</summary>
@@ -145,16 +382,13 @@ inline BYTE CMsgMgr::BarcodeID2Drv(short id)
 /// of range.</exception>
 inline BYTE CMsgMgr::TemplID2PageID(short id)
 {
-	if((id < 0) || (id > 999))
-	{
-		WCL_THROW_ARGUMENTEXCEPTION(L"id", L"must between 0 to 999");
-	}
+	BYTE byTmp;
 
-	if(!IsUserDefinedTempl(id))
+	if(!TryTemplID2PageID(id, byTmp))
 	{
-		return 'A';
+		WCL_THROW_ARGUMENTEXCEPTION(L"id", L"must between 0 to 999");
 	}
-	return min('B' + id - 100, 'J');
+	return byTmp;
 }
 
 /// <summary>Determines memory page ID to be used in print command for user-defined
@@ -172,6 +406,79 @@ inline BYTE CMsgMgr::TemplID2PageIDPrint(short id)
 	return min('1' + id - 100, '9');
 }
 
+/// <summary>Growable byte sink which messages are encoded into.</summary>
+/// <remarks>Memory is only re-allocated when it grows, so a sink kept alive
+/// across commands reaches a steady state without allocation.</remarks>
+class CMsgSink
+{
+protected:
+  /// <value>Encoded bytes.</value>
+  BYTE *m_pbyData;
+
+  /// <value>Number of encoded bytes in <see cref="m_pbyData"/>.</value>
+  DWORD m_dwSize;
+
+  /// <value>Size of memory allocated for <see cref="m_pbyData"/>.</value>
+  DWORD m_dwMemSize;
+
+  /// <value>Scratch buffer for wide to multi-byte conversion.</value>
+  char *m_pszScratch;
+
+  /// <value>Size of memory allocated for <see cref="m_pszScratch"/>.</value>
+  DWORD m_dwScratchSize;
+
+public:
+  CMsgSink(DWORD memSize = 1024);
+  ~CMsgSink();
+
+public:
+  void Clear();
+
+  void Append(BYTE by);
+  void Append(const BYTE* data, DWORD size);
+  void AppendUInt(DWORD value);
+  void AppendInt(long value);
+  void AppendStr(const CWkString& str);
+
+  BYTE* GetData() const;
+  DWORD GetSize() const;
+
+protected:
+  void Reserve(DWORD size);
+
+private:
+  CMsgSink(const CMsgSink&);
+  CMsgSink& operator=(const CMsgSink&);
+};
+
+/// <summary>Discards encoded bytes, allocated memory is kept.</summary>
+inline void CMsgSink::Clear()
+{
+  m_dwSize = 0;
+}
+
+/// <summary>Appends a byte.</summary>
+/// <param name="by">Byte to be appended.</param>
+inline void CMsgSink::Append(BYTE by)
+{
+  if(m_dwSize >= m_dwMemSize) { Reserve(m_dwSize + 1); }
+  m_pbyData[m_dwSize++] = by;
+}
+
+/// <summary>Retrieves encoded bytes.</summary>
+/// <returns>Pointer to encoded bytes.</returns>
+inline BYTE* CMsgSink::GetData() const
+{
+  return m_pbyData;
+}
+
+/// <summary>Retrieves number of encoded bytes.</summary>
+/// <returns>Number of encoded bytes.</returns>
+inline DWORD CMsgSink::GetSize() const
+{
+  return m_dwSize;
+}
+
 /// <summary>Communication message.</summary>
 class CMsg
 {
@@ -186,6 +493,12 @@ public:
   /// contain the command bytes if <paramref name="buffer"/> is NULL or
   /// <paramref name="bufferSize"/> is zero.</returns>
   virtual DWORD Build(BYTE* buffer, DWORD bufferSize) { return 0; }
+
+  /// <summary>Appends command bytes to sink in a single pass.</summary>
+  /// <param name="sink">Sink to receive constructed bytes.</param>
+  /// <remarks>Default implementation sizes then fills via <see cref="Build"/>,
+  /// messages with variable content override it.</remarks>
+  virtual void Encode(CMsgSink& sink);
   
   /// <summary>Parses printer response.</summary>
   /// <param name="resp">Printer's response.</param>
@@ -203,6 +516,9 @@ public:
   /// error description if parse failed. If NULL, no error description is returned.</param>
   /// <returns>True if parse success, false otherwise.</returns>
   virtual bool TryParse(BYTE* resp, DWORD size, CWkString* errMsg) { return false; }
+
+protected:
+  DWORD BuildByEncode(BYTE* buffer, DWORD bufferSize);
 };
 
 /// <summary>Define template command.</summary>
@@ -220,12 +536,13 @@ public:
 
 public:
   virtual DWORD Build(BYTE* buffer, DWORD bufferSize);
+  virtual void Encode(CMsgSink& sink);
 
   void Dump(MSXML2::IXMLDOMElement* pElem);
 
 protected:
-  DWORD BuildDefine(BYTE* buffer, DWORD bufferSize);
-  DWORD BuildDelete(BYTE* buffer, DWORD bufferSize);
+  void EncodeDefine(CMsgSink& sink);
+  void EncodeDelete(CMsgSink& sink);
 };
 
 /// <summary>Define print region command.</summary>
@@ -243,12 +560,13 @@ public:
 
 public:
   virtual DWORD Build(BYTE* buffer, DWORD bufferSize);
+  virtual void Encode(CMsgSink& sink);
 
   void Dump(MSXML2::IXMLDOMElement* pElem);
 
 protected:
-  DWORD BuildDefine(BYTE* buffer, DWORD bufferSize);
-  DWORD BuildDelete(BYTE* buffer, DWORD bufferSize);
+  void EncodeDefine(CMsgSink& sink);
+  void EncodeDelete(CMsgSink& sink);
 };
 
 /// <summary>Print command.</summary>
@@ -256,13 +574,18 @@ class CMsgPrint : public CMsg
 {
 public:
   /// <value>Pointer to job to be printed.</value>
-  print::CJob *m_pJob;
+  const print::CJob *m_pJob;
+
+  /// <value>Number of blank fields sent after those of <see cref="m_pJob"/>.
+  /// </value>
+  int m_nBlankCnt;
 
 public:
   CMsgPrint();
 
 public:
   virtual DWORD Build(BYTE* buffer, DWORD bufferSize);
+  virtual void Encode(CMsgSink& sink);
 
   void Dump(MSXML2::IXMLDOMElement* pElem);
 };
@@ -282,12 +605,13 @@ public:
 
 public:
   virtual DWORD Build(BYTE* buffer, DWORD bufferSize);
+  virtual void Encode(CMsgSink& sink);
 
   void Dump(MSXML2::IXMLDOMElement* pElem);
 
 protected:
-  DWORD BuildDefine(BYTE* buffer, DWORD bufferSize);
-  DWORD BuildDelete(BYTE* buffer, DWORD bufferSize);
+  void EncodeDefine(CMsgSink& sink);
+  void EncodeDelete(CMsgSink& sink);
 };
 
 /// <summary>Clear error status command.</summary>
@@ -362,98 +686,74 @@ public:
 };
 
 /// <summary>Printer status.</summary>
+/// <remarks>Flags are kept in a single word laid out as the five status flag
+/// bytes of the response, 6 bits each, so that they are copied in one go and
+/// compared with a single XOR.</remarks>
 class CStatus
 {
 public:
-  /// <value>True if busy processing print or command, false otherwise.</value>
-  bool m_bBusy;
-  
-  /// <value>True if error detected, false otherwise.</value>
-  bool m_bError;
-  
-  /// <value>True if print head opened, false otherwise.</value>
-  bool m_bPrintHeadOpen;
-  
-  /// <value>True if paper out, false otherwise.</value>
-  bool m_bPaperOut;
-
-  /// <value>True if print head error, false otherwise.</value>
-  bool m_bPrintHeadErr;
-  
-  /// <value>True if voltage error, false otherwise.</value>
-  bool m_bVoltageErr;
-  
-  /// <value>True if print head temperature error, false otherwise.</value>
-  bool m_bTemperatureErr;
-  
-  /// <value>True if library reference in define template or define print region is
-  /// invalid, false otherwise.</value>
-  bool m_bLibRefErr;
-  
-  /// <value>True if there is an error in the define template or define print
-  /// region command, or error in data of print command, false otherwise.</value>
-  bool m_bRegionDataErr;
-  
-  /// <value>True if there is an error in library management command when loading
-  /// graphics/fonts, false otherwise.</value>
-  bool m_bLoadLibErr;
-  
-  /// <value>True if printer buffer overflow, false otherwise.</value>
-  bool m_bBufferOverflow;
-  
-  /// <value>True if not enough memory to print current job, false otherwise.</value>
-  bool m_bJobMemOverflow;
-  
-  /// <value>True if there is a syntax error with a receive command, or the command
-  /// is unsupported, false otherwise.</value>
-  bool m_bCmdErr;
-  
-  /// <value>True if no font is available to carry out printing, false otherwise.</value>
-  bool m_bNoFont;
-  
-  /// <value>True if paper in chute (ticket not taken), false otherwise.</value>
-  bool m_bPaperInChute;
-  
-  /// <value>True if flash error, false otherwise.</value>
-  bool m_bFlashErr;
-  
-  /// <value>True if printer offline, false otherwise.</value>
-  bool m_bOffLine;
- 
-  /// <value>True if wrong paper, false otherwise.</value>
-  bool m_bWrongPaper;
-  
-  /// <value>True for journal mode, false for TCL mode.</value>
-  bool m_bJournalMode;
-  
-  /// <value>True if cutter error, false otherwise.</value>
-  bool m_bCutterErr;
-  
-  /// <value>True if paper jammed, false otherwise.</value>
-  bool m_bPaperJam;
-  
-  /// <value>True if paper low, false otherwise.</value>
-  bool m_bPaperLow;
-  
-  /// <value>True if last bar of barcode printed, false otherwise.</value>
-  bool m_bLastBarPrinted;
-  
-  /// <value>True if paper at top of form, false otherwise.</value>
-  bool m_bTopOfForm;
-  
-  /// <value>True if printer ready to receive command, false otherwise.</value>
-  bool m_bReadyToRx;
-  
-  /// <value>True if printer door opened, false otherwise.</value>
-  bool m_bDoorOpened;
-  
-  /// <value>True if printer has powered up or been reset, false otherwise.</value>
-  bool m_bPowerUpReset;
+  /// <summary>Bits of <see cref="m_dwFlags"/>.</summary>
+  enum FLAG
+  {
+    // status flag 1.
+    FLAG_VOLTAGE_ERR        = 0x00000001,
+    FLAG_PRINT_HEAD_ERR     = 0x00000002,
+    FLAG_PAPER_OUT          = 0x00000004,
+    FLAG_PRINT_HEAD_OPEN    = 0x00000008,
+    FLAG_ERROR              = 0x00000010,
+    FLAG_BUSY               = 0x00000020,
+
+    // status flag 2.
+    FLAG_JOB_MEM_OVERFLOW   = 0x00000040,
+    FLAG_BUFFER_OVERFLOW    = 0x00000080,
+    FLAG_LOAD_LIB_ERR       = 0x00000100,
+    FLAG_REGION_DATA_ERR    = 0x00000200,
+    FLAG_LIB_REF_ERR        = 0x00000400,
+    FLAG_TEMPERATURE_ERR    = 0x00000800,
+
+    // status flag 3.
+    FLAG_WRONG_PAPER        = 0x00001000,
+    FLAG_OFF_LINE           = 0x00002000,
+    FLAG_FLASH_ERR          = 0x00004000,
+    FLAG_PAPER_IN_CHUTE     = 0x00008000,
+    FLAG_NO_FONT            = 0x00010000,
+    FLAG_CMD_ERR            = 0x00020000,
+
+    // status flag 4.
+    FLAG_PAPER_LOW          = 0x00040000,
+    FLAG_PAPER_JAM          = 0x00080000,
+    FLAG_CUTTER_ERR         = 0x00100000,
+    FLAG_JOURNAL_MODE       = 0x00200000,
+
+    // status flag 5, printer reports ready to receive inverted.
+    FLAG_POWER_UP_RESET     = 0x00400000,
+    FLAG_DOOR_OPENED        = 0x01000000,
+    FLAG_READY_TO_RX        = 0x02000000,
+    FLAG_TOP_OF_FORM        = 0x04000000,
+    FLAG_LAST_BAR_PRINTED   = 0x08000000
+  };
+
+  /// <summary>Bits of <see cref="m_dwFlags"/> carried by a status response.
+  /// </summary>
+  static const DWORD FLAG_MASK = 0x0F7FFFFF;
+
+  /// <summary>Flags that need clear error status command, unless
+  /// <see cref="FLAG_TOP_OF_FORM"/> which needs it when cleared.</summary>
+  static const DWORD FLAG_CLEAR_ERR = FLAG_LIB_REF_ERR | FLAG_REGION_DATA_ERR |
+    FLAG_LOAD_LIB_ERR | FLAG_BUFFER_OVERFLOW | FLAG_JOB_MEM_OVERFLOW |
+    FLAG_CMD_ERR | FLAG_LAST_BAR_PRINTED;
+
+public:
+  /// <value>Status flags, combination of <see cref="FLAG"/>.</value>
+  DWORD m_dwFlags;
 
 public:
   CStatus();
 
 public:
+  bool Test(DWORD flags) const;
+  void SetFlags(BYTE flag1, BYTE flag2, BYTE flag3, BYTE flag4, BYTE flag5);
+
   bool ExtPowerLost() const;
   bool FirmwareErr() const;
   bool NVMErr() const;
@@ -471,22 +771,33 @@ public:
   bool ShouldSuspend() const;
   bool NeedClearErr() const;
 
+  DWORD GetEvtMask() const;
+
 public:
   void Dump(MSXML2::IXMLDOMElement* pElem);
 };
 
+/// <summary>Checks for status flags.</summary>
+/// <param name="flags">Combination of <see cref="FLAG"/>.</param>
+/// <returns>True if any of <paramref name="flags"/> is set, false otherwise.
+/// </returns>
+inline bool CStatus::Test(DWORD flags) const
+{
+  return (m_dwFlags & flags) != 0;
+}
+
 /// <summary>Checks for external power lost.</summary>
 /// <returns>True if external power lost, false otherwise.</returns>
 inline bool CStatus::ExtPowerLost() const
 {
-  return m_bVoltageErr;
+  return Test(FLAG_VOLTAGE_ERR);
 }
 
 /// <summary>Checks for firmware error.</summary>
 /// <returns>True if firmware error, false otherwise.</returns>
 inline bool CStatus::FirmwareErr() const
 {
-  return m_bFlashErr;
+  return Test(FLAG_FLASH_ERR);
 }
 
 /// <summary>Checks for non-volatile memory error.</summary>
@@ -500,28 +811,35 @@ inline bool CStatus::NVMErr() const
 /// <returns>True if print head error, false otherwise.</returns>
 inline bool CStatus::PrintHeadErr() const
 {
-  return m_bPrintHeadErr;
+  return Test(FLAG_PRINT_HEAD_ERR);
 }
 
 /// <summary>Checks for print head temperature error.</summary>
 /// <returns>True if print head temperature error, false otherwise.</returns>
 inline bool CStatus::TemperatureErr() const
 {
-  return m_bTemperatureErr;
+  return Test(FLAG_TEMPERATURE_ERR);
+}
+
+/// <summary>Checks for general error.</summary>
+/// <returns>True if general error, false otherwise.</returns>
+inline bool CStatus::GeneralErr() const
+{
+  return Test(FLAG_NO_FONT | FLAG_OFF_LINE | FLAG_JOURNAL_MODE);
 }
 
 /// <summary>Checks for chassis opened.</summary>
 /// <returns>True if chassis opened, false otherwise.</returns>
 inline bool CStatus::ChassisOpened() const
 {
-  return m_bDoorOpened;
+  return Test(FLAG_DOOR_OPENED);
 }
 
 /// <summary>Checks for print head opened.</summary>
 /// <returns>True if print head opened, false otherwise.</returns>
 inline bool CStatus::PrintHeadOpened() const
 {
-  return m_bPrintHeadOpen;
+  return Test(FLAG_PRINT_HEAD_OPEN);
 }
 
 /// <summary>Checks for paper at top of form.</summary>
@@ -535,32 +853,40 @@ inline bool CStatus::TopOfForm() const
 /// <returns>True if paper jammed, false otherwise.</returns>
 inline bool CStatus::PaperJam() const
 {
-  return m_bPaperJam;
+  return Test(FLAG_PAPER_JAM);
 }
 
 /// <summary>Checks for paper low.</summary>
 /// <returns>True if paper low, false otherwise.</returns>
 inline bool CStatus::PaperLow() const
 {
-  return m_bPaperLow;
+  return Test(FLAG_PAPER_LOW);
 }
 
 /// <summary>Checks for paper empty.</summary>
 /// <returns>True if paper empty, false otherwise.</returns>
 inline bool CStatus::PaperEmpty() const
 {
-  return m_bPaperOut || m_bWrongPaper;
+  return Test(FLAG_PAPER_OUT | FLAG_WRONG_PAPER);
 }
 
 /// <summary>Printer status response.</summary>
+/// <remarks>Holds no heap storage so that it can be decoded on stack for every
+/// status poll.</remarks>
 class CMsgRespStatus : public CMsg
 {
+public:
+  /// <summary>Size of <see cref="m_szSoftwareVer"/>, in number of characters,
+  /// including terminating NULL.</summary>
+  static const int SOFTWARE_VER_SIZE = 32;
+
 public:
   /// <value>Unit address.</value>
   DWORD m_dwUnitAddr;
 
-  /// <value>Software version information.</value>
-  CWkString m_strSoftwareVer;
+  /// <value>Software version information, NULL terminated. Truncated if longer
+  /// than <see cref="SOFTWARE_VER_SIZE"/> - 1 characters.</value>
+  wchar_t m_szSoftwareVer[SOFTWARE_VER_SIZE];
   
   /// <value>Status flags.</value>
   CStatus m_Status;
@@ -576,8 +902,7 @@ public:
   virtual void Parse(BYTE* resp, DWORD size);
   virtual bool TryParse(BYTE* resp, DWORD size, CWkString* errMsg);
 
-  void Dump(MSXML2::IXMLDOMElement* pElem);
+  bool GetTemplateID(short& id) const;
 
-protected:
-  void ParseStatus(BYTE flag1, BYTE flag2, BYTE flag3, BYTE flag4, BYTE flag5);
+  void Dump(MSXML2::IXMLDOMElement* pElem);
 };
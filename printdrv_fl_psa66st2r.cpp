@@ -65,3 +65,130 @@ void PrintReleaseInstance(print::IPrinter* pPrinter)
 
   delete pObj;
 }
+
+/// <summary>Uploads graphic, region and template definitions in one batch.</summary>
+/// <param name="pPrinter">Pointer to <see cref="IPrinter"/> object created by
+/// <see cref="PrintCreateInstance"/>, cannot be NULL.</param>
+/// <param name="batch">Definitions, copied before return.</param>
+/// <returns>True if batch is queued, false if printer is not initialized.
+/// </returns>
+/// <exception cref="wcl::CArgumentNullException">If <paramref name="pPrinter"/> is
+/// NULL.</exception>
+/// <exception cref="wcl::CArgumentException">If <paramref name="batch"/> is
+/// invalid.</exception>
+/// <remarks>Definitions are sent back to back, each followed by an immediate
+/// status poll, without returning to idle in between.
+/// <see cref="IDefineBatchObserver::OnDefineBatchCompleted"/> is notified once
+/// with result of every definition, all not attempted if printer is not idle
+/// when the batch is taken.</remarks>
+bool PrintDefineBatch(print::IPrinter* pPrinter, const SDefineBatch& batch)
+{
+  if(pPrinter == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"pPrinter"); }
+
+  return ((CPrinter*)pPrinter)->DefineBatch(batch);
+}
+
+/// <summary>Retrieves driver statistics: round-trip latency histograms and
+/// transfer counters.</summary>
+/// <param name="pPrinter">Pointer to <see cref="IPrinter"/> object created by
+/// <see cref="PrintCreateInstance"/>, cannot be NULL.</param>
+/// <param name="stats">Receives statistics since instance was created.</param>
+/// <exception cref="wcl::CArgumentNullException">If <paramref name="pPrinter"/> is
+/// NULL.</exception>
+void PrintGetDriverStats(print::IPrinter* pPrinter, SDriverStats& stats)
+{
+  if(pPrinter == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"pPrinter"); }
+
+  ((CPrinter*)pPrinter)->GetDriverStats(stats);
+}
+
+/// <summary>Retrieves progress of last large command, e.g. a graphic
+/// definition, streamed to printer.</summary>
+/// <param name="pPrinter">Pointer to <see cref="IPrinter"/> object created by
+/// <see cref="PrintCreateInstance"/>, cannot be NULL.</param>
+/// <param name="sent">Receives number of bytes sent.</param>
+/// <param name="total">Receives size of definition command, 0 if none was
+/// streamed.</param>
+/// <returns>True if command is still being streamed, false otherwise.
+/// </returns>
+/// <exception cref="wcl::CArgumentNullException">If <paramref name="pPrinter"/> is
+/// NULL.</exception>
+/// <remarks>Progress of graphic uploads is also delivered by
+/// <see cref="IStatusObserver::OnUploadProgress"/>.</remarks>
+bool PrintGetUploadProgress(print::IPrinter* pPrinter, DWORD& sent, DWORD& total)
+{
+  if(pPrinter == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"pPrinter"); }
+
+  return ((CPrinter*)pPrinter)->GetUploadProgress(sent, total);
+}
+
+/// <summary>Cancels large graphic definition being streamed to printer.
+/// Graphic is reported failed through the observer, other commands being
+/// streamed are never cancelled.</summary>
+/// <param name="pPrinter">Pointer to <see cref="IPrinter"/> object created by
+/// <see cref="PrintCreateInstance"/>, cannot be NULL.</param>
+/// <exception cref="wcl::CArgumentNullException">If <paramref name="pPrinter"/> is
+/// NULL.</exception>
+void PrintCancelUpload(print::IPrinter* pPrinter)
+{
+  if(pPrinter == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"pPrinter"); }
+
+  ((CPrinter*)pPrinter)->CancelUpload();
+}
+
+/// <summary>Sets observer to receive printer condition changes in one call per
+/// status poll, instead of one <see cref="print::IEvtObserver"/> call per
+/// condition.</summary>
+/// <param name="pPrinter">Pointer to <see cref="IPrinter"/> object created by
+/// <see cref="PrintCreateInstance"/>, cannot be NULL.</param>
+/// <param name="pObserver">Observer, NULL to go back to
+/// <see cref="print::IEvtObserver"/> condition callbacks.</param>
+/// <exception cref="wcl::CArgumentNullException">If <paramref name="pPrinter"/> is
+/// NULL.</exception>
+void PrintSetStatusObserver(print::IPrinter* pPrinter, IStatusObserver* pObserver)
+{
+  if(pPrinter == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"pPrinter"); }
+
+  ((CPrinter*)pPrinter)->SetStatusObserver(pObserver);
+}
+
+/// <summary>Prints a job as <see cref="print::IPrinter::Print"/> does, and
+/// retrieves its identifier.</summary>
+/// <param name="pPrinter">Pointer to <see cref="IPrinter"/> object created by
+/// <see cref="PrintCreateInstance"/>, cannot be NULL.</param>
+/// <param name="job">Print job.</param>
+/// <returns>Identifier given to <paramref name="job"/>, never zero.</returns>
+/// <exception cref="wcl::CArgumentNullException">If <paramref name="pPrinter"/> is
+/// NULL.</exception>
+/// <exception cref="wcl::CArgumentException">If template ID of
+/// <paramref name="job"/> is out of range.</exception>
+/// <exception cref="wcl::CInvalidOperationException">If invoked before printer
+/// is initialized.</exception>
+/// <remarks>Identifiers increase with each submitted job. Every job is reported
+/// exactly once, by OnPrintCompleted or OnPrintFailed, in the order of the
+/// identifiers, so the host can tell which job each event belongs to.</remarks>
+DWORD PrintSubmitJob(print::IPrinter* pPrinter, const print::CJob& job)
+{
+  if(pPrinter == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"pPrinter"); }
+
+  return ((CPrinter*)pPrinter)->SubmitJob(job);
+}
+
+/// <summary>Sets status flags reported by printer simulator, selected by
+/// "transport=sim" in <see cref="print::IPrinter::Init"/> parameters.</summary>
+/// <param name="pPrinter">Pointer to <see cref="IPrinter"/> object created by
+/// <see cref="PrintCreateInstance"/>, cannot be NULL.</param>
+/// <param name="flags">Status flags, combination of the flags decoded from
+/// status responses. Busy is added by the simulator while printing.</param>
+/// <returns>True if flags are reported from next status poll on, false if
+/// printer is not simulated.</returns>
+/// <exception cref="wcl::CArgumentNullException">If <paramref name="pPrinter"/> is
+/// NULL.</exception>
+/// <remarks>Lets the host inject paper, door and error conditions to exercise
+/// the driver without a printer.</remarks>
+bool PrintSimSetStatus(print::IPrinter* pPrinter, DWORD flags)
+{
+  if(pPrinter == NULL) { WCL_THROW_ARGUMENTNULLEXCEPTION(L"pPrinter"); }
+
+  return ((CPrinter*)pPrinter)->SetSimStatus(flags);
+}
@@ -4,8 +4,270 @@
 
 #include "printPrinter.h"
 
+/// <summary>Result of a definition in <see cref="SDefineBatch"/>.</summary>
+struct SDefineResult
+{
+  /// <value>True if defined successfully, false otherwise.</value>
+  bool m_bSuccess;
+
+  /// <value>If failed, error code as reported to <see cref="print::IObserver"/>
+  /// (GRAPH_ERR_*, REGION_ERR_* or TEMPL_ERR_*), or -1 if the definition was
+  /// not attempted.</value>
+  int m_nErr;
+};
+
+/// <summary>Receives completion of <see cref="PrintDefineBatch"/>.</summary>
+class IDefineBatchObserver
+{
+public:
+  /// <summary>Destructor.</summary>
+  virtual ~IDefineBatchObserver() {}
+
+  /// <summary>Handles batch definition completed event.</summary>
+  /// <param name="results">Result of each definition, graphics first, then
+  /// regions, then templates, each in the order given.</param>
+  /// <param name="count">Number of elements in <paramref name="results"/>.</param>
+  virtual void OnDefineBatchCompleted(const SDefineResult* results, int count) = 0;
+};
+
+/// <summary>Graphics, regions and templates to be defined in one go.</summary>
+/// <remarks>Definitions are copied, arrays need not outlive the call.</remarks>
+struct SDefineBatch
+{
+  /// <value>Graphics to be defined, may be NULL if <see cref="m_nGraphicCnt"/>
+  /// is zero.</value>
+  const print::CGraphic* m_pGraphics;
+
+  /// <value>Number of elements in <see cref="m_pGraphics"/>.</value>
+  int m_nGraphicCnt;
+
+  /// <value>Regions to be defined, may be NULL if <see cref="m_nRegionCnt"/>
+  /// is zero.</value>
+  const print::CRegion* m_pRegions;
+
+  /// <value>Number of elements in <see cref="m_pRegions"/>.</value>
+  int m_nRegionCnt;
+
+  /// <value>Templates to be defined, may be NULL if <see cref="m_nTemplCnt"/>
+  /// is zero.</value>
+  const print::CTemplate* m_pTemplates;
+
+  /// <value>Number of elements in <see cref="m_pTemplates"/>.</value>
+  int m_nTemplCnt;
+
+  /// <value>Observer to receive completion, may be NULL.</value>
+  IDefineBatchObserver* m_pObserver;
+};
+
+/// <summary>Print failures reported by this driver to
+/// <see cref="print::IPrintObserver::OnPrintFailed"/>, besides the
+/// print::IPrintObserver ones.</summary>
+enum PRINT_ERR_DRV
+{
+  /// <summary>Job discarded without being printed: submitted while suspend is
+  /// pending or queue is full, or still queued when printer suspended,
+  /// disconnected or was un-initialized.</summary>
+  PRINT_ERR_DISCARDED = 0x1000,
+
+  /// <summary>Job sent but printer suspended, failed or disconnected before
+  /// its completion was seen.</summary>
+  PRINT_ERR_INTERRUPTED = 0x1001
+};
+
+/// <summary>Printer conditions reported to <see cref="IStatusObserver"/>, one
+/// bit each.</summary>
+enum STATUS_EVT
+{
+  /// <summary>External power lost.</summary>
+  STATUS_EXT_POWER_LOST     = 0x0001,
+
+  /// <summary>Firmware error.</summary>
+  STATUS_FIRMWARE_ERR       = 0x0002,
+
+  /// <summary>Non-volatile memory error.</summary>
+  STATUS_NVM_ERR            = 0x0004,
+
+  /// <summary>Print head error.</summary>
+  STATUS_PRINT_HEAD_ERR     = 0x0008,
+
+  /// <summary>Print head temperature error.</summary>
+  STATUS_TEMPERATURE_ERR    = 0x0010,
+
+  /// <summary>General error.</summary>
+  STATUS_GENERAL_ERR        = 0x0020,
+
+  /// <summary>Print head opened.</summary>
+  STATUS_PRINT_HEAD_OPENED  = 0x0040,
+
+  /// <summary>Paper jammed.</summary>
+  STATUS_PAPER_JAM          = 0x0080,
+
+  /// <summary>Paper empty.</summary>
+  STATUS_PAPER_EMPTY        = 0x0100,
+
+  /// <summary>Paper at top of form, missing once paper is not.</summary>
+  STATUS_TOP_OF_FORM        = 0x0200,
+
+  /// <summary>Chassis opened.</summary>
+  STATUS_CHASSIS_OPENED     = 0x0400,
+
+  /// <summary>Paper low.</summary>
+  STATUS_PAPER_LOW          = 0x0800
+};
+
+/// <summary>Receives printer condition changes in one call per status poll.
+/// </summary>
+class IStatusObserver
+{
+public:
+  /// <summary>Destructor.</summary>
+  virtual ~IStatusObserver() {}
+
+  /// <summary>Handles printer conditions changed event.</summary>
+  /// <param name="oldMask">Conditions before, combination of
+  /// <see cref="STATUS_EVT"/>.</param>
+  /// <param name="newMask">Conditions now, combination of
+  /// <see cref="STATUS_EVT"/>. Bits that differ from
+  /// <paramref name="oldMask"/> are the ones being reported.</param>
+  virtual void OnStatusChanged(DWORD oldMask, DWORD newMask) = 0;
+
+  /// <summary>Handles graphic upload progress event.</summary>
+  /// <param name="sent">Number of bytes sent so far.</param>
+  /// <param name="total">Size of graphic definition, in number of bytes.
+  /// </param>
+  /// <remarks>Raised after each chunk of a graphic larger than one chunk, the
+  /// last one with <paramref name="sent"/> equal to <paramref name="total"/>.
+  /// Progress not yet delivered is replaced by newer progress.</remarks>
+  virtual void OnUploadProgress(DWORD sent, DWORD total) {}
+};
+
+#define LATENCY_SUB_BUCKETS 8
+#define LATENCY_BUCKET_CNT  240
+
+/// <summary>Commands whose round trip is measured in
+/// <see cref="SDriverStats"/>.</summary>
+enum LATENCY_CMD
+{
+  /// <summary>Print job, until printing completes.</summary>
+  LATENCY_PRINT = 0,
+
+  /// <summary>Region definition, until region is added.</summary>
+  LATENCY_DEFINE_REGION,
+
+  /// <summary>Template definition, until template is added.</summary>
+  LATENCY_DEFINE_TEMPL,
+
+  /// <summary>Template flash transfer, until transfer completes.</summary>
+  LATENCY_FLASH_TRANSFER,
+
+  /// <summary>Program CRC calculation, until CRC is reported.</summary>
+  LATENCY_CRC,
+
+  LATENCY_CMD_CNT
+};
+
+/// <summary>Latency histogram with bounded relative error.</summary>
+/// <remarks>Values below <see cref="LATENCY_SUB_BUCKETS"/> have a bucket each.
+/// Above that, every power of 2 is split into
+/// <see cref="LATENCY_SUB_BUCKETS"/> equal buckets, so a bucket is never wider
+/// than 1/8 of its values. Lower bound of a bucket is given by
+/// <see cref="GetLatencyBucketFloor"/>.</remarks>
+struct SLatencyHist
+{
+  /// <value>Number of values recorded.</value>
+  DWORD m_dwCount;
+
+  /// <value>Smallest value recorded, in microseconds.</value>
+  DWORD m_dwMin;
+
+  /// <value>Largest value recorded, in microseconds.</value>
+  DWORD m_dwMax;
+
+  /// <value>Sum of values recorded, in microseconds.</value>
+  ULONGLONG m_ullSum;
+
+  /// <value>Number of values recorded in each bucket.</value>
+  DWORD m_adwBucket[LATENCY_BUCKET_CNT];
+};
+
+/// <summary>Driver statistics since instance was created.</summary>
+struct SDriverStats
+{
+  /// <value>Time from command write to printer response completing it, by
+  /// <see cref="LATENCY_CMD"/>.</value>
+  SLatencyHist m_aLatency[LATENCY_CMD_CNT];
+
+  /// <value>Number of commands re-sent after printer reported command error.
+  /// </value>
+  DWORD m_dwResendCnt;
+
+  /// <value>Number of command errors reported by printer, including those
+  /// given up after <see cref="m_dwResendCnt"/> resends.</value>
+  DWORD m_dwCmdErrCnt;
+
+  /// <value>Number of times printer was disconnected.</value>
+  DWORD m_dwDisconnectCnt;
+
+  /// <value>Number of received bytes discarded as not part of a valid
+  /// response.</value>
+  DWORD m_dwDiscardedBytes;
+
+  /// <value>Number of bytes written to port.</value>
+  ULONGLONG m_ullBytesWritten;
+
+  /// <value>Number of bytes read from port.</value>
+  ULONGLONG m_ullBytesRead;
+
+  /// <value>Time from observer event posted to observer returning from it.
+  /// </value>
+  SLatencyHist m_EvtLatency;
+
+  /// <value>Number of observer events never delivered as a later event made
+  /// them redundant.</value>
+  DWORD m_dwEvtCoalesced;
+
+  /// <value>Number of observer events dropped as event queue was full and
+  /// could not grow, i.e. out of memory.</value>
+  DWORD m_dwEvtDropped;
+
+  /// <value>Number of state machine runs longer than the reactor stall bound,
+  /// 250 ms, each delaying the other printers sharing the worker thread.
+  /// </value>
+  DWORD m_dwStallCnt;
+
+  /// <value>Number of state machine runs delayed past their due time by more
+  /// than the reactor stall bound, as other printers sharing the worker
+  /// thread stalled it.</value>
+  DWORD m_dwLateCnt;
+
+  /// <value>Total delay of <see cref="m_dwLateCnt"/> runs beyond the stall
+  /// bound, in milliseconds, which was not charged to the printer's timers.
+  /// </value>
+  ULONGLONG m_ullLateTime;
+};
+
+/// <summary>Retrieves lower bound of a bucket of <see cref="SLatencyHist"/>.
+/// </summary>
+/// <param name="index">Bucket index, less than
+/// <see cref="LATENCY_BUCKET_CNT"/>.</param>
+/// <returns>Smallest value counted in the bucket, in microseconds.</returns>
+inline DWORD GetLatencyBucketFloor(int index)
+{
+  if(index < LATENCY_SUB_BUCKETS) { return (DWORD)index; }
+
+  return (DWORD)(LATENCY_SUB_BUCKETS + (index % LATENCY_SUB_BUCKETS)) <<
+    (index / LATENCY_SUB_BUCKETS - 1);
+}
+
 void PrintGetInterfaceVer(WORD* version);
 bool PrintInit();
 void PrintUnInit();
 print::IPrinter* PrintCreateInstance();
 void PrintReleaseInstance(print::IPrinter* pPrinter);
+bool PrintDefineBatch(print::IPrinter* pPrinter, const SDefineBatch& batch);
+void PrintGetDriverStats(print::IPrinter* pPrinter, SDriverStats& stats);
+bool PrintGetUploadProgress(print::IPrinter* pPrinter, DWORD& sent, DWORD& total);
+void PrintCancelUpload(print::IPrinter* pPrinter);
+void PrintSetStatusObserver(print::IPrinter* pPrinter, IStatusObserver* pObserver);
+DWORD PrintSubmitJob(print::IPrinter* pPrinter, const print::CJob& job);
+bool PrintSimSetStatus(print::IPrinter* pPrinter, DWORD flags);
@@ -1,24 +1,446 @@
 #pragma once
 
-#include "ComPort.h"
+#include "transport.h"
 #include "message.h"
 #include "filter.h"
+#include "printdrv_fl_psa66st2r.h"
 
 #define MAX_RESEND_CNT  3
 #define RUN_INTERVAL    10
+#define POLL_INTERVAL   300
+#define POLL_BUSY_INTERVAL 100
+#define ALIVE_TIMEOUT   2000
+#define FLASH_TRANSFER_TIME 2000
+#define PRINT_QUEUE_SIZE 16
+#define RX_RING_SIZE    4096
+#define CACHE_LINE_SIZE 64
+#define RX_FRAME_SIZE   64
+#define RX_FRAME_QUEUE_SIZE 32
+#define TX_CHUNK_SIZE   64
+#define TRACE_RING_SIZE 1024
+#define REACTOR_MAX_WORKERS 4
+#define REACTOR_WORKER_SIZE 31
+#define REACTOR_STALL_MAX 250
+#define TX_TIMEOUT      100
+#define DEF_CACHE_SIZE  1024
+#define FIRMWARE_REGISTRY_SIZE 128
+#define EVT_QUEUE_SIZE  64
+
+/// <summary>Incremental decoder of printer response frames.</summary>
+/// <remarks>Bytes are fed one at a time from the head of the receive buffer,
+/// each byte is examined once, and the parse state is kept between calls so
+/// partially received frames are not rescanned.</remarks>
+class CRespDecoder
+{
+protected:
+  /// <value>Number of bytes fed since last reset.</value>
+  DWORD m_dwLen;
+
+  /// <value>Length of completed frame, 0 if not completed yet.</value>
+  DWORD m_dwFrameLen;
+
+  /// <value>Status response lookup state.</value>
+  int m_nState;
+
+  /// <value>Start index of current status response field.</value>
+  DWORD m_dwStart;
+
+  /// <value>First byte of current status response field.</value>
+  BYTE m_byFieldHead;
+
+  /// <value>True if bytes fed so far can no longer form a status response.</value>
+  bool m_bStatusDead;
+
+  /// <value>First bytes fed, enough to contain a CRC response.</value>
+  BYTE m_abyHead[7];
+
+public:
+  CRespDecoder();
+
+public:
+  void Reset();
+  DWORD Feed(BYTE by);
+
+  DWORD GetLength() const;
+  DWORD GetFrameLength() const;
+};
+
+/// <summary>Retrieves number of bytes fed since last reset.</summary>
+/// <returns>Number of bytes fed.</returns>
+inline DWORD CRespDecoder::GetLength() const
+{
+  return m_dwLen;
+}
+
+/// <summary>Retrieves length of completed frame.</summary>
+/// <returns>Length of completed frame, in number of bytes. 0 if no frame
+/// completed.</returns>
+inline DWORD CRespDecoder::GetFrameLength() const
+{
+  return m_dwFrameLen;
+}
+
+/// <summary>Wait-free single-producer/single-consumer byte ring.</summary>
+/// <remarks>Only one thread may call <see cref="Push"/>, and only one thread
+/// may call the other functions. Each side owns one free-running index and
+/// only reads the other's, so no lock is taken. Indexes are kept on separate
+/// cache lines so the two sides do not invalidate each other's line on every
+/// update.</remarks>
+class CSpscRing
+{
+protected:
+  /// <value>Ring storage, <see cref="RX_RING_SIZE"/> must be a power of 2.
+  /// </value>
+  BYTE m_abyData[RX_RING_SIZE];
+
+  /// <value>Number of bytes ever pushed, written by producer only.</value>
+  volatile DWORD m_dwWrite;
+  BYTE m_abyPadWrite[CACHE_LINE_SIZE - sizeof(DWORD)];
+
+  /// <value>Number of bytes ever popped, written by consumer only.</value>
+  volatile DWORD m_dwRead;
+  BYTE m_abyPadRead[CACHE_LINE_SIZE - sizeof(DWORD)];
+
+public:
+  CSpscRing();
+
+public:
+  // producer.
+  int Push(const BYTE* data, int size);
+
+  // consumer.
+  DWORD GetCount();
+  BYTE GetAt(DWORD index) const;
+  DWORD Pop(BYTE* buffer, DWORD size);
+  void Discard(DWORD size);
+
+  DWORD GetCapacity() const;
+};
+
+/// <summary>Retrieves byte not yet popped, without popping it.</summary>
+/// <param name="index">Index from oldest byte, must be less than last result of
+/// <see cref="GetCount"/>.</param>
+/// <returns>Byte at <paramref name="index"/>.</returns>
+inline BYTE CSpscRing::GetAt(DWORD index) const
+{
+  return m_abyData[(m_dwRead + index) & (RX_RING_SIZE - 1)];
+}
+
+/// <summary>Retrieves capacity.</summary>
+/// <returns>Maximum number of bytes held.</returns>
+inline DWORD CSpscRing::GetCapacity() const
+{
+  return RX_RING_SIZE;
+}
+
+/// <summary>Trace events, arguments are listed in order.</summary>
+/// <remarks>Values are part of the trace format read by the offline decoder,
+/// never renumber them.</remarks>
+enum TRACE_EVT
+{
+  /// <summary>State entered as target: state ID.</summary>
+  TRACE_STATE_ENTER = 1,
+
+  /// <summary>Communication failure: port, system error code.</summary>
+  TRACE_COMM_ERR = 2,
+
+  /// <summary>Unexpected exception in state execution.</summary>
+  TRACE_UNEXPECTED = 3,
+
+  /// <summary>Unknown response: size, first 12 bytes packed little-endian.
+  /// </summary>
+  TRACE_RESP_UNKNOWN = 4,
+
+  /// <summary>Disconnected as alive timer expired.</summary>
+  TRACE_ALIVE_EXPIRED = 5,
+
+  /// <summary>Printer software version changed: first 12 characters of
+  /// version packed as bytes, currency packed as bytes.</summary>
+  TRACE_SOFTWARE_VER = 6,
+
+  /// <summary>Print job sent: job ID.</summary>
+  TRACE_JOB_SENT = 7,
+
+  /// <summary>Print job queued: job ID.</summary>
+  TRACE_JOB_QUEUED = 8,
+
+  /// <summary>Print job ignored: 0 if queue full, 1 if suspend pending.
+  /// </summary>
+  TRACE_JOB_IGNORED = 9,
+
+  /// <summary>Print job failed: job ID.</summary>
+  TRACE_JOB_FAILED = 10,
+
+  /// <summary>Print job completed: job ID.</summary>
+  TRACE_JOB_COMPLETED = 11,
+
+  /// <summary>Queued print jobs discarded: number of jobs.</summary>
+  TRACE_JOBS_DISCARDED = 12,
+
+  /// <summary>Run thread stopped by exception.</summary>
+  TRACE_RUN_EXCEPTION = 13,
+
+  /// <summary>Chunk of streamed command sent: bytes sent, total bytes.
+  /// </summary>
+  TRACE_TX_PROGRESS = 14,
+
+  /// <summary>Streamed command cancelled: bytes sent, total bytes.</summary>
+  TRACE_TX_CANCELLED = 15,
+
+  /// <summary>Queued API call failed by exception: call type.</summary>
+  TRACE_CMD_EXCEPTION = 16
+};
+
+/// <summary>Trace record.</summary>
+/// <remarks>32 bytes, dumped as is for the offline decoder.</remarks>
+struct STraceRec
+{
+  /// <value>Sequence number plus 1, 0 while being written.</value>
+  volatile LONG m_lSeq;
+
+  /// <value>Event, one of <see cref="TRACE_EVT"/>.</value>
+  WORD m_wEvt;
+
+  /// <value>Current state ID when recorded.</value>
+  short m_nsState;
+
+  /// <value>Time recorded, in microseconds of
+  /// <see cref="CPrinterPort::GetTime"/>.</value>
+  ULONGLONG m_ullTime;
+
+  /// <value>Event arguments.</value>
+  DWORD m_adwArg[4];
+};
+
+/// <summary>Lock-free ring of the most recent trace records.</summary>
+/// <remarks>Any thread may <see cref="Add"/>, a slot is claimed with one
+/// interlocked increment and no formatting is done, so tracing stays on in
+/// production. Oldest records are overwritten. Records are formatted offline
+/// from <see cref="Dump"/>.</remarks>
+class CTraceRing
+{
+protected:
+  /// <value>Records, <see cref="TRACE_RING_SIZE"/> must be a power of 2.
+  /// </value>
+  STraceRec m_aRec[TRACE_RING_SIZE];
+
+  /// <value>Number of records ever claimed.</value>
+  volatile LONG m_lNext;
+
+  /// <value>Current state ID, stamped on every record.</value>
+  volatile short m_nsState;
+
+public:
+  CTraceRing();
+
+public:
+  void SetState(int state);
+  void Add(WORD evt, DWORD arg0, DWORD arg1, DWORD arg2, DWORD arg3);
+
+  void Dump(MSXML2::IXMLDOMElement* pElem);
+
+  static DWORD Pack(const BYTE* data, int size);
+  static DWORD Pack(const wchar_t* str, int offset);
+};
+
+/// <summary>Driver statistics, see <see cref="SDriverStats"/>.</summary>
+/// <remarks>Updated from both state and reader threads, all members are
+/// protected by <see cref="m_cs"/>.</remarks>
+class CDrvStats
+{
+protected:
+  /// <value>Statistics.</value>
+  SDriverStats m_Stats;
+
+  /// <value>Time last command was written, in microseconds.</value>
+  ULONGLONG m_ullCmdTime;
+
+  /// <value>Time command before last one was written, in microseconds.</value>
+  ULONGLONG m_ullPrevCmdTime;
+
+  /// <value>Critical section for this object.</value>
+  wcl::CCriticalSection m_cs;
+
+public:
+  CDrvStats();
+
+public:
+  void Reset();
+  void Get(SDriverStats& stats);
+
+  void AddCmd(ULONGLONG time);
+  void AddLatency(int cmd, ULONGLONG rxTime);
+  void AddResend();
+  void AddCmdErr();
+  void AddDisconnect();
+  void AddDiscarded(DWORD cnt);
+  void AddWritten(DWORD cnt);
+  void AddRead(DWORD cnt);
+  void AddEvtLatency(ULONGLONG value);
+  void AddEvtCoalesced(DWORD cnt);
+  void AddEvtDropped();
+  void AddStall();
+  void AddLate(DWORD time);
+
+  void Dump(MSXML2::IXMLDOMElement* pElem);
+
+  static int GetBucket(ULONGLONG value);
+
+protected:
+  static void AddValue(SLatencyHist& hist, ULONGLONG value);
+  static void DumpHist(MSXML2::IXMLDOMElement* pElem, const SLatencyHist& hist);
+};
+
+/// <summary>Printer response frame, as posted by reader thread.</summary>
+struct SRxFrame
+{
+  /// <value>Time frame was received, in microseconds of
+  /// <see cref="CPrinterPort::GetTime"/>.</value>
+  ULONGLONG m_ullRxTime;
+
+  /// <value>Size of <see cref="m_abyData"/> used, in number of bytes.</value>
+  DWORD m_dwLen;
+
+  /// <value>Frame bytes.</value>
+  BYTE m_abyData[RX_FRAME_SIZE];
+};
+
+/// <summary>Wait-free single-producer/single-consumer queue of response
+/// frames.</summary>
+/// <remarks>Follows the rules of <see cref="CSpscRing"/>: the reader thread
+/// fills slots, the state thread drains them.</remarks>
+class CRxFrameQueue
+{
+protected:
+  /// <value>Frame slots, <see cref="RX_FRAME_QUEUE_SIZE"/> must be a power of
+  /// 2.</value>
+  SRxFrame m_aFrame[RX_FRAME_QUEUE_SIZE];
+
+  /// <value>Number of frames ever posted, written by producer only.</value>
+  volatile DWORD m_dwWrite;
+  BYTE m_abyPadWrite[CACHE_LINE_SIZE - sizeof(DWORD)];
+
+  /// <value>Number of frames ever removed, written by consumer only.</value>
+  volatile DWORD m_dwRead;
+  BYTE m_abyPadRead[CACHE_LINE_SIZE - sizeof(DWORD)];
+
+public:
+  CRxFrameQueue();
+
+public:
+  // producer.
+  SRxFrame* GetFree();
+  void Post();
+
+  // consumer.
+  const SRxFrame* GetHead();
+  void Pop();
+  void Clear();
+  DWORD GetCount();
+};
 
 /// <summary>Printer communication port.</summary>
-class CPrinterPort : public CComPort
+/// <remarks>Bytes are read by a dedicated reader thread, running from
+/// <see cref="Open"/> to <see cref="Close"/>, which frames printer responses,
+/// stamps them with their receive time and posts them to the state thread
+/// through <see cref="m_Frames"/>. A slow state thread therefore never delays
+/// draining the transport.</remarks>
+class CPrinterPort
 {
 public:
-  /// <value>Incoming message buffer.</value>
-  CWkCirBuffer<BYTE> m_Buffer;
+  /// <value>Incoming byte buffer, used by reader thread only.</value>
+  CSpscRing m_Buffer;
+
+  /// <value>Decoder of frame at head of <see cref="m_Buffer"/>, used by reader
+  /// thread only.</value>
+  CRespDecoder m_Decoder;
+
+  /// <value>Received frames, posted by reader thread and drained by
+  /// <see cref="GetMsg"/>.</value>
+  CRxFrameQueue m_Frames;
+
+  /// <value>Driver statistics, including bytes moved by this port.</value>
+  CDrvStats m_Stats;
+
+  /// <value>Serial port transport.</value>
+  CSerialTransport m_Serial;
+
+  /// <value>Printer simulator transport.</value>
+  CSimTransport m_Sim;
+
+protected:
+  /// <value>Selected transport, <see cref="m_Serial"/> unless configured
+  /// otherwise.</value>
+  ITransport* m_pTransport;
+
+  /// <value>Handle to reader thread, NULL if not running.</value>
+  HANDLE m_hReader;
+
+  /// <value>Manual-reset event to stop reader thread.</value>
+  HANDLE m_hStopReader;
+
+  /// <value>Auto-reset event set by reader thread when a frame is posted or
+  /// reading failed.</value>
+  HANDLE m_hRxEvent;
+
+  /// <value>True if reader thread failed since last <see cref="GetMsg"/>, set
+  /// and cleared under <see cref="m_csRxErr"/>.</value>
+  volatile bool m_bRxErr;
+
+  /// <value>Message of last reader thread failure, protected by
+  /// <see cref="m_csRxErr"/>.</value>
+  CWkString m_strRxErr;
+
+  /// <value>Critical section for <see cref="m_bRxErr"/> and
+  /// <see cref="m_strRxErr"/>.</value>
+  wcl::CCriticalSection m_csRxErr;
+
+  /// <value>Number of frames dropped as <see cref="m_Frames"/> was full,
+  /// written by reader thread only.</value>
+  volatile DWORD m_dwRxDropped;
+
+  /// <value>Receive time of last frame retrieved by <see cref="GetMsg"/>, in
+  /// microseconds.</value>
+  ULONGLONG m_ullRxTime;
+
+  /// <value>Time of last <see cref="Write"/>, in microseconds.</value>
+  ULONGLONG m_ullTxTime;
+
+  /// <value>Copy of command being streamed by <see cref="Send"/>, followed by
+  /// commands written meanwhile.</value>
+  BYTE *m_pbyTx;
+
+  /// <value>Size of memory allocated for <see cref="m_pbyTx"/>.</value>
+  DWORD m_dwTxMemSize;
+
+  /// <value>True while a command is being streamed.</value>
+  volatile bool m_bTxPending;
+
+  /// <value>Number of bytes in <see cref="m_pbyTx"/>.</value>
+  volatile DWORD m_dwTxSize;
+
+  /// <value>Size of last streamed command, in number of bytes.</value>
+  volatile DWORD m_dwTxCmdSize;
 
-  /// <value>Critical section for <see cref="m_Buffer"/>.</value>
-  wcl::CCriticalSection m_csBuffer;
+  /// <value>Offset in <see cref="m_pbyTx"/> where streamed command ends, less
+  /// than <see cref="m_dwTxCmdSize"/> once its rest is dropped. Commands
+  /// written meanwhile follow.</value>
+  volatile DWORD m_dwTxCmdEnd;
 
-  /// <value>Handshake type, can be "rtsx", "rts", or "x".</value>
-  CWkString m_strHandshake;
+  /// <value>Number of bytes of <see cref="m_pbyTx"/> sent so far.</value>
+  volatile DWORD m_dwTxSent;
+
+  /// <value>True if streamed command is a graphic upload, which
+  /// <see cref="CancelTx"/> may cancel.</value>
+  volatile bool m_bTxCancellable;
+
+  /// <value>Non-zero if cancellation of streamed command was requested.
+  /// </value>
+  volatile LONG m_lTxCancel;
+
+  /// <value>Maximum number of bytes written per <see cref="PumpTx"/>,
+  /// commands not larger than this are written at once.</value>
+  DWORD m_dwTxChunk;
 
 public:
   CPrinterPort();
@@ -27,12 +449,551 @@ public:
 public:
   void Parse(const wchar_t* parameters);
   bool Open();
-  void Poll();
+  void Close();
   DWORD GetMsg(BYTE* buffer, DWORD bufferSize);
+  int GetPort();
+  HANDLE GetRxEvent() const;
+  ULONGLONG GetRxTime() const;
+  ULONGLONG GetTxTime() const;
 
   int Write(BYTE* data, int dataSize);
+  int Send(BYTE* data, int dataSize, bool cancellable = false);
+  bool PumpTx();
+  bool IsTxPending() const;
+  bool IsTxCancellable() const;
+  void CancelTx();
+  void DiscardTx();
+  bool GetTxProgress(DWORD& sent, DWORD& total) const;
+  bool SetSimStatus(DWORD flags);
+
+  void Dump(MSXML2::IXMLDOMElement* pElem);
+
+  static ULONGLONG GetTime();
+
+protected:
+  void QueueTx(BYTE* data, int dataSize);
+  void ClearTx();
+  void Poll(ULONGLONG now);
+  DWORD Extract(BYTE* buffer, DWORD bufferSize);
+  void SetRxErr(const wchar_t* message);
+
+  static DWORD WINAPI _Read(LPVOID lpParameter);
+};
+
+/// <summary>Retrieves event set whenever a frame is available to
+/// <see cref="GetMsg"/>.</summary>
+/// <returns>Handle to auto-reset event, NULL if it could not be created.</returns>
+inline HANDLE CPrinterPort::GetRxEvent() const
+{
+  return m_hRxEvent;
+}
+
+/// <summary>Retrieves receive time of last frame retrieved by
+/// <see cref="GetMsg"/>.</summary>
+/// <returns>Receive time, in microseconds of <see cref="GetTime"/>.</returns>
+inline ULONGLONG CPrinterPort::GetRxTime() const
+{
+  return m_ullRxTime;
+}
+
+/// <summary>Retrieves time of last <see cref="Write"/>.</summary>
+/// <returns>Send time, in microseconds of <see cref="GetTime"/>.</returns>
+inline ULONGLONG CPrinterPort::GetTxTime() const
+{
+  return m_ullTxTime;
+}
+
+/// <summary>Checks if a command is being streamed.</summary>
+/// <returns>True if <see cref="PumpTx"/> has more to send, false otherwise.
+/// </returns>
+inline bool CPrinterPort::IsTxPending() const
+{
+  return m_bTxPending;
+}
+
+/// <summary>Checks if command being streamed may be cancelled.</summary>
+/// <returns>True if a graphic upload is being streamed, false otherwise.
+/// </returns>
+inline bool CPrinterPort::IsTxCancellable() const
+{
+  return m_bTxPending && m_bTxCancellable;
+}
+
+/// <summary>Bounded FIFO of print jobs submitted while printer is busy.</summary>
+/// <remarks>Each job is given a sequential identifier when it is submitted,
+/// completion events are issued to the observer in the same order.</remarks>
+class CPrintQueue
+{
+protected:
+  /// <value>Queued jobs, circular.</value>
+  print::CJob m_aJob[PRINT_QUEUE_SIZE];
+
+  /// <value>Identifiers of <see cref="m_aJob"/>.</value>
+  DWORD m_adwID[PRINT_QUEUE_SIZE];
+
+  /// <value>Index of oldest job in <see cref="m_aJob"/>.</value>
+  int m_nHead;
+
+  /// <value>Number of queued jobs.</value>
+  int m_nCount;
+
+  /// <value>Identifier to be given to next job.</value>
+  DWORD m_dwNextID;
+
+  /// <value>Critical section for this object.</value>
+  wcl::CCriticalSection m_csThis;
+
+public:
+  CPrintQueue();
+
+public:
+  DWORD NewID();
+  bool Push(const print::CJob& job, DWORD id);
+  bool Pop(print::CJob& job, DWORD& id);
+  int GetCount();
+
+  void Dump(MSXML2::IXMLDOMElement* pElem);
+};
+
+/// <summary>Definitions being uploaded by <see cref="CStateDefineBatch"/>.</summary>
+class CDefineBatch
+{
+public:
+  /// <value>Graphics to be defined.</value>
+  print::CGraphic* m_aGraphic;
+
+  /// <value>Number of elements in <see cref="m_aGraphic"/>.</value>
+  int m_nGraphicCnt;
+
+  /// <value>Regions to be defined.</value>
+  print::CRegion* m_aRegion;
+
+  /// <value>Number of elements in <see cref="m_aRegion"/>.</value>
+  int m_nRegionCnt;
+
+  /// <value>Templates to be defined.</value>
+  print::CTemplate* m_aTemplate;
+
+  /// <value>Number of elements in <see cref="m_aTemplate"/>.</value>
+  int m_nTemplCnt;
+
+  /// <value>Result of each definition, graphics, regions, then templates.</value>
+  SDefineResult* m_aResult;
+
+  /// <value>Index of definition in progress.</value>
+  int m_nIndex;
+
+  /// <value>Observer to receive completion, may be NULL.</value>
+  IDefineBatchObserver* m_pObserver;
+
+public:
+  CDefineBatch();
+  ~CDefineBatch();
+
+public:
+  void Assign(const SDefineBatch& batch);
+  void Take(CDefineBatch& src);
+  void Clear();
+  void SetResult(bool success, int err);
+  void Complete();
+
+  int GetCount() const;
+  bool IsGraphic() const;
+  bool IsRegion() const;
+  print::CGraphic& GetGraphic();
+  print::CRegion& GetRegion();
+  print::CTemplate& GetTemplate();
+
+  void Dump(MSXML2::IXMLDOMElement* pElem);
+
+private:
+  CDefineBatch(const CDefineBatch&);
+  CDefineBatch& operator=(const CDefineBatch&);
+};
+
+/// <summary>Retrieves total number of definitions.</summary>
+/// <returns>Number of graphics, regions and templates.</returns>
+inline int CDefineBatch::GetCount() const
+{
+  return m_nGraphicCnt + m_nRegionCnt + m_nTemplCnt;
+}
+
+/// <summary>Checks if definition in progress is a graphic.</summary>
+/// <returns>True if <see cref="m_nIndex"/> refers to a graphic.</returns>
+inline bool CDefineBatch::IsGraphic() const
+{
+  return m_nIndex < m_nGraphicCnt;
+}
+
+/// <summary>Checks if definition in progress is a region.</summary>
+/// <returns>True if <see cref="m_nIndex"/> refers to a region.</returns>
+inline bool CDefineBatch::IsRegion() const
+{
+  return (m_nIndex >= m_nGraphicCnt) && (m_nIndex < (m_nGraphicCnt + m_nRegionCnt));
+}
+
+/// <summary>Retrieves graphic in progress.</summary>
+/// <returns>Graphic referred by <see cref="m_nIndex"/>.</returns>
+inline print::CGraphic& CDefineBatch::GetGraphic()
+{
+  return m_aGraphic[m_nIndex];
+}
+
+/// <summary>Retrieves region in progress.</summary>
+/// <returns>Region referred by <see cref="m_nIndex"/>.</returns>
+inline print::CRegion& CDefineBatch::GetRegion()
+{
+  return m_aRegion[m_nIndex - m_nGraphicCnt];
+}
+
+/// <summary>Retrieves template in progress.</summary>
+/// <returns>Template referred by <see cref="m_nIndex"/>.</returns>
+inline print::CTemplate& CDefineBatch::GetTemplate()
+{
+  return m_aTemplate[m_nIndex - m_nGraphicCnt - m_nRegionCnt];
+}
+
+/// <summary>Definitions known to be held by printer, to skip re-defining
+/// identical content.</summary>
+/// <remarks>Each entry records the hash of the define command last accepted by
+/// printer for a graphic, region or template identifier. Entries are tied to a
+/// firmware version, and saved to file so they survive host restart.</remarks>
+class CDefCache
+{
+public:
+  /// <summary>Kind of definition.</summary>
+  enum KIND
+  {
+    KIND_GRAPHIC = 0,
+    KIND_REGION,
+    KIND_TEMPL
+  };
+
+protected:
+  /// <summary>Cached definition.</summary>
+  struct SEntry
+  {
+    /// <value>Kind in high word, identifier in low word.</value>
+    DWORD m_dwKey;
+
+    /// <value>Hash of define command bytes.</value>
+    ULONGLONG m_ullHash;
+  };
+
+  /// <value>Cached definitions.</value>
+  SEntry m_aEntry[DEF_CACHE_SIZE];
+
+  /// <value>Number of elements used in <see cref="m_aEntry"/>.</value>
+  int m_nCount;
+
+  /// <value>Firmware version the entries belong to.</value>
+  CWkString m_strVersion;
+
+  /// <value>True once printer reported <see cref="m_strVersion"/>, entries
+  /// loaded from file are not trusted before that.</value>
+  bool m_bVerified;
+
+  /// <value>Path of file to persist entries, empty to disable the cache.</value>
+  CWkString m_strFile;
+
+  /// <value>True if entries changed since last <see cref="Save"/>.</value>
+  bool m_bDirty;
+
+  /// <value>Scratch sink to encode define command for hashing.</value>
+  CMsgSink m_Sink;
+
+public:
+  CDefCache();
+
+public:
+  void Load(const wchar_t* file);
+  void SetVersion(const wchar_t* ver);
+  void Invalidate();
+
+  bool IsDefined(const print::CGraphic& graphic);
+  bool IsDefined(const print::CRegion& region);
+  bool IsDefined(const print::CTemplate& templ);
+  void Add(const print::CGraphic& graphic);
+  void Add(const print::CRegion& region);
+  void Add(const print::CTemplate& templ);
+  void Remove(int kind, int id);
+  void Flush();
+
+  void Dump(MSXML2::IXMLDOMElement* pElem);
+
+protected:
+  ULONGLONG Hash(CMsg& msg);
+  int Find(DWORD key);
+  bool IsDefined(DWORD key, ULONGLONG hash);
+  void Add(DWORD key, ULONGLONG hash);
+  void SetDirty();
+  void Save();
+
+private:
+  CDefCache(const CDefCache&);
+  CDefCache& operator=(const CDefCache&);
+};
+
+/// <summary>Firmware specific settings.</summary>
+struct SFirmware
+{
+  /// <summary>Job filter used by firmware.</summary>
+  enum FILTER
+  {
+    FILTER_NONE = 0,
+    FILTER_GUR126003,
+    FILTER_GURNSW200
+  };
+
+  /// <value>Printer software version.</value>
+  CWkString m_strVersion;
+
+  /// <value>Currency, in ISO 4217.</value>
+  CWkString m_strCurrency;
+
+  /// <value>Job filter, one of <see cref="FILTER"/>.</value>
+  int m_nFilter;
+};
+
+/// <summary>Settings of known firmware, sorted by version for binary search.
+/// </summary>
+/// <remarks>Built-in firmware can be overridden, and new firmware added,
+/// through a configuration file, see <see cref="Load"/>.</remarks>
+class CFirmwareRegistry
+{
+protected:
+  /// <value>Known firmware, sorted by <see cref="SFirmware::m_strVersion"/>.
+  /// </value>
+  SFirmware m_aFirmware[FIRMWARE_REGISTRY_SIZE];
+
+  /// <value>Number of elements used in <see cref="m_aFirmware"/>.</value>
+  int m_nCount;
+
+public:
+  CFirmwareRegistry();
+
+public:
+  void Reset();
+  void Load(const wchar_t* file);
+  bool Set(const wchar_t* version, const wchar_t* currency, int filter);
+  const SFirmware* Find(const wchar_t* version) const;
+  int GetCount() const;
 
   void Dump(MSXML2::IXMLDOMElement* pElem);
+
+protected:
+  int Search(const wchar_t* version, bool& found) const;
+
+private:
+  CFirmwareRegistry(const CFirmwareRegistry&);
+  CFirmwareRegistry& operator=(const CFirmwareRegistry&);
+};
+
+/// <summary>Retrieves number of known firmware.</summary>
+/// <returns>Number of known firmware.</returns>
+inline int CFirmwareRegistry::GetCount() const
+{
+  return m_nCount;
+}
+
+/// <summary>Default data of defined templates, resolved per field position.
+/// </summary>
+/// <remarks>Each template's regions are mapped to their default data once, when
+/// the template is stored, and kept up to date as region default data changes.
+/// Filling a print job is then a single walk over its fields.</remarks>
+class CTemplDefData
+{
+protected:
+  /// <summary>Resolved default data of a template.</summary>
+  struct SEntry
+  {
+    /// <value>Number of template fields.</value>
+    int m_nCount;
+
+    /// <value>Number of fields with default data.</value>
+    int m_nDefCnt;
+
+    /// <value>Driver region ID of each field, 0 if it has none.</value>
+    BYTE *m_abyRegion;
+
+    /// <value>Default data of each field, empty if none.</value>
+    CWkString *m_astrDef;
+  };
+
+  /// <value>Entries by driver template ID, NULL if template is not stored.
+  /// </value>
+  SEntry* m_apEntry[256];
+
+public:
+  CTemplDefData();
+  ~CTemplDefData();
+
+public:
+  void Set(BYTE templateID, const print::CTemplate& templ,
+    CWkMapInt<CWkString>& regionDefData);
+  void Remove(BYTE templateID);
+  void SetRegion(BYTE regionID, const wchar_t* defData);
+  bool NeedApply(BYTE templateID, const print::CJob& job);
+  void Apply(BYTE templateID, print::CJob& job);
+
+  void Dump(MSXML2::IXMLDOMElement* pElem);
+
+private:
+  CTemplDefData(const CTemplDefData&);
+  CTemplDefData& operator=(const CTemplDefData&);
+};
+
+/// <summary>Observer events queued by <see cref="CEvtQueue"/>, named after the
+/// <see cref="print::IEvtObserver"/> function.</summary>
+/// <remarks>Condition events come first, numbered by their bit position in
+/// <see cref="STATUS_EVT"/>, and carry whether the condition is present.
+/// </remarks>
+enum OBS_EVT
+{
+  EVT_NONE = -1,
+
+  // conditions, argument is 1 if present, 0 otherwise.
+  EVT_EXT_POWER = 0,
+  EVT_FIRMWARE_ERR,
+  EVT_NVM_ERR,
+  EVT_PRINT_HEAD_ERR,
+  EVT_TEMPERATURE_ERR,
+  EVT_GENERAL_ERR,
+  EVT_PRINT_HEAD,
+  EVT_PAPER_JAM,
+  EVT_PAPER_EMPTY,
+  EVT_TOP_OF_FORM,
+  EVT_CHASSIS,
+  EVT_PAPER_LOW,
+  EVT_COND_CNT,
+
+  // argument is error code.
+  EVT_PRINT_FAILED = EVT_COND_CNT,
+  EVT_DEFINE_GRAPHIC_FAILED,
+  EVT_DEFINE_REGION_FAILED,
+  EVT_DEFINE_TEMPL_FAILED,
+
+  // argument is CRC.
+  EVT_CRC_READY,
+
+  // text is software version.
+  EVT_GAT_REPORT_READY,
+
+  // arguments are old and new mask, see IStatusObserver::OnStatusChanged.
+  EVT_STATUS_CHANGED,
+
+  // arguments are bytes sent and total, see IStatusObserver::OnUploadProgress.
+  EVT_UPLOAD_PROGRESS,
+
+  EVT_CONNECTED,
+  EVT_DISCONNECTED,
+  EVT_READY,
+  EVT_SUSPENDED,
+  EVT_RESUMED,
+  EVT_PRINTING,
+  EVT_PRINT_COMPLETED,
+  EVT_DEFINE_GRAPHIC_SUCCESS,
+  EVT_DEFINE_REGION_SUCCESS,
+  EVT_DEFINE_TEMPL_SUCCESS
+};
+
+/// <summary>Observer event waiting in <see cref="CEvtQueue"/>.</summary>
+struct SObsEvt
+{
+  /// <value>Event, one of <see cref="OBS_EVT"/>, <see cref="EVT_NONE"/> once
+  /// coalesced away.</value>
+  int m_nType;
+
+  /// <value>Event arguments.</value>
+  DWORD m_adwArg[2];
+
+  /// <value>Time event was posted, in microseconds of
+  /// <see cref="CPrinterPort::GetTime"/>.</value>
+  ULONGLONG m_ullTime;
+
+  /// <value>Text argument.</value>
+  wchar_t m_szText[CMsgRespStatus::SOFTWARE_VER_SIZE];
+};
+
+class CPrinterContext;
+
+/// <summary>Queue of observer events, delivered by a dispatcher thread of its
+/// own.</summary>
+/// <remarks>The state machine posts and returns at once, so a slow observer
+/// never delays status polling or response handling. A condition event still
+/// waiting takes the value posted last, and is removed once that value is the
+/// one last delivered, as the host never saw the change. Likewise consecutive
+/// <see cref="EVT_STATUS_CHANGED"/> are merged, and a waiting
+/// <see cref="EVT_UPLOAD_PROGRESS"/> takes the latest progress. So at most one
+/// event of each waits, and the queue only grows past
+/// <see cref="EVT_QUEUE_SIZE"/> with completion events, one per host call, none
+/// of which is dropped unless out of memory.</remarks>
+class CEvtQueue
+{
+protected:
+  /// <value>Event slots, in posting order from <see cref="m_nHead"/>.</value>
+  SObsEvt *m_pEvt;
+
+  /// <value>Number of slots in <see cref="m_pEvt"/>.</value>
+  int m_nSize;
+
+  /// <value>Slot of oldest event.</value>
+  int m_nHead;
+
+  /// <value>Number of slots in use.</value>
+  int m_nCount;
+
+  /// <value>Slot of waiting event of each condition, then for
+  /// <see cref="EVT_STATUS_CHANGED"/> and <see cref="EVT_UPLOAD_PROGRESS"/>, -1
+  /// if none.</value>
+  int m_anPending[EVT_COND_CNT + 2];
+
+  /// <value>Value of each condition last taken for delivery, as observers
+  /// assume after initialization if none yet.</value>
+  DWORD m_adwDelivered[EVT_COND_CNT];
+
+  /// <value>Critical section for slots.</value>
+  wcl::CCriticalSection m_cs;
+
+  /// <value>Auto-reset event set when an event is posted or on stop.</value>
+  HANDLE m_hEvent;
+
+  /// <value>Dispatcher thread, NULL if not running.</value>
+  HANDLE m_hThread;
+
+  /// <value>Identifier of dispatcher thread.</value>
+  DWORD m_dwThreadID;
+
+  /// <value>True once dispatcher thread is asked to stop.</value>
+  volatile bool m_bStop;
+
+  /// <value>Context holding observers and statistics.</value>
+  CPrinterContext *m_pContext;
+
+public:
+  CEvtQueue();
+  ~CEvtQueue();
+
+public:
+  bool Start(CPrinterContext* pContext);
+  void Stop();
+
+  void Post(int type, DWORD arg0 = 0, DWORD arg1 = 0);
+  void PostText(int type, const wchar_t* text);
+
+protected:
+  void Add(const SObsEvt& evt);
+  void ResetDelivered();
+  bool Grow();
+  bool Take(SObsEvt& evt);
+  void Dispatch(const SObsEvt& evt);
+  void Run();
+
+  static DWORD WINAPI _Run(LPVOID lpParameter);
+
+private:
+  CEvtQueue(const CEvtQueue&);
+  CEvtQueue& operator=(const CEvtQueue&);
 };
 
 /// <summary>Printer context.</summary>
@@ -42,9 +1003,13 @@ public:
   /// <value>Printer communication port.</value>
   CPrinterPort m_Port;
 
-  /// <value>True to output detail debug info, false otherwise.</value>
+  /// <value>True to also output every trace record to debugger, false
+  /// otherwise.</value>
   bool m_bDebug;
 
+  /// <value>Most recent trace records.</value>
+  CTraceRing m_Trace;
+
   /// <value>True to enable dumping information to file when unexpected error
   /// occurs, false otherwise.</value>
   bool m_bErrDump;
@@ -52,14 +1017,32 @@ public:
   /// <value>Pointer to event observer.</value>
   print::IEvtObserver* m_pEvtObserver;
 
+  /// <value>Pointer to observer taking condition changes in one call, NULL to
+  /// notify <see cref="m_pEvtObserver"/> per condition.</value>
+  IStatusObserver* m_pStatusObserver;
+
+  /// <value>Conditions last notified to observers, combination of
+  /// <see cref="STATUS_EVT"/>.</value>
+  DWORD m_dwEvtMask;
+
+  /// <value>Events waiting to be delivered to <see cref="m_pEvtObserver"/> or
+  /// <see cref="m_pStatusObserver"/>.</value>
+  CEvtQueue m_Events;
+
   /// <value>Last sent command (excluding status poll).</value>
-  BYTE *m_pbyLastCmd;
+  CMsgSink m_LastCmd;
 
-  /// <value>Size of last sent command, <see cref="m_pbyLastCmd"/>.</value>
-  DWORD m_dwLastCmdSize;
+  /// <value>Jobs waiting for current print job to complete.</value>
+  CPrintQueue m_PrintQueue;
 
-  /// <value>Size of memory allocated for <see cref="m_pbyLastCmt"/>.</value>
-  DWORD m_dwLastCmdMemSize;
+  /// <value>Identifier of print job in progress.</value>
+  DWORD m_dwPrintJobID;
+
+  /// <value>Definitions being uploaded in batch.</value>
+  CDefineBatch m_Batch;
+
+  /// <value>Definitions known to be held by printer.</value>
+  CDefCache m_DefCache;
 
   /// <value>Last graphic definition.</value>
   print::CGraphic m_LastGraphic;
@@ -82,8 +1065,9 @@ public:
   /// <value>Defined template.</value>
   CWkMapInt<print::CTemplate> m_Template;
 
-  /// <value>Handle to Run thread.</value>
-  HANDLE m_hThread;
+  /// <value>Default data of <see cref="m_Template"/>, by field position.
+  /// </value>
+  CTemplDefData m_TemplDefData;
 
   /// <value>True to suspend after initiailization, false otherwise.</value>
   bool m_bInitSuspend;
@@ -94,58 +1078,45 @@ public:
   /// <value>Configured currency.</value>
   CWkString m_strCfgCurrency;
 
-protected:
-  /// <value>True to stop Run thread, false otherwise.</value>
-  bool m_bStopThread;
-
-  /// <value>Critical section for <see cref="m_bStopThread"/>.</value>
-  wcl::CCriticalSection m_csStopThread;
-
-	/// <value>Pointer to current active filter, NULL if no active filter.</value>
-	IJobFilter *m_pJobFilter;
-
-	/// <value>Critical section for <see cref="m_pJobFilter"/>.</value>
-	wcl::CCriticalSection m_csJobFilter;
-
-	/// <value>Job filter for firmware GUR126001.</value>
-	CJobFilterGUR126001 m_JFGUR126001;
-
-	/// <value>Job filter for firmware GUR126003.</value>
-	CJobFilterGUR126003 m_JFGUR126003;
+  /// <value>Known firmware.</value>
+  CFirmwareRegistry m_Firmware;
 
-	/// <value>Job filter for firmware GUR109000.</value>
-	CJobFilterGUR109000 m_JFGUR109000;
+  /// <value>Currency of printer firmware, empty if unknown.</value>
+  CWkString m_strCurrency;
 
-	/// <value>Job filter for firmware GUREUR100.</value>
-	CJobFilterGUREUR100 m_JFGUREUR100;
+  /// <value>Status polling interval while a command is in progress, in
+  /// milliseconds.</value>
+  DWORD m_dwPollBusy;
 
-	/// <value>Job filter for firmware GUREUR101.</value>
-	CJobFilterGUREUR101 m_JFGUREUR101;
+  /// <value>Status polling interval while idle or suspended, in
+  /// milliseconds.</value>
+  DWORD m_dwPollIdle;
 
-	/// <value>Job filter for firmware GUREUR102.</value>
-	CJobFilterGUREUR102 m_JFGUREUR102;
+  /// <value>Time without response before printer is considered disconnected, in
+  /// milliseconds.</value>
+  DWORD m_dwAliveTimeout;
 
-	/// <value>Job filter for firmware GUREUR200.</value>
-	CJobFilterGUREUR200 m_JFGUREUR200;
+  /// <value>Time printer is left alone after flash transfer command, as it
+  /// does not respond meanwhile, in milliseconds.</value>
+  DWORD m_dwFlashTime;
 
-	/// <value>Job filter for firmware GURTOR100.</value>
-	CJobFilterGURTOR100 m_JFGURTOR100;
+protected:
+  /// <value>Event to wake reactor worker running this printer from waiting.
+  /// </value>
+  HANDLE m_hWakeEvent;
 
-	/// <value>Job filter for firmware GURTOR101.</value>
-	CJobFilterGURTOR101 m_JFGURTOR101;
+	/// <value>Pointer to current active filter, NULL if no active filter.</value>
+	IJobFilter *m_pJobFilter;
 
-	/// <value>Job filter for firmware GURUSA001.</value>
-	CJobFilterGURUSA001 m_JFGURUSA001;
+	/// <value>Critical section for <see cref="m_pJobFilter"/>.</value>
+	wcl::CCriticalSection m_csJobFilter;
 
-	/// <value>Job filter for firmware GURUSA003.</value>
-	CJobFilterGURUSA003 m_JFGURUSA003;
+	/// <value>Job filter for firmware GUR126003 and most others.</value>
+	CJobFilterGUR126003 m_JFGUR126003;
 
 	/// <value>Job filter for firmware GURNSW200.</value>
 	CJobFilterGURNSW200 m_JFGURNSW200;
 
-	/// <value>Job filter for firmware GURSNG103.</value>
-	CJobFilterGURSNG103 m_JFGURSNG103;
-
 public:
   CPrinterContext();
   ~CPrinterContext();
@@ -153,77 +1124,51 @@ public:
 public:
   void Parse(const wchar_t* parameters);
 
-  bool StopThread();
-  void SetStopThread(bool stop);
-
-  void Trace(const wchar_t* format, ...);
-  void SendNUpdateLastCmd(CMsg& msg);
+  void Wake();
+  HANDLE GetWakeEvent() const;
+
+  void Trace(WORD evt, DWORD arg0 = 0, DWORD arg1 = 0, DWORD arg2 = 0,
+    DWORD arg3 = 0);
+  void SendNUpdateLastCmd(CMsg& msg, bool cancellable = false);
+  void SendPrintJob(const print::CJob& job, DWORD id);
+  void FailPrintJob(DWORD id);
+  void DiscardPrintJobs();
+  void SetTemplate(BYTE templateID, const print::CTemplate& templ);
+  void RemoveTemplate(BYTE templateID);
+  void SetRegionDefData(BYTE regionID, const wchar_t* defData);
   void UpdateStatusNNotifyObserver(const CStatus& status);
+  void NotifyStatus(DWORD newMask);
+  void ResetEvtMask();
   void UpdateSoftwareVer(const wchar_t* ver);
 
   IJobFilter* GetJobFilter();
 
   void Dump(MSXML2::IXMLDOMElement* pElem);
-
-  static DWORD WINAPI _Run(LPVOID lpParameter);
 };
 
-/// <summary>Output string to debugger if <see cref="m_bDebug"/> is true.</summary>
-/// <param name="format">Format of output string.</param>
-inline void CPrinterContext::Trace(const wchar_t* format, ...)
+/// <summary>Retrieves event set by <see cref="Wake"/>.</summary>
+/// <returns>Handle to auto-reset event, NULL if it could not be created.</returns>
+inline HANDLE CPrinterContext::GetWakeEvent() const
 {
-  va_list args;
-
-  if(m_bDebug)
-  {
-    va_start(args, format);
-    TRACE_ARGS(format, args);
-    va_end(args);
-  } // if...
+  return m_hWakeEvent;
 }
 
-/// <summary>Updates software version.</summary>
-/// <param name="ver">Software version.</param>
-inline void CPrinterContext::UpdateSoftwareVer(const wchar_t* ver)
+/// <summary>Adds a record to <see cref="m_Trace"/>.</summary>
+/// <param name="evt">Event, one of <see cref="TRACE_EVT"/>.</param>
+/// <param name="arg0">First event argument.</param>
+/// <param name="arg1">Second event argument.</param>
+/// <param name="arg2">Third event argument.</param>
+/// <param name="arg3">Fourth event argument.</param>
+inline void CPrinterContext::Trace(WORD evt, DWORD arg0, DWORD arg1, DWORD arg2,
+                                   DWORD arg3)
 {
-	m_strSoftwareVer = ver;
-
-	// select job filter.
-	m_csJobFilter.Enter();
-	m_pJobFilter = NULL;
-	if(m_strSoftwareVer == L"GUR126001") { m_pJobFilter = &m_JFGUR126001; }
-	else if(m_strSoftwareVer == L"GUR126003") { m_pJobFilter = &m_JFGUR126003; }
-	else if(m_strSoftwareVer == L"GUR109000") { m_pJobFilter = &m_JFGUR109000; }
-  else if(m_strSoftwareVer == L"GUREUR100") { m_pJobFilter = &m_JFGUREUR100; }
-  else if(m_strSoftwareVer == L"GUREUR101") { m_pJobFilter = &m_JFGUREUR101; }
-  else if(m_strSoftwareVer == L"GUREUR102") { m_pJobFilter = &m_JFGUREUR102; }
-  else if(m_strSoftwareVer == L"GUREUR200") { m_pJobFilter = &m_JFGUREUR200; }
-  else if(m_strSoftwareVer == L"GURTOR100") { m_pJobFilter = &m_JFGURTOR100; }
-  else if(m_strSoftwareVer == L"GURTOR101") { m_pJobFilter = &m_JFGURTOR101; }
-  else if(m_strSoftwareVer == L"GURUSA001") { m_pJobFilter = &m_JFGURUSA001; }
-  else if(m_strSoftwareVer == L"GURUSA003") { m_pJobFilter = &m_JFGURUSA003; }
-	else if(m_strSoftwareVer == L"GURNSW200")	{ m_pJobFilter = &m_JFGURNSW200; }
-	else if(m_strSoftwareVer == L"GURSNG103")	{ m_pJobFilter = &m_JFGURSNG103; }
-
-	if (m_strSoftwareVer == L"GUREURGE2") { m_pJobFilter = &m_JFGUR126003; }
-	else if (m_strSoftwareVer == L"GURMAC105") { m_pJobFilter = &m_JFGUR126003; }
-	else if (m_strSoftwareVer == L"GURKORGE1") { m_pJobFilter = &m_JFGUR126003; }
-	else if (m_strSoftwareVer == L"GURLKAGE1") { m_pJobFilter = &m_JFGUR126003; }
-	else if (m_strSoftwareVer == L"GURMYSGE0") { m_pJobFilter = &m_JFGUR126003; }
-	else if (m_strSoftwareVer == L"GURPHI101") { m_pJobFilter = &m_JFGUR126003; }
-	else if (m_strSoftwareVer == L"GURSNG103") { m_pJobFilter = &m_JFGUR126003; }
-	else if (m_strSoftwareVer == L"GURTHAGE0") { m_pJobFilter = &m_JFGUR126003; }
-	else if (m_strSoftwareVer == L"GURTHBGE0") { m_pJobFilter = &m_JFGUR126003; }
-	else if (m_strSoftwareVer == L"GURLTG000") { m_pJobFilter = &m_JFGUR126003; }
-	else if (m_strSoftwareVer == L"GURUSAG13") { m_pJobFilter = &m_JFGUR126003; }
-	else if (m_strSoftwareVer == L"GURSAFGE0") { m_pJobFilter = &m_JFGUR126003; }
-	else 
-		m_pJobFilter = &m_JFGUR126003;
-
-
-
+  m_Trace.Add(evt, arg0, arg1, arg2, arg3);
 
-	m_csJobFilter.Leave();
+  if(m_bDebug)
+  {
+    TRACE(L"[printdrv_fl_psa66st2r] trace %u: 0x%X 0x%X 0x%X 0x%X\n", evt, arg0,
+      arg1, arg2, arg3);
+  } // if...
 }
 
 /// <summary>Retrieves currect active job filter.</summary>
@@ -254,16 +1199,185 @@ public:
   /// <param name="elapsed">Time elapsed since last run, in milliseconds.</param>
   virtual void Run(DWORD elapsed) = 0;
 
+  /// <summary>Retrieves time until state needs to run again.</summary>
+  /// <returns>Time until next timer is due, in milliseconds.</returns>
+  virtual DWORD GetIdleTime() { return RUN_INTERVAL; }
+
   ///	<summary>Dump object data to XML.</summary>
   ///	<param name='func'>Name of function which triggers the dump.</param>
   virtual void Dump(const wchar_t* func) {}
 };
 
-/// <summary>Parameters for Run thread.</summary>
+class CState;
+
+/// <summary>API call queued by <see cref="CPrinter"/> for its state machine.
+/// </summary>
+class CApiCmd
+{
+public:
+  /// <summary>Queued calls, named after the <see cref="print::IPrinter"/>
+  /// function.</summary>
+  enum TYPE
+  {
+    TYPE_SUSPEND = 0,
+    TYPE_RESUME,
+    TYPE_SELF_TEST,
+    TYPE_GAT_REPORT,
+    TYPE_CRC,
+    TYPE_DEFINE_GRAPHIC,
+    TYPE_DEFINE_REGION,
+    TYPE_DEFINE_TEMPL,
+    TYPE_PRINT,
+    TYPE_FORM_FEED,
+    TYPE_DEFINE_BATCH
+  };
+
+public:
+  /// <value>Next call in <see cref="CCmdMailbox"/>.</value>
+  CApiCmd* m_pNext;
+
+  /// <value>Call, one of <see cref="TYPE"/>.</value>
+  int m_nType;
+
+  /// <value>Argument of <see cref="TYPE_SELF_TEST"/>.</value>
+  bool m_bClearNVM;
+
+  /// <value>Argument of <see cref="TYPE_CRC"/>.</value>
+  DWORD m_dwSeed;
+
+  /// <value>Argument of <see cref="TYPE_DEFINE_GRAPHIC"/>.</value>
+  print::CGraphic m_Graphic;
+
+  /// <value>Argument of <see cref="TYPE_DEFINE_REGION"/>.</value>
+  print::CRegion m_Region;
+
+  /// <value>Argument of <see cref="TYPE_DEFINE_TEMPL"/>.</value>
+  print::CTemplate m_Templ;
+
+  /// <value>Argument of <see cref="TYPE_PRINT"/>.</value>
+  print::CJob m_Job;
+
+  /// <value>Identifier of <see cref="m_Job"/>.</value>
+  DWORD m_dwJobID;
+
+  /// <value>Argument of <see cref="TYPE_DEFINE_BATCH"/>, taken over by the
+  /// state accepting it.</value>
+  CDefineBatch m_Batch;
+
+public:
+  CApiCmd(int type);
+
+public:
+  void Execute(CState* pTarget);
+  void Fail(CPrinterContext* pContext);
+};
+
+/// <summary>Lock-free queue of API calls, posted by any host thread and taken
+/// by the state machine thread.</summary>
+/// <remarks>Posting pushes on a singly linked list with a single compare and
+/// swap. The consumer takes the whole list at once and reverses it back to
+/// posting order, so it never races with producers on individual nodes.
+/// </remarks>
+class CCmdMailbox
+{
+protected:
+  /// <value>Posted calls, newest first.</value>
+  CApiCmd* volatile m_pHead;
+
+public:
+  CCmdMailbox();
+  ~CCmdMailbox();
+
+public:
+  // producers.
+  void Post(CApiCmd* pCmd);
+
+  // consumer.
+  CApiCmd* TakeAll();
+  void Clear();
+};
+
+/// <summary>Printer instance run by <see cref="CReactor"/>.</summary>
 struct SRunThreadParam
 {
   CPrinterContext *m_pContext;
   IStateMach *m_pStateMach;
+
+  /// <value>Time of last run, in milliseconds of CWkTime::GetTime.</value>
+  DWORD m_dwLastTime;
+
+  /// <value>Time state machine asked to be run again after last run, in
+  /// milliseconds.</value>
+  DWORD m_dwIdleTime;
+};
+
+/// <summary>Process-wide pool of worker threads running the state machines of
+/// every printer instance.</summary>
+/// <remarks>Instances are spread over at most one worker per processor, up to
+/// <see cref="REACTOR_MAX_WORKERS"/>. A worker waits on the wake and receive
+/// events of all its instances at once, and runs an instance's state machine
+/// only from that worker, so each state machine stays single-threaded.
+/// Workers are started with their first instance and stopped with their last.
+/// A run should not block longer than <see cref="REACTOR_STALL_MAX"/>: writes
+/// are at most a chunk, bounded by the serial write timeout, and observers are
+/// called from each printer's event thread. Runs over the bound are counted in
+/// <see cref="SDriverStats::m_dwStallCnt"/>, and the lateness they cause
+/// other instances beyond the bound is not charged to their timers but counted
+/// in <see cref="SDriverStats::m_dwLateCnt"/>.</remarks>
+class CReactor
+{
+protected:
+  /// <summary>Worker thread and the instances it runs.</summary>
+  struct SWorker
+  {
+    /// <value>Handle to worker thread, NULL if not running.</value>
+    HANDLE m_hThread;
+
+    /// <value>ID of worker thread, 0 if not running. A thread whose ID no
+    /// longer matches exits.</value>
+    DWORD m_dwThreadID;
+
+    /// <value>Auto-reset event to make worker re-read its instances.</value>
+    HANDLE m_hCtrl;
+
+    /// <value>Instances run by this worker.</value>
+    SRunThreadParam* m_apInst[REACTOR_WORKER_SIZE];
+
+    /// <value>Number of elements in <see cref="m_apInst"/>.</value>
+    int m_nCount;
+
+    /// <value>Held while worker runs instances, so that an instance is not run
+    /// anymore once <see cref="Unregister"/> returns.</value>
+    wcl::CCriticalSection m_csRun;
+
+    /// <value>Owner reactor.</value>
+    CReactor* m_pOwner;
+  };
+
+  /// <value>Workers, first <see cref="m_nWorkerCnt"/> are used.</value>
+  SWorker m_aWorker[REACTOR_MAX_WORKERS];
+
+  /// <value>Number of workers used.</value>
+  int m_nWorkerCnt;
+
+  /// <value>Critical section for worker's thread and instances.</value>
+  wcl::CCriticalSection m_cs;
+
+public:
+  CReactor();
+  ~CReactor();
+
+public:
+  bool Register(SRunThreadParam* pInst);
+  void Unregister(SRunThreadParam* pInst);
+
+  static CReactor& GetInstance();
+
+protected:
+  void Run(SWorker& worker);
+  bool RunInst(SRunThreadParam* pInst, DWORD now);
+
+  static DWORD WINAPI _Run(LPVOID lpParameter);
 };
 
 /// <summary>Printer state.</summary>
@@ -295,11 +1409,12 @@ public:
 
   virtual CState* GetParent();
 
-  virtual CState* IsAncenstorOf(int id);
+  void Flatten(CState** apState, int size);
 
   virtual void OnEnter(bool isTarget);
   virtual void OnLeave();
   virtual void Run(DWORD elapsed);
+  virtual DWORD GetIdleTime();
   virtual bool HandleResp(BYTE* resp, DWORD size);
 
   virtual void Dump(MSXML2::IXMLDOMElement* pElem);
@@ -318,10 +1433,13 @@ public:
   virtual void Print(const print::CJob& job);
   virtual void FormFeed();
   virtual void GetFirmwareCurrency(CWkString& currency);
+  virtual bool DefineBatch(CDefineBatch& batch);
+
+  virtual void PrintJob(const print::CJob& job, DWORD id);
 
 protected:
   virtual bool HandleRespCRC(BYTE* resp, DWORD size);
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
 };
 
 /// <summary>Implementation of <see cref="print::IPrinter"/> on PSA-66-ST2R.</summary>
@@ -337,9 +1455,28 @@ public:
   /// <value>Pointer to current state.</value>
   CState *m_pCurState;
 
-  /// <value>Critical section for this object.</value>
+  /// <value>States indexed by ID, NULL for unused IDs.</value>
+  CState *m_apState[STATE_CNT];
+
+  /// <value>ID of next state to go from a state (first index) toward a target
+  /// state (second index), -1 if target cannot be reached.</value>
+  signed char m_aanNext[STATE_CNT][STATE_CNT];
+
+  /// <value>Critical section for this object, held by the state machine
+  /// thread and by the calls that still run synchronously.</value>
   wcl::CCriticalSection m_csThis;
 
+  /// <value>API calls waiting for the state machine thread.</value>
+  CCmdMailbox m_Mailbox;
+
+  /// <value>Critical section held while a print job is given its identifier
+  /// and posted, so that jobs reach the mailbox in identifier order.</value>
+  wcl::CCriticalSection m_csSubmit;
+
+  /// <value>True once <see cref="Init"/> succeeded, until
+  /// <see cref="UnInit"/>.</value>
+  volatile bool m_bInit;
+
 public:
   CPrinter();
   virtual ~CPrinter();
@@ -362,9 +1499,25 @@ public:
   virtual void FormFeed();
   virtual void GetFirmwareCurrency(CWkString& currency);
 
+  bool DefineBatch(const SDefineBatch& batch);
+  void GetDriverStats(SDriverStats& stats);
+  bool GetUploadProgress(DWORD& sent, DWORD& total);
+  void CancelUpload();
+  void SetStatusObserver(IStatusObserver* pObserver);
+  DWORD SubmitJob(const print::CJob& job);
+  bool SetSimStatus(DWORD flags);
+
   virtual void Run(DWORD elapsed);
+  virtual DWORD GetIdleTime();
 
   void Dump(MSXML2::IXMLDOMElement* pElem);
   void Dump(MSXML2::IXMLDOMElement* pElem, const wchar_t* func);
   virtual void Dump(const wchar_t* func);
+
+protected:
+  void BuildTransitTable();
+  void CheckInit();
+  void PostCmd(CApiCmd* pCmd);
+  void RunCmds();
+  void FailCmds(CApiCmd* pCmd);
 };
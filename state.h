@@ -51,7 +51,7 @@ public:
   virtual void UnInit();
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
 };
 
 /// <summary>Status polling state.</summary>
@@ -69,6 +69,29 @@ public:
   /// <value>True if a poll status command has been sent, false otherwise.</value>
   bool m_bPolled;
 
+protected:
+  /// <value>Time since <see cref="m_PollStatusTimer"/> reset, in milliseconds.</value>
+  DWORD m_dwSincePoll;
+
+  /// <value>Time since <see cref="m_AliveTimer"/> reset, in milliseconds.</value>
+  DWORD m_dwSinceAlive;
+
+  /// <value>True if a response was handled in last run, more may be buffered.</value>
+  bool m_bRxHandled;
+
+  /// <value>Status polling interval of this state, in milliseconds.</value>
+  DWORD m_dwPollInterval;
+
+  /// <value>Alive timeout of this state, in milliseconds.</value>
+  DWORD m_dwAliveTimeout;
+
+  /// <value>Number of status polls sent and not yet answered.</value>
+  int m_nPollPending;
+
+  /// <value>True if a status poll is held back until the command being
+  /// streamed is sent.</value>
+  bool m_bPollAfterTx;
+
 public:
   CStatePollStatus(IStateMach* pStateMach, CPrinterContext* pContext,
     CState* pParent);
@@ -76,6 +99,15 @@ public:
 public:
   virtual void OnEnter(bool isTarget);
   virtual void Run(DWORD elapsed);
+  virtual DWORD GetIdleTime();
+
+protected:
+  virtual DWORD GetPollInterval();
+  virtual void OnTxCancelled();
+  virtual void OnPollsLost();
+
+  void PollNow();
+  void RunTx();
 };
 
 /// <summary>Initializing state.</summary>
@@ -94,7 +126,7 @@ public:
   virtual void Resume();
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
 };
 
 /// <summary>Disconnected state.</summary>
@@ -115,7 +147,7 @@ public:
   virtual void Run(DWORD elapsed);
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
 };
 
 /// <summary>Ready state.</summary>
@@ -150,7 +182,8 @@ public:
   virtual void CalculateCRC(DWORD seed);
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
+  virtual DWORD GetPollInterval();
 };
 
 /// <summary>Requesting GAT report state.</summary>
@@ -166,7 +199,7 @@ public:
   virtual void OnEnter(bool isTarget);
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
 };
 
 /// <summary>Calculating CRC state.</summary>
@@ -183,7 +216,7 @@ public:
 
 protected:
   virtual bool HandleRespCRC(BYTE* resp, DWORD size);
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
 };
 
 /// <summary>Idling state.</summary>
@@ -202,11 +235,13 @@ public:
   virtual void DefineGraphic(const print::CGraphic& graphic);
   virtual void DefineRegion(const print::CRegion& region);
   virtual void DefineTemplate(const print::CTemplate& templ);
-  virtual void Print(const print::CJob& job);
+  virtual void PrintJob(const print::CJob& job, DWORD id);
   virtual void FormFeed();
+  virtual bool DefineBatch(CDefineBatch& batch);
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
+  virtual DWORD GetPollInterval();
 };
 
 /// <summary>Define graphic state.</summary>
@@ -235,7 +270,7 @@ public:
   virtual void OnEnter(bool isTarget);
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
 };
 
 /// <summary>Add graphic state.</summary>
@@ -251,7 +286,8 @@ public:
   virtual void OnEnter(bool isTarget);
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
+  virtual void OnTxCancelled();
 };
 
 /// <summary>Define region state.</summary>
@@ -280,7 +316,7 @@ public:
   virtual void OnEnter(bool isTarget);
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
 };
 
 /// <summary>Add region state.</summary>
@@ -296,7 +332,7 @@ public:
   virtual void OnEnter(bool isTarget);
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
 };
 
 /// <summary>Define template state.</summary>
@@ -325,7 +361,7 @@ public:
   virtual void OnEnter(bool isTarget);
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
 };
 
 /// <summary>Add template state.</summary>
@@ -341,7 +377,7 @@ public:
   virtual void OnEnter(bool isTarget);
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
 };
 
 /// <summary>Flash transfer state.</summary>
@@ -381,7 +417,7 @@ public:
 	virtual void Run(DWORD elapsed);
 
 protected:
-	virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+	virtual bool HandleRespStatus(const CMsgRespStatus& msg);
 };
 
 /// <summary>Printing state.</summary>
@@ -391,6 +427,18 @@ public:
   /// <value>True if suspend command pending, false otherwise.</value>
   bool m_bSuspendPending;
 
+  /// <value>True if job being printed is not reported to observer yet, false
+  /// otherwise.</value>
+  bool m_bJobPending;
+
+  /// <value>True if printer reported busy since job was sent, false otherwise.
+  /// </value>
+  bool m_bBusySeen;
+
+  /// <value>Number of polled responses not busy while
+  /// <see cref="m_bBusySeen"/> is false.</value>
+  int m_nNotBusyCnt;
+
 public:
   CStatePrinting(IStateMach* pStateMach, CPrinterContext* pContext,
     CState* pParent);
@@ -399,10 +447,66 @@ public:
   virtual int GetID();
 
   virtual void OnEnter(bool isTarget);
+  virtual void OnLeave();
 
   virtual void Suspend();
   virtual void Resume();
+  virtual void PrintJob(const print::CJob& job, DWORD id);
+
+protected:
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
+
+  bool PrintNext();
+};
+
+/// <summary>Batch definition state.</summary>
+/// <remarks>Defines each graphic, region and template of
+/// <see cref="CPrinterContext::m_Batch"/> in turn without returning to idle,
+/// polling status immediately after each command instead of waiting for the
+/// poll timer.</remarks>
+class CStateDefineBatch : public CStatePollStatus
+{
+public:
+  /// <summary>Step of definition in progress.</summary>
+  enum PHASE
+  {
+    PHASE_ADD,
+    PHASE_FLASH,
+    PHASE_FLASH_DONE
+  };
+
+protected:
+  /// <value>Step of definition in progress.</value>
+  int m_nPhase;
+
+  /// <value>Time since flash transfer sent, in milliseconds.</value>
+  DWORD m_dwSinceFlash;
+
+  /// <value>Number of status responses to ignore, as they answer polls sent
+  /// before the command in progress.</value>
+  int m_nSkip;
+
+public:
+  CStateDefineBatch(IStateMach* pStateMach, CPrinterContext* pContext,
+    CState* pParent);
+
+public:
+  virtual int GetID();
+
+  virtual void OnEnter(bool isTarget);
+  virtual void OnLeave();
+  virtual void Run(DWORD elapsed);
+  virtual DWORD GetIdleTime();
 
 protected:
-  virtual bool HandleRespStatus(BYTE* resp, DWORD size);
+  virtual bool HandleRespStatus(const CMsgRespStatus& msg);
+  virtual void OnTxCancelled();
+  virtual void OnPollsLost();
+
+  bool SendItem();
+  bool SendCmd(bool define);
+  bool CheckAddErr(const CStatus& status);
+  bool IsCached();
+  void CommitItem();
+  void NextItem();
 };
@@ -21,3 +21,7 @@
 			#define STATE_FLASH_TRANSFER			23
 			#define STATE_COMPLETE_FLASH_TRANSFER	24
 	  #define STATE_PRINTING        25
+		#define STATE_DEFINE_BATCH    26
+
+// number of state IDs, all IDs above are less than this.
+#define STATE_CNT 27
@@ -0,0 +1,78 @@
+#include "stdafx.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "Check.h"
+
+CCheck* CCheck::s_pFirst = NULL;
+CCheck* CCheck::s_pLast = NULL;
+int CCheck::s_nFailCnt = 0;
+
+/// <summary>Constructor, registers check after those registered before.
+/// </summary>
+/// <param name="name">Name of check, must stay valid.</param>
+/// <param name="pfnFunc">Check function.</param>
+CCheck::CCheck(const char* name, CHECK_FUNC pfnFunc) :
+  m_szName(name),
+  m_pfnFunc(pfnFunc),
+  m_pNext(NULL)
+{
+  if(s_pLast == NULL) { s_pFirst = this; }
+  else { s_pLast->m_pNext = this; }
+  s_pLast = this;
+}
+
+/// <summary>Reports a failed check.</summary>
+/// <param name="file">Source file of check.</param>
+/// <param name="line">Line in <paramref name="file"/>.</param>
+/// <param name="expr">Expression found false.</param>
+/// <returns>False.</returns>
+bool CCheck::Fail(const char* file, int line, const char* expr)
+{
+  printf("%s(%d): CHECK(%s) failed\n", file, line, expr);
+  s_nFailCnt++;
+
+  return false;
+}
+
+/// <summary>Runs registered checks.</summary>
+/// <param name="filter">Part of name of checks to be run, NULL to run every
+/// check.</param>
+/// <returns>Number of checks failed.</returns>
+int CCheck::RunAll(const char* filter)
+{
+  CWkString strTmp;
+  CCheck *pCheck;
+  int prev, cnt = 0, failed = 0;
+
+  for(pCheck = s_pFirst;pCheck != NULL;pCheck = pCheck->m_pNext)
+  {
+    if((filter != NULL) && (strstr(pCheck->m_szName, filter) == NULL)) { continue; }
+
+    printf("[ RUN  ] %s\n", pCheck->m_szName);
+    prev = s_nFailCnt;
+    try
+    {
+      pCheck->m_pfnFunc();
+    }
+    catch(wcl::CSelfDocException& e)
+    {
+      e.ToString(strTmp);
+      wprintf(L"exception: %s\n", (const wchar_t*)strTmp);
+      s_nFailCnt++;
+    }
+    catch(...)
+    {
+      printf("unexpected exception\n");
+      s_nFailCnt++;
+    } // try...catch...
+
+    cnt++;
+    if(s_nFailCnt != prev) { failed++; }
+    printf("[ %s ] %s\n", (s_nFailCnt != prev) ? "FAIL" : " OK ", pCheck->m_szName);
+  } // for...
+
+  printf("%d checks run, %d failed\n", cnt, failed);
+
+  return failed;
+}
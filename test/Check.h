@@ -0,0 +1,47 @@
+#pragma once
+
+/// <summary>Function of a check, see <see cref="CHECK_CASE"/>.</summary>
+typedef void (*CHECK_FUNC)();
+
+/// <summary>Check of driver behaviour, registered at start-up and run by
+/// <see cref="RunAll"/>.</summary>
+/// <remarks>Checks are declared at file scope with <see cref="CHECK_CASE"/>.
+/// A failed <see cref="CHECK"/> is reported and the check goes on, so that a
+/// run lists every failure. An exception escaping a check fails it.</remarks>
+class CCheck
+{
+protected:
+  /// <value>Name of check.</value>
+  const char* m_szName;
+
+  /// <value>Check function.</value>
+  CHECK_FUNC m_pfnFunc;
+
+  /// <value>Next registered check.</value>
+  CCheck* m_pNext;
+
+  /// <value>First registered check.</value>
+  static CCheck* s_pFirst;
+
+  /// <value>Last registered check.</value>
+  static CCheck* s_pLast;
+
+  /// <value>Number of failures reported so far.</value>
+  static int s_nFailCnt;
+
+public:
+  CCheck(const char* name, CHECK_FUNC pfnFunc);
+
+public:
+  static bool Fail(const char* file, int line, const char* expr);
+  static int RunAll(const char* filter);
+};
+
+/// <summary>Declares and registers a check.</summary>
+#define CHECK_CASE(name)  static void name();\
+                          static CCheck s_##name(#name, name);\
+                          static void name()
+
+/// <summary>Reports a failure unless expression is true.</summary>
+/// <returns>Value of expression.</returns>
+#define CHECK(expr) ((expr) ? true : CCheck::Fail(__FILE__, __LINE__, #expr))
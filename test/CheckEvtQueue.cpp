@@ -0,0 +1,211 @@
+#include "stdafx.h"
+#include <stdio.h>
+
+#include "printer.h"
+
+#include "Check.h"
+
+/// <summary>Event queue whose events can be taken without a dispatcher
+/// thread.</summary>
+class CCheckEvtQueue : public CEvtQueue
+{
+public:
+  using CEvtQueue::Take;
+
+public:
+  /// <summary>Takes every waiting event.</summary>
+  /// <param name="aEvt">Receives events, in delivery order.</param>
+  /// <param name="size">Number of elements in <paramref name="aEvt"/>.
+  /// </param>
+  /// <returns>Number of events taken, may exceed <paramref name="size"/>.
+  /// </returns>
+  int TakeAll(SObsEvt* aEvt, int size)
+  {
+    SObsEvt evt;
+    int cnt = 0;
+
+    while(Take(evt))
+    {
+      if(cnt < size) { aEvt[cnt] = evt; }
+      cnt++;
+    } // while...
+
+    return cnt;
+  }
+};
+
+/// <summary>Status observer taking its time, recording the calls it receives.
+/// </summary>
+class CSlowStatusObserver : public IStatusObserver
+{
+public:
+  /// <value>Time each call takes, in milliseconds.</value>
+  DWORD m_dwDelay;
+
+  /// <value>Number of calls received.</value>
+  volatile int m_nCnt;
+
+  /// <value>Conditions before, of first call.</value>
+  DWORD m_dwFirstOld;
+
+  /// <value>Conditions now, of last call.</value>
+  DWORD m_dwLastNew;
+
+  /// <value>True if a call went from other conditions than the previous call
+  /// ended with.</value>
+  bool m_bBroken;
+
+public:
+  CSlowStatusObserver(DWORD delay) :
+    m_dwDelay(delay), m_nCnt(0), m_dwFirstOld(0), m_dwLastNew(0), m_bBroken(false) {}
+
+public:
+  virtual void OnStatusChanged(DWORD oldMask, DWORD newMask)
+  {
+    if(m_nCnt == 0) { m_dwFirstOld = oldMask; }
+    else if(oldMask != m_dwLastNew) { m_bBroken = true; }
+    if(oldMask == newMask) { m_bBroken = true; }
+    m_dwLastNew = newMask;
+    m_nCnt++;
+    Sleep(m_dwDelay);
+  }
+};
+
+/// <summary>A condition changed back before being delivered is not delivered,
+/// one changed again is delivered once with its last value.</summary>
+CHECK_CASE(EvtQueue_CondCoalesce)
+{
+  CCheckEvtQueue queue;
+  SObsEvt aEvt[4];
+
+  queue.Post(EVT_PAPER_LOW, 1);
+  queue.Post(EVT_PAPER_LOW, 0);
+  CHECK(queue.TakeAll(aEvt, 4) == 0);
+
+  queue.Post(EVT_PAPER_LOW, 1);
+  queue.Post(EVT_PAPER_LOW, 0);
+  queue.Post(EVT_PAPER_LOW, 1);
+  if(CHECK(queue.TakeAll(aEvt, 4) == 1))
+  {
+    CHECK(aEvt[0].m_nType == EVT_PAPER_LOW);
+    CHECK(aEvt[0].m_adwArg[0] == 1);
+  }
+
+  // paper is assumed at top of form.
+  queue.Post(EVT_TOP_OF_FORM, 0);
+  queue.Post(EVT_TOP_OF_FORM, 1);
+  CHECK(queue.TakeAll(aEvt, 4) == 0);
+}
+
+/// <summary>Conditions coalesce against the value last delivered.</summary>
+CHECK_CASE(EvtQueue_CondDelivered)
+{
+  CCheckEvtQueue queue;
+  SObsEvt aEvt[4];
+
+  queue.Post(EVT_PAPER_JAM, 1);
+  CHECK(queue.TakeAll(aEvt, 4) == 1);
+
+  queue.Post(EVT_PAPER_JAM, 0);
+  queue.Post(EVT_PAPER_JAM, 1);
+  CHECK(queue.TakeAll(aEvt, 4) == 0);
+
+  queue.Post(EVT_PAPER_JAM, 0);
+  if(CHECK(queue.TakeAll(aEvt, 4) == 1)) { CHECK(aEvt[0].m_adwArg[0] == 0); }
+}
+
+/// <summary>Status changes are merged, from the first conditions to the last,
+/// and dropped if conditions are back to the first ones.</summary>
+CHECK_CASE(EvtQueue_StatusMerge)
+{
+  static const DWORD a = STATUS_TOP_OF_FORM;
+  static const DWORD b = STATUS_TOP_OF_FORM | STATUS_PAPER_LOW;
+  static const DWORD c = STATUS_PAPER_EMPTY;
+  CCheckEvtQueue queue;
+  SObsEvt aEvt[4];
+
+  queue.Post(EVT_STATUS_CHANGED, a, b);
+  queue.Post(EVT_STATUS_CHANGED, b, a);
+  CHECK(queue.TakeAll(aEvt, 4) == 0);
+
+  queue.Post(EVT_STATUS_CHANGED, a, b);
+  queue.Post(EVT_STATUS_CHANGED, b, c);
+  if(CHECK(queue.TakeAll(aEvt, 4) == 1))
+  {
+    CHECK(aEvt[0].m_nType == EVT_STATUS_CHANGED);
+    CHECK((aEvt[0].m_adwArg[0] == a) && (aEvt[0].m_adwArg[1] == c));
+  }
+}
+
+/// <summary>Waiting upload progress is replaced by the latest.</summary>
+CHECK_CASE(EvtQueue_ProgressLatest)
+{
+  CCheckEvtQueue queue;
+  SObsEvt aEvt[4];
+
+  queue.Post(EVT_UPLOAD_PROGRESS, 100, 300);
+  queue.Post(EVT_UPLOAD_PROGRESS, 200, 300);
+  queue.Post(EVT_UPLOAD_PROGRESS, 300, 300);
+  if(CHECK(queue.TakeAll(aEvt, 4) == 1))
+  {
+    CHECK((aEvt[0].m_adwArg[0] == 300) && (aEvt[0].m_adwArg[1] == 300));
+  }
+}
+
+/// <summary>Completion events are never coalesced nor dropped, the queue
+/// grows past its initial size, coalesced events keep their place.</summary>
+CHECK_CASE(EvtQueue_CompletionsKept)
+{
+  static const int cnt = EVT_QUEUE_SIZE * 2;
+  CCheckEvtQueue queue;
+  SObsEvt aEvt[EVT_QUEUE_SIZE * 2 + 2];
+  int i;
+
+  queue.Post(EVT_PAPER_LOW, 1);
+  for(i = 0;i < cnt;i++) { queue.Post(EVT_PRINT_COMPLETED, i); }
+  queue.Post(EVT_PAPER_LOW, 0);
+  queue.Post(EVT_CHASSIS, 1);
+
+  if(!CHECK(queue.TakeAll(aEvt, cnt + 2) == cnt + 1)) { return; }
+  for(i = 0;i < cnt;i++)
+  {
+    if(!CHECK((aEvt[i].m_nType == EVT_PRINT_COMPLETED) && (aEvt[i].m_adwArg[0] == (DWORD)i)))
+    {
+      printf("  event %d\n", i);
+      return;
+    }
+  } // for...
+  CHECK(aEvt[cnt].m_nType == EVT_CHASSIS);
+}
+
+/// <summary>A slow observer does not hold up the poster, and receives the
+/// changes it missed merged.</summary>
+CHECK_CASE(EvtQueue_SlowObserver)
+{
+  CPrinterContext context;
+  CSlowStatusObserver observer(100);
+  DWORD start, elapsed;
+  int i;
+
+  context.m_pStatusObserver = &observer;
+  if(!CHECK(context.m_Events.Start(&context))) { return; }
+
+  start = CWkTime::GetTime();
+  for(i = 0;i < 50;i++)
+  {
+    context.NotifyStatus(((i & 1) == 0) ?
+      (STATUS_TOP_OF_FORM | STATUS_PAPER_LOW) : STATUS_TOP_OF_FORM);
+    Sleep(RUN_INTERVAL);
+  } // for...
+  context.NotifyStatus(STATUS_PAPER_EMPTY);
+  elapsed = CWkTime::GetTime() - start;
+
+  context.m_Events.Stop();
+
+  // observer alone would have taken 5 seconds.
+  CHECK(elapsed < 2000);
+  CHECK((observer.m_nCnt > 0) && (observer.m_nCnt < 25));
+  CHECK(!observer.m_bBroken);
+  CHECK(observer.m_dwFirstOld == STATUS_TOP_OF_FORM);
+  CHECK(observer.m_dwLastNew == STATUS_PAPER_EMPTY);
+}
@@ -0,0 +1,174 @@
+#include "stdafx.h"
+#include <stdio.h>
+
+#include "printer.h"
+
+#include "Check.h"
+
+/// <summary>Number of threads posting at once.</summary>
+static const int POST_THREAD_CNT = 4;
+
+/// <summary>Number of calls posted by each thread.</summary>
+static const int POST_CMD_CNT = 5000;
+
+/// <summary>Posting thread parameter.</summary>
+struct SPostParam
+{
+  /// <value>Mailbox calls are posted to.</value>
+  CCmdMailbox* m_pMailbox;
+
+  /// <value>Manual-reset event releasing every thread at once.</value>
+  HANDLE m_hStart;
+
+  /// <value>Index of thread, carried in the high word of each job ID.</value>
+  DWORD m_dwThread;
+};
+
+/// <summary>Batch observer recording the call it receives.</summary>
+class CBatchRecorder : public IDefineBatchObserver
+{
+public:
+  /// <value>Number of calls received.</value>
+  int m_nCallCnt;
+
+  /// <value>Number of results of last call.</value>
+  int m_nCount;
+
+  /// <value>Number of results of last call reported not attempted.</value>
+  int m_nNotAttempted;
+
+public:
+  CBatchRecorder() : m_nCallCnt(0), m_nCount(0), m_nNotAttempted(0) {}
+
+public:
+  virtual void OnDefineBatchCompleted(const SDefineResult* results, int count)
+  {
+    int i;
+
+    m_nCallCnt++;
+    m_nCount = count;
+    m_nNotAttempted = 0;
+    for(i = 0;i < count;i++)
+    {
+      if(!results[i].m_bSuccess && (results[i].m_nErr == -1)) { m_nNotAttempted++; }
+    }
+  }
+};
+
+/// <summary>Posts calls numbered in the order posted.</summary>
+/// <param name="lpParameter">Pointer to <see cref="SPostParam"/>.</param>
+/// <returns>0.</returns>
+static DWORD WINAPI PostCmds(LPVOID lpParameter)
+{
+  SPostParam *pParam = (SPostParam*)lpParameter;
+  CApiCmd *pCmd;
+  DWORD i;
+
+  ::WaitForSingleObject(pParam->m_hStart, INFINITE);
+  for(i = 0;i < POST_CMD_CNT;i++)
+  {
+    pCmd = new CApiCmd(CApiCmd::TYPE_PRINT);
+    pCmd->m_dwJobID = (pParam->m_dwThread << 16) | i;
+    pParam->m_pMailbox->Post(pCmd);
+  } // for...
+
+  return 0;
+}
+
+/// <summary>Calls taken while being posted from several threads arrive once
+/// each, in the order each thread posted them.</summary>
+CHECK_CASE(Mailbox_Order)
+{
+  CCmdMailbox mailbox;
+  SPostParam aParam[POST_THREAD_CNT];
+  HANDLE ahThread[POST_THREAD_CNT];
+  DWORD adwNext[POST_THREAD_CNT] = {0};
+  HANDLE hStart;
+  CApiCmd *pCmd, *pNext;
+  DWORD thread, seq, start;
+  int i, cnt = 0, bad = 0, takes = 0;
+
+  CHECK(mailbox.TakeAll() == NULL);
+
+  hStart = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+  if(!CHECK(hStart != NULL)) { return; }
+
+  for(i = 0;i < POST_THREAD_CNT;i++)
+  {
+    aParam[i].m_pMailbox = &mailbox;
+    aParam[i].m_hStart = hStart;
+    aParam[i].m_dwThread = i;
+    ahThread[i] = ::CreateThread(NULL, 0, PostCmds, &aParam[i], 0, NULL);
+    CHECK(ahThread[i] != NULL);
+  } // for...
+  ::SetEvent(hStart);
+
+  // consume while producers post.
+  start = CWkTime::GetTime();
+  while((cnt < POST_THREAD_CNT * POST_CMD_CNT) && (CWkTime::GetTime() - start < 10000))
+  {
+    for(pCmd = mailbox.TakeAll();pCmd != NULL;pCmd = pNext)
+    {
+      pNext = pCmd->m_pNext;
+      thread = pCmd->m_dwJobID >> 16;
+      seq = pCmd->m_dwJobID & 0xFFFF;
+      if((thread >= POST_THREAD_CNT) || (seq != adwNext[thread])) { bad++; }
+      else { adwNext[thread]++; }
+      cnt++;
+      delete pCmd;
+    } // for...
+    takes++;
+  } // while...
+
+  for(i = 0;i < POST_THREAD_CNT;i++)
+  {
+    if(ahThread[i] == NULL) { continue; }
+
+    ::WaitForSingleObject(ahThread[i], INFINITE);
+    ::CloseHandle(ahThread[i]);
+  } // for...
+  ::CloseHandle(hStart);
+
+  CHECK(bad == 0);
+  CHECK(cnt == POST_THREAD_CNT * POST_CMD_CNT);
+  for(i = 0;i < POST_THREAD_CNT;i++) { CHECK(adwNext[i] == POST_CMD_CNT); }
+  CHECK(mailbox.TakeAll() == NULL);
+  printf("  %d calls taken in %d takes\n", cnt, takes);
+}
+
+/// <summary>Calls still queued at un-initialization are reported failed and
+/// discarded.</summary>
+/// <remarks>The printer is marked initialized without being run, so that
+/// calls stay in its mailbox.</remarks>
+CHECK_CASE(Mailbox_FailOnUnInit)
+{
+  CPrinter printer;
+  CBatchRecorder recorder;
+  print::CRegion region;
+  print::CTemplate templ;
+  print::CJob job;
+  SDefineBatch batch;
+
+  batch.m_pGraphics = NULL;
+  batch.m_nGraphicCnt = 0;
+  batch.m_pRegions = &region;
+  batch.m_nRegionCnt = 1;
+  batch.m_pTemplates = &templ;
+  batch.m_nTemplCnt = 1;
+  batch.m_pObserver = &recorder;
+
+  CHECK(!printer.DefineBatch(batch));
+
+  printer.m_bInit = true;
+  if(!CHECK(printer.DefineBatch(batch))) { return; }
+  job.m_nsTemplateID = 6;
+  printer.SubmitJob(job);
+  CHECK(recorder.m_nCallCnt == 0);
+
+  printer.UnInit();
+  CHECK(recorder.m_nCallCnt == 1);
+  CHECK(recorder.m_nCount == 2);
+  CHECK(recorder.m_nNotAttempted == 2);
+  CHECK(printer.m_Mailbox.TakeAll() == NULL);
+  CHECK(!printer.m_bInit);
+}
@@ -0,0 +1,16 @@
+// CheckMain.cpp : Runs driver checks, against the printer simulator where a
+// printer is needed.
+//
+
+#include "stdafx.h"
+#include "Check.h"
+
+/// <summary>Entry point.</summary>
+/// <param name="argc">Number of arguments.</param>
+/// <param name="argv">Arguments, the first one, if any, selects checks whose
+/// name contains it.</param>
+/// <returns>0 if every check passed, 1 otherwise.</returns>
+int main(int argc, char* argv[])
+{
+  return (CCheck::RunAll((argc > 1) ? argv[1] : NULL) == 0) ? 0 : 1;
+}
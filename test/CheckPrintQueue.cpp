@@ -0,0 +1,158 @@
+#include "stdafx.h"
+#include <stdio.h>
+
+#include "printer.h"
+
+#include "Check.h"
+
+/// <summary>Number of threads submitting jobs at once.</summary>
+static const int SUBMIT_THREAD_CNT = 4;
+
+/// <summary>Number of jobs submitted by each thread.</summary>
+static const int SUBMIT_JOB_CNT = 100;
+
+/// <summary>Print queue whose next identifier can be set.</summary>
+class CCheckPrintQueue : public CPrintQueue
+{
+public:
+  void SetNextID(DWORD id) { m_dwNextID = id; }
+};
+
+/// <summary>Submitting thread parameter.</summary>
+struct SSubmitParam
+{
+  /// <value>Printer jobs are submitted to.</value>
+  CPrinter* m_pPrinter;
+
+  /// <value>Manual-reset event releasing every thread at once.</value>
+  HANDLE m_hStart;
+
+  /// <value>Identifiers returned, in the order submitted.</value>
+  DWORD m_adwID[SUBMIT_JOB_CNT];
+
+  /// <value>True if a submission threw.</value>
+  bool m_bFailed;
+};
+
+/// <summary>Submits jobs.</summary>
+/// <param name="lpParameter">Pointer to <see cref="SSubmitParam"/>.</param>
+/// <returns>0.</returns>
+static DWORD WINAPI SubmitJobs(LPVOID lpParameter)
+{
+  SSubmitParam *pParam = (SSubmitParam*)lpParameter;
+  print::CJob job;
+  int i;
+
+  job.m_nsTemplateID = 6;
+  ::WaitForSingleObject(pParam->m_hStart, INFINITE);
+  try
+  {
+    for(i = 0;i < SUBMIT_JOB_CNT;i++) { pParam->m_adwID[i] = pParam->m_pPrinter->SubmitJob(job); }
+  }
+  catch(...)
+  {
+    pParam->m_bFailed = true;
+  }
+
+  return 0;
+}
+
+/// <summary>Identifiers are sequential and never zero, also on wrap.</summary>
+CHECK_CASE(PrintQueue_NewID)
+{
+  CCheckPrintQueue queue;
+
+  CHECK(queue.NewID() == 1);
+  CHECK(queue.NewID() == 2);
+
+  queue.SetNextID(0xFFFFFFFF);
+  CHECK(queue.NewID() == 0xFFFFFFFF);
+  CHECK(queue.NewID() == 1);
+  CHECK(queue.NewID() == 2);
+}
+
+/// <summary>Jobs are popped in the order pushed, with their identifiers, up to
+/// the queue size.</summary>
+CHECK_CASE(PrintQueue_Fifo)
+{
+  CPrintQueue queue;
+  print::CJob job;
+  DWORD id;
+  int i;
+
+  CHECK(!queue.Pop(job, id));
+
+  for(i = 0;i < PRINT_QUEUE_SIZE;i++)
+  {
+    job.m_nsTemplateID = (short)i;
+    CHECK(queue.Push(job, queue.NewID()));
+  } // for...
+  CHECK(!queue.Push(job, 0));
+  CHECK(queue.GetCount() == PRINT_QUEUE_SIZE);
+
+  for(i = 0;i < PRINT_QUEUE_SIZE;i++)
+  {
+    if(!CHECK(queue.Pop(job, id))) { break; }
+    CHECK(id == (DWORD)i + 1);
+    CHECK(job.m_nsTemplateID == (short)i);
+  } // for...
+  CHECK(!queue.Pop(job, id));
+  CHECK(queue.GetCount() == 0);
+}
+
+/// <summary>Jobs submitted from several threads at once reach the state
+/// machine in the order of their identifiers.</summary>
+/// <remarks>The printer is marked initialized without being run, so that
+/// calls stay in its mailbox.</remarks>
+CHECK_CASE(PrintQueue_SubmitOrder)
+{
+  CPrinter printer;
+  SSubmitParam aParam[SUBMIT_THREAD_CNT];
+  HANDLE ahThread[SUBMIT_THREAD_CNT];
+  HANDLE hStart;
+  CApiCmd *pCmd, *pNext;
+  DWORD expected = 1;
+  int i, j, cnt = 0;
+
+  hStart = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+  if(!CHECK(hStart != NULL)) { return; }
+
+  printer.m_bInit = true;
+  for(i = 0;i < SUBMIT_THREAD_CNT;i++)
+  {
+    aParam[i].m_pPrinter = &printer;
+    aParam[i].m_hStart = hStart;
+    aParam[i].m_bFailed = false;
+    ahThread[i] = ::CreateThread(NULL, 0, SubmitJobs, &aParam[i], 0, NULL);
+    CHECK(ahThread[i] != NULL);
+  } // for...
+  ::SetEvent(hStart);
+
+  for(i = 0;i < SUBMIT_THREAD_CNT;i++)
+  {
+    if(ahThread[i] == NULL) { continue; }
+
+    ::WaitForSingleObject(ahThread[i], INFINITE);
+    ::CloseHandle(ahThread[i]);
+    if(!CHECK(!aParam[i].m_bFailed)) { continue; }
+
+    for(j = 1;j < SUBMIT_JOB_CNT;j++) { CHECK(aParam[i].m_adwID[j] > aParam[i].m_adwID[j - 1]); }
+  } // for...
+  ::CloseHandle(hStart);
+
+  // mailbox holds every job, oldest first.
+  for(pCmd = printer.m_Mailbox.TakeAll();pCmd != NULL;pCmd = pNext)
+  {
+    pNext = pCmd->m_pNext;
+    if(!CHECK(pCmd->m_dwJobID == expected))
+    {
+      printf("  job %d, ID %u\n", cnt, pCmd->m_dwJobID);
+    }
+    expected = pCmd->m_dwJobID + 1;
+    cnt++;
+    delete pCmd;
+  } // for...
+  CHECK(cnt == SUBMIT_THREAD_CNT * SUBMIT_JOB_CNT);
+
+  printer.m_bInit = false;
+}
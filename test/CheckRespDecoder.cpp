@@ -0,0 +1,260 @@
+#include "stdafx.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "printer.h"
+
+#include "Check.h"
+
+/// <summary>Status response, as answered by <see cref="CSimTransport"/>.
+/// </summary>
+static const char STATUS_RESP[] = "*S|0|GUR126003|@|@|@|@|@|P0|*";
+
+/// <summary>Size of <see cref="STATUS_RESP"/>, in number of bytes.</summary>
+static const DWORD STATUS_RESP_SIZE = sizeof(STATUS_RESP) - 1;
+
+/// <summary>CRC response.</summary>
+static const BYTE CRC_RESP[] = {'*', 'G', '|', 0x12, 0x34, '|', '*'};
+
+/// <summary>Responses corrupted so that they are not a frame.</summary>
+static const char* const BAD_RESP[] =
+{
+  "*X|0|GUR126003|@|@|@|@|@|P0|*",    // unknown command
+  "**S|0|GUR126003|@|@|@|@|@|P0|*",   // command not second
+  "*S0|GUR126003|@|@|@|@|@|P0|*",     // missing command delimiter
+  "*S|0|GUR126003|@@|@|@|@|@|P0|*",   // status flag of 2 bytes
+  "*S|0|GUR126003|@|@|@||@|P0|*",     // empty status flag
+  "*S|0|GUR126003|@|@|@|@|@|Q0|*",    // template not starting with P
+  "*S|0|GUR126003|@|@|@|@|@|P0|x*",   // bytes before terminator
+  "*H|\x12\x34|*",                    // CRC of unknown command
+  "*G|\x12|*"                         // CRC of 1 byte
+};
+
+/// <summary>Pseudo-random generator, so that a failure can be replayed.
+/// </summary>
+/// <param name="seed">Generator state, updated.</param>
+/// <returns>Next value, between 0 and 32767.</returns>
+static int NextRand(DWORD& seed)
+{
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 16) & 0x7FFF);
+}
+
+/// <summary>Retrieves length of first frame at start of bytes, as the message
+/// parsers accept it.</summary>
+/// <param name="data">Bytes.</param>
+/// <param name="dataSize">Size of <paramref name="data"/>, in number of bytes.
+/// </param>
+/// <returns>Length of shortest prefix parsed as CRC or status response, 0 if
+/// none.</returns>
+static DWORD ParseFirst(BYTE* data, DWORD dataSize)
+{
+  CMsgRespCRC respCRC;
+  CMsgRespStatus respStatus;
+  DWORD i;
+
+  for(i = 1;i <= dataSize;i++)
+  {
+    if(respCRC.TryParse(data, i, NULL) || respStatus.TryParse(data, i, NULL))
+    {
+      return i;
+    }
+  } // for...
+
+  return 0;
+}
+
+/// <summary>Feeds bytes to decoder.</summary>
+/// <param name="decoder">Decoder.</param>
+/// <param name="data">Bytes.</param>
+/// <param name="dataSize">Size of <paramref name="data"/>, in number of bytes.
+/// </param>
+/// <returns>Length of completed frame, 0 if none completed.</returns>
+static DWORD FeedAll(CRespDecoder& decoder, const BYTE* data, DWORD dataSize)
+{
+  DWORD i, len = 0;
+
+  for(i = 0;(i < dataSize) && (len == 0);i++) { len = decoder.Feed(data[i]); }
+
+  return len;
+}
+
+/// <summary>Waits for a frame from port.</summary>
+/// <param name="port">Port.</param>
+/// <param name="buffer">Buffer to receive frame.</param>
+/// <param name="bufferSize">Size of <paramref name="buffer"/>, in number of
+/// bytes.</param>
+/// <param name="timeout">Time to wait, in milliseconds.</param>
+/// <returns>Size of frame, 0 if none arrived in time.</returns>
+static DWORD WaitMsg(CPrinterPort& port, BYTE* buffer, DWORD bufferSize,
+                     DWORD timeout)
+{
+  DWORD len, start = CWkTime::GetTime();
+
+  while((len = port.GetMsg(buffer, bufferSize)) == 0)
+  {
+    if(CWkTime::GetTime() - start >= timeout) { break; }
+    ::WaitForSingleObject(port.GetRxEvent(), RUN_INTERVAL);
+  } // while...
+
+  return len;
+}
+
+/// <summary>Complete frames are found at their last byte, bytes after are
+/// ignored until reset.</summary>
+CHECK_CASE(RespDecoder_Frames)
+{
+  CRespDecoder decoder;
+  DWORD i;
+
+  for(i = 0;i < STATUS_RESP_SIZE - 1;i++)
+  {
+    CHECK(decoder.Feed(STATUS_RESP[i]) == 0);
+  }
+  CHECK(decoder.Feed(STATUS_RESP[i]) == STATUS_RESP_SIZE);
+  CHECK(decoder.Feed('*') == STATUS_RESP_SIZE);
+  CHECK(decoder.GetFrameLength() == STATUS_RESP_SIZE);
+  CHECK(decoder.GetLength() == STATUS_RESP_SIZE);
+
+  decoder.Reset();
+  CHECK(decoder.GetFrameLength() == 0);
+  for(i = 0;i < sizeof(CRC_RESP) - 1;i++) { CHECK(decoder.Feed(CRC_RESP[i]) == 0); }
+  CHECK(decoder.Feed(CRC_RESP[i]) == sizeof(CRC_RESP));
+}
+
+/// <summary>A truncated response is never a frame.</summary>
+CHECK_CASE(RespDecoder_Truncated)
+{
+  CRespDecoder decoder;
+  DWORD len;
+
+  for(len = 1;len < STATUS_RESP_SIZE;len++)
+  {
+    decoder.Reset();
+    CHECK(FeedAll(decoder, (const BYTE*)STATUS_RESP, len) == 0);
+    CHECK(decoder.GetLength() == len);
+  } // for...
+
+  for(len = 1;len < sizeof(CRC_RESP);len++)
+  {
+    decoder.Reset();
+    CHECK(FeedAll(decoder, CRC_RESP, len) == 0);
+  } // for...
+}
+
+/// <summary>A corrupted response is never a frame, nor for the message
+/// parsers.</summary>
+CHECK_CASE(RespDecoder_Garbage)
+{
+  CRespDecoder decoder;
+  BYTE buffer[64];
+  DWORD len;
+  int i;
+
+  for(i = 0;i < (int)(sizeof(BAD_RESP) / sizeof(BAD_RESP[0]));i++)
+  {
+    len = (DWORD)strlen(BAD_RESP[i]);
+    memcpy(buffer, BAD_RESP[i], len);
+
+    decoder.Reset();
+    if(!CHECK(FeedAll(decoder, buffer, len) == 0))
+    {
+      printf("  response: %s\n", BAD_RESP[i]);
+    }
+    CHECK(ParseFirst(buffer, len) == 0);
+  } // for...
+}
+
+/// <summary>On mutated responses, the decoder finds the same frame as the
+/// message parsers.</summary>
+CHECK_CASE(RespDecoder_MatchesParsers)
+{
+  static const char alphabet[] = "*|SGP0@";
+  CRespDecoder decoder;
+  BYTE buffer[64];
+  DWORD seed = 1, len, expected;
+  int trial, i, j, pos;
+
+  for(trial = 0;trial < 20000;trial++)
+  {
+    if((trial & 1) == 0)
+    {
+      len = STATUS_RESP_SIZE;
+      memcpy(buffer, STATUS_RESP, len);
+    }
+    else
+    {
+      len = sizeof(CRC_RESP);
+      memcpy(buffer, CRC_RESP, len);
+    } // if...else...
+
+    // replace, insert or remove a few bytes, keeping the header.
+    for(i = NextRand(seed) % 4;i > 0;i--)
+    {
+      pos = 1 + NextRand(seed) % (len - 1);
+      switch(NextRand(seed) % 3)
+      {
+      case 0:
+        buffer[pos] = alphabet[NextRand(seed) % (sizeof(alphabet) - 1)];
+        break;
+      case 1:
+        if(len >= 44) { break; }
+        for(j = len;j > pos;j--) { buffer[j] = buffer[j - 1]; }
+        buffer[pos] = alphabet[NextRand(seed) % (sizeof(alphabet) - 1)];
+        len++;
+        break;
+      default:
+        if(len <= 2) { break; }
+        for(j = pos;j < (int)len - 1;j++) { buffer[j] = buffer[j + 1]; }
+        len--;
+        break;
+      } // switch...
+    } // for...
+
+    expected = ParseFirst(buffer, len);
+    decoder.Reset();
+    if(!CHECK(FeedAll(decoder, buffer, len) == expected))
+    {
+      printf("  trial %d, expected %u\n", trial, expected);
+      return;
+    }
+  } // for...
+}
+
+/// <summary>Port delivers every frame received, in order, after skipping
+/// garbage and a false header, and waits for the rest of a frame received
+/// in part.</summary>
+CHECK_CASE(RespDecoder_PortResync)
+{
+  CPrinterPort port;
+  SDriverStats stats;
+  BYTE buffer[64];
+  DWORD len;
+
+  port.Parse(L"transport=sim");
+  if(!CHECK(port.Open())) { return; }
+
+  // garbage, then a header the frame after cannot complete, then 2 frames.
+  port.m_Sim.Inject((const BYTE*)"xx*S|*", 6);
+  port.m_Sim.Inject((const BYTE*)STATUS_RESP, STATUS_RESP_SIZE);
+  port.m_Sim.Inject((const BYTE*)STATUS_RESP, STATUS_RESP_SIZE);
+
+  len = WaitMsg(port, buffer, sizeof(buffer), 1000);
+  CHECK((len == STATUS_RESP_SIZE) && (memcmp(buffer, STATUS_RESP, len) == 0));
+  len = WaitMsg(port, buffer, sizeof(buffer), 1000);
+  CHECK((len == STATUS_RESP_SIZE) && (memcmp(buffer, STATUS_RESP, len) == 0));
+
+  // only garbage and false header are discarded.
+  port.m_Stats.Get(stats);
+  CHECK(stats.m_dwDiscardedBytes == 6);
+
+  // first part of a frame is kept until the rest arrives.
+  port.m_Sim.Inject(CRC_RESP, 3);
+  CHECK(WaitMsg(port, buffer, sizeof(buffer), 100) == 0);
+  port.m_Sim.Inject(CRC_RESP + 3, sizeof(CRC_RESP) - 3);
+  len = WaitMsg(port, buffer, sizeof(buffer), 1000);
+  CHECK((len == sizeof(CRC_RESP)) && (memcmp(buffer, CRC_RESP, len) == 0));
+
+  CHECK(port.GetMsg(buffer, sizeof(buffer)) == 0);
+  port.Close();
+}
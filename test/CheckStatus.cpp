@@ -0,0 +1,231 @@
+#include "stdafx.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "printer.h"
+
+#include "Check.h"
+
+/// <summary>Status observer recording the calls it receives.</summary>
+class CStatusRecorder : public IStatusObserver
+{
+public:
+  /// <summary>Maximum number of calls recorded.</summary>
+  static const int CALL_MAX = 64;
+
+public:
+  /// <value>Conditions before, of each call.</value>
+  DWORD m_adwOld[CALL_MAX];
+
+  /// <value>Conditions now, of each call.</value>
+  DWORD m_adwNew[CALL_MAX];
+
+  /// <value>Number of calls received, may exceed <see cref="CALL_MAX"/>.
+  /// </value>
+  volatile int m_nCnt;
+
+public:
+  CStatusRecorder() : m_nCnt(0) {}
+
+public:
+  virtual void OnStatusChanged(DWORD oldMask, DWORD newMask)
+  {
+    if(m_nCnt < CALL_MAX)
+    {
+      m_adwOld[m_nCnt] = oldMask;
+      m_adwNew[m_nCnt] = newMask;
+    }
+    m_nCnt++;
+  }
+};
+
+/// <summary>Encodes status flags as the printer reports them.</summary>
+/// <param name="flags">Combination of <see cref="CStatus::FLAG"/>.</param>
+/// <param name="bytes">Receives the 5 status flag bytes.</param>
+static void EncodeFlags(DWORD flags, BYTE bytes[5])
+{
+  // printer sets the bit when it is NOT ready.
+  flags ^= CStatus::FLAG_READY_TO_RX;
+
+  bytes[0] = (BYTE)(0x40 | (flags & 0x3F));
+  bytes[1] = (BYTE)(0x40 | ((flags >> 6) & 0x3F));
+  bytes[2] = (BYTE)(0x40 | ((flags >> 12) & 0x3F));
+  bytes[3] = (BYTE)(0x40 | ((flags >> 18) & 0x0F));
+  bytes[4] = (BYTE)(0x40 | ((flags >> 22) & 0x3F));
+}
+
+/// <summary>Checks that observer calls chain from the conditions assumed after
+/// initialization up to the final ones.</summary>
+/// <param name="recorder">Observer.</param>
+/// <param name="finalMask">Conditions notified last.</param>
+static void CheckChain(const CStatusRecorder& recorder, DWORD finalMask)
+{
+  int i;
+
+  if(!CHECK((recorder.m_nCnt > 0) && (recorder.m_nCnt <= CStatusRecorder::CALL_MAX))) { return; }
+
+  CHECK(recorder.m_adwOld[0] == STATUS_TOP_OF_FORM);
+  for(i = 0;i < recorder.m_nCnt;i++)
+  {
+    CHECK(recorder.m_adwOld[i] != recorder.m_adwNew[i]);
+    if(i > 0) { CHECK(recorder.m_adwOld[i] == recorder.m_adwNew[i - 1]); }
+  } // for...
+  CHECK(recorder.m_adwNew[recorder.m_nCnt - 1] == finalMask);
+}
+
+/// <summary>Every flag carried by a status response is decoded to its own
+/// bit, ready to receive being reported inverted.</summary>
+CHECK_CASE(Status_SetFlags)
+{
+  CStatus status;
+  BYTE bytes[5];
+  DWORD bit;
+
+  for(bit = 1;bit != 0;bit <<= 1)
+  {
+    if((bit & CStatus::FLAG_MASK) == 0) { continue; }
+
+    EncodeFlags(bit, bytes);
+    status.SetFlags(bytes[0], bytes[1], bytes[2], bytes[3], bytes[4]);
+    if(!CHECK(status.m_dwFlags == bit)) { printf("  flag 0x%08X\n", bit); }
+  } // for...
+
+  EncodeFlags(0, bytes);
+  status.SetFlags(bytes[0], bytes[1], bytes[2], bytes[3], bytes[4]);
+  CHECK(status.m_dwFlags == 0);
+}
+
+/// <summary>Flags are mapped to the conditions reported to observers.
+/// </summary>
+CHECK_CASE(Status_EvtMask)
+{
+  static const struct { DWORD m_dwFlags; DWORD m_dwMask; } map[] =
+  {
+    { 0, 0 },
+    { CStatus::FLAG_VOLTAGE_ERR, STATUS_EXT_POWER_LOST },
+    { CStatus::FLAG_FLASH_ERR, STATUS_FIRMWARE_ERR },
+    { CStatus::FLAG_PRINT_HEAD_ERR, STATUS_PRINT_HEAD_ERR },
+    { CStatus::FLAG_TEMPERATURE_ERR, STATUS_TEMPERATURE_ERR },
+    { CStatus::FLAG_NO_FONT, STATUS_GENERAL_ERR },
+    { CStatus::FLAG_OFF_LINE, STATUS_GENERAL_ERR },
+    { CStatus::FLAG_JOURNAL_MODE, STATUS_GENERAL_ERR },
+    { CStatus::FLAG_PRINT_HEAD_OPEN, STATUS_PRINT_HEAD_OPENED },
+    { CStatus::FLAG_PAPER_JAM, STATUS_PAPER_JAM },
+    { CStatus::FLAG_PAPER_OUT, STATUS_PAPER_EMPTY },
+    { CStatus::FLAG_WRONG_PAPER, STATUS_PAPER_EMPTY },
+    { CStatus::FLAG_DOOR_OPENED, STATUS_CHASSIS_OPENED },
+    { CStatus::FLAG_PAPER_LOW, STATUS_PAPER_LOW },
+    { CStatus::FLAG_BUSY | CStatus::FLAG_READY_TO_RX, 0 },
+    { CStatus::FLAG_PAPER_LOW | CStatus::FLAG_DOOR_OPENED,
+      STATUS_PAPER_LOW | STATUS_CHASSIS_OPENED }
+  };
+  CStatus status;
+  int i;
+
+  for(i = 0;i < (int)(sizeof(map) / sizeof(map[0]));i++)
+  {
+    status.m_dwFlags = map[i].m_dwFlags;
+    if(!CHECK(status.GetEvtMask() == (map[i].m_dwMask | STATUS_TOP_OF_FORM)))
+    {
+      printf("  flags 0x%08X\n", map[i].m_dwFlags);
+    }
+  } // for...
+}
+
+/// <summary>Status response is decoded with its flags.</summary>
+CHECK_CASE(Status_RespParse)
+{
+  static const char head[] = "*S|0|GUR126003|";
+  CMsgRespStatus resp;
+  BYTE buffer[64], bytes[5];
+  DWORD flags = CStatus::FLAG_PAPER_LOW | CStatus::FLAG_DOOR_OPENED |
+    CStatus::FLAG_READY_TO_RX;
+  int i, len;
+
+  len = (int)strlen(head);
+  memcpy(buffer, head, len);
+  EncodeFlags(flags, bytes);
+  for(i = 0;i < 5;i++)
+  {
+    buffer[len++] = bytes[i];
+    buffer[len++] = '|';
+  } // for...
+  buffer[len++] = 'P';
+  buffer[len++] = '0';
+  buffer[len++] = '|';
+  buffer[len++] = '*';
+
+  if(!CHECK(resp.TryParse(buffer, len, NULL))) { return; }
+  CHECK(resp.m_dwUnitAddr == 0);
+  CHECK(wcscmp(resp.m_szSoftwareVer, L"GUR126003") == 0);
+  CHECK(resp.m_Status.m_dwFlags == flags);
+}
+
+/// <summary>Only changed conditions are notified, each call going from the
+/// conditions notified before to the new ones.</summary>
+CHECK_CASE(Status_NotifyMask)
+{
+  static const DWORD masks[] =
+  {
+    STATUS_TOP_OF_FORM,
+    STATUS_TOP_OF_FORM | STATUS_PAPER_LOW,
+    STATUS_TOP_OF_FORM | STATUS_PAPER_LOW,
+    STATUS_TOP_OF_FORM | STATUS_PAPER_LOW | STATUS_CHASSIS_OPENED,
+    STATUS_TOP_OF_FORM | STATUS_CHASSIS_OPENED,
+    STATUS_TOP_OF_FORM | STATUS_PAPER_EMPTY,
+    STATUS_PAPER_EMPTY
+  };
+  CPrinterContext context;
+  CStatusRecorder recorder;
+  int i;
+
+  context.m_pStatusObserver = &recorder;
+  if(!CHECK(context.m_Events.Start(&context))) { return; }
+
+  for(i = 0;i < (int)(sizeof(masks) / sizeof(masks[0]));i++)
+  {
+    context.NotifyStatus(masks[i]);
+    CHECK(context.m_dwEvtMask == masks[i]);
+    ::Sleep(RUN_INTERVAL);
+  } // for...
+
+  context.m_Events.Stop();
+  CheckChain(recorder, STATUS_PAPER_EMPTY);
+
+  // unchanged conditions are not notified.
+  i = recorder.m_nCnt;
+  context.m_Events.Start(&context);
+  context.NotifyStatus(STATUS_PAPER_EMPTY);
+  context.m_Events.Stop();
+  CHECK(recorder.m_nCnt == i);
+}
+
+/// <summary>Flags that change no condition are not notified, conditions
+/// changed by a status poll are notified once.</summary>
+CHECK_CASE(Status_NotifyFlags)
+{
+  CPrinterContext context;
+  CStatusRecorder recorder;
+  CStatus status;
+
+  context.m_pStatusObserver = &recorder;
+  if(!CHECK(context.m_Events.Start(&context))) { return; }
+
+  status.m_dwFlags = CStatus::FLAG_READY_TO_RX;
+  context.UpdateStatusNNotifyObserver(status);
+  status.m_dwFlags = CStatus::FLAG_BUSY;
+  context.UpdateStatusNNotifyObserver(status);
+  context.m_Events.Stop();
+  CHECK(recorder.m_nCnt == 0);
+
+  context.m_Events.Start(&context);
+  status.m_dwFlags = CStatus::FLAG_BUSY | CStatus::FLAG_PAPER_LOW |
+    CStatus::FLAG_DOOR_OPENED;
+  context.UpdateStatusNNotifyObserver(status);
+  context.m_Events.Stop();
+
+  if(!CHECK(recorder.m_nCnt == 1)) { return; }
+  CHECK(recorder.m_adwOld[0] == STATUS_TOP_OF_FORM);
+  CHECK(recorder.m_adwNew[0] ==
+    (STATUS_TOP_OF_FORM | STATUS_PAPER_LOW | STATUS_CHASSIS_OPENED));
+}
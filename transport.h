@@ -0,0 +1,246 @@
+#pragma once
+
+#include "ComPort.h"
+
+/// <summary>Byte transport beneath <see cref="CPrinterPort"/>.</summary>
+/// <remarks>Transport only moves bytes, framing of printer responses is done
+/// by <see cref="CPrinterPort"/>.</remarks>
+class ITransport
+{
+public:
+  /// <summary>Destructor.</summary>
+  virtual ~ITransport() {}
+
+  /// <summary>Extracts transport related parameters.</summary>
+  /// <param name="parameters">Parameters string.</param>
+  virtual void Parse(const wchar_t* parameters) = 0;
+
+  /// <summary>Opens transport.</summary>
+  /// <returns>True if opened successfully, false otherwise.</returns>
+  virtual bool Open() = 0;
+
+  /// <summary>Closes transport.</summary>
+  virtual void Close() = 0;
+
+  /// <summary>Reads received bytes.</summary>
+  /// <param name="buffer">Buffer to receive bytes.</param>
+  /// <param name="bufferSize">Size of <paramref name="buffer"/>, in number of
+  /// bytes.</param>
+  /// <returns>Number of bytes read, zero if none received.</returns>
+  /// <exception cref="CCommException">If transport failed.</exception>
+  virtual int Read(BYTE* buffer, int bufferSize) = 0;
+
+  /// <summary>Writes bytes.</summary>
+  /// <param name="data">Data to be written.</param>
+  /// <param name="dataSize">Size of <paramref name="data"/>, in number of bytes.</param>
+  /// <returns>Number of bytes written.</returns>
+  /// <exception cref="CCommException">If not all bytes are written.</exception>
+  virtual int Write(BYTE* data, int dataSize) = 0;
+
+  /// <summary>Waits until bytes are received or timeout.</summary>
+  /// <param name="timeout">Maximum time to wait, in milliseconds.</param>
+  /// <param name="hWake">Event to abort the wait, NULL if none.</param>
+  /// <returns>True if bytes are available for <see cref="Read"/>, false if
+  /// timeout or woken by <paramref name="hWake"/>.</returns>
+  virtual bool WaitRx(DWORD timeout, HANDLE hWake) = 0;
+
+  /// <summary>Checks if <see cref="WaitRx"/> blocks until bytes arrive.</summary>
+  /// <returns>True if waiting is supported, false if caller should poll.</returns>
+  virtual bool CanWaitRx() = 0;
+
+  /// <summary>Retrieves port number, for diagnostic messages.</summary>
+  /// <returns>Port number.</returns>
+  virtual int GetPort() = 0;
+
+  /// <summary>Dumps object's state into XML DOM element for debug purposes.</summary>
+  /// <param name="pElem">Pointer to XML DOM element.</param>
+  virtual void Dump(MSXML2::IXMLDOMElement* pElem) = 0;
+};
+
+/// <summary>Win32 serial port transport.</summary>
+class CSerialTransport : public CComPort, public ITransport
+{
+public:
+  /// <value>Handshake type, can be "rtsx", "rts", or "x".</value>
+  CWkString m_strHandshake;
+
+  /// <value>True to block on the port until bytes arrive or the next timer is
+  /// due, false to poll the port every <see cref="RUN_INTERVAL"/>.</value>
+  bool m_bRxWait;
+
+  /// <value>Time a write may take beyond twice the line time of its bytes,
+  /// e.g. held back by handshake, in milliseconds.</value>
+  DWORD m_dwTxTimeout;
+
+protected:
+  /// <value>Event signalled by the port when a receive event completes.</value>
+  HANDLE m_hRxEvent;
+
+public:
+  CSerialTransport();
+  virtual ~CSerialTransport();
+
+public:
+  virtual void Parse(const wchar_t* parameters);
+  virtual bool Open();
+  virtual void Close();
+  virtual int Read(BYTE* buffer, int bufferSize);
+  virtual int Write(BYTE* data, int dataSize);
+  virtual bool WaitRx(DWORD timeout, HANDLE hWake);
+  virtual bool CanWaitRx();
+  virtual int GetPort();
+
+  virtual void Dump(MSXML2::IXMLDOMElement* pElem);
+};
+
+/// <summary>In-process transport, bytes are exchanged with a peer in the same
+/// process instead of a device.</summary>
+/// <remarks>The peer, <see cref="CSimTransport"/>, calls <see cref="Inject"/>
+/// to deliver response bytes and <see cref="Drain"/> to collect command bytes.
+/// </remarks>
+class CMemTransport : public ITransport
+{
+protected:
+  /// <value>Bytes from peer, not yet read.</value>
+  CWkCirBuffer<BYTE> m_RxBuffer;
+
+  /// <value>Bytes written, not yet drained by peer.</value>
+  CWkCirBuffer<BYTE> m_TxBuffer;
+
+  /// <value>Critical section for <see cref="m_RxBuffer"/> and
+  /// <see cref="m_TxBuffer"/>.</value>
+  wcl::CCriticalSection m_csThis;
+
+  /// <value>Event set while <see cref="m_RxBuffer"/> is not empty.</value>
+  HANDLE m_hRxEvent;
+
+  /// <value>Auto-reset event set when bytes are written for peer.</value>
+  HANDLE m_hTxEvent;
+
+  /// <value>Auto-reset event set when peer drains bytes, waking a
+  /// <see cref="Write"/> waiting for room.</value>
+  HANDLE m_hRoomEvent;
+
+  /// <value>Time <see cref="Write"/> waits for peer to drain, in milliseconds,
+  /// as the serial port write timeout.</value>
+  static const DWORD WRITE_TIMEOUT = 1000;
+
+  /// <value>True if opened, false otherwise.</value>
+  bool m_bOpened;
+
+public:
+  CMemTransport();
+  virtual ~CMemTransport();
+
+public:
+  virtual void Parse(const wchar_t* parameters);
+  virtual bool Open();
+  virtual void Close();
+  virtual int Read(BYTE* buffer, int bufferSize);
+  virtual int Write(BYTE* data, int dataSize);
+  virtual bool WaitRx(DWORD timeout, HANDLE hWake);
+  virtual bool CanWaitRx();
+  virtual int GetPort();
+
+  int Inject(const BYTE* data, int dataSize);
+  int Drain(BYTE* buffer, int bufferSize);
+  bool WaitTx(DWORD timeout, HANDLE hWake);
+
+  virtual void Dump(MSXML2::IXMLDOMElement* pElem);
+};
+
+/// <summary>Printer simulator, answering the driver through
+/// <see cref="CMemTransport"/> from a thread of its own.</summary>
+/// <remarks>Status polls are answered from modelled flags, print, form feed
+/// and flash transfer commands keep the printer busy for a configured time,
+/// CRC requests are answered, other commands are accepted as they are. Used to
+/// run the driver end to end without a printer.</remarks>
+class CSimTransport : public CMemTransport
+{
+protected:
+  /// <summary>State of command parser.</summary>
+  enum PARSE
+  {
+    PARSE_IDLE,   ///< Waiting for command start.
+    PARSE_HEAD,   ///< Collecting command header.
+    PARSE_DATA    ///< Skipping binary data of a definition.
+  };
+
+  /// <value>Size of <see cref="m_abyHead"/>, in number of bytes.</value>
+  static const int HEAD_SIZE = 32;
+
+  /// <value>Handle to simulator thread, NULL if not running.</value>
+  HANDLE m_hSim;
+
+  /// <value>Manual-reset event to stop simulator thread.</value>
+  HANDLE m_hStopSim;
+
+  /// <value>Critical section for <see cref="m_dwFlags"/>.</value>
+  wcl::CCriticalSection m_csSim;
+
+  /// <value>Reported status flags, combination of <see cref="CStatus::FLAG"/>,
+  /// busy is added while a command is being processed.</value>
+  DWORD m_dwFlags;
+
+  /// <value>Time print, form feed and flash transfer keep printer busy, in
+  /// milliseconds.</value>
+  DWORD m_dwBusyTime;
+
+  /// <value>Simulated line speed, in bits per second, zero if unlimited.
+  /// </value>
+  DWORD m_dwBaud;
+
+  /// <value>One of this many response bytes is corrupted, zero if none.</value>
+  DWORD m_dwCorrupt;
+
+  /// <value>Software version reported in status responses.</value>
+  char m_szVer[16];
+
+  /// <value>Parser state, one of <see cref="PARSE"/>.</value>
+  int m_nParse;
+
+  /// <value>Header of command being parsed.</value>
+  BYTE m_abyHead[HEAD_SIZE];
+
+  /// <value>Number of bytes of command parsed so far, may exceed
+  /// <see cref="HEAD_SIZE"/>.</value>
+  int m_nHeadLen;
+
+  /// <value>Number of data bytes left to skip.</value>
+  DWORD m_dwSkip;
+
+  /// <value>Time printer stops being busy, in milliseconds.</value>
+  DWORD m_dwBusyEnd;
+
+  /// <value>True while printer is busy.</value>
+  bool m_bBusy;
+
+  /// <value>Template identifier reported in status responses.</value>
+  BYTE m_byTemplate;
+
+  /// <value>Number of response bytes sent, to corrupt one of
+  /// <see cref="m_dwCorrupt"/>.</value>
+  DWORD m_dwRespCnt;
+
+public:
+  CSimTransport();
+  virtual ~CSimTransport();
+
+public:
+  virtual void Parse(const wchar_t* parameters);
+  virtual bool Open();
+  virtual void Close();
+
+  void SetStatus(DWORD flags);
+
+  virtual void Dump(MSXML2::IXMLDOMElement* pElem);
+
+protected:
+  void Run();
+  void Feed(BYTE by);
+  void Execute();
+  void RespondStatus();
+  void Respond(const BYTE* data, int dataSize);
+
+  static DWORD WINAPI _Run(LPVOID lpParameter);
+};